@@ -0,0 +1,192 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#ifndef CORRELATION_H
+#define CORRELATION_H
+
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <Eigen/Core>
+
+namespace pteros {
+
+/** Computes correlation functions of time series by FFT in O(n log n).
+ The series are zero-padded to avoid periodic wrap-around, so the result is exactly
+ the same as direct summation over all time origins.
+ The object keeps FFT plan and work buffers, so it should be reused for many series
+ of the same length. It is not thread-safe, use separate object in each thread.
+*/
+class Fft_correlator {
+public:
+    /// Prepares the correlator for series of length n
+    explicit Fft_correlator(int n);
+    ~Fft_correlator();
+
+    /// Length of series
+    int size() const;
+
+    /// Computes c(m) = sum_k x(k)*x(k+m) for m=0..n-1. Result is not normalized.
+    void autocorrelation(const Eigen::Ref<const Eigen::VectorXd>& x, Eigen::Ref<Eigen::VectorXd> c);
+
+    /// Computes c(m) = sum_k x(k)*y(k+m) for m=0..n-1. Result is not normalized.
+    void correlation(const Eigen::Ref<const Eigen::VectorXd>& x,
+                     const Eigen::Ref<const Eigen::VectorXd>& y,
+                     Eigen::Ref<Eigen::VectorXd> c);
+
+private:
+    class Fft_correlator_impl;
+    std::unique_ptr<Fft_correlator_impl> p;
+};
+
+
+/** Stores time series of observables collected in each frame and computes
+ their time correlation functions by FFT.
+ The observable in each frame consists of num_series() vectors with num_dim() components,
+ for example dipoles of all molecules (dim=3) or single scalar (series=1, dim=1).
+ Correlation of vectors is the sum of correlations of their components.
+
+ Frames are identified by valid frame index and may be added in any order,
+ so the stores filled by instances of parallel task could be merged in collect_data():
+ \code
+ // In process_frame()
+ corr.add_frame(info.valid_frame,values);
+ // In collect_data()
+ for(auto& t: tasks) corr.merge(dynamic_cast<my_task*>(t.get())->corr);
+ VectorXd c = corr.autocorrelation(max_lag,false,true);
+ \endcode
+ All frames between the first and the last one should be present when correlations are computed.
+
+ Values could be stored in memory in single or half precision (4 or 2 bytes per value)
+ or in temporary file on disk if the series do not fit into memory.
+ Correlations of different series are computed in parallel.
+*/
+class Time_correlation {
+public:
+    enum Storage {
+        Float, ///< Single precision in memory
+        Half,  ///< Half precision in memory (about 3 significant digits)
+        Disk   ///< Single precision in temporary file
+    };
+
+    Time_correlation();
+    Time_correlation(int n_series, int n_dim = 1, Storage storage = Float);
+    Time_correlation(const Time_correlation& other);
+    Time_correlation& operator=(const Time_correlation& other);
+    ~Time_correlation();
+
+    /// Sets the shape of observable and storage type. Removes all stored frames.
+    void create(int n_series, int n_dim = 1, Storage storage = Float);
+
+    /// Adds values of the observable in frame fr. Layout is [series][dim].
+    void add_frame(int fr, const Eigen::Ref<const Eigen::VectorXf>& values);
+
+    /// Adds all frames of other store with the same shape. Store can't be merged with itself.
+    void merge(const Time_correlation& other);
+
+    int num_series() const { return n_series; }
+    int num_dim() const { return n_dim; }
+    int num_frames() const { return frames.size(); }
+
+    /** Autocorrelation <a(0).a(t)> averaged over all time origins and all series
+     * for lags 0..max_lag frames. If max_lag<0 all lags are computed.
+     * @param subtract_mean Subtract time average of each component (gives covariance).
+     * @param normalize Divide by the value at zero lag.
+     */
+    Eigen::VectorXd autocorrelation(int max_lag = -1, bool subtract_mean = false, bool normalize = false) const;
+
+    /// Autocorrelations of each series in columns
+    Eigen::MatrixXd autocorrelation_per_series(int max_lag = -1, bool subtract_mean = false, bool normalize = false) const;
+
+    /// Cross-correlation <a_i(0).a_j(t)> of series i and j averaged over all time origins
+    Eigen::VectorXd cross_correlation(int i, int j, int max_lag = -1, bool subtract_mean = false) const;
+
+    /// Time series of all components of series [b:e) in columns ordered by frame
+    void get_series(int b, int e, Eigen::MatrixXd& res) const;
+
+private:
+    int n_series;
+    int n_dim;
+    Storage storage;
+    // Frame index of each stored record in the order of addition
+    std::vector<int> frames;
+    // Record of each frame contains n_series*n_dim values
+    std::vector<float> data_float;
+    std::vector<Eigen::half> data_half;
+    FILE* file;
+
+    int record_size() const { return n_series*n_dim; }
+    // Reads n values starting from value b of record k
+    void read_record(int k, int b, int n, float* buf) const;
+    void close_file();
+    // Order of records by frame. Throws if frames are missing.
+    std::vector<int> frame_order() const;
+};
+
+
+/** Streaming multiple-tau correlator for very long series.
+ Correlation is accumulated on the fly at quasi-logarithmically spaced lags:
+ the values are averaged by blocks of m frames at each next level,
+ so the memory does not depend on the length of series and the cost per frame is constant.
+ The result at large lags is approximate due to block averaging.
+ Frames should be added in order, so it is suitable for serial tasks.
+ Shape of observable is the same as in Time_correlation.
+*/
+class Multi_tau_correlator {
+public:
+    /**
+     * @param p Number of lags at each level
+     * @param m Averaging factor between levels
+     * @param n_levels Number of levels. Largest lag is about p*m^(n_levels-1) frames
+     */
+    Multi_tau_correlator(int n_series, int n_dim = 1, int p = 16, int m = 2, int n_levels = 20);
+
+    /// Adds values of the next frame
+    void add_frame(const Eigen::Ref<const Eigen::VectorXf>& values);
+
+    /// Returns lags in frames and autocorrelation averaged over series for all lags with data
+    void get_result(Eigen::VectorXd& lags, Eigen::VectorXd& corr) const;
+
+private:
+    int n_series, n_dim, p, m;
+    struct Level {
+        Eigen::MatrixXd shift;  // Circular buffer of values, p columns
+        Eigen::MatrixXd corr;   // Sums of products for each lag
+        std::vector<long> n_corr;
+        Eigen::VectorXd accum;  // Accumulator of values for the next level
+        int n_accum = 0;
+        int insert = 0;         // Position of the next value in circular buffer
+        long n_values = 0;      // Number of values added to level
+    };
+    std::vector<Level> levels;
+    void add(const Eigen::VectorXd& v, int k);
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#ifndef MSD_H
+#define MSD_H
+
+#include <vector>
+#include <Eigen/Core>
+#include "pteros/core/typedefs.h"
+
+namespace pteros {
+
+/** Compact store of 3D vectors (positions or velocities) of a fixed set of points
+ in consecutive frames.
+ Frames are appended one after another as single precision numbers,
+ so adding the frame never moves the data of other points.
+*/
+class Vector_series {
+public:
+    Vector_series(): n_points(0), n_frames(0) {}
+    explicit Vector_series(int n): n_points(n), n_frames(0) {}
+
+    /// Sets the number of points and removes all frames
+    void reset(int n);
+
+    /// Appends vectors of all points for the next frame. v should have num_points() columns.
+    void add_frame(const Eigen::Ref<const Eigen::Matrix3Xf>& v);
+
+    int num_points() const { return n_points; }
+    int num_frames() const { return n_frames; }
+
+    /// Time series of coordinate dim (0,1,2) of point p
+    void get_series(int p, int dim, Eigen::Ref<Eigen::VectorXd> res) const;
+
+private:
+    int n_points;
+    int n_frames;
+    // Layout is [frame][point][dim]
+    std::vector<float> data;
+};
+
+/** Computes mean square displacement averaged over all time origins for lags 0..num_frames-1.
+ The FFT algorithm is used, which costs O(T log T) per point instead of O(T^2)
+ for direct summation over time origins. Points are processed in parallel.
+ Positions should not contain periodic jumps (use Jump_remover).
+ @param pos Positions of points.
+ @param dims Dimensions to consider, for example (1,1,0) gives lateral MSD in XY plane.
+ @param group Group of each point 0..n_groups-1. If empty all points are in single group.
+ @return Matrix with MSD of each group in columns. Points are averaged within group.
+*/
+Eigen::MatrixXd msd_fft(const Vector_series& pos,
+                        Array3i_const_ref dims = fullPBC,
+                        const std::vector<int>& group = {});
+
+/** Computes time autocorrelation <v(0).v(t)> of vectors averaged over all time origins
+ for lags 0..num_frames-1 by FFT. When applied to velocities gives velocity autocorrelation function.
+ Parameters are the same as for msd_fft(). Result is not normalized to the value at zero lag.
+*/
+Eigen::MatrixXd vector_autocorrelation_fft(const Vector_series& v,
+                                           Array3i_const_ref dims = fullPBC,
+                                           const std::vector<int>& group = {});
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#ifndef RESIDENCE_H
+#define RESIDENCE_H
+
+#include <vector>
+#include <Eigen/Core>
+
+namespace pteros {
+
+/// Statistics of visits of single molecule to the region accumulated by Residence_tracker
+struct Residence_stats {
+    /// Number of frames where the molecule is inside
+    int num_frames;
+    /// Number of separate visits
+    int num_visits;
+    /// Mean duration of visit in frames
+    float mean_time;
+    /// Longest visit in frames
+    int max_time;
+};
+
+/** Tracks presence of molecules (for example waters or ions) in some region,
+ such as the solvation shell or the binding site, to compute their residence times.
+
+ Presence of each molecule is stored as run-length encoded intervals of frames,
+ so memory is proportional to the number of visits rather than to the number of frames.
+ Frames are valid frame indexes and may come in any order, so partial trackers
+ filled by parallel trajectory tasks could be merged. All frames between
+ the first and the last one should be present when results are computed.
+
+ Short excursions of the molecule out of the region could be ignored:
+ the absences, which last no more than given tolerance, are treated as presence.
+*/
+class Residence_tracker {
+public:
+    Residence_tracker(): n_mol(0) {}
+    explicit Residence_tracker(int n) { create(n); }
+
+    /// Sets the number of molecules and removes all frames
+    void create(int n);
+
+    /// Records molecules, which are inside the region in frame fr
+    void add_frame(int fr, const std::vector<int>& inside);
+
+    /// Adds data from other tracker with the same number of molecules
+    void merge(const Residence_tracker& other);
+
+    int num_molecules() const { return n_mol; }
+    /// Number of frames from the first one to the last one
+    int num_frames() const;
+
+    /// Visits of molecule i as [first,last+1) intervals of frames counted from the first frame.
+    /// Absences not longer than tolerance frames are bridged.
+    std::vector<Eigen::Vector2i> get_visits(int i, int tolerance = 0) const;
+
+    /// Statistics of visits of all molecules
+    std::vector<Residence_stats> get_stats(int tolerance = 0) const;
+
+    /// Number of molecules inside in each frame
+    Eigen::VectorXi occupancy() const;
+
+    /// Number of molecules, which enter and leave the region in each frame.
+    /// Molecules present in the first frame are not counted as entering.
+    void exchange(Eigen::VectorXi& entered, Eigen::VectorXi& left, int tolerance = 0) const;
+
+    /** Survival probability S(t) for lags 0..max_lag frames: probability that the molecule,
+     which is inside at some time origin, stays inside continuously for time t.
+     Averaged over all molecules and time origins. Only the origins, for which the whole
+     interval of length t fits into the trajectory, are counted.
+     If max_lag<0 all lags are computed.
+    */
+    Eigen::VectorXd survival_probability(int max_lag = -1, int tolerance = 0) const;
+
+private:
+    int n_mol;
+    // Sorted non-adjacent [first,last+1) intervals of frames for each molecule
+    std::vector<std::vector<Eigen::Vector2i>> visits;
+    // Bitmap of added frames
+    std::vector<bool> frames;
+    // Checks that frames are consecutive and returns their range
+    void frame_range(int& first, int& n) const;
+};
+
+}
+
+#endif
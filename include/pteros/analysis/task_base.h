@@ -43,11 +43,26 @@ public:
     // Default implementation of global preprocess for parallel tasks
     virtual void before_spawn(){}
 
+    // Default implementation of collector for multiprocess tasks.
+    // Receives serialized results of all worker processes, which consumed some frames.
+    virtual void collect_results(const std::vector<std::string>& results, int n_frames){}
+
 protected:
     virtual void set_id(int _id){ task_id = _id; }
 
     virtual bool is_parallel() = 0;    
 
+    // Parallel tasks, which can't run in threads (like Python tasks because of GIL),
+    // are run in forked worker processes instead
+    virtual bool is_multiprocess(){ return false; }
+
+    // Called in master process right before fork() and in both processes after it
+    virtual void before_fork(){}
+    virtual void after_fork(bool is_child){}
+
+    // Serialized result of worker process instance, which is sent to the master
+    virtual std::string get_result(){ return ""; }
+
     // Handlers, which call actual functions
     // Could be overriden in subclasses
     virtual void before_spawn_handler(){
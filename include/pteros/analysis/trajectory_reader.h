@@ -44,6 +44,33 @@ using Task_ptr = std::shared_ptr<Task_base> ;
 using Data_channel = Message_channel<std::shared_ptr<pteros::Data_container> > ;
 using Data_channel_ptr = std::shared_ptr<Data_channel> ;
 
+/// Throughput statistics of the last trajectory processing run
+struct Trajectory_reader_stats {
+    Trajectory_reader_stats(): wall_time(0), frames_read(0), read_time(0),
+        reader_wait(0), consumer_wait(0), mean_occupancy(0), max_occupancy(0),
+        buffer_size(0), dispatch_wait(0) {}
+
+    /// Total wall time in seconds
+    double wall_time;
+    /// Number of frames read from trajectory files
+    int frames_read;
+    /// Time spent by reader thread in reading frames
+    double read_time;
+    /// Time reader thread was blocked by full frame buffer (consumers are slower than reader)
+    double reader_wait;
+    /// Total time consumers of reader buffer were waiting for frames (reader is slower than consumers)
+    double consumer_wait;
+    /// Mean and maximal number of frames in the reader buffer
+    double mean_occupancy;
+    int max_occupancy;
+    /// Size of the frame buffer
+    int buffer_size;
+    /// For several serial tasks: time each task was waiting for frames from dispatcher
+    std::vector<double> task_wait;
+    /// For several serial tasks: time dispatcher was blocked by full buffers of tasks
+    double dispatch_wait;
+};
+
 /** The base class for trajectory processing
 *   It provides facilities for loading large trajectories by frames
 *   and to analyze each frame by user-defined function.
@@ -80,6 +107,9 @@ public:
             tasks.push_back( task );
         }        
 
+        /// Statistics of the last run
+        const Trajectory_reader_stats& get_stats() const { return stats; }
+
 private:
 
         // Options
@@ -92,6 +122,8 @@ private:
         std::vector<Task_ptr> tasks;
 
         bool is_parallel;
+
+        Trajectory_reader_stats stats;
 };
 
 }
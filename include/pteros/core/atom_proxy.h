@@ -30,6 +30,7 @@
 #pragma once
 
 #include "pteros/core/atom.h"
+#include "pteros/core/copy_on_write.h"
 #include <Eigen/Core>
 
 namespace pteros {
@@ -39,9 +40,11 @@ class System;
 /// Auxilary type used to incapsulate the atom and its current coordinates
 /// Used internally in Selection::operator[] and in iterator access to Selection.
 /// Objects of this class should not be created by the user in normal situation.
+/// Atom is accessed through the copy-on-write storage of the system on each call,
+/// so only non-const accessors make private copy of shared atoms.
 class Atom_proxy {    
 public:
-    Atom_proxy(): atom_ptr(nullptr), coord_ptr(nullptr), ind(-1) {}
+    Atom_proxy(): atoms(nullptr), coord_ptr(nullptr), ind(-1) {}
     Atom_proxy(System* s, int i, int fr);
 
     void set(System* s, int i, int fr);
@@ -50,41 +53,41 @@ public:
     /// @{
     inline const int& index() const { return ind; }
 
-    inline int& resid(){ return atom_ptr->resid; }
-    inline const int& resid() const { return atom_ptr->resid; }
+    inline int& resid(){ return (*atoms)[ind].resid; }
+    inline const int& resid() const { return atoms->get()[ind].resid; }
 
-    inline std::string& name(){ return atom_ptr->name; }
-    inline const std::string& name() const { return atom_ptr->name; }
+    inline std::string& name(){ return (*atoms)[ind].name; }
+    inline const std::string& name() const { return atoms->get()[ind].name; }
 
-    inline char& chain(){ return atom_ptr->chain; }
-    inline const char& chain() const { return atom_ptr->chain; }
+    inline char& chain(){ return (*atoms)[ind].chain; }
+    inline const char& chain() const { return atoms->get()[ind].chain; }
 
-    inline std::string& resname(){ return atom_ptr->resname; }
-    inline const std::string& resname() const { return atom_ptr->resname; }
+    inline std::string& resname(){ return (*atoms)[ind].resname; }
+    inline const std::string& resname() const { return atoms->get()[ind].resname; }
 
-    inline std::string& tag(){ return atom_ptr->tag; }
-    inline const std::string& tag() const { return atom_ptr->tag; }
+    inline std::string& tag(){ return (*atoms)[ind].tag; }
+    inline const std::string& tag() const { return atoms->get()[ind].tag; }
 
-    inline float& occupancy(){ return atom_ptr->occupancy; }
-    inline const float& occupancy() const { return atom_ptr->occupancy; }
+    inline float& occupancy(){ return (*atoms)[ind].occupancy; }
+    inline const float& occupancy() const { return atoms->get()[ind].occupancy; }
 
-    inline float& beta(){ return atom_ptr->beta; }
-    inline const float& beta() const { return atom_ptr->beta; }
+    inline float& beta(){ return (*atoms)[ind].beta; }
+    inline const float& beta() const { return atoms->get()[ind].beta; }
 
-    inline int& resindex() { return atom_ptr->resindex; }
-    inline const int& resindex() const { return atom_ptr->resindex; }
+    inline int& resindex() { return (*atoms)[ind].resindex; }
+    inline const int& resindex() const { return atoms->get()[ind].resindex; }
 
-    inline float& mass(){ return atom_ptr->mass; }
-    inline const float& mass() const { return atom_ptr->mass; }
+    inline float& mass(){ return (*atoms)[ind].mass; }
+    inline const float& mass() const { return atoms->get()[ind].mass; }
 
-    inline float& charge(){ return atom_ptr->charge; }
-    inline const float& charge() const { return atom_ptr->charge; }
+    inline float& charge(){ return (*atoms)[ind].charge; }
+    inline const float& charge() const { return atoms->get()[ind].charge; }
 
-    inline int& type(){ return atom_ptr->type; }
-    inline const int& type() const { return atom_ptr->type; }
+    inline int& type(){ return (*atoms)[ind].type; }
+    inline const int& type() const { return atoms->get()[ind].type; }
 
-    inline std::string& type_name(){ return atom_ptr->type_name; }
-    inline const std::string& type_name() const { return atom_ptr->type_name; }
+    inline std::string& type_name(){ return (*atoms)[ind].type_name; }
+    inline const std::string& type_name() const { return atoms->get()[ind].type_name; }
 
     inline float& x(){ return (*coord_ptr)(0); }
     inline const float& x() const { return (*coord_ptr)(0); }
@@ -104,11 +107,11 @@ public:
     inline Eigen::Vector3f& force(){ return *f_ptr; }
     inline const Eigen::Vector3f& force() const { return *f_ptr; }
 
-    inline Atom& atom(){ return *atom_ptr; }
-    inline const Atom& atom() const { return *atom_ptr; }
+    inline Atom& atom(){ return (*atoms)[ind]; }
+    inline const Atom& atom() const { return atoms->get()[ind]; }
 
-    inline int& atomic_number(){ return atom_ptr->atomic_number; }
-    inline const int& atomic_number() const { return atom_ptr->atomic_number; }
+    inline int& atomic_number(){ return (*atoms)[ind].atomic_number; }
+    inline const int& atomic_number() const { return atoms->get()[ind].atomic_number; }
 
     std::string element_name() const;
 
@@ -117,7 +120,7 @@ public:
 
     /// Equality operator
     bool operator==(const Atom_proxy& other) const {
-        return (coord_ptr==other.coord_ptr && atom_ptr==other.atom_ptr);
+        return (coord_ptr==other.coord_ptr && atoms==other.atoms && ind==other.ind);
     }
 
     /// Inequality operator
@@ -127,7 +130,7 @@ public:
 
 private:        
     int ind;
-    Atom *atom_ptr;
+    Cow_vector<Atom>* atoms;
     Eigen::Vector3f* coord_ptr;
     Eigen::Vector3f* v_ptr;
     Eigen::Vector3f* f_ptr;
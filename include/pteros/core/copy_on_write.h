@@ -0,0 +1,199 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace pteros {
+
+namespace detail {
+
+/// True if p is the only owner of the object, so it could be modified in place.
+/// Other owners could only disappear but not appear concurrently, since each holder
+/// is used by one thread at a time. use_count() is a relaxed load, so the fence is needed
+/// to make reads of the object by the owners, which released it in other threads,
+/// happen before our modification.
+template<class T>
+bool cow_unique(const std::shared_ptr<T>& p){
+    if(p.use_count()!=1) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+}
+
+/** Vector with copy-on-write semantics.
+ Copies of Cow_vector share the same storage until one of them is modified.
+ Any non-const access (including non-const operator[] and iterators) makes
+ a private copy of the storage if it is shared, so the modification is never
+ visible in other copies. Const access never copies.
+
+ Shared storage could be read concurrently from many threads. Each copy
+ of Cow_vector itself should only be used by one thread at a time.
+
+ Each non-const access increments the version number, which allows to
+ detect possible modifications and to invalidate data computed from the vector.
+ Thus code, which only reads the elements, should use const access.
+ References and iterators obtained by non-const access should not be kept
+ while the vector is copied, since modifying through them after copying
+ affects all copies.
+*/
+template<class T>
+class Cow_vector {
+public:
+    using value_type = T;
+    using size_type = typename std::vector<T>::size_type;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    Cow_vector(): data(std::make_shared<std::vector<T>>()) {}
+    Cow_vector(const std::vector<T>& v): data(std::make_shared<std::vector<T>>(v)) {}
+    Cow_vector(std::vector<T>&& v): data(std::make_shared<std::vector<T>>(std::move(v))) {}
+
+    Cow_vector& operator=(const std::vector<T>& v){
+        data = std::make_shared<std::vector<T>>(v);
+        ++ver;
+        return *this;
+    }
+
+    Cow_vector& operator=(std::vector<T>&& v){
+        data = std::make_shared<std::vector<T>>(std::move(v));
+        ++ver;
+        return *this;
+    }
+
+    /// Read-only access to underlying vector
+    const std::vector<T>& get() const { return *data; }
+    operator const std::vector<T>&() const { return *data; }
+
+    /// Writable access to underlying vector. Makes private copy if shared.
+    std::vector<T>& mut(){ detach(); return *data; }
+
+    /// True if the storage is shared with other copies
+    bool is_shared() const { return data.use_count()>1; }
+
+    /// Version number, which changes on each non-const access
+    unsigned long version() const { return ver; }
+
+    // Const access
+    size_type size() const { return data->size(); }
+    bool empty() const { return data->empty(); }
+    const T& operator[](size_type i) const { return (*data)[i]; }
+    const T& front() const { return data->front(); }
+    const T& back() const { return data->back(); }
+    const_iterator begin() const { return data->cbegin(); }
+    const_iterator end() const { return data->cend(); }
+    const_iterator cbegin() const { return data->cbegin(); }
+    const_iterator cend() const { return data->cend(); }
+
+    // Non-const access
+    T& operator[](size_type i){ return mut()[i]; }
+    T& front(){ return mut().front(); }
+    T& back(){ return mut().back(); }
+    iterator begin(){ return mut().begin(); }
+    iterator end(){ return mut().end(); }
+    void push_back(const T& v){ mut().push_back(v); }
+    void push_back(T&& v){ mut().push_back(std::move(v)); }
+    void resize(size_type n){ mut().resize(n); }
+    void reserve(size_type n){ mut().reserve(n); }
+    // Iterators may point to shared storage, which is replaced by detach(),
+    // so they are converted to offsets first
+    template<class It>
+    iterator insert(const_iterator pos, It b, It e){
+        auto off = pos - data->cbegin();
+        detach();
+        return data->insert(data->cbegin()+off,b,e);
+    }
+
+    iterator erase(const_iterator b, const_iterator e){
+        auto off_b = b - data->cbegin();
+        auto off_e = e - data->cbegin();
+        detach();
+        return data->erase(data->cbegin()+off_b,data->cbegin()+off_e);
+    }
+
+    void clear(){
+        // No need to copy the data, which are going to be deleted
+        if(!detail::cow_unique(data))
+            data = std::make_shared<std::vector<T>>();
+        else
+            data->clear();
+        ++ver;
+    }
+
+private:
+    void detach(){
+        if(!detail::cow_unique(data)) data = std::make_shared<std::vector<T>>(*data);
+        ++ver;
+    }
+
+    std::shared_ptr<std::vector<T>> data;
+    unsigned long ver = 0;
+};
+
+/** Pointer-like holder of object with copy-on-write semantics.
+ Copies share the same object. Reading is done by * and -> and never copies.
+ Modification requires explicit call of mut(), which makes private copy
+ of the object if it is shared and increments the version number.
+*/
+template<class T>
+class Cow_ptr {
+public:
+    Cow_ptr(): data(std::make_shared<T>()) {}
+
+    const T& operator*() const { return *data; }
+    const T* operator->() const { return data.get(); }
+
+    /// Writable access. Makes private copy if shared.
+    T& mut(){
+        if(!detail::cow_unique(data)) data = std::make_shared<T>(*data);
+        ++ver;
+        return *data;
+    }
+
+    /// Replaces the object by default-constructed one without copying
+    void reset(){ data = std::make_shared<T>(); ++ver; }
+
+    /// True if the object is shared with other copies
+    bool is_shared() const { return data.use_count()>1; }
+
+    /// Version number, which changes on each call of mut() or reset()
+    unsigned long version() const { return ver; }
+
+private:
+    std::shared_ptr<T> data;
+    unsigned long ver = 0;
+};
+
+}
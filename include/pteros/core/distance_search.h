@@ -56,6 +56,22 @@ void search_contacts(float d,
                      bool periodic = false,
                      std::vector<float>* dist_vec = nullptr);
 
+/// Bins distances between atoms of single selection into histogram on the fly
+/// without storing the pairs. Histogram covers [0:d] with hist.size() bins.
+/// Found distances are added to existing content of hist, so it could be accumulated
+/// over many frames. Each searching thread fills its own local histogram.
+void search_distances_histogram(float d,
+                                const Selection& sel,
+                                Eigen::VectorXd& hist,
+                                bool periodic = false);
+
+/// Bins distances between atoms of two selections into histogram on the fly
+void search_distances_histogram(float d,
+                                const Selection& sel1,
+                                const Selection& sel2,
+                                Eigen::VectorXd& hist,
+                                bool periodic = false);
+
 /// Search atoms from source selection around the traget selection
 /// Returns absolute indexes only!
 void search_within(float d,
@@ -118,10 +118,15 @@ public:
 
     // Computes energy of atom pair at given distance
     // Returns {Coulomb_en,LJ_en}
-    Eigen::Vector2f pair_energy(int at1, int at2, float r, float q1, float q2, int type1, int type2);
+    Eigen::Vector2f pair_energy(int at1, int at2, float r, float q1, float q2, int type1, int type2) const;
 
     /// Returns "natural" cutoff (currenly min of rcoulomb and rvdw)
-    float get_cutoff();
+    float get_cutoff() const;
+
+    /// Renumbers atoms in exclusions, bonds, 1-4 pairs and molecules.
+    /// new_index[i] is the new index of atom i or -1 if the atom is deleted.
+    /// New indexes should preserve the order of atoms.
+    void remap_atoms(const std::vector<int>& new_index, int new_natoms);
 };
 
 }
@@ -94,6 +94,72 @@ namespace pteros {
         std::deque<Eigen::Vector3f> wrapped_atoms;        
     };
 
+
+    /**
+    3D grid of accumulated atomic weights (counts, masses, charges, etc.)
+    for computing volumetric density maps.
+    Grid covers either fixed rectangular region or the whole periodic box.
+    In periodic case atoms are mapped by their fractional coordinates,
+    so the box may fluctuate and the averaged box is used for output.
+    Each call of add() is considered as one frame.
+    Grids accumulated in parallel could be combined by merge().
+    \code
+    Density_grid g(sel.box(), 0.1);
+    // For each frame
+    g.add(sel, sel.get_mass());
+    // Average mass density
+    g.write_dx("density.dx");
+    \endcode
+     */
+    class Density_grid {
+    public:
+        Density_grid(){}
+        /// Fixed region between min and max
+        Density_grid(Vector3f_const_ref min, Vector3f_const_ref max, float spacing){ create(min,max,spacing); }
+        /// Whole periodic box
+        Density_grid(const Periodic_box& box, float spacing){ create(box,spacing); }
+
+        void create(Vector3f_const_ref min, Vector3f_const_ref max, float spacing);
+        void create(const Periodic_box& box, float spacing);
+
+        /// Adds atoms of selection with given per-atom weights (unit weights if empty).
+        /// If sigma is positive each atom is spread over neighbouring cells by Gaussian.
+        void add(const Selection& sel, const std::vector<float>& weights = {}, float sigma = 0);
+
+        void merge(const Density_grid& other);
+
+        Eigen::Vector3i dims() const {return n;}
+        int num_frames() const {return n_frames;}
+        /// Density in the cell averaged over frames (weight per nm^3)
+        double density(int i, int j, int k) const;
+
+        /// Write density in OpenDX format. Coordinates are in Angstroms.
+        void write_dx(const std::string& fname) const;
+        /// Write density in CCP4/MRC format. Coordinates are in Angstroms.
+        void write_ccp4(const std::string& fname) const;
+
+    private:
+        bool periodic;
+        // Number of cells
+        Eigen::Vector3i n;
+        // Origin of fixed region
+        Eigen::Vector3f origin;
+        // Cell vectors of fixed region
+        Eigen::Matrix3f cell;
+        // Sum of box matrices over frames in periodic case
+        Eigen::Matrix3f box_sum;
+        int n_frames = 0;
+        // Cells with z changing fastest
+        std::vector<double> data;
+
+        // Cell vectors averaged over frames
+        Eigen::Matrix3f average_cell() const;
+        // Adds weight at the point given in cell coordinates
+        void add_point(Vector3f_const_ref u, float w, float sigma,
+                       Matrix3f_const_ref cell_m, Matrix3f_const_ref cell_inv);
+        double& at(int i, int j, int k){ return data[(long(i)*n(1)+j)*n(2)+k]; }
+    };
+
 }
 
 
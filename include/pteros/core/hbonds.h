@@ -0,0 +1,201 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <array>
+#include "pteros/core/selection.h"
+
+namespace pteros {
+
+/// Hydrogen bond found by Hbond_search. Atom indexes are absolute.
+struct Hbond {
+    int donor;
+    int hydrogen;
+    int acceptor;
+    /// Donor-acceptor distance in nm
+    float dist;
+    /// Hydrogen-donor-acceptor angle in degrees
+    float angle;
+};
+
+/** Fast search of hydrogen bonds.
+ Hydrogen bond D-H...A is recorded if the distance between donor D and acceptor A is
+ smaller than cutoff (0.35 nm by default) and the angle H-D-A is smaller than
+ angle cutoff (30 degrees by default). These are the criteria used by Gromacs.
+
+ Donors, their hydrogens and acceptors are classified once when the search is created:
+ - If single selection is given N and O atoms bonded to hydrogens are donors and all
+   N and O atoms are acceptors.
+ - If donor and acceptor selections are given all heavy atoms of donor selection bonded to
+   hydrogens from this selection are donors and all heavy atoms of acceptor selection
+   are acceptors.
+
+ Bonds to hydrogens are taken from topology if it is present. Otherwise the hydrogens
+ closer than bond cutoff (0.12 nm by default) to heavy atom are considered bonded.
+ Elements are determined by atomic number or by the first letter of atom name if atomic
+ number is not set.
+
+ In each frame the donor-acceptor candidate pairs are found by grid search and then
+ filtered by angle in a single parallel pass over all candidate pairs.
+ Since the atoms are classified once, the search could be reused for all frames of the trajectory:
+ \code
+ Hbond_search hb(sys.select("protein or resname SOL"));
+ vector<Hbond> res;
+ for(int fr=0; fr<sys.num_frames(); ++fr){
+    hb.set_frame(fr);
+    hb.search(res);
+ }
+ \endcode
+*/
+class Hbond_search {
+public:
+    Hbond_search();
+
+    /// Creates search with automatic classification. See create().
+    Hbond_search(const Selection& sel,
+                 float d = 0.35,
+                 float angle = 30,
+                 bool periodic = true,
+                 float bond_d = 0);
+
+    /// Creates search with explicit donor and acceptor selections. See create().
+    Hbond_search(const Selection& donors,
+                 const Selection& acceptors,
+                 float d = 0.35,
+                 float angle = 30,
+                 bool periodic = true,
+                 float bond_d = 0);
+
+    /** Classifies donors and acceptors in single selection.
+     * @param d Donor-acceptor distance cutoff in nm.
+     * @param angle Hydrogen-donor-acceptor angle cutoff in degrees.
+     * @param periodic Account for periodicity.
+     * @param bond_d Cutoff for finding donor-hydrogen bonds by distance.
+     *        If 0 bonds from topology are used if available and 0.12 nm cutoff otherwise.
+     */
+    void create(const Selection& sel,
+                float d = 0.35,
+                float angle = 30,
+                bool periodic = true,
+                float bond_d = 0);
+
+    /// Takes donors and acceptors from explicit selections, which may overlap.
+    void create(const Selection& donors,
+                const Selection& acceptors,
+                float d = 0.35,
+                float angle = 30,
+                bool periodic = true,
+                float bond_d = 0);
+
+    /// Sets the frame used for searching
+    void set_frame(int fr);
+
+    /// Binds the search to another system with the same atoms (for example its copy)
+    /// keeping the classification. Frame is set to 0.
+    void set_system(const System& sys);
+
+    /// Finds hydrogen bonds in current frame.
+    /// Result is sorted by donor, hydrogen and acceptor.
+    void search(std::vector<Hbond>& res) const;
+
+    int num_donors() const { return donors.size(); }
+    int num_hydrogens() const { return hydrogens.size(); }
+    int num_acceptors() const { return acceptors.size(); }
+
+    const Selection& get_donors() const { return donors; }
+    const Selection& get_acceptors() const { return acceptors; }
+
+private:
+    // Heavy donor atoms, which have at least one hydrogen
+    Selection donors;
+    Selection acceptors;
+    // Hydrogens of donor i are hydrogens[h_start[i]:h_start[i+1]]
+    std::vector<int> h_start;
+    std::vector<int> hydrogens;
+
+    float cutoff;
+    float cos_cutoff;
+    bool periodic;
+
+    void classify(const Selection& don_sel, const Selection& acc_sel, bool by_element, float bond_d);
+};
+
+
+/// Statistics of individual hydrogen bond accumulated by Hbond_lifetime
+struct Hbond_stats {
+    int donor;
+    int hydrogen;
+    int acceptor;
+    /// Number of frames where the bond is present
+    int num_frames;
+    /// Number of times the bond was formed
+    int num_formed;
+    /// Mean continuous life time in frames
+    float mean_life_time;
+};
+
+/** Accumulates hydrogen bonds over the trajectory to compute their life times
+ and autocorrelation functions.
+ Frames are valid frame indexes and may come in any order, so partial accumulators
+ filled by parallel trajectory tasks could be merged.
+*/
+class Hbond_lifetime {
+public:
+    /// Records bonds present in given frame
+    void add_frame(int fr, const std::vector<Hbond>& hb);
+
+    /// Adds data from other accumulator
+    void merge(const Hbond_lifetime& other);
+
+    /// Number of distinct bonds
+    int num_bonds() const { return bonds.size(); }
+
+    /// Returns statistics for all bonds ordered by donor, hydrogen and acceptor.
+    /// Bonds, which only exist in single frame at a time, are ignored unless keep_transient is true.
+    std::vector<Hbond_stats> get_stats(bool keep_transient = true);
+
+    /** Computes normalized autocorrelation functions of the bond existence for lags 0..max_lag frames.
+     * Intermittent function counts bond present at both time origin and origin+lag.
+     * Continuous function requires the bond to be present in all frames in between.
+     * @param n_frames Total number of frames.
+     */
+    void autocorrelation(int n_frames, int max_lag,
+                         Eigen::VectorXf& intermittent,
+                         Eigen::VectorXf& continuous);
+
+private:
+    // Frames of each bond (donor,hydrogen,acceptor)
+    std::map<std::array<int,3>,std::vector<int>> bonds;
+    bool sorted = true;
+    void sort_frames();
+};
+
+}
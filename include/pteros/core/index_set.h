@@ -0,0 +1,113 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace pteros {
+
+/** @name Operations on sorted indexes
+ Indexes are vectors of atom indexes sorted in ascending order without duplicates,
+ like the indexes of selections. Arguments may refer to the same vector.
+ All operations are done in place in O(N+M)
+ (or faster if one index is much smaller than the other) without temporary storage.
+ */
+/// @{
+
+/// Sorts the index and removes duplicates.
+/// If the index is already sorted and unique it is only checked in O(N).
+void sort_unique_index(std::vector<int>& ind);
+
+/// Replaces a by the union of a and b
+void index_union(std::vector<int>& a, const std::vector<int>& b);
+
+/// Replaces a by the intersection of a and b
+void index_intersection(std::vector<int>& a, const std::vector<int>& b);
+
+/// Removes all elements of b from a
+void index_difference(std::vector<int>& a, const std::vector<int>& b);
+
+/// @}
+
+
+/** Dense set of atom indexes stored as a bitset.
+ The mask of N atoms takes N/8 bytes regardless of the number of selected atoms.
+ Adding, removing and testing individual atoms are O(1) and logical
+ operations between masks work on 64 atoms at once, which makes the mask
+ the fastest way of building large selections incrementally or
+ combining many dense sets. Use Selection::modify(const Index_mask&) or
+ Selection::append(const Index_mask&) to convert the mask to selection.
+ */
+class Index_mask {
+public:
+    /// Creates empty mask for n atoms
+    Index_mask(int n=0): N(n), bits((n+63)/64,0) {}
+
+    /// Creates the mask for n atoms with given indexes set
+    Index_mask(int n, const std::vector<int>& ind);
+
+    /// Number of atoms covered by the mask
+    int size() const { return N; }
+
+    void set(int i){ bits[i>>6] |= uint64_t(1)<<(i&63); }
+    void reset(int i){ bits[i>>6] &= ~(uint64_t(1)<<(i&63)); }
+    bool test(int i) const { return (bits[i>>6]>>(i&63)) & 1; }
+
+    /// Sets all given indexes
+    void set(const std::vector<int>& ind);
+
+    /// Resets all bits
+    void clear();
+
+    /// Number of set bits
+    int count() const;
+
+    /// Sets all unset bits and vice versa
+    void invert();
+
+    Index_mask& operator|=(const Index_mask& other);
+    Index_mask& operator&=(const Index_mask& other);
+    /// Removes all atoms set in other
+    Index_mask& operator-=(const Index_mask& other);
+
+    /// Writes indexes of set bits in ascending order
+    void to_index(std::vector<int>& ind) const;
+
+    std::vector<int> to_index() const;
+
+private:
+    int N;
+    std::vector<uint64_t> bits;
+
+    void check_size(const Index_mask& other) const;
+};
+
+}
@@ -61,8 +61,16 @@ public:
     bool rand() const { return flags[4]; }
     Mol_file_content rand(bool val){ flags[4] = val; return *this;}
 
+    // Trajectory frames may contain velocities
+    bool vel() const { return flags[5]; }
+    Mol_file_content vel(bool val){ flags[5] = val; return *this;}
+
+    // Trajectory frames may contain forces
+    bool force() const { return flags[6]; }
+    Mol_file_content force(bool val){ flags[6] = val; return *this;}
+
 private:
-    std::bitset<5> flags;
+    std::bitset<7> flags;
 };
 
 /// Generic API for reading and writing any molecule file formats
@@ -30,6 +30,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <cmath>
 #include <Eigen/Core>
 #include "pteros/core/typedefs.h"
 
@@ -153,6 +155,63 @@ public:
                                     Vector3f_const_ref point2,
                                     Array3i_const_ref pbc = fullPBC) const;
 
+    /// Wraps points coord[ind[i]] to the box for given set of dimensions.
+    /// Box type and periodic dimensions are resolved once for the whole set.
+    void wrap_points(std::vector<Eigen::Vector3f>& coord,
+                     const std::vector<int>& ind,
+                     Array3i_const_ref pbc = fullPBC,
+                     Vector3f_const_ref origin = Eigen::Vector3f::Zero()) const;
+
+    /// Replaces points coord[ind[i]] by their periodic images closest to target.
+    /// Box type and periodic dimensions are resolved once for the whole set.
+    void closest_images(std::vector<Eigen::Vector3f>& coord,
+                        const std::vector<int>& ind,
+                        Vector3f_const_ref target,
+                        Array3i_const_ref pbc = fullPBC) const;
+
+    /// Replaces points coord[ind[i]] by their periodic images closest to targets.col(i).
+    void closest_images_to(std::vector<Eigen::Vector3f>& coord,
+                           const std::vector<int>& ind,
+                           const Eigen::Ref<const Eigen::Matrix3Xf>& targets,
+                           Array3i_const_ref pbc = fullPBC) const;
+
+    /** @name Compile-time specialized kernels
+     These kernels are used internally by the functions above and could be called directly
+     in hot loops if the type of the box is known in advance.
+     Triclinic selects the general kernel, otherwise the box is assumed to be rectangular.
+     PBC is a bit mask of periodic dimensions: 1 for X, 2 for Y and 4 for Z.
+     The box must be periodic, this is not checked.
+     */
+    ///@{
+    template<bool Triclinic, int PBC = 7>
+    Eigen::Vector3f shortest_vector_t(Vector3f_const_ref point1, Vector3f_const_ref point2) const {
+        if(Triclinic){
+            Eigen::Vector3f d = _box_inv*(point2-point1);
+            for(int i=0;i<3;++i)
+                if(PBC & (1<<i)) d(i) -= std::round(d(i));
+            return _box*d;
+        } else {
+            Eigen::Vector3f d = point2-point1;
+            for(int i=0;i<3;++i)
+                if(PBC & (1<<i)) d(i) -= _diag(i)*std::round(d(i)*_diag_inv(i));
+            return d;
+        }
+    }
+
+    template<bool Triclinic, int PBC = 7>
+    void wrap_point_t(Vector3f_ref point, Vector3f_const_ref origin) const {
+        if(Triclinic){
+            Eigen::Vector3f p = _box_inv*(point-origin);
+            for(int i=0;i<3;++i)
+                if(PBC & (1<<i)) p(i) -= std::floor(p(i));
+            point = _box*p + origin;
+        } else {
+            for(int i=0;i<3;++i)
+                if(PBC & (1<<i)) point(i) -= _diag(i)*std::floor((point(i)-origin(i))*_diag_inv(i));
+        }
+    }
+    ///@}
+
     /// Returns box volume
     float volume();
 
@@ -173,7 +232,9 @@ public:
 
 private:
     Eigen::Matrix3f _box;
-    Eigen::Matrix3f _box_inv;    
+    Eigen::Matrix3f _box_inv;
+    // Diagonal of the box and its inverse for rectangular kernels
+    Eigen::Vector3f _diag, _diag_inv;
     bool _is_triclinic;
     bool _is_periodic;
 
@@ -0,0 +1,232 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace pteros {
+
+/// Aggregated timing of single instrumented region in single thread
+struct Profile_entry {
+    /// Name of the thread
+    std::string thread;
+    /// Name of the region
+    std::string region;
+    /// Number of times the region was entered
+    long count;
+    /// Total, minimal and maximal time spent in the region in seconds
+    double total;
+    double min;
+    double max;
+};
+
+/// Value of single profiling counter in single thread
+struct Profile_counter {
+    std::string thread;
+    std::string name;
+    long value;
+};
+
+/** @brief Collector of built-in profiling data.
+ Instrumented regions are marked by PTEROS_PROFILE_SCOPE("name") and counters
+ are incremented by PTEROS_PROFILE_COUNT("name",n). These macros expand to nothing
+ unless Pteros is compiled with WITH_PROFILING option, so the hot paths
+ are not affected in normal builds. If profiling is compiled in, it is still
+ switched off by default and costs a single atomic load per region until enabled.
+
+ Timings are accumulated in per-thread storage without any locking.
+ Thread data are never deallocated, so the results of finished threads are preserved.
+ Results should only be queried when instrumented threads are idle.
+ Region and counter names must be string literals.
+
+ Optionally each individual region is recorded as an event, which could be written
+ in Chrome trace format and inspected in chrome://tracing or Perfetto.
+ */
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Returns global profiler instance
+    static Profiler& instance();
+
+    /// Returns true if instrumentation macros were compiled in
+    static bool is_compiled();
+
+    /// Switch profiling on or off. If trace is true individual events are recorded.
+    void enable(bool on, bool trace=false);
+
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /// Set human-readable name of the calling thread
+    void set_thread_name(const std::string& name);
+
+    /// Add timing of the region to the calling thread
+    void add(const char* region, Clock::time_point t0, Clock::time_point t1);
+
+    /// Increment counter of the calling thread
+    void count(const char* counter, long n=1);
+
+    /// Clear all accumulated data
+    void reset();
+
+    /// Returns aggregated timings sorted by thread and by decreasing total time
+    std::vector<Profile_entry> get_entries() const;
+
+    /// Returns counters sorted by thread
+    std::vector<Profile_counter> get_counters() const;
+
+    /// Returns formatted table of timings and counters.
+    /// If wall_time is given the percentage of wall time is also printed.
+    std::string report(double wall_time=0) const;
+
+    /// Writes recorded events in Chrome trace JSON format
+    void write_chrome_trace(const std::string& fname) const;
+
+private:
+    Profiler();
+    struct Thread_data;
+    Thread_data* thread_data();
+
+    std::atomic<bool> enabled;
+    std::atomic<bool> tracing;
+    Clock::time_point epoch;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Thread_data>> threads;
+};
+
+/// Evaluation statistics of single type of selection AST nodes
+struct Selection_node_profile {
+    Selection_node_profile(): count(0), time(0), self_time(0) {}
+    /// Number of evaluations
+    long count;
+    /// Total time in seconds including evaluation of child nodes
+    double time;
+    /// Time in seconds excluding evaluation of child nodes
+    double self_time;
+};
+
+/// Accumulated statistics of all selections with the same selection text
+struct Selection_profile {
+    Selection_profile(): coord_dependent(false), n_parsed(0), parse_time(0),
+        n_evaluated(0), n_reevaluated(0), eval_time(0), total_size(0), last_size(0) {}
+    /// Selection text after expansion of macro
+    std::string text;
+    /// True if selection depends on coordinates and is re-evaluated on frame change
+    bool coord_dependent;
+    /// Number of times the text was parsed and total parsing time in seconds
+    long n_parsed;
+    double parse_time;
+    /// Number of evaluations including the initial ones
+    long n_evaluated;
+    /// Number of re-evaluations by Selection::apply() and Selection::set_frame()
+    long n_reevaluated;
+    /// Total evaluation time in seconds
+    double eval_time;
+    /// Sum of sizes of all evaluation results and the size of the last result
+    long total_size;
+    int last_size;
+    /// Evaluation statistics for each type of AST nodes
+    std::map<std::string,Selection_node_profile> nodes;
+};
+
+/** @brief Collector of selection parsing and evaluation statistics.
+ It is owned by the System when selection profiling is switched on by
+ System::set_selection_profiling(). Selection parsers of this system look
+ it up on each evaluation. Statistics are accumulated per selection text.
+ Updates are serialized by the mutex, so selections of the same system
+ could be evaluated from different threads.
+ */
+class Selection_profiler {
+public:
+    /// Returns entry for given selection text creating it if needed.
+    /// Returned pointer remains valid for the lifetime of profiler.
+    Selection_profile* get_entry(const std::string& text);
+
+    /// Record parsing of selection
+    void add_parse(Selection_profile* entry, double time, bool coord_dependent);
+
+    /// Record evaluation of selection
+    void add_eval(Selection_profile* entry, double time, int size, bool reevaluation,
+                  const std::map<std::string,Selection_node_profile>& nodes);
+
+    /// Clear all statistics
+    void reset();
+
+    /// Returns statistics sorted by decreasing total time
+    std::vector<Selection_profile> get_entries() const;
+
+    /// Returns formatted report for at most max_entries most expensive selections
+    /// and summary for all types of AST nodes
+    std::string report(int max_entries=20) const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string,Selection_profile> entries;
+};
+
+/// RAII timer of the instrumented region
+class Profile_scope {
+public:
+    Profile_scope(const char* region) {
+        name = Profiler::instance().is_enabled() ? region : nullptr;
+        if(name) t0 = Profiler::Clock::now();
+    }
+
+    ~Profile_scope(){
+        if(name) Profiler::instance().add(name,t0,Profiler::Clock::now());
+    }
+
+private:
+    const char* name;
+    Profiler::Clock::time_point t0;
+};
+
+}
+
+#define PTEROS_PROFILE_CONCAT_IMPL(a,b) a##b
+#define PTEROS_PROFILE_CONCAT(a,b) PTEROS_PROFILE_CONCAT_IMPL(a,b)
+
+#ifdef PTEROS_PROFILING
+#define PTEROS_PROFILE_SCOPE(region) \
+    pteros::Profile_scope PTEROS_PROFILE_CONCAT(_pteros_profile_scope_,__LINE__)(region)
+#define PTEROS_PROFILE_COUNT(counter,n) \
+    do { if(pteros::Profiler::instance().is_enabled()) pteros::Profiler::instance().count(counter,n); } while(0)
+#define PTEROS_PROFILE_THREAD(name) pteros::Profiler::instance().set_thread_name(name)
+#else
+#define PTEROS_PROFILE_SCOPE(region)
+#define PTEROS_PROFILE_COUNT(counter,n) do {} while(0)
+#define PTEROS_PROFILE_THREAD(name)
+#endif
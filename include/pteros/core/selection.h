@@ -40,6 +40,7 @@
 #include <Eigen/Geometry>
 #include "pteros/core/atom_proxy.h"
 #include "pteros/core/system.h"
+#include "pteros/core/index_set.h"
 #include "pteros/core/typedefs.h"
 
 namespace pteros {
@@ -184,6 +185,15 @@ class Selection {
     /// Creates new Selection, which is a logical negation of existing one.
     /// Parent selection is not modified
     Selection operator~() const;        
+
+    /// In-place logical OR. Same as append(sel).
+    Selection& operator|=(const Selection& sel);
+
+    /// In-place logical AND. Only atoms present in sel are kept.
+    Selection& operator&=(const Selection& sel);
+
+    /// In-place removal of all atoms of sel. Same as remove(sel).
+    Selection& operator-=(const Selection& sel);
     /// @}
 
     //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -196,6 +206,14 @@ class Selection {
     /// Append absolute index to selection
     void append(int ind);
 
+    /// Append many absolute indexes at once.
+    /// Vector may be in any order and may contain duplicates.
+    /// This is much faster than appending indexes one by one.
+    void append(const std::vector<int>& ind);
+
+    /// Append all atoms set in the mask
+    void append(const Index_mask& mask);
+
     /// Remove all atoms of sel from current selection
     void remove(const Selection& sel);
 
@@ -226,6 +244,10 @@ class Selection {
     /// Vector may be in any order and may contain duplicates.
     void modify(std::vector<int>::iterator it1, std::vector<int>::iterator it2);
 
+    /// Modifies selection using the mask of atoms.
+    /// The size of the mask should be equal to the number of atoms in the system.
+    void modify(const Index_mask& mask);
+
     /** Modifies selection using user-defined callback.
       Callback takes the system as first argument, target frame number as the second
       and the vector to be filled by selected atom indexes.
@@ -260,6 +282,15 @@ class Selection {
     */
     void apply();
 
+    /** Evaluates selection for given frame into provided storage without modifying the selection.
+    *   For coordinate-dependent selections the parsed selection is evaluated against
+    *   the coordinates of frame fr, otherwise result is just a copy of selection index.
+    *   Unlike set_frame() and apply() this method is safe to call concurrently
+    *   from several threads for the same selection provided that the system is not modified.
+    *   Each thread should use its own result vector.
+    */
+    void evaluate(int fr, std::vector<int>& result) const;
+
     /** Recomputes selection completely.
     *   May be used when new file is loaded into the system, or when atoms are
     *   created/deleted. Forces re-parsing of selection text.
@@ -366,6 +397,9 @@ class Selection {
     /// Get vector of all indexes in selection
     std::vector<int> get_index() const { return _index; }
 
+    /// Get the mask of selected atoms for the whole system
+    Index_mask get_mask() const { return Index_mask(system->num_atoms(),_index); }
+
     /// Get vector of all chains in selection
     std::vector<char> get_chain(bool unique=false) const;
 
@@ -622,6 +656,8 @@ class Selection {
     /** Unwraps selection to make it whole (without jumps over periodic box boundary).
      * based on preserving all bonds.
      * This method works reliably in any case, but is much slower than unwrap()
+     * If the same selection is unwrapped in many frames use Unwrap_plan instead,
+     * which finds the bonds only once.
      * @param d Maximal bond length. If 0 bonds from topology are used (if present).
      * @param pbc_atom Local index of the reference atom, which doesn't move.
      * @return Number of disconnected pieces after unwrapping. 1 means solid selection.
@@ -907,7 +943,7 @@ class Selection {
 
 #define DEFINE_ACCESSOR(T,prop) \
     inline T& prop(int ind){ return system->atoms[_index[ind]].prop; } \
-    inline const T& prop(int ind) const { return system->atoms[_index[ind]].prop; }
+    inline const T& prop(int ind) const { return system->atoms.get()[_index[ind]].prop; }
 
     /// Extracts type
     DEFINE_ACCESSOR(int,type)
@@ -937,7 +973,7 @@ class Selection {
 
     /// Extracts whole atom
     inline Atom& atom(int ind){ return system->atoms[_index[ind]]; }
-    inline const Atom& atom(int ind) const { return system->atoms[_index[ind]]; }
+    inline const Atom& atom(int ind) const { return system->atoms.get()[_index[ind]]; }
 
     /// Extracts resindex
     DEFINE_ACCESSOR(int,resindex)
@@ -34,12 +34,15 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include "pteros/core/atom.h"
 #include "pteros/core/force_field.h"
 #include "pteros/core/periodic_box.h"
 #include "pteros/core/typedefs.h"
+#include "pteros/core/profiling.h"
+#include "pteros/core/copy_on_write.h"
 
 #include <iostream>
 
@@ -70,6 +73,22 @@ struct Frame {
     void swap(int i, int j);
 };
 
+/// Precomputed ranges of residues and molecules of the System.
+/// Obtained by System::get_topology_ranges().
+struct Topology_ranges {
+    /// True if atoms of each residue are contiguous.
+    /// Residue ranges are meaningless otherwise.
+    bool contiguous;
+    /// First and last atom of each resindex. (-1,-1) if there is no such resindex.
+    std::vector<Eigen::Vector2i> residues;
+    /// Index of molecule from the force field for each atom or -1.
+    /// Empty if there is no topology.
+    std::vector<int> atom_molecule;
+    // Versions of atoms and force field these ranges correspond to
+    unsigned long atoms_version;
+    unsigned long ff_version;
+};
+
 //Forward declarations
 class Selection;
 class Mol_file;
@@ -86,6 +105,20 @@ class Atom_proxy;
     signals if selections should adapt to the changes of coordinates of atom properties.
 *   Copying and assignment of systems is allowed, but associated selections are
     not copied.
+*
+*   Concurrency model:
+*   Atoms and force field (the topology) are shared between copies of the System
+*   in copy-on-write manner. Copying is cheap and the topology is physically copied
+*   only when one of the copies modifies it. Thus many copies of the System
+*   (for example, in parallel trajectory processing tasks) occupy the memory
+*   of a single topology as long as they only read it.
+*   Any number of threads may read the same System concurrently (get atom properties,
+*   coordinates, box, etc.) provided that no thread modifies it. Each thread
+*   could work with its own copy of the System instead, which is safe to
+*   modify and to load frames to independently.
+*   Selections are not thread-safe by themselves since re-evaluation of
+*   coordinate-dependent selections modifies their indexes. Use Selection::evaluate()
+*   to evaluate a selection from several threads into thread-local storage.
 */
 class System {
     // System and Selection are friends because they are closely integrated.
@@ -94,6 +127,8 @@ class System {
     friend class Selection_parser;
     // Mol_file needs an access too
     friend class Mol_file;
+    // Atom_proxy accesses atoms through their copy-on-write storage
+    friend class Atom_proxy;
 
 public:    
     //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -400,8 +435,12 @@ public:
     Selection atoms_add(const std::vector<Atom>& atm,
                    const std::vector<Eigen::Vector3f>& crd);
 
-    /// Delete the set of atoms by indexes
-    void atoms_delete(const std::vector<int>& ind);
+    /// Delete the set of atoms by indexes.
+    /// Atoms and coordinates, velocities and forces in all frames are compacted in place,
+    /// atom indexes in the force field are renumbered.
+    /// Memory of deleted atoms is not released.
+    /// \returns mapping from old to new atom indexes (-1 for deleted atoms)
+    std::vector<int> atoms_delete(const std::vector<int>& ind);
 
     /// Move atom i to other position. Atom is inserted instead of atom j, shift is performed towards previous position of i.
     void atom_move(int i, int j);
@@ -456,11 +495,22 @@ public:
     /// Clears the system and prepares for loading completely new structure
     void clear();
 
-    bool force_field_ready(){return force_field.ready;}
+    bool force_field_ready() const {return force_field->ready;}
 
-    /// Returns internal Force_field object
+    /// Returns internal Force_field object for modification.
+    /// Makes private copy of the force field if it is shared with other systems.
     Force_field& get_force_field(){
-        return force_field;
+        return force_field.mut();
+    }
+
+    /// Returns internal Force_field object for reading
+    const Force_field& get_force_field() const {
+        return *force_field;
+    }
+
+    /// Returns true if the topology (atoms and force field) is shared with other systems
+    bool is_topology_shared() const {
+        return atoms.is_shared() || force_field.is_shared();
     }
 
     /// Assign unique resindexes
@@ -471,6 +521,18 @@ public:
     /// into contigous pieces. Could be called after atom additions or duplications.
     void sort_by_resindex();
 
+    /// Returns precomputed ranges of residues and molecules.
+    /// Ranges are computed on first request and reused until atoms or
+    /// force field are accessed for modification.
+    /// Safe to call concurrently from several threads.
+    std::shared_ptr<const Topology_ranges> get_topology_ranges() const;
+
+    /// Number of residues (largest resindex plus one)
+    int num_residues() const { return get_topology_ranges()->residues.size(); }
+
+    /// First and last atoms of residue with given resindex
+    Eigen::Vector2i residue_range(int resind) const;
+
     /// Delete velocities from all frames.
     /// Does nothing if no velocities.
     void clear_vel();
@@ -481,16 +543,54 @@ public:
 
     /// @}
 
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    /// @name Selection profiling
+    /// @{
+
+    /// Switch collection of parsing and evaluation statistics of selections on or off.
+    /// Parsing and evaluation of selections is accounted while profiling is on,
+    /// including the selections created before profiling was switched on.
+    /// Switching off discards collected statistics.
+    /// Profiling state is not copied when the System is copied.
+    void set_selection_profiling(bool on);
+
+    /// Returns true if selection profiling is on
+    bool is_selection_profiling() const { return (bool)sel_profiler; }
+
+    /// Returns statistics of selections sorted by decreasing total time
+    std::vector<Selection_profile> get_selection_profile() const;
+
+    /// Returns formatted report for at most max_entries most expensive selections
+    /// (all if negative) and summary for all types of AST nodes
+    std::string selection_profile_report(int max_entries=20) const;
+
+    /// Clear collected selection statistics
+    void reset_selection_profile();
+
+    /// @}
+
 protected:
 
-    // Holds all atom attributes except the coordinates
-    std::vector<Atom>  atoms;
+    // Holds all atom attributes except the coordinates.
+    // Shared between copies of the system until modified.
+    Cow_vector<Atom>  atoms;
 
     // Coordinates for any number of frames
     std::vector<Frame> traj;
 
-    // Force field parameters
-    Force_field force_field;
+    // Force field parameters. Shared between copies of the system until modified.
+    Cow_ptr<Force_field> force_field;
+
+    // Selection statistics. Shared with parsers of persistent selections.
+    std::shared_ptr<Selection_profiler> sel_profiler;
+
+    // Topology ranges computed on demand. Shared with copies of the system.
+    mutable std::shared_ptr<const Topology_ranges> topo_ranges;
+    mutable std::mutex topo_ranges_mutex;
+
+    // Removes atoms with negative new_index and moves the rest to new positions
+    // in atoms, all frames and the force field. New indexes should preserve the order of atoms.
+    void compact_atoms(const std::vector<int>& new_index, int new_natoms);
 
     // Indexes for filtering
     std::vector<int> filter;
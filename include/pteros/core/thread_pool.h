@@ -0,0 +1,125 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+namespace pteros {
+
+/*
+ All parallel algorithms of Pteros run in the single library-wide pool of worker threads.
+ The calling thread always participates in the work, so parallel loops could be nested
+ safely (for example when parallel trajectory task calls parallel algorithm):
+ idle workers pick up chunks of any active loop and the total number of running
+ threads never exceeds the number set by set_num_threads().
+*/
+
+/// Set the number of threads used by parallel algorithms (including calling thread).
+/// Zero or negative value means the number of hardware threads.
+/// Default is taken from PTEROS_NUM_THREADS environment variable if it is set.
+/// Should not be called while parallel algorithms are running.
+void set_num_threads(int n);
+
+/// Returns the number of threads available for parallel algorithms called from this thread
+int get_num_threads();
+
+/** Limits the number of threads used by parallel algorithms called from current thread.
+ Each parallel loop started under the limit runs in at most n threads including
+ the calling thread. Nested loops inside the body inherit the limit.
+ The limit is active until the object goes out of scope.
+ For example, instances of parallel trajectory tasks, which already occupy all threads,
+ run their algorithms serially:
+ \code
+ Thread_limit lim(1);
+ sel.center(); // Runs in this thread only
+ \endcode
+*/
+class Thread_limit {
+public:
+    Thread_limit(int n);
+    ~Thread_limit();
+private:
+    int saved;
+};
+
+/// Runs body(chunk) for chunk=0..n_chunks-1 in the thread pool.
+/// Returns when all chunks are finished. Exceptions thrown by the body are rethrown.
+void parallel_chunks(int n_chunks, const std::function<void(int)>& body);
+
+/// Number of chunks used to split n items with given minimal chunk size
+inline int num_parallel_chunks(int n, int grain){
+    if(n<=0) return 0;
+    int nt = get_num_threads();
+    if(nt<=1 || n<=grain) return 1;
+    // Several chunks per thread for load balancing
+    return std::min((n+grain-1)/grain, 4*nt);
+}
+
+/// Runs body(b,e) for consecutive ranges covering [begin,end) in parallel.
+/// Ranges smaller than grain items are not created.
+inline void parallel_for(int begin, int end, const std::function<void(int,int)>& body, int grain=1024){
+    int n = end-begin;
+    int nch = num_parallel_chunks(n,grain);
+    if(nch==0) return;
+    if(nch==1){
+        body(begin,end);
+        return;
+    }
+    parallel_chunks(nch,[&](int c){
+        body(begin + int(long(n)*c/nch), begin + int(long(n)*(c+1)/nch));
+    });
+}
+
+/// Parallel reduction over [begin,end).
+/// body(b,e,acc) accumulates the range into acc, which is initialized by init.
+/// Partial results are combined by reduce(acc1,acc2) in the order of ranges,
+/// so the result does not depend on scheduling.
+template<class T, class Body, class Reduce>
+T parallel_reduce(int begin, int end, const T& init, Body body, Reduce reduce, int grain=1024){
+    int n = end-begin;
+    int nch = num_parallel_chunks(n,grain);
+    if(nch==0) return init;
+    if(nch==1){
+        T acc = init;
+        body(begin,end,acc);
+        return acc;
+    }
+    std::vector<T> parts(nch,init);
+    parallel_chunks(nch,[&](int c){
+        body(begin + int(long(n)*c/nch), begin + int(long(n)*(c+1)/nch), parts[c]);
+    });
+    T acc = parts[0];
+    for(int c=1; c<nch; ++c) acc = reduce(acc,parts[c]);
+    return acc;
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <vector>
+#include "pteros/core/selection.h"
+
+namespace pteros {
+
+/** Precomputed plan for making selection whole across periodic boundaries.
+ The plan is computed once from the bonds (from topology or found by distance search)
+ by breadth-first traversal of each connected piece and stores the traversal
+ order together with the parent of each atom. Applying the plan to the frame
+ is a single linear pass, which puts each atom to the periodic image closest to
+ its parent. Connected pieces (molecules) are processed in parallel.
+
+ Since the bonds usually do not change between frames, the plan could be created
+ once and applied to all frames of the trajectory:
+ \code
+ Unwrap_plan plan(sel,0); // Bonds from topology
+ ...
+ // For each frame
+ plan.apply(sel);
+ \endcode
+ The plan refers to absolute atom indexes and remains valid as long as the atoms
+ are not added or deleted.
+*/
+class Unwrap_plan {
+public:
+    Unwrap_plan(): max_index(-1) {}
+
+    /// Creates the plan. See create().
+    Unwrap_plan(const Selection& sel, float d=0, int pbc_atom=-1);
+
+    /** Computes the plan for selection.
+     * @param d Maximal bond length. If 0 bonds from topology are used.
+     * @param pbc_atom Local index of the reference atom, which doesn't move.
+     *        If -1 the middle atom of selection is used.
+     */
+    void create(const Selection& sel, float d=0, int pbc_atom=-1);
+
+    /// Makes the atoms whole in given frame of the system
+    void apply(System& sys, int fr, Array3i_const_ref pbc = fullPBC) const;
+
+    /// Makes the atoms whole in the current frame of selection
+    void apply(Selection& sel, Array3i_const_ref pbc = fullPBC) const;
+
+    /// Number of disconnected pieces. 1 means solid selection.
+    int num_pieces() const { return piece_start.empty() ? 0 : piece_start.size()-1; }
+
+    /// Number of atoms in the plan
+    int num_atoms() const { return order.size(); }
+
+private:
+    // Absolute indexes of atoms in traversal order.
+    // First atom of each piece is its root, which doesn't move.
+    std::vector<int> order;
+    // Absolute index of the parent of each atom in order (-1 for roots)
+    std::vector<int> parent;
+    // Beginning of each piece in order. The last element is order.size()
+    std::vector<int> piece_start;
+    // Largest atom index to check if the plan fits the system
+    int max_index;
+};
+
+}
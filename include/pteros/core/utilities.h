@@ -69,7 +69,15 @@ namespace pteros {
     /// Get 3-letter protein code from 1-letter
     std::string resname_3char(char code);
 
-    /// Simple histogram class
+    /// Simple histogram class.
+    /// Histograms with the same binning could be merged, so they could be
+    /// filled independently by parallel threads or task instances:
+    /// \code
+    /// auto res = parallel_reduce(0,N,hist.empty_copy(),
+    ///     [&](int b, int e, Histogram& local){ for(int i=b;i<e;++i) local.add(values[i]); },
+    ///     [](Histogram a, const Histogram& b){ a.merge(b); return a; });
+    /// hist.merge(res);
+    /// \endcode
     class Histogram {
     public:
         Histogram(){}
@@ -78,7 +86,15 @@ namespace pteros {
         int get_bin(float v);
         void add(float v, float weight=1.0);
         void add(const std::vector<float> &v);
+        void add(const std::vector<float> &v, const std::vector<float> &weights);
+        /// Batch add of n values with optional weights.
+        /// Large batches are binned by OpenMP threads into thread-local copies.
+        void add(const float* v, int n, const float* weights=nullptr);
         void add_cylindrical(float r, float w, float sector, float cyl_h);
+        /// Adds values of other histogram with the same binning
+        void merge(const Histogram& other);
+        /// Histogram with the same binning and zero values
+        Histogram empty_copy() const;
         void normalize(float norm=0);
         float value(int i) const;
         float position(int i) const;
@@ -90,9 +106,13 @@ namespace pteros {
     private:
         int nbins;
         float minv,maxv,d;
+        // Inverse bin width
+        float inv_d;
         Eigen::VectorXd val;
         Eigen::VectorXd pos;
         bool normalized;
+        // Bins values into given vector without checks
+        void bin_values(const float* v, int n, const float* weights, Eigen::VectorXd& res) const;
     };
 
     /// Simple 2D histogram class
@@ -102,6 +122,12 @@ namespace pteros {
         Histogram2D(float minval1, float maxval1, int n1, float minval2, float maxval2, int n2);
         void create(float minval1, float maxval1, int n1, float minval2, float maxval2, int n2);
         void add(float v1, float v2, float weight=1.0);
+        /// Batch add of n pairs of values with optional weights
+        void add(const float* v1, const float* v2, int n, const float* weights=nullptr);
+        /// Adds values of other histogram with the same binning
+        void merge(const Histogram2D& other);
+        /// Histogram with the same binning and zero values
+        Histogram2D empty_copy() const;
         void normalize(float norm=0);
         Eigen::Vector2f delta() const {return d;}
 
@@ -109,11 +135,57 @@ namespace pteros {
     private:
         Eigen::Vector2i nbins;
         Eigen::Vector2f minv,maxv,d;
+        // Inverse bin widths
+        Eigen::Vector2f inv_d;
         Eigen::MatrixXd val;
 
         bool normalized;
     };
 
+    /// Streaming accumulator of the mean and covariance matrix of vector samples.
+    /// Samples are buffered into blocks, which are added by rank-k updates
+    /// and merged with the running statistics in double precision
+    /// (pairwise Welford/Chan scheme). Partial accumulators from parallel
+    /// task instances are combined with merge().
+    /// If full_matrix is false only the mean is accumulated, which makes
+    /// sense together with keep_samples for randomized PCA of large systems.
+    class Covariance_accumulator {
+    public:
+        Covariance_accumulator(){}
+        Covariance_accumulator(int dim, bool full_matrix=true, bool keep_samples=false, int block_size=64);
+        void create(int dim, bool full_matrix=true, bool keep_samples=false, int block_size=64);
+        void add(const Eigen::Ref<const Eigen::VectorXf>& x);
+        void add(const Eigen::Ref<const Eigen::VectorXd>& x);
+        void merge(const Covariance_accumulator& other);
+        long num_samples() const {return n+n_buf;}
+        int dim() const {return n_dim;}
+        const Eigen::VectorXd& mean();
+        /// Covariance matrix normalized by the number of samples
+        Eigen::MatrixXd covariance();
+        /// Principal components with eigenvalues in decreasing order
+        /// and eigenvectors as columns.
+        /// Uses randomized subspace iteration over stored samples if keep_samples is set,
+        /// otherwise diagonalizes the full covariance matrix.
+        void pca(Eigen::VectorXd& eigenvalues, Eigen::MatrixXd& eigenvectors,
+                 int n_comp=-1, int oversampling=10, int n_power_iter=3);
+    private:
+        void flush();
+        void add_block(const Eigen::Ref<const Eigen::MatrixXd>& block);
+        // Product of unnormalized covariance matrix by m computed from stored samples
+        Eigen::MatrixXd samples_product(const Eigen::MatrixXd& m) const;
+        int n_dim = 0;
+        int blk_size = 64;
+        int n_buf = 0;
+        long n = 0;
+        bool with_matrix = true;
+        bool with_samples = false;
+        Eigen::VectorXd mu;
+        // Upper triangle of the scatter matrix
+        Eigen::MatrixXd m2;
+        Eigen::MatrixXd buf;
+        std::vector<Eigen::MatrixXf> samples;
+    };
+
     void greeting(std::string tool_name="");
 
 } // namespace
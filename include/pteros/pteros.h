@@ -3,10 +3,13 @@
 
 #include "core/system.h"
 #include "core/selection.h"
+#include "core/unwrap_plan.h"
 #include "core/pteros_error.h"
 #include "core/distance_search.h"
+#include "core/hbonds.h"
 #include "analysis/options.h"
 #include "core/utilities.h"
+#include "core/thread_pool.h"
 #include "core/logging.h"
 
 #include <Eigen/Core>
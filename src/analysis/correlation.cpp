@@ -0,0 +1,369 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/analysis/correlation.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/profiling.h"
+#include <unsupported/Eigen/FFT>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+
+class Fft_correlator::Fft_correlator_impl {
+public:
+    Fft_correlator_impl(int n): n(n) {
+        if(n<=0) throw Pteros_error("Correlation requires non-empty series!");
+        // Padding to at least 2n removes wrap-around. Power of two is the fastest size.
+        nfft = 1;
+        while(nfft<2*n) nfft *= 2;
+        in.resize(nfft);
+        out.resize(nfft);
+        // Input is real, so only half of the spectrum is needed
+        fft.SetFlag(FFT<double>::HalfSpectrum);
+    }
+
+    // Computes spectrum of x padded by zeros
+    void forward(const Ref<const VectorXd>& x, vector<complex<double>>& spec){
+        if(x.size()!=n) throw Pteros_error("Expected series of length {}, got {}!",n,x.size());
+        for(int i=0;i<n;++i) in[i] = x(i);
+        std::fill(in.begin()+n,in.end(),0.0);
+        fft.fwd(spec,in);
+    }
+
+    // Inverse transform of spec to c
+    void inverse(Ref<VectorXd> c){
+        if(c.size()!=n) throw Pteros_error("Expected result of length {}, got {}!",n,c.size());
+        fft.inv(out,spec1);
+        for(int i=0;i<n;++i) c(i) = out[i];
+    }
+
+    int n, nfft;
+    FFT<double> fft;
+    vector<double> in, out;
+    vector<complex<double>> spec1, spec2;
+};
+
+
+Fft_correlator::Fft_correlator(int n)
+{
+    p.reset(new Fft_correlator_impl(n));
+}
+
+Fft_correlator::~Fft_correlator(){}
+
+int Fft_correlator::size() const
+{
+    return p->n;
+}
+
+void Fft_correlator::autocorrelation(const Ref<const VectorXd> &x, Ref<VectorXd> c)
+{
+    p->forward(x,p->spec1);
+    for(auto& v: p->spec1) v = std::norm(v);
+    p->inverse(c);
+}
+
+void Fft_correlator::correlation(const Ref<const VectorXd> &x, const Ref<const VectorXd> &y, Ref<VectorXd> c)
+{
+    p->forward(x,p->spec1);
+    p->forward(y,p->spec2);
+    for(int i=0;i<p->spec1.size();++i) p->spec1[i] = std::conj(p->spec1[i])*p->spec2[i];
+    p->inverse(c);
+}
+
+//--------------------------------------------------------------------------
+
+Time_correlation::Time_correlation(): n_series(0), n_dim(1), storage(Float), file(nullptr) {}
+
+Time_correlation::Time_correlation(int n_series, int n_dim, Storage storage): file(nullptr)
+{
+    create(n_series,n_dim,storage);
+}
+
+Time_correlation::Time_correlation(const Time_correlation &other): file(nullptr)
+{
+    *this = other;
+}
+
+Time_correlation &Time_correlation::operator=(const Time_correlation &other)
+{
+    if(this==&other) return *this;
+    // Each copy gets its own temporary file if stored on disk
+    create(other.n_series,other.n_dim,other.storage);
+    merge(other);
+    return *this;
+}
+
+Time_correlation::~Time_correlation()
+{
+    close_file();
+}
+
+void Time_correlation::close_file()
+{
+    if(file) fclose(file); // Temporary file is deleted on close
+    file = nullptr;
+}
+
+void Time_correlation::create(int n_series_, int n_dim_, Storage storage_)
+{
+    if(n_series_<0 || n_dim_<1) throw Pteros_error("Wrong shape of observable: {} series of dimension {}!",n_series_,n_dim_);
+    n_series = n_series_;
+    n_dim = n_dim_;
+    storage = storage_;
+    frames.clear();
+    data_float.clear();
+    data_half.clear();
+    close_file();
+    if(storage==Disk){
+        file = std::tmpfile();
+        if(!file) throw Pteros_error("Can't create temporary file for time series!");
+    }
+}
+
+void Time_correlation::add_frame(int fr, const Ref<const VectorXf> &values)
+{
+    int rs = record_size();
+    if(values.size()!=rs) throw Pteros_error("Expected {} values in frame, got {}!",rs,values.size());
+    frames.push_back(fr);
+    switch(storage){
+    case Float:
+        data_float.insert(data_float.end(),values.data(),values.data()+rs);
+        break;
+    case Half:
+        for(int i=0;i<rs;++i) data_half.push_back(Eigen::half(values(i)));
+        break;
+    case Disk:
+        fseek(file,0,SEEK_END);
+        if(fwrite(values.data(),sizeof(float),rs,file)!=rs)
+            throw Pteros_error("Can't write time series to temporary file!");
+        break;
+    }
+}
+
+void Time_correlation::merge(const Time_correlation &other)
+{
+    // Records of itself would be added while reading them
+    if(&other==this) throw Pteros_error("Can't merge time series with itself!");
+    if(other.n_series!=n_series || other.n_dim!=n_dim)
+        throw Pteros_error("Can't merge time series of different shapes!");
+    vector<float> buf(record_size());
+    for(int k=0;k<other.frames.size();++k){
+        other.read_record(k,0,buf.size(),buf.data());
+        add_frame(other.frames[k],Map<VectorXf>(buf.data(),buf.size()));
+    }
+}
+
+void Time_correlation::read_record(int k, int b, int n, float *buf) const
+{
+    size_t offset = size_t(k)*record_size()+b;
+    switch(storage){
+    case Float:
+        std::copy(data_float.begin()+offset,data_float.begin()+offset+n,buf);
+        break;
+    case Half:
+        for(int i=0;i<n;++i) buf[i] = float(data_half[offset+i]);
+        break;
+    case Disk:
+        fseek(file,offset*sizeof(float),SEEK_SET);
+        if(fread(buf,sizeof(float),n,file)!=n)
+            throw Pteros_error("Can't read time series from temporary file!");
+        break;
+    }
+}
+
+std::vector<int> Time_correlation::frame_order() const
+{
+    vector<int> order(frames.size());
+    for(int i=0;i<order.size();++i) order[i] = i;
+    sort(order.begin(),order.end(),[this](int a, int b){ return frames[a]<frames[b]; });
+    for(int i=1;i<order.size();++i){
+        if(frames[order[i]]!=frames[order[i-1]]+1)
+            throw Pteros_error("Time series should contain consecutive frames, got frame {} after {}!",
+                               frames[order[i]],frames[order[i-1]]);
+    }
+    return order;
+}
+
+void Time_correlation::get_series(int b, int e, MatrixXd &res) const
+{
+    if(b<0 || e>n_series || b>e) throw Pteros_error("Wrong range of series {}:{}!",b,e);
+    auto order = frame_order();
+    int nv = (e-b)*n_dim;
+    res.resize(order.size(),nv);
+    vector<float> buf(nv);
+    for(int i=0;i<order.size();++i){
+        read_record(order[i],b*n_dim,nv,buf.data());
+        for(int j=0;j<nv;++j) res(i,j) = buf[j];
+    }
+}
+
+MatrixXd Time_correlation::autocorrelation_per_series(int max_lag, bool subtract_mean, bool normalize) const
+{
+    PTEROS_PROFILE_SCOPE("time_correlation.auto");
+    int n = num_frames();
+    if(n==0) throw Pteros_error("No frames in time series!");
+    if(max_lag<0 || max_lag>=n) max_lag = n-1;
+
+    MatrixXd res(max_lag+1,n_series);
+    // Series are loaded by blocks of limited size (about 128 Mb)
+    int block = std::max(1, int((1<<24)/(long(n)*n_dim)));
+    MatrixXd x;
+    for(int b=0; b<n_series; b+=block){
+        int e = std::min(n_series,b+block);
+        get_series(b,e,x);
+        if(subtract_mean) x.rowwise() -= x.colwise().mean();
+
+        parallel_for(b,e,[&](int sb, int se){
+            Fft_correlator corr(n);
+            VectorXd c(n), sum(n);
+            for(int s=sb;s<se;++s){
+                sum.fill(0);
+                for(int d=0;d<n_dim;++d){
+                    corr.autocorrelation(x.col((s-b)*n_dim+d),c);
+                    sum += c;
+                }
+                for(int m=0;m<=max_lag;++m) res(m,s) = sum(m)/(n-m);
+                if(normalize && res(0,s)!=0) res.col(s) /= res(0,s);
+            }
+        },1);
+    }
+    return res;
+}
+
+VectorXd Time_correlation::autocorrelation(int max_lag, bool subtract_mean, bool normalize) const
+{
+    VectorXd res = autocorrelation_per_series(max_lag,subtract_mean,false).rowwise().mean();
+    if(normalize && res(0)!=0) res /= res(0);
+    return res;
+}
+
+VectorXd Time_correlation::cross_correlation(int i, int j, int max_lag, bool subtract_mean) const
+{
+    PTEROS_PROFILE_SCOPE("time_correlation.cross");
+    int n = num_frames();
+    if(n==0) throw Pteros_error("No frames in time series!");
+    if(max_lag<0 || max_lag>=n) max_lag = n-1;
+
+    MatrixXd x, y;
+    get_series(i,i+1,x);
+    get_series(j,j+1,y);
+    if(subtract_mean){
+        x.rowwise() -= x.colwise().mean();
+        y.rowwise() -= y.colwise().mean();
+    }
+
+    Fft_correlator corr(n);
+    VectorXd c(n), sum = VectorXd::Zero(n);
+    for(int d=0;d<n_dim;++d){
+        corr.correlation(x.col(d),y.col(d),c);
+        sum += c;
+    }
+    VectorXd res(max_lag+1);
+    for(int m=0;m<=max_lag;++m) res(m) = sum(m)/(n-m);
+    return res;
+}
+
+//--------------------------------------------------------------------------
+
+Multi_tau_correlator::Multi_tau_correlator(int n_series, int n_dim, int p, int m, int n_levels):
+    n_series(n_series), n_dim(n_dim), p(p), m(m)
+{
+    if(n_series<1 || n_dim<1) throw Pteros_error("Wrong shape of observable: {} series of dimension {}!",n_series,n_dim);
+    if(m<2 || p<m || p%m!=0 || n_levels<1)
+        throw Pteros_error("Wrong multiple-tau parameters p={}, m={}, levels={}!",p,m,n_levels);
+
+    int nc = n_series*n_dim;
+    levels.resize(n_levels);
+    for(auto& l: levels){
+        l.shift = MatrixXd::Zero(nc,p);
+        l.corr = MatrixXd::Zero(nc,p);
+        l.n_corr.assign(p,0);
+        l.accum = VectorXd::Zero(nc);
+    }
+}
+
+void Multi_tau_correlator::add_frame(const Ref<const VectorXf> &values)
+{
+    if(values.size()!=n_series*n_dim)
+        throw Pteros_error("Expected {} values in frame, got {}!",n_series*n_dim,values.size());
+    add(values.cast<double>(),0);
+}
+
+void Multi_tau_correlator::add(const VectorXd &v, int k)
+{
+    if(k>=levels.size()) return;
+    Level& l = levels[k];
+
+    l.shift.col(l.insert) = v;
+    ++l.n_values;
+
+    // Pass block average to the next level
+    l.accum += v;
+    if(++l.n_accum==m){
+        VectorXd a = l.accum/m;
+        l.accum.fill(0);
+        l.n_accum = 0;
+        add(a,k+1);
+    }
+
+    // Lags below p/m are already covered by previous level with better resolution
+    int jmin = (k==0) ? 0 : p/m;
+    int jmax = std::min<long>(l.n_values,p);
+    for(int j=jmin;j<jmax;++j){
+        int ind = (l.insert-j+p)%p;
+        l.corr.col(j) += l.shift.col(l.insert).cwiseProduct(l.shift.col(ind));
+        ++l.n_corr[j];
+    }
+    l.insert = (l.insert+1)%p;
+}
+
+void Multi_tau_correlator::get_result(VectorXd &lags, VectorXd &corr) const
+{
+    vector<double> lag_v, corr_v;
+    double scale = 1.0;
+    for(int k=0;k<levels.size();++k){
+        const Level& l = levels[k];
+        int jmin = (k==0) ? 0 : p/m;
+        for(int j=jmin;j<p;++j){
+            if(l.n_corr[j]==0) continue;
+            lag_v.push_back(j*scale);
+            // Sum over dimensions and average over series
+            corr_v.push_back(l.corr.col(j).sum()/l.n_corr[j]/n_series);
+        }
+        scale *= m;
+    }
+    lags = Map<VectorXd>(lag_v.data(),lag_v.size());
+    corr = Map<VectorXd>(corr_v.data(),corr_v.size());
+}
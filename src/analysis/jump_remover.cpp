@@ -138,15 +138,11 @@ void Jump_remover::remove_jumps(System& system){
 
     } else { // For other frames, not first
 
-        int ind;
+        // Get images closest to running reference
+        system.box(0).closest_images_to(system.frame(0).coord, no_jump_ind, no_jump_ref, dims);
+        // Update running reference
         for(int i=0;i<no_jump_ind.size();++i){
-            ind = no_jump_ind[i];
-            // Get image closest to running reference
-            system.xyz(ind,0) = system.box(0).closest_image(system.xyz(ind,0),
-                                                            no_jump_ref.col(i),
-                                                            dims);
-            // Update running reference
-            no_jump_ref.col(i) = system.xyz(ind,0);
+            no_jump_ref.col(i) = system.xyz(no_jump_ind[i],0);
         }
 
     }
@@ -29,10 +29,27 @@
 #include <condition_variable>
 #include <queue>
 #include <functional>
+#include <chrono>
+#include "pteros/core/profiling.h"
 
 template<class T>
 class Message_channel {
 public:
+    /// Usage statistics of the channel
+    struct Stats {
+        Stats(): n_sent(0), send_wait(0), recieve_wait(0), occupancy_sum(0), max_occupancy(0) {}
+        /// Number of sent messages
+        int n_sent;
+        /// Total time in seconds spent by senders waiting for free space (backpressure)
+        double send_wait;
+        /// Total time in seconds spent by recievers waiting for new messages (starvation)
+        double recieve_wait;
+        /// Sum of queue sizes after each send. Divide by n_sent to get mean occupancy.
+        double occupancy_sum;
+        /// Maximal queue size
+        int max_occupancy;
+    };
+
     Message_channel(): buffer_size(10), stop_requested(false) { }
 
     Message_channel(int sz): buffer_size(sz), stop_requested(false) { }
@@ -58,12 +75,25 @@ public:
         std::unique_lock<std::mutex> lock(mutex);
 
         // Wait until buffer will clear a bit or until stop is requested
-        cond.wait(lock, [this]{return (queue.size()<buffer_size || stop_requested);} );
+        auto ready = [this]{return (queue.size()<buffer_size || stop_requested);};
+        if(!ready()){
+            auto t0 = std::chrono::steady_clock::now();
+            cond.wait(lock, ready);
+            auto t1 = std::chrono::steady_clock::now();
+            stats.send_wait += std::chrono::duration<double>(t1-t0).count();
+#ifdef PTEROS_PROFILING
+            if(pteros::Profiler::instance().is_enabled())
+                pteros::Profiler::instance().add("channel.send_wait",t0,t1);
+#endif
+        }
 
         // If stop requested just do nothing
         if(stop_requested) return false;
 
         queue.push(data);
+        ++stats.n_sent;
+        stats.occupancy_sum += queue.size();
+        if(queue.size()>stats.max_occupancy) stats.max_occupancy = queue.size();
         cond.notify_one();
         return true;
     }
@@ -72,7 +102,17 @@ public:
         std::unique_lock<std::mutex> lock(mutex);
 
         // Wait until something appears in the queue or until stop requested
-        cond.wait(lock, [this]{return (!queue.empty() || stop_requested);} );
+        auto ready = [this]{return (!queue.empty() || stop_requested);};
+        if(!ready()){
+            auto t0 = std::chrono::steady_clock::now();
+            cond.wait(lock, ready);
+            auto t1 = std::chrono::steady_clock::now();
+            stats.recieve_wait += std::chrono::duration<double>(t1-t0).count();
+#ifdef PTEROS_PROFILING
+            if(pteros::Profiler::instance().is_enabled())
+                pteros::Profiler::instance().add("channel.recieve_wait",t0,t1);
+#endif
+        }
 
         // If stop requested see if there is something in, if not return false
         if(stop_requested && queue.empty()) return false;
@@ -83,12 +123,18 @@ public:
         return true;
     }
 
+    Stats get_stats(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
 private:
     int buffer_size;
     std::condition_variable cond;
     std::mutex mutex;
     std::queue<T> queue;
     bool stop_requested;
+    Stats stats;
 };
 
 
@@ -0,0 +1,147 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/analysis/msd.h"
+#include "pteros/analysis/correlation.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/profiling.h"
+#include <algorithm>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+
+void Vector_series::reset(int n)
+{
+    n_points = n;
+    n_frames = 0;
+    data.clear();
+}
+
+void Vector_series::add_frame(const Ref<const Matrix3Xf> &v)
+{
+    if(v.cols()!=n_points) throw Pteros_error("Expected {} points in frame, got {}!",n_points,v.cols());
+    // Storage grows geometrically, frame is copied in one go
+    size_t pos = data.size();
+    data.resize(pos+3*size_t(n_points));
+    Map<Matrix3Xf>(data.data()+pos,3,n_points) = v;
+    ++n_frames;
+}
+
+void Vector_series::get_series(int p, int dim, Ref<VectorXd> res) const
+{
+    if(res.size()!=n_frames) throw Pteros_error("Expected series of length {}, got {}!",n_frames,res.size());
+    size_t stride = 3*size_t(n_points);
+    const float* ptr = data.data() + 3*size_t(p) + dim;
+    for(int i=0;i<n_frames;++i) res(i) = ptr[i*stride];
+}
+
+namespace {
+
+// Computes body(p,correlator,res) for each point in parallel and averages res over groups
+template<class F>
+MatrixXd average_over_points(const Vector_series& s, const vector<int>& group, F body){
+    int n = s.num_frames();
+    int np = s.num_points();
+    if(n==0) throw Pteros_error("No frames in time series!");
+    if(!group.empty() && group.size()!=np)
+        throw Pteros_error("Groups given for {} points while series has {} points!",group.size(),np);
+
+    int n_groups = group.empty() ? 1 : *max_element(group.begin(),group.end())+1;
+    VectorXd num(n_groups);
+    num.fill(0);
+    for(int p=0;p<np;++p) num(group.empty() ? 0 : group[p]) += 1;
+
+    MatrixXd sum = parallel_reduce(0, np, MatrixXd::Zero(n,n_groups).eval(),
+        [&](int b, int e, MatrixXd& acc){
+            // FFT buffers are reused for all points of the chunk
+            Fft_correlator corr(n);
+            VectorXd res(n);
+            for(int p=b;p<e;++p){
+                body(p,corr,res);
+                acc.col(group.empty() ? 0 : group[p]) += res;
+            }
+        },
+        [](const MatrixXd& a, const MatrixXd& b)->MatrixXd{ return a+b; }, 8);
+
+    for(int g=0;g<n_groups;++g){
+        if(num(g)>0) sum.col(g) /= num(g);
+    }
+    return sum;
+}
+
+} // namespace
+
+
+MatrixXd pteros::msd_fft(const Vector_series &pos, Array3i_const_ref dims, const std::vector<int> &group)
+{
+    PTEROS_PROFILE_SCOPE("msd_fft");
+    int n = pos.num_frames();
+    return average_over_points(pos,group,[&](int p, Fft_correlator& corr, VectorXd& res){
+        // MSD(m) = S1(m) - 2*S2(m), where S2 is autocorrelation of positions
+        // and S1 is computed recursively from squared positions
+        VectorXd x(n), c(n), sq(n);
+        sq.fill(0);
+        res.fill(0);
+        for(int d=0;d<3;++d){
+            if(dims(d)==0) continue;
+            pos.get_series(p,d,x);
+            // Shift to the first frame to reduce round-off errors, MSD doesn't change
+            x.array() -= x(0);
+            sq.array() += x.array().square();
+            corr.autocorrelation(x,c);
+            res -= 2.0*c;
+        }
+        double q = 2.0*sq.sum();
+        for(int m=0;m<n;++m){
+            if(m>0) q -= sq(m-1)+sq(n-m);
+            res(m) = (q+res(m))/(n-m);
+        }
+        // Exactly zero by definition, avoid round-off
+        res(0) = 0;
+    });
+}
+
+MatrixXd pteros::vector_autocorrelation_fft(const Vector_series &v, Array3i_const_ref dims, const std::vector<int> &group)
+{
+    PTEROS_PROFILE_SCOPE("vector_autocorrelation_fft");
+    int n = v.num_frames();
+    return average_over_points(v,group,[&](int p, Fft_correlator& corr, VectorXd& res){
+        VectorXd x(n), c(n);
+        res.fill(0);
+        for(int d=0;d<3;++d){
+            if(dims(d)==0) continue;
+            v.get_series(p,d,x);
+            corr.autocorrelation(x,c);
+            res += c;
+        }
+        for(int m=0;m<n;++m) res(m) /= n-m;
+    });
+}
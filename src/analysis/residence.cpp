@@ -0,0 +1,256 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/analysis/residence.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/profiling.h"
+#include <algorithm>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Shifts intervals to start from the first frame and joins those separated by
+// gaps not longer than tolerance
+void bridge_gaps(const vector<Vector2i>& v, int first, int tolerance, vector<Vector2i>& res)
+{
+    res.clear();
+    for(const auto& it: v){
+        Vector2i cur = it.array()-first;
+        if(!res.empty() && cur(0)-res.back()(1)<=tolerance)
+            res.back()(1) = cur(1);
+        else
+            res.push_back(cur);
+    }
+}
+
+}
+
+void Residence_tracker::create(int n)
+{
+    n_mol = n;
+    visits.assign(n,{});
+    frames.clear();
+}
+
+void Residence_tracker::add_frame(int fr, const vector<int> &inside)
+{
+    if(fr<0) throw Pteros_error("Wrong frame {}!",fr);
+    if(fr>=frames.size()) frames.resize(fr+1,false);
+    if(frames[fr]) throw Pteros_error("Frame {} is already added!",fr);
+    frames[fr] = true;
+
+    for(int m: inside){
+        if(m<0 || m>=n_mol) throw Pteros_error("Molecule {} is out of range 0:{}!",m,n_mol-1);
+        auto& v = visits[m];
+
+        // Frames usually come in increasing order, so only the last interval is touched
+        if(v.empty() || v.back()(1)<fr){
+            v.emplace_back(fr,fr+1);
+            continue;
+        }
+        if(v.back()(1)==fr){
+            ++v.back()(1);
+            continue;
+        }
+
+        // Frame before the last interval
+        auto it = upper_bound(v.begin(),v.end(),fr,
+                              [](int f, const Vector2i& iv){ return f<iv(0); });
+        auto prev = (it==v.begin()) ? v.end() : it-1;
+        // Listed twice
+        if(prev!=v.end() && (*prev)(1)>fr) continue;
+
+        bool joined = false;
+        if(prev!=v.end() && (*prev)(1)==fr){
+            (*prev)(1) = fr+1;
+            joined = true;
+        }
+        if(it!=v.end() && (*it)(0)==fr+1){
+            if(joined){
+                (*prev)(1) = (*it)(1);
+                v.erase(it);
+            } else {
+                (*it)(0) = fr;
+            }
+        } else if(!joined){
+            v.insert(it,Vector2i(fr,fr+1));
+        }
+    }
+}
+
+void Residence_tracker::merge(const Residence_tracker &other)
+{
+    if(other.n_mol!=n_mol)
+        throw Pteros_error("Can't merge residence data for {} and {} molecules!",n_mol,other.n_mol);
+
+    if(other.frames.size()>frames.size()) frames.resize(other.frames.size(),false);
+    for(int i=0;i<other.frames.size();++i){
+        if(!other.frames[i]) continue;
+        if(frames[i]) throw Pteros_error("Frame {} is present in both residence trackers!",i);
+        frames[i] = true;
+    }
+
+    for(int m=0;m<n_mol;++m){
+        if(other.visits[m].empty()) continue;
+        auto& v = visits[m];
+        v.insert(v.end(),other.visits[m].begin(),other.visits[m].end());
+        sort(v.begin(),v.end(),[](const Vector2i& a, const Vector2i& b){ return a(0)<b(0); });
+        // Join adjacent intervals
+        int k = 0;
+        for(int i=1;i<v.size();++i){
+            if(v[i](0)<=v[k](1)){
+                v[k](1) = std::max(v[k](1),v[i](1));
+            } else {
+                v[++k] = v[i];
+            }
+        }
+        v.resize(k+1);
+    }
+}
+
+void Residence_tracker::frame_range(int &first, int &n) const
+{
+    auto b = find(frames.begin(),frames.end(),true);
+    if(b==frames.end()) throw Pteros_error("No frames in residence data!");
+    first = b-frames.begin();
+    n = frames.size()-first;
+    for(int i=first;i<frames.size();++i){
+        if(!frames[i]) throw Pteros_error("Residence data should contain consecutive frames, frame {} is missing!",i);
+    }
+}
+
+int Residence_tracker::num_frames() const
+{
+    auto b = find(frames.begin(),frames.end(),true);
+    return frames.end()-b;
+}
+
+vector<Vector2i> Residence_tracker::get_visits(int i, int tolerance) const
+{
+    if(i<0 || i>=n_mol) throw Pteros_error("Molecule {} is out of range 0:{}!",i,n_mol-1);
+    int first, n;
+    frame_range(first,n);
+    vector<Vector2i> res;
+    bridge_gaps(visits[i],first,tolerance,res);
+    return res;
+}
+
+vector<Residence_stats> Residence_tracker::get_stats(int tolerance) const
+{
+    int first, n;
+    frame_range(first,n);
+
+    vector<Residence_stats> res(n_mol);
+    vector<Vector2i> v;
+    for(int m=0;m<n_mol;++m){
+        auto& st = res[m];
+        st.num_frames = 0;
+        for(const auto& it: visits[m]) st.num_frames += it(1)-it(0);
+
+        bridge_gaps(visits[m],first,tolerance,v);
+        st.num_visits = v.size();
+        st.max_time = 0;
+        int total = 0;
+        for(const auto& it: v){
+            total += it(1)-it(0);
+            st.max_time = std::max(st.max_time,it(1)-it(0));
+        }
+        st.mean_time = v.empty() ? 0.0 : total/float(v.size());
+    }
+    return res;
+}
+
+VectorXi Residence_tracker::occupancy() const
+{
+    int first, n;
+    frame_range(first,n);
+    // Difference array over frames
+    VectorXi res = VectorXi::Zero(n+1);
+    for(const auto& v: visits){
+        for(const auto& it: v){
+            ++res(it(0)-first);
+            --res(it(1)-first);
+        }
+    }
+    for(int i=1;i<n;++i) res(i) += res(i-1);
+    res.conservativeResize(n);
+    return res;
+}
+
+void Residence_tracker::exchange(VectorXi &entered, VectorXi &left, int tolerance) const
+{
+    int first, n;
+    frame_range(first,n);
+    entered = VectorXi::Zero(n);
+    left = VectorXi::Zero(n);
+    vector<Vector2i> v;
+    for(int m=0;m<n_mol;++m){
+        bridge_gaps(visits[m],first,tolerance,v);
+        for(const auto& it: v){
+            if(it(0)>0) ++entered(it(0));
+            if(it(1)<n) ++left(it(1));
+        }
+    }
+}
+
+VectorXd Residence_tracker::survival_probability(int max_lag, int tolerance) const
+{
+    PTEROS_PROFILE_SCOPE("residence.survival");
+    int first, n;
+    frame_range(first,n);
+    if(max_lag<0 || max_lag>=n) max_lag = n-1;
+    int nl = max_lag+1;
+
+    // Accumulates number of continuous stays of each length in first half
+    // and number of available time origins in the second half
+    auto acc = parallel_reduce(0,n_mol,VectorXd::Zero(2*nl).eval(),
+        [&](int b, int e, VectorXd& acc){
+            vector<Vector2i> v;
+            for(int m=b;m<e;++m){
+                bridge_gaps(visits[m],first,tolerance,v);
+                for(const auto& it: v){
+                    int len = it(1)-it(0);
+                    int lmax = std::min(max_lag,n-it(0)-1);
+                    for(int lag=0;lag<=lmax;++lag){
+                        if(lag<len) acc(lag) += len-lag;
+                        acc(nl+lag) += std::min(it(1),n-lag)-it(0);
+                    }
+                }
+            }
+        },
+        [](const VectorXd& a, const VectorXd& b)->VectorXd{ return a+b; }, 64);
+
+    VectorXd res(nl);
+    for(int lag=0;lag<nl;++lag)
+        res(lag) = acc(nl+lag)>0 ? acc(lag)/acc(nl+lag) : 0.0;
+    return res;
+}
@@ -0,0 +1,240 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "shared_frame_channel.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/profiling.h"
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+using namespace std;
+using namespace pteros;
+
+#ifndef _WIN32
+
+struct Shared_frame_channel::Header {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int num_slots;
+    int head; // Next slot to read
+    int count; // Number of filled slots
+    bool stop_requested;
+};
+
+// Fixed part of each slot, followed by coordinates (and optionally velocities and forces)
+struct Slot_header {
+    Frame_info frame_info;
+    float time;
+    float box[9];
+    bool has_vel;
+    bool has_force;
+};
+
+namespace {
+
+// Locks process-shared mutex taking care of the worker, which died while holding it
+void lock_robust(pthread_mutex_t* m){
+    if(pthread_mutex_lock(m)==EOWNERDEAD) pthread_mutex_consistent(m);
+}
+
+size_t aligned(size_t sz){ return (sz+63) & ~size_t(63); }
+
+}
+
+Shared_frame_channel::Shared_frame_channel(int buf_size, int _natoms, bool _with_vel_force):
+    natoms(_natoms), with_vel_force(_with_vel_force)
+{
+    if(buf_size<1) throw Pteros_error("Buffer size should be positive!");
+
+    size_t nvec = with_vel_force ? 3 : 1;
+    slot_size = aligned(sizeof(Slot_header)) + aligned(nvec*natoms*sizeof(Eigen::Vector3f));
+    mem_size = aligned(sizeof(Header)) + buf_size*slot_size;
+
+    // Anonymous shared mapping is inherited by forked workers
+    void* p = mmap(nullptr, mem_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(p==MAP_FAILED) throw Pteros_error("Can't allocate {} bytes of shared memory for frames!",mem_size);
+    mem = (char*)p;
+
+    header = new (mem) Header;
+    header->num_slots = buf_size;
+    header->head = 0;
+    header->count = 0;
+    header->stop_requested = false;
+
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&header->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+Shared_frame_channel::~Shared_frame_channel(){
+    // Each process unmaps its own copy of the mapping,
+    // synchronization primitives are destroyed by the last one
+    munmap(mem, mem_size);
+}
+
+char *Shared_frame_channel::slot(int i){
+    return mem + aligned(sizeof(Header)) + i*slot_size;
+}
+
+bool Shared_frame_channel::send(const Data_container &data, const std::function<void()> &on_wait){
+    PTEROS_PROFILE_SCOPE("shared_channel.send");
+    const Frame& fr = data.frame;
+    if(fr.coord.size()!=natoms)
+        throw Pteros_error("Expected {} atoms in frame but got {}!",natoms,fr.coord.size());
+
+    lock_robust(&header->mutex);
+
+    // Wait until some slot is free or until stop is requested
+    while(header->count==header->num_slots && !header->stop_requested){
+        timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += 1;
+        if(pthread_cond_timedwait(&header->cond, &header->mutex, &deadline)==ETIMEDOUT && on_wait){
+            // Let the caller check if the consumers are still alive
+            pthread_mutex_unlock(&header->mutex);
+            on_wait();
+            lock_robust(&header->mutex);
+        }
+    }
+
+    if(header->stop_requested){
+        pthread_mutex_unlock(&header->mutex);
+        return false;
+    }
+
+    // Only one producer exists, so the slot could be filled without holding the lock
+    int ind = (header->head + header->count) % header->num_slots;
+    pthread_mutex_unlock(&header->mutex);
+
+    char* s = slot(ind);
+    Slot_header* sh = (Slot_header*)s;
+    sh->frame_info = data.frame_info;
+    sh->time = fr.time;
+    Eigen::Map<Eigen::Matrix3f>(sh->box) = fr.box.get_matrix();
+    sh->has_vel = with_vel_force && fr.has_vel();
+    sh->has_force = with_vel_force && fr.has_force();
+
+    float* v = (float*)(s + aligned(sizeof(Slot_header)));
+    memcpy(v, fr.coord.data(), natoms*sizeof(Eigen::Vector3f));
+    if(sh->has_vel) memcpy(v+3*natoms, fr.vel.data(), natoms*sizeof(Eigen::Vector3f));
+    if(sh->has_force) memcpy(v+6*natoms, fr.force.data(), natoms*sizeof(Eigen::Vector3f));
+
+    lock_robust(&header->mutex);
+    ++header->count;
+    pthread_cond_broadcast(&header->cond);
+    pthread_mutex_unlock(&header->mutex);
+    return true;
+}
+
+bool Shared_frame_channel::recieve(Data_container &data){
+    lock_robust(&header->mutex);
+
+    // Wait until something appears in the buffer or until stop requested
+    while(header->count==0 && !header->stop_requested)
+        pthread_cond_wait(&header->cond, &header->mutex);
+
+    // If stop requested and nothing left return false
+    if(header->count==0){
+        pthread_mutex_unlock(&header->mutex);
+        return false;
+    }
+
+    // Copy under the lock since many consumers compete for slots
+    char* s = slot(header->head);
+    Slot_header* sh = (Slot_header*)s;
+    Frame& fr = data.frame;
+    data.frame_info = sh->frame_info;
+    fr.time = sh->time;
+    fr.box.set_matrix(Eigen::Map<Eigen::Matrix3f>(sh->box));
+
+    float* v = (float*)(s + aligned(sizeof(Slot_header)));
+    fr.coord.resize(natoms);
+    memcpy(fr.coord.data(), v, natoms*sizeof(Eigen::Vector3f));
+    if(sh->has_vel){
+        fr.vel.resize(natoms);
+        memcpy(fr.vel.data(), v+3*natoms, natoms*sizeof(Eigen::Vector3f));
+    } else {
+        fr.vel.clear();
+    }
+    if(sh->has_force){
+        fr.force.resize(natoms);
+        memcpy(fr.force.data(), v+6*natoms, natoms*sizeof(Eigen::Vector3f));
+    } else {
+        fr.force.clear();
+    }
+
+    header->head = (header->head+1) % header->num_slots;
+    --header->count;
+    pthread_cond_broadcast(&header->cond);
+    pthread_mutex_unlock(&header->mutex);
+    return true;
+}
+
+void Shared_frame_channel::send_stop(){
+    lock_robust(&header->mutex);
+    header->stop_requested = true;
+    pthread_cond_broadcast(&header->cond);
+    pthread_mutex_unlock(&header->mutex);
+}
+
+#else
+
+struct Shared_frame_channel::Header {};
+
+Shared_frame_channel::Shared_frame_channel(int buf_size, int _natoms, bool _with_vel_force){
+    throw Pteros_error("Multiprocess tasks are not supported on this platform!");
+}
+
+Shared_frame_channel::~Shared_frame_channel(){}
+
+char *Shared_frame_channel::slot(int i){ return nullptr; }
+
+bool Shared_frame_channel::send(const Data_container &data, const std::function<void()> &on_wait){ return false; }
+
+bool Shared_frame_channel::recieve(Data_container &data){ return false; }
+
+void Shared_frame_channel::send_stop(){}
+
+#endif
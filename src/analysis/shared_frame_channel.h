@@ -0,0 +1,70 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#ifndef SHARED_FRAME_CHANNEL_H
+#define SHARED_FRAME_CHANNEL_H
+
+#include "data_container.h"
+#include <functional>
+
+namespace pteros {
+
+/// Bounded queue of frames, which lives in anonymous shared memory.
+/// It is created in the master process before forking the workers and
+/// is used to send frames to them without any serialization.
+/// The interface mimics Message_channel.
+class Shared_frame_channel {
+public:
+    /// Creates buffer of buf_size frames for natoms atoms.
+    /// If with_vel_force is false velocities and forces are not transferred.
+    Shared_frame_channel(int buf_size, int natoms, bool with_vel_force);
+    ~Shared_frame_channel();
+
+    /// Copies the frame into the shared buffer.
+    /// If the buffer is full on_wait is called periodically while waiting.
+    bool send(const Data_container& data, const std::function<void()>& on_wait = nullptr);
+    /// Copies next frame from shared buffer. Returns false when stopped and empty.
+    bool recieve(Data_container& data);
+    void send_stop();
+
+private:
+    struct Header;
+    Header* header;
+    char* mem;
+    size_t mem_size;
+    size_t slot_size;
+    int natoms;
+    bool with_vel_force;
+
+    char* slot(int i);
+};
+
+}
+
+#endif // SHARED_FRAME_CHANNEL_H
@@ -1,5 +1,6 @@
 #include "pteros/analysis/task_base.h"
 #include "task_driver.h"
+#include "pteros/core/profiling.h"
 
 using namespace std;
 using namespace pteros;
@@ -21,7 +22,10 @@ Task_base::Task_base(const Task_base &other)
 }
 
 void pteros::Task_base::put_frame(const pteros::Frame &frame){
+    PTEROS_PROFILE_SCOPE("task.put_frame");
     system.frame(0) = frame;
+    PTEROS_PROFILE_COUNT("task.put_frame.bytes",
+                         sizeof(Eigen::Vector3f)*(frame.coord.size()+frame.vel.size()+frame.force.size()));
 }
 
 void pteros::Task_base::put_system(const pteros::System &sys){
@@ -1,4 +1,6 @@
 #include "task_driver.h"
+#include "pteros/core/profiling.h"
+#include "pteros/core/thread_pool.h"
 
 using namespace std;
 using namespace pteros;
@@ -24,12 +26,18 @@ void Task_driver::set_data_channel_and_system(const Data_channel_ptr &ch, const
 }
 
 void Task_driver::process_until_end() {
+    PTEROS_PROFILE_THREAD(fmt::format("task #{}",task->task_id));
+    // Instances of parallel task already occupy all threads,
+    // so parallel algorithms called by them run serially
+    std::unique_ptr<Thread_limit> limit;
+    if(task->is_parallel()) limit.reset(new Thread_limit(1));
     pre_process_done = false;
     while(channel->recieve(data)){
         if(stop_now) return; // Emergency stop point
 
         task->put_frame(data->frame);
         if(!pre_process_done){
+            PTEROS_PROFILE_SCOPE("task.pre_process");
             task->pre_process_handler();
             pre_process_done = true;
         }
@@ -43,8 +51,36 @@ void Task_driver::process_until_end() {
     }
 }
 
+void Task_driver::process_until_end_shared(Shared_frame_channel &ch) {
+    PTEROS_PROFILE_THREAD(fmt::format("worker #{}",task->task_id));
+    // Each worker process occupies one thread
+    Thread_limit limit(1);
+    pre_process_done = false;
+    Data_container buf;
+    while(ch.recieve(buf)){
+        task->put_frame(buf.frame);
+        if(!pre_process_done){
+            PTEROS_PROFILE_SCOPE("task.pre_process");
+            task->pre_process_handler();
+            pre_process_done = true;
+        }
+        task->process_frame_handler(buf.frame_info);
+        ++task->n_consumed;
+    }
+    if(task->n_consumed>0){
+        task->post_process_handler(buf.frame_info);
+    } else {
+        task->log->warn("No frames consumed!");
+    }
+}
+
 void Task_driver::process_until_end_in_thread() {
-    t = std::thread(&Task_driver::process_until_end, this);
+    // Thread limit of the caller applies to the task thread as well
+    int nt = get_num_threads();
+    t = std::thread([this,nt](){
+        Thread_limit limit(nt);
+        process_until_end();
+    });
 }
 
 void Task_driver::join_thread() { t.join(); }
@@ -3,6 +3,7 @@
 #include "message_channel.h"
 #include "pteros/core/pteros_error.h"
 #include "data_container.h"
+#include "shared_frame_channel.h"
 #include <iostream>
 
 namespace pteros {
@@ -16,6 +17,8 @@ public:
     virtual ~Task_driver();
     void set_data_channel_and_system(const Data_channel_ptr& ch, const System &sys);
     void process_until_end();
+    // Used in worker processes of multiprocess tasks
+    void process_until_end_shared(Shared_frame_channel& ch);
     void process_until_end_in_thread ();
     void join_thread();
 private:
@@ -1,4 +1,5 @@
 #include "pteros/analysis/task_plugin.h"
+#include "pteros/core/profiling.h"
 
 
 pteros::Task_plugin::Task_plugin(const pteros::Task_plugin &other): Task_base(other)
@@ -29,7 +30,11 @@ void pteros::Task_plugin::pre_process_handler()
 void pteros::Task_plugin::process_frame_handler(const pteros::Frame_info &info)
 {
     try {
-        jump_remover.remove_jumps(system);
+        {
+            PTEROS_PROFILE_SCOPE("task.remove_jumps");
+            jump_remover.remove_jumps(system);
+        }
+        PTEROS_PROFILE_SCOPE("task.process_frame");
         process_frame(info);
 
     } catch (const std::exception& e) {
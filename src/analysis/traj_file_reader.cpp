@@ -1,6 +1,7 @@
 #include "traj_file_reader.h"
 #include "pteros/core/pteros_error.h"
 #include "pteros/core/mol_file.h"
+#include "pteros/core/profiling.h"
 #include <boost/algorithm/string.hpp> // For to_lower
 #include <boost/lexical_cast.hpp>
 
@@ -37,6 +38,8 @@ void process_suffix_value(const string& s, int* intval, float* floatval){
 
 Traj_file_reader::Traj_file_reader(Options &options, int natoms){
     Natoms = natoms;
+    n_read = 0;
+    read_time = 0;
 
     // Separate reader logger (not registered since only used here)
     log = create_logger("traj_file");
@@ -95,6 +98,9 @@ bool Traj_file_reader::is_end_of_interval(int fr, float t){
 
 void Traj_file_reader::run(const vector<string> &traj_files, const Data_channel_ptr &ch){
     stop_now = false;
+    n_read = 0;
+    read_time = 0;
+    channel = ch;
     t = std::thread( &Traj_file_reader::reader_thread_body, this, ref(traj_files), ref(ch) );
 }
 
@@ -103,6 +109,8 @@ Traj_file_reader::~Traj_file_reader(){
         // Stop the thread
         stop_now = true;
         log->error("Ups! Stopping reader thread on outer exception...");
+        // Unblock the reader if it waits for free space in the channel
+        channel->send_stop();
         t.join();
     }
 }
@@ -110,6 +118,7 @@ Traj_file_reader::~Traj_file_reader(){
 void Traj_file_reader::join(){ t.join(); }
 
 void Traj_file_reader::reader_thread_body(const vector<string> &traj_files, const Data_channel_ptr &channel){
+    PTEROS_PROFILE_THREAD("reader");
     try {
         int abs_frame = 0;
         float abs_time = 0.0;
@@ -181,7 +190,13 @@ void Traj_file_reader::reader_thread_body(const vector<string> &traj_files, cons
                 std::shared_ptr<Data_container> data(new Data_container);
 
                 // Load data to this container
+                auto t0 = chrono::steady_clock::now();
                 bool good = trj->read(nullptr, &data->frame, Mol_file_content().traj(true));
+                auto t1 = chrono::steady_clock::now();
+                read_time += chrono::duration<double>(t1-t0).count();
+#ifdef PTEROS_PROFILING
+                if(Profiler::instance().is_enabled()) Profiler::instance().add("reader.read",t0,t1);
+#endif
 
                 // Check number of atoms
                 if(data->frame.coord.size() != Natoms)
@@ -191,6 +206,8 @@ void Traj_file_reader::reader_thread_body(const vector<string> &traj_files, cons
                 if(!good) break;
 
                 ++abs_frame; // Next absolute frame loaded
+                ++n_read;
+                PTEROS_PROFILE_COUNT("reader.frames",1);
 
                 // If time stamps are overriden, override time
                 if(custom_dt>=0){
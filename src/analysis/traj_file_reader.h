@@ -28,6 +28,11 @@ public:
 
     void join();
 
+    /// Number of frames read from trajectory files (valid after join)
+    int get_num_read() const { return n_read; }
+    /// Time in seconds spent in reading frames (valid after join)
+    double get_read_time() const { return read_time; }
+
     void reader_thread_body(const std::vector<std::string>& traj_files, const Data_channel_ptr &channel);
 
 private:
@@ -40,8 +45,13 @@ private:
     float first_time, last_time;
     int skip;
 
+    // Statistics
+    int n_read;
+    double read_time;
+
     std::thread t;
     bool stop_now; // Emergency stop flag
+    Data_channel_ptr channel;
     std::shared_ptr<spdlog::logger> log;
 };
 
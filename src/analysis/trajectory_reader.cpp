@@ -36,11 +36,100 @@
 #include "task_driver.h"
 #include "traj_file_reader.h"
 #include "pteros/core/logging.h"
+#include "shared_frame_channel.h"
+#include "pteros/core/profiling.h"
+#include "pteros/core/thread_pool.h"
 #include <thread>
+#include <functional>
+#include <boost/algorithm/string.hpp>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <poll.h>
+#endif
 
 using namespace pteros;
 using namespace std;
 
+#ifndef _WIN32
+namespace {
+
+// Forked worker process running an instance of multiprocess task
+struct Worker_process {
+    pid_t pid;
+    int fd; // Read end of the pipe, which delivers the result
+    bool exited; // Process is already reaped
+    int status; // Exit status if exited
+};
+
+// Reaps the worker without blocking if it has exited. Returns true if exited.
+bool reap_worker(Worker_process& w){
+    if(!w.exited && w.pid>0 && waitpid(w.pid,&w.status,WNOHANG)==w.pid) w.exited = true;
+    return w.exited;
+}
+
+bool worker_succeeded(const Worker_process& w){
+    return WIFEXITED(w.status) && WEXITSTATUS(w.status)==0;
+}
+
+// Waits until the result is available in the pipe of the worker.
+// Calls on_wait periodically while waiting.
+void wait_for_result(const Worker_process& w, const std::function<void()>& on_wait){
+    pollfd p {w.fd, POLLIN, 0};
+    while(true){
+        int k = poll(&p,1,1000);
+        if(k>0) return; // Data or EOF
+        if(k<0 && errno!=EINTR) return; // Let read report the error
+        on_wait();
+    }
+}
+
+void write_all(int fd, const void* buf, size_t n){
+    const char* p = (const char*)buf;
+    while(n>0){
+        auto k = ::write(fd,p,n);
+        if(k<0){
+            if(errno==EINTR) continue;
+            throw Pteros_error("Can't send result of worker process to master!");
+        }
+        p += k;
+        n -= k;
+    }
+}
+
+bool read_all(int fd, void* buf, size_t n){
+    char* p = (char*)buf;
+    while(n>0){
+        auto k = ::read(fd,p,n);
+        if(k<0 && errno==EINTR) continue;
+        if(k<=0) return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+void kill_workers(vector<Worker_process>& workers){
+    for(auto& w: workers){
+        if(w.pid>0){
+            if(!w.exited){
+                kill(w.pid,SIGKILL);
+                waitpid(w.pid,nullptr,0);
+            }
+            w.pid = -1;
+        }
+        if(w.fd>=0){
+            close(w.fd);
+            w.fd = -1;
+        }
+    }
+}
+
+}
+#endif
+
 
 string Trajectory_reader::help(){
     return
@@ -85,6 +174,17 @@ Processing options:
     -buffer <n>
         Number of frames, which are kept in memory, default: 10
         Only touch this if individual frames are very large.
+    -nt <n>
+        Number of threads for parallel tasks and parallel algorithms
+        in this run, default: number of hardware threads or PTEROS_NUM_THREADS
+        environment variable if it is set. Can't exceed the default.
+    -profile
+        Print timings of processing stages per thread at the end.
+        Only works if Pteros is compiled with WITH_PROFILING option.
+        Worker processes of multiprocess tasks are not profiled.
+    -profile_trace <file.json>
+        Also write timings of individual frames in Chrome trace format.
+        Implies -profile.
 
 Suffixes:
     All parameters marked as <value[suffix]> accept the following optional suffixes:
@@ -119,6 +219,20 @@ void Trajectory_reader::run(){
     // Preparation stage
     log->debug("Starting trajectory processing");
     auto start = chrono::steady_clock::now();
+    stats = Trajectory_reader_stats();
+
+    // Set up built-in profiling if asked
+    string profile_trace = options("profile_trace","").as_string();
+    bool do_profile = options.has("profile") || profile_trace!="";
+    if(do_profile && !Profiler::is_compiled()){
+        log->warn("Pteros is compiled without WITH_PROFILING option, profiling is not available!");
+        do_profile = false;
+    }
+    if(do_profile){
+        Profiler::instance().reset();
+        Profiler::instance().set_thread_name("master");
+        Profiler::instance().enable(true, profile_trace!="");
+    }
 
     // Get file path
     auto file_path = options("path","").as_string();
@@ -213,10 +327,12 @@ void Trajectory_reader::run(){
     // Analysing which kind of tasks we have
 
     is_parallel = false;
+    bool is_multiprocess = false;
     for(auto& task: tasks){
         if(task->is_parallel()){
             if(tasks.size()>1) throw Pteros_error("No other tasks can run if parallel task is present!");
             is_parallel = true;
+            is_multiprocess = task->is_multiprocess();
             break;
         }
     }
@@ -241,21 +357,179 @@ void Trajectory_reader::run(){
     Data_channel_ptr reader_channel(new Data_channel);
     reader_channel->set_buffer_size(buf_size);
 
-    int Nproc = std::thread::hardware_concurrency();
-    log->debug("Physical cores: {}", Nproc);
+    // Limit number of threads if asked. Only this run is affected,
+    // task threads inherit the limit from this thread.
+    std::unique_ptr<Thread_limit> thread_limit;
+    if(options.has("nt")) thread_limit.reset(new Thread_limit(options("nt").as_int()));
+
+    int Nproc = get_num_threads();
+    log->debug("Threads available: {}", Nproc);
     log->debug("\tFile reading thread: 1");
 
     // Create traj file reader
     Traj_file_reader reader(options, system.num_atoms());
-    // Start reader thread
-    reader.run(traj_files, reader_channel);
+    // Start reader thread.
+    // For multiprocess tasks this is only done after forking the workers
+    if(!is_multiprocess) reader.run(traj_files, reader_channel);
 
     // Data container
     using Data_container_ptr = std::shared_ptr<Data_container>;
     Data_container_ptr data;
 
+    // Number of frames consumed by each worker process of multiprocess task
+    vector<int> worker_frames;
+
     // Processing depends on which tasks we have
-    if(is_parallel){
+    if(is_multiprocess){
+        /* Single parallel task, which can't run in threads
+         * We fork Nproc-1 worker processes each with a copy of this task.
+         * Master process forwards frames from the reader channel
+         * to the workers through the shared memory buffer.
+         * Workers send serialized results back to the master through pipes
+         * and they are passed to collect_results() of the master instance.
+         */
+#ifndef _WIN32
+        int num_workers = std::max(1,Nproc-1);
+
+        log->debug("\tWorker processes running parallel task: {}", num_workers);
+        log->debug("\t(master process is dispatching frames)");
+
+        // Velocities and forces are only transferred if some trajectory may contain them
+        bool with_vel_force = false;
+        for(auto& f: traj_files){
+            auto c = Mol_file::recognize(f)->get_content_type();
+            if(c.vel() || c.force()) with_vel_force = true;
+        }
+
+        Shared_frame_channel shared_channel(buf_size, system.num_atoms(), with_vel_force);
+
+        tasks[0]->set_id(0);
+        tasks[0]->driver->set_data_channel_and_system(reader_channel,system);
+
+        // Call user-defined init before forking. It is done only once in master.
+        tasks[0]->before_spawn_handler();
+
+        // Fork workers. There are no other threads at this point.
+        vector<Worker_process> workers;
+        for(int i=1; i<=num_workers; ++i){
+            int fds[2];
+            if(pipe(fds)!=0){
+                kill_workers(workers);
+                throw Pteros_error("Can't create pipe for worker process!");
+            }
+
+            tasks[0]->before_fork();
+            pid_t pid = fork();
+
+            if(pid==0){
+                // Worker process
+                tasks[0]->after_fork(true);
+                close(fds[0]);
+                for(auto& w: workers) close(w.fd);
+
+                int status = 0;
+                try {
+                    tasks[0]->set_id(i);
+                    tasks[0]->driver->process_until_end_shared(shared_channel);
+                    string res = tasks[0]->n_consumed ? tasks[0]->get_result() : "";
+                    uint64_t sz = res.size();
+                    write_all(fds[1], &tasks[0]->n_consumed, sizeof(int));
+                    write_all(fds[1], &sz, sizeof(uint64_t));
+                    write_all(fds[1], res.data(), sz);
+                } catch(const std::exception& e) {
+                    tasks[0]->log->error(e.what());
+                    status = 1;
+                }
+                close(fds[1]);
+                spdlog::apply_all([](const std::shared_ptr<spdlog::logger>& l){ l->flush(); });
+                fflush(stdout);
+                // Exit without running any destructors or atexit handlers of the master
+                _exit(status);
+            }
+
+            tasks[0]->after_fork(false);
+            close(fds[1]);
+            if(pid<0){
+                close(fds[0]);
+                kill_workers(workers);
+                throw Pteros_error("Can't fork worker process!");
+            }
+            workers.push_back({pid,fds[0],false,0});
+        }
+
+        // Workers exit only after stop is sent, so exited worker means failure.
+        // Checked after each frame and while waiting for free space in the buffer,
+        // so that the worker, which dies while the buffer is not full, is detected too.
+        auto check_workers = [&](){
+            for(auto& w: workers){
+                if(reap_worker(w)){
+                    reader_channel->send_stop();
+                    kill_workers(workers);
+                    throw Pteros_error("Worker process of parallel task died unexpectedly!");
+                }
+            }
+        };
+
+        // Now it's safe to start reader thread
+        reader.run(traj_files, reader_channel);
+
+        // Forward all frames to workers
+        while(reader_channel->recieve(data)){
+            shared_channel.send(*data, check_workers);
+            check_workers();
+        }
+        shared_channel.send_stop();
+
+        // While waiting for the result of one worker the others may fail
+        auto check_failed_workers = [&](){
+            for(int i=0; i<workers.size(); ++i){
+                if(reap_worker(workers[i]) && !worker_succeeded(workers[i])){
+                    kill_workers(workers);
+                    throw Pteros_error("Worker process #{} of parallel task failed!",i+1);
+                }
+            }
+        };
+
+        // Collect results from workers, which consumed some frames
+        vector<string> results;
+        int n_total = 0;
+        for(int i=0; i<workers.size(); ++i){
+            auto& w = workers[i];
+            int n = 0;
+            uint64_t sz = 0;
+            string res;
+            wait_for_result(w,check_failed_workers);
+            bool ok = read_all(w.fd,&n,sizeof(int)) && read_all(w.fd,&sz,sizeof(uint64_t));
+            if(ok){
+                res.resize(sz);
+                ok = read_all(w.fd,&res[0],sz);
+            }
+            close(w.fd);
+            w.fd = -1;
+
+            if(!w.exited){
+                waitpid(w.pid,&w.status,0);
+                w.exited = true;
+            }
+            w.pid = -1;
+            if(!ok || !worker_succeeded(w)){
+                kill_workers(workers);
+                throw Pteros_error("Worker process #{} of parallel task failed!",i+1);
+            }
+
+            worker_frames.push_back(n);
+            if(n){
+                results.push_back(std::move(res));
+                n_total += n;
+            }
+        }
+
+        log->debug("Collecting results from {} worker processes...", results.size());
+        tasks[0]->collect_results(results,n_total);
+#else
+        throw Pteros_error("Multiprocess tasks are not supported on this platform!");
+#endif
+    } else if(is_parallel){
         /* Single parallel task present
          * We run Nproc threads each with an instance of this task
          * and dispatch frames async to them from the reader channel
@@ -302,10 +576,14 @@ void Trajectory_reader::run(){
         if(tasks.size()>1)
             for(int i=1; i<=num_threads; ++i) tasks[i]->driver->join_thread();
 
+        // Task instances share the topology unless they modified it
+        int n_shared = 0;
+        for(auto& t: tasks) if(t->system.is_topology_shared()) ++n_shared;
+        log->debug("Topology is shared by {} of {} task instances", n_shared, tasks.size());
 
         // Now collect results from all instances that consumed some frames
         vector<Task_ptr> resultive_tasks;
-        int n_total = 0;
+        int n_total = tasks[0]->n_consumed;
         for(int i=1; i<tasks.size();++i){
             if(tasks[i]->n_consumed) resultive_tasks.push_back(tasks[i]);
             n_total += tasks[i]->n_consumed;
@@ -362,6 +640,12 @@ void Trajectory_reader::run(){
             // Join all workers
             for(auto& t: tasks) t->driver->join_thread();
 
+            for(auto &ch: worker_channels){
+                auto st = ch->get_stats();
+                stats.task_wait.push_back(st.recieve_wait);
+                stats.dispatch_wait += st.send_wait;
+            }
+
         } else {            
             // There is only one consumer, no need for multiple threads
             log->debug("\tRunning single serial task in master thread");
@@ -378,10 +662,42 @@ void Trajectory_reader::run(){
 
     auto end = chrono::steady_clock::now();
 
-    log->info("Processing wall time: {}s", chrono::duration<double>(end-start).count() );
+    // Collect throughput statistics
+    auto rs = reader_channel->get_stats();
+    stats.wall_time = chrono::duration<double>(end-start).count();
+    stats.frames_read = reader.get_num_read();
+    stats.read_time = reader.get_read_time();
+    stats.reader_wait = rs.send_wait;
+    stats.consumer_wait = rs.recieve_wait;
+    stats.mean_occupancy = rs.n_sent ? rs.occupancy_sum/rs.n_sent : 0.0;
+    stats.max_occupancy = rs.max_occupancy;
+    stats.buffer_size = buf_size;
+
+    log->info("Processing wall time: {}s", stats.wall_time);
+    log->debug("Frames read: {} in {}s, reader blocked by full buffer: {}s, consumers waited for frames: {}s",
+               stats.frames_read, stats.read_time, stats.reader_wait, stats.consumer_wait);
+    log->debug("Buffer occupancy: mean {:.2f}, max {} of {}",
+               stats.mean_occupancy, stats.max_occupancy, stats.buffer_size);
+
+    if(do_profile){
+        Profiler::instance().enable(false);
+        log->info("Profiling results:\n{}", Profiler::instance().report(stats.wall_time));
+        if(profile_trace!=""){
+            Profiler::instance().write_chrome_trace(profile_trace);
+            log->info("Profiling trace written to '{}'", profile_trace);
+        }
+    }
 
     // Print statistics
-    if( is_parallel ){
+    if( is_multiprocess ){
+        log->info("Number of frames processed by worker processes:");
+        int tot = 0;
+        for(int i=0; i<worker_frames.size(); ++i){
+            log->info("\tWorker #{}: {}", i+1, worker_frames[i]);
+            tot += worker_frames[i];
+        }
+        log->info("\tTotal: {}", tot);
+    } else if( is_parallel ){
         log->info("Number of frames processed by parallel task instances:");
         int tot = 0;
         for(int i=0; i<tasks.size(); ++i){
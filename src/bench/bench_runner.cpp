@@ -0,0 +1,177 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "bench_runner.h"
+#include "pteros/core/logging.h"
+#include "pteros/core/pteros_error.h"
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+using namespace std;
+using namespace pteros;
+
+double Bench_result::min() const
+{
+    return *std::min_element(times.begin(),times.end());
+}
+
+double Bench_result::median() const
+{
+    vector<double> t = times;
+    std::sort(t.begin(),t.end());
+    int n = t.size();
+    return (n%2) ? t[n/2] : 0.5*(t[n/2-1]+t[n/2]);
+}
+
+double Bench_result::mean() const
+{
+    return std::accumulate(times.begin(),times.end(),0.0)/times.size();
+}
+
+Bench_runner::Bench_runner(double min_time, int repetitions, const string &filter):
+    min_time(min_time), repetitions(std::max(1,repetitions)), use_filter(!filter.empty())
+{
+    if(use_filter) this->filter = std::regex(filter);
+}
+
+bool Bench_runner::enabled(const string &name) const
+{
+    return !use_filter || std::regex_search(name,filter);
+}
+
+namespace {
+
+// Time of n calls of body in seconds
+double time_calls(const std::function<void()>& body, int n){
+    auto t0 = chrono::steady_clock::now();
+    for(int i=0;i<n;++i) body();
+    auto t1 = chrono::steady_clock::now();
+    return chrono::duration<double>(t1-t0).count();
+}
+
+}
+
+void Bench_runner::run(const string &name, const std::function<void()> &body, double items)
+{
+    if(!enabled(name)) return;
+
+    // Warm-up and calibration of the number of iterations
+    int n = 1;
+    double t = time_calls(body,n);
+    while(t<min_time && n<1000000000){
+        // Aim slightly above min_time, but grow at most 10x per step
+        double factor = (t>0) ? std::min(10.0,1.2*min_time/t) : 10.0;
+        n = std::max(n+1,int(n*factor));
+        t = time_calls(body,n);
+    }
+
+    Bench_result res;
+    res.name = name;
+    res.iterations = n;
+    res.items = items;
+    for(int r=0;r<repetitions;++r){
+        res.times.push_back(time_calls(body,n)/n);
+    }
+
+    if(items>0){
+        LOG()->info("{:<40} {:>12.3f} us {:>12.3f} us {:>10} iter {:>12.4g} items/s",
+                    name, res.min()*1e6, res.median()*1e6, n, items/res.median());
+    } else {
+        LOG()->info("{:<40} {:>12.3f} us {:>12.3f} us {:>10} iter",
+                    name, res.min()*1e6, res.median()*1e6, n);
+    }
+
+    results.push_back(res);
+}
+
+void Bench_runner::add_result(const Bench_result &res)
+{
+    if(res.times.empty()) throw Pteros_error("Benchmark result '{}' has no timings!",res.name);
+    results.push_back(res);
+}
+
+void Bench_runner::add_context(const string &key, const string &val)
+{
+    context[key] = val;
+}
+
+namespace {
+
+string json_escape(const string& s){
+    string res;
+    for(char c: s){
+        switch(c){
+        case '"': res += "\\\""; break;
+        case '\\': res += "\\\\"; break;
+        case '\n': res += "\\n"; break;
+        case '\t': res += "\\t"; break;
+        default: res += c;
+        }
+    }
+    return res;
+}
+
+}
+
+void Bench_runner::write_json(ostream &out) const
+{
+    out << "{\n  \"context\": {";
+    bool first = true;
+    for(const auto& it: context){
+        out << (first ? "\n" : ",\n");
+        out << "    \"" << json_escape(it.first) << "\": \"" << json_escape(it.second) << "\"";
+        first = false;
+    }
+    out << "\n  },\n  \"benchmarks\": [";
+
+    first = true;
+    out.precision(9);
+    for(const auto& r: results){
+        out << (first ? "\n" : ",\n");
+        out << "    {\n"
+            << "      \"name\": \"" << json_escape(r.name) << "\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"repetitions\": " << r.times.size() << ",\n"
+            << "      \"min_time\": " << r.min() << ",\n"
+            << "      \"median_time\": " << r.median() << ",\n"
+            << "      \"mean_time\": " << r.mean() << ",\n"
+            << "      \"time_unit\": \"s\"";
+        if(r.items>0){
+            out << ",\n      \"items\": " << r.items
+                << ",\n      \"items_per_second\": " << r.items/r.median();
+        }
+        for(const auto& c: r.counters){
+            out << ",\n      \"" << json_escape(c.first) << "\": " << c.second;
+        }
+        out << "\n    }";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+#include <functional>
+#include <ostream>
+
+namespace pteros {
+
+/// Prevents the compiler from optimizing away the computation of val
+template<class T>
+inline void do_not_optimize(const T& val){
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&val) : "memory");
+#else
+    volatile const void* p = &val; (void)p;
+#endif
+}
+
+/// Timings of single benchmark
+struct Bench_result {
+    std::string name;
+    /// Number of calls in each repetition
+    int iterations = 1;
+    /// Times per call in seconds for each repetition
+    std::vector<double> times;
+    /// Number of processed items (atoms, pairs, frames...) per call. Zero if not applicable.
+    double items = 0;
+    /// Additional named values, which are written to JSON as is
+    std::map<std::string,double> counters;
+
+    double min() const;
+    double median() const;
+    double mean() const;
+};
+
+/**
+ Minimal micro-benchmark runner.
+ Each benchmark is a callable, which is called repeatedly. The number of calls
+ in each repetition is calibrated to run for at least min_time seconds.
+ The best, median and mean times per call over all repetitions are reported.
+ Results could be written as JSON for comparison between builds.
+*/
+class Bench_runner {
+public:
+    Bench_runner(double min_time = 0.2, int repetitions = 5, const std::string& filter = "");
+
+    /// Returns true if benchmark with this name would be run
+    bool enabled(const std::string& name) const;
+
+    /// Runs benchmark body. Items is a number of items processed by each call of body.
+    void run(const std::string& name, const std::function<void()>& body, double items = 0);
+
+    /// Adds result measured outside of run(), for example by single timed run of long benchmark
+    void add_result(const Bench_result& res);
+
+    /// Adds key-value pair to the context section of JSON output
+    void add_context(const std::string& key, const std::string& val);
+
+    /// Writes results as JSON
+    void write_json(std::ostream& out) const;
+
+    const std::vector<Bench_result>& get_results() const {return results;}
+
+private:
+    double min_time;
+    int repetitions;
+    std::regex filter;
+    bool use_filter;
+    std::vector<Bench_result> results;
+    std::map<std::string,std::string> context;
+};
+
+} // namespace
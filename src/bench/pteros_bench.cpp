@@ -0,0 +1,351 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/pteros.h"
+#include "pteros/core/mol_file.h"
+#include "pteros/core/distance_search.h"
+#include "pteros/core/hbonds.h"
+#include "pteros/core/version.h"
+#include "pteros/analysis/options.h"
+#include "pteros/analysis/msd.h"
+#include "pteros/analysis/correlation.h"
+#include "pteros/analysis/residence.h"
+#include "bench_runner.h"
+#include "synthetic_system.h"
+#include <fstream>
+#include <thread>
+#include <cstdio>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+string help(){
+    return
+R"(Usage: pteros_bench [options]
+Micro-benchmarks of core Pteros kernels on synthetic systems.
+-size <int>, default: 30000 - approximate number of atoms in each test system.
+-min_time <float>, default: 0.2 - minimal time of each repetition in seconds.
+-repeat <int>, default: 5 - number of repetitions.
+-filter <regex>, optional - run only benchmarks with matching names.
+-frames <int>, default: 20 - number of frames in trajectory IO benchmarks.
+-tmp <dir>, default: /tmp - directory for temporary trajectory files.
+-json <file>, optional - write results in JSON format to this file.
+-help - print this help.
+
+Benchmark names have the form kernel/system[/variant].
+Compare JSON files from different builds to detect regressions.
+)";
+}
+
+namespace {
+
+struct Test_system {
+    string name;
+    System sys;
+};
+
+void bench_search(Bench_runner& runner, Test_system& t)
+{
+    auto all = t.sys.select_all();
+    vector<Vector2i> pairs;
+
+    runner.run("search_contacts/"+t.name+"/pbc", [&]{
+        pairs.clear();
+        search_contacts(0.5,all,pairs,false,true);
+        do_not_optimize(pairs);
+    }, all.size());
+
+    runner.run("search_contacts/"+t.name+"/nopbc", [&]{
+        pairs.clear();
+        search_contacts(0.5,all,pairs,false,false);
+        do_not_optimize(pairs);
+    }, all.size());
+
+    // Central tenth of the system as a target
+    auto target = t.sys.select(0,all.size()/10);
+    vector<int> res;
+    runner.run("search_within/"+t.name+"/pbc", [&]{
+        res.clear();
+        search_within(0.5,all,target,res,true,true);
+        do_not_optimize(res);
+    }, all.size());
+
+    // Atoms are classified once, only the search is timed.
+    // Synthetic protein has no hydrogens, so there is nothing to search.
+    Hbond_search hb(all);
+    if(hb.num_donors()==0) return;
+    vector<Hbond> hbonds;
+    runner.run("hbonds/"+t.name, [&]{
+        hb.search(hbonds);
+        do_not_optimize(hbonds);
+    }, all.size());
+}
+
+void bench_selections(Bench_runner& runner, Test_system& t)
+{
+    const vector<pair<string,string>> texts = {
+        {"keyword", "name CA OW P N"},
+        {"logic", "(resid 1 to 100 or resname SOL) and not name HW1"},
+        {"coord", "x<3 and y>1 or z<2"},
+        {"within", "within 0.5 pbc of resid 1 to 10"}
+    };
+
+    for(const auto& txt: texts){
+        runner.run("select_parse/"+t.name+"/"+txt.first, [&]{
+            Selection sel(t.sys,txt.second);
+            do_not_optimize(sel);
+        }, t.sys.num_atoms());
+
+        Selection sel(t.sys,txt.second);
+        if(sel.coord_dependent()){
+            runner.run("select_apply/"+t.name+"/"+txt.first, [&]{
+                sel.apply();
+                do_not_optimize(sel);
+            }, t.sys.num_atoms());
+        }
+    }
+}
+
+void bench_geometry(Bench_runner& runner, Test_system& t)
+{
+    auto all = t.sys.select_all();
+
+    runner.run("center/"+t.name+"/nopbc", [&]{
+        auto c = all.center(true);
+        do_not_optimize(c);
+    }, all.size());
+
+    runner.run("center/"+t.name+"/pbc", [&]{
+        auto c = all.center(true,fullPBC,0);
+        do_not_optimize(c);
+    }, all.size());
+
+    // Wrap and unwrap modify coordinates, so work on a copy
+    System tmp = t.sys;
+    auto tmp_all = tmp.select_all();
+    runner.run("wrap/"+t.name, [&]{
+        tmp_all.wrap();
+    }, all.size());
+
+    runner.run("unwrap/"+t.name, [&]{
+        tmp_all.unwrap(fullPBC,0);
+    }, all.size());
+
+    // Bond-based unwrapping with bonds found on each call and with precomputed plan
+    runner.run("unwrap_bonds/"+t.name, [&]{
+        tmp_all.unwrap_bonds(0.11,fullPBC,0);
+    }, all.size());
+
+    Unwrap_plan plan(tmp_all,0.11,0);
+    runner.run("unwrap_plan/"+t.name, [&]{
+        plan.apply(tmp_all);
+    }, all.size());
+
+    if(t.sys.num_frames()>1){
+        Selection sel1(t.sys,"all",0);
+        Selection sel2(t.sys,"all",1);
+        runner.run("fit_transform/"+t.name, [&]{
+            auto tr = fit_transform(sel1,sel2);
+            do_not_optimize(tr);
+        }, all.size());
+
+        runner.run("rmsd/"+t.name, [&]{
+            float r = all.rmsd(0,1);
+            do_not_optimize(r);
+        }, all.size());
+    }
+}
+
+void bench_sasa(Bench_runner& runner, Test_system& t)
+{
+    auto all = t.sys.select_all();
+    runner.run("sasa/"+t.name, [&]{
+        float a = all.sasa();
+        do_not_optimize(a);
+    }, all.size());
+}
+
+void bench_energy(Bench_runner& runner, Test_system& t)
+{
+    make_synthetic_force_field(t.sys,1.0);
+    auto all = t.sys.select_all();
+    runner.run("non_bond_energy/"+t.name, [&]{
+        auto e = all.non_bond_energy(1.0,true);
+        do_not_optimize(e);
+    }, all.size());
+}
+
+void bench_xtc(Bench_runner& runner, Test_system& t, int n_frames, const string& tmp_dir)
+{
+    string fname = tmp_dir+"/pteros_bench_"+t.name+".xtc";
+    add_synthetic_frames(t.sys,n_frames-t.sys.num_frames());
+    auto all = t.sys.select_all();
+
+    runner.run("xtc_write/"+t.name, [&]{
+        all.write(fname,0,n_frames-1);
+    }, n_frames);
+
+    // Make sure file exists even if writing is filtered out
+    if(!runner.enabled("xtc_write/"+t.name)) all.write(fname,0,n_frames-1);
+
+    runner.run("xtc_read/"+t.name, [&]{
+        auto f = Mol_file::open(fname,'r');
+        Frame fr;
+        while(f->read(nullptr,&fr,Mol_file_content().traj(true))){
+            do_not_optimize(fr);
+        }
+    }, n_frames);
+
+    std::remove(fname.c_str());
+}
+
+void bench_msd(Bench_runner& runner, int n_points, int n_frames)
+{
+    // Random walk of points
+    Vector_series pos(n_points);
+    Matrix3Xf cur = Matrix3Xf::Zero(3,n_points);
+    for(int fr=0; fr<n_frames; ++fr){
+        cur += 0.1*Matrix3Xf::Random(3,n_points);
+        pos.add_frame(cur);
+    }
+
+    runner.run(fmt::format("msd_fft/{}x{}",n_points,n_frames), [&]{
+        auto m = msd_fft(pos);
+        do_not_optimize(m);
+    }, n_points);
+}
+
+void bench_correlation(Bench_runner& runner, int n_series, int n_frames)
+{
+    for(auto storage: {Time_correlation::Float, Time_correlation::Half}){
+        string name = fmt::format("time_correlation/{}x{}/{}",n_series,n_frames,
+                                  storage==Time_correlation::Float ? "float" : "half");
+        Time_correlation corr(n_series,3,storage);
+        for(int fr=0; fr<n_frames; ++fr) corr.add_frame(fr,VectorXf::Random(3*n_series));
+
+        runner.run(name, [&]{
+            auto c = corr.autocorrelation(-1,true,true);
+            do_not_optimize(c);
+        }, n_series);
+    }
+}
+
+void bench_residence(Bench_runner& runner, int n_mol, int n_frames)
+{
+    // Random entering and leaving of molecules
+    Residence_tracker tr(n_mol);
+    VectorXf state = VectorXf::Zero(n_mol);
+    vector<int> inside;
+    for(int fr=0; fr<n_frames; ++fr){
+        VectorXf r = VectorXf::Random(n_mol);
+        inside.clear();
+        for(int i=0;i<n_mol;++i){
+            if(r(i)>0.9) state(i) = 1-state(i);
+            if(state(i)>0) inside.push_back(i);
+        }
+        tr.add_frame(fr,inside);
+    }
+
+    runner.run(fmt::format("residence_survival/{}x{}",n_mol,n_frames), [&]{
+        auto s = tr.survival_probability(200,2);
+        do_not_optimize(s);
+    }, n_mol);
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[]){
+    try{
+        greeting("pteros_bench");
+
+        Options opt;
+        parse_command_line(argc,argv,opt);
+
+        if(opt.has("help")){
+            cout << help();
+            return 0;
+        }
+
+        int size = opt("size","30000").as_int();
+        int n_frames = opt("frames","20").as_int();
+        string tmp_dir = opt("tmp","/tmp").as_string();
+        string json_file = opt("json","").as_string();
+
+        Bench_runner runner(opt("min_time","0.2").as_float(),
+                            opt("repeat","5").as_int(),
+                            opt("filter","").as_string());
+
+        runner.add_context("version",_version_tag);
+        runner.add_context("git_revision",_git_revision);
+        runner.add_context("build_time",_build_time);
+        runner.add_context("size",to_string(size));
+        runner.add_context("frames",to_string(n_frames));
+        runner.add_context("hardware_threads",to_string(std::thread::hardware_concurrency()));
+
+        // Test systems
+        LOG()->info("Generating synthetic systems of ~{} atoms...",size);
+        Test_system water {"water", make_water_box(size/3)};
+        Test_system water_tric {"water_tric", make_water_box(size/3,true)};
+        Test_system membrane {"membrane", make_membrane(std::max(2,size/50))};
+        Test_system protein {"protein", make_protein(std::max(1,size/5))};
+        add_synthetic_frames(protein.sys,1,0.05);
+
+        LOG()->info("{:<40} {:>15} {:>15} {:>15}","Benchmark","Best","Median","Iterations");
+
+        for(auto t: {&water,&water_tric,&membrane,&protein}){
+            bench_search(runner,*t);
+            bench_selections(runner,*t);
+            bench_geometry(runner,*t);
+        }
+
+        bench_sasa(runner,protein);
+
+        bench_energy(runner,water);
+        bench_energy(runner,membrane);
+
+        bench_xtc(runner,water,n_frames,tmp_dir);
+
+        bench_msd(runner,size/30,2000);
+        bench_correlation(runner,size/300,10000);
+        bench_residence(runner,size/3,2000);
+
+        if(!json_file.empty()){
+            ofstream out(json_file);
+            if(!out) throw Pteros_error("Can't open '{}' for writing!",json_file);
+            runner.write_json(out);
+            LOG()->info("Results written to '{}'",json_file);
+        }
+
+    } catch(const Pteros_error& e) {
+        LOG()->error(e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "synthetic_system.h"
+#include "pteros/core/selection.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/mol_file.h"
+#include <random>
+#include <cmath>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Number of water molecules per nm^3 at normal conditions
+const float water_density = 33.4;
+
+// Atom types used in synthetic systems
+enum {type_O=0, type_H, type_C, type_N, type_P, num_types};
+
+Atom make_atom(const string& name, const string& resname, int resid, char chain, int type){
+    Atom at;
+    at.name = name;
+    at.resname = resname;
+    at.resid = resid;
+    at.chain = chain;
+    at.type = type;
+    switch(type){
+    case type_O: at.mass = 15.999; at.atomic_number = 8; at.type_name = "O"; break;
+    case type_H: at.mass = 1.008; at.atomic_number = 1; at.type_name = "H"; break;
+    case type_C: at.mass = 12.011; at.atomic_number = 6; at.type_name = "C"; break;
+    case type_N: at.mass = 14.007; at.atomic_number = 7; at.type_name = "N"; break;
+    case type_P: at.mass = 30.974; at.atomic_number = 15; at.type_name = "P"; break;
+    }
+    return at;
+}
+
+// Adds water molecule with oxygen at o and random orientation
+void add_water(vector<Atom>& atoms, vector<Vector3f>& coord, Vector3f_const_ref o, int resid, std::mt19937& gen){
+    std::normal_distribution<float> norm(0.0,1.0);
+    Vector3f u(norm(gen),norm(gen),norm(gen));
+    Vector3f v(norm(gen),norm(gen),norm(gen));
+    u.normalize();
+    v = (v - v.dot(u)*u).normalized();
+    // O-H 0.1 nm, H-O-H ~109 deg
+    Vector3f h1 = o + 0.1*(0.577*u + 0.816*v);
+    Vector3f h2 = o + 0.1*(0.577*u - 0.816*v);
+
+    atoms.push_back(make_atom("OW","SOL",resid,'W',type_O));
+    atoms.back().charge = -0.82;
+    atoms.push_back(make_atom("HW1","SOL",resid,'W',type_H));
+    atoms.back().charge = 0.41;
+    atoms.push_back(make_atom("HW2","SOL",resid,'W',type_H));
+    atoms.back().charge = 0.41;
+    coord.push_back(o);
+    coord.push_back(h1);
+    coord.push_back(h2);
+}
+
+// Fills a region given by the box matrix and origin with n waters on a jittered lattice
+void fill_water(vector<Atom>& atoms, vector<Vector3f>& coord, int n_waters,
+                Matrix3f_const_ref region, Vector3f_const_ref origin, int first_resid, std::mt19937& gen){
+    if(n_waters<=0) return;
+    // Lattice dimensions proportional to region extents
+    Vector3f ext = region.colwise().norm();
+    float a = std::cbrt(ext.prod()/n_waters);
+    Vector3i n;
+    for(int i=0;i<3;++i) n(i) = std::max(1,int(ceil(ext(i)/a)));
+    while(n.prod()<n_waters) n(n.prod()%3)++;
+
+    std::uniform_real_distribution<float> jitter(-0.15,0.15);
+    int added = 0;
+    for(int i=0;i<n(0) && added<n_waters;++i)
+        for(int j=0;j<n(1) && added<n_waters;++j)
+            for(int k=0;k<n(2) && added<n_waters;++k){
+                Vector3f f((i+0.5+jitter(gen))/n(0),(j+0.5+jitter(gen))/n(1),(k+0.5+jitter(gen))/n(2));
+                add_water(atoms,coord,origin+region*f,first_resid+added,gen);
+                ++added;
+            }
+}
+
+System make_system(const vector<Atom>& atoms, const vector<Vector3f>& coord, Matrix3f_const_ref box){
+    System sys;
+    sys.atoms_add(atoms,coord);
+    sys.box(0).set_matrix(box);
+    sys.assign_resindex();
+    return sys;
+}
+
+} // namespace
+
+
+System pteros::make_water_box(int n_waters, bool triclinic, unsigned seed)
+{
+    if(n_waters<=0) throw Pteros_error("Number of waters should be positive!");
+    std::mt19937 gen(seed);
+
+    Matrix3f shape;
+    if(triclinic){
+        // Skewed prism with angles similar to rhombic dodecahedron
+        shape << 1.0, 0.0, 0.5,
+                 0.0, 1.0, 0.5,
+                 0.0, 0.0, 0.7071;
+    } else {
+        shape.setIdentity();
+    }
+    // Scale to get normal density
+    float vol = n_waters/water_density;
+    Matrix3f box = shape*std::cbrt(vol/shape.determinant());
+
+    vector<Atom> atoms;
+    vector<Vector3f> coord;
+    atoms.reserve(3*n_waters);
+    coord.reserve(3*n_waters);
+    fill_water(atoms,coord,n_waters,box,Vector3f::Zero(),1,gen);
+
+    return make_system(atoms,coord,box);
+}
+
+
+System pteros::make_membrane(int n_lipids, int waters_per_lipid, unsigned seed)
+{
+    if(n_lipids<2) throw Pteros_error("Need at least two lipids!");
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> jitter(-0.03,0.03);
+
+    // Lipids per leaflet on square lattice, area per lipid 0.65 nm^2
+    int n_side = ceil(sqrt(n_lipids/2.0));
+    float a = sqrt(0.65);
+    float Lxy = n_side*a;
+    // Half thickness of the bilayer
+    const float half = 2.3;
+
+    int n_waters = n_lipids*waters_per_lipid;
+    float water_thickness = n_waters/(water_density*Lxy*Lxy);
+    float Lz = 2*half + water_thickness;
+
+    vector<Atom> atoms;
+    vector<Vector3f> coord;
+    atoms.reserve(20*n_lipids + 3*n_waters);
+    coord.reserve(20*n_lipids + 3*n_waters);
+
+    // Bilayer is in the middle of the box
+    float zc = 0.5*Lz;
+    for(int l=0; l<n_lipids; ++l){
+        int leaflet = (l<(n_lipids+1)/2) ? 1 : -1;
+        int ind = (leaflet>0) ? l : l-(n_lipids+1)/2;
+        float x = (ind%n_side+0.5)*a;
+        float y = (ind/n_side+0.5)*a;
+        int resid = l+1;
+        // Head group
+        auto add = [&](const string& name, int type, float charge, float dx, float dy, float depth){
+            atoms.push_back(make_atom(name,"LIP",resid,'M',type));
+            atoms.back().charge = charge;
+            coord.emplace_back(x+dx+jitter(gen), y+dy+jitter(gen), zc+leaflet*(half-depth)+jitter(gen));
+        };
+        add("N",type_N,1.0, 0.0,0.0,0.0);
+        add("P",type_P,1.2, 0.0,0.0,0.35);
+        add("O11",type_O,-1.1, 0.1,0.0,0.45);
+        add("O12",type_O,-1.1,-0.1,0.0,0.45);
+        // Two tails
+        for(int c=0;c<8;++c){
+            add(fmt::format("C2{}",c+1),type_C,0.0,-0.2,0.0,0.6+c*0.2);
+            add(fmt::format("C3{}",c+1),type_C,0.0, 0.2,0.0,0.6+c*0.2);
+        }
+    }
+
+    // Water slab is continuous across periodic boundary in Z
+    Matrix3f region = Vector3f(Lxy,Lxy,water_thickness).asDiagonal();
+    fill_water(atoms,coord,n_waters,region,Vector3f(0,0,zc+half),n_lipids+1,gen);
+
+    Matrix3f box = Vector3f(Lxy,Lxy,Lz).asDiagonal();
+    return make_system(atoms,coord,box);
+}
+
+
+System pteros::make_protein(int n_residues, unsigned seed)
+{
+    if(n_residues<=0) throw Pteros_error("Number of residues should be positive!");
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> norm(0.0,1.0);
+
+    // Radius of the globule, which confines the chain
+    float R = std::cbrt(n_residues*0.13f*3.0f/(4.0f*M_PI)) + 0.5;
+    const vector<string> resnames = {"ALA","LEU","LYS","GLU","SER"};
+
+    vector<Atom> atoms;
+    vector<Vector3f> coord;
+    atoms.reserve(5*n_residues);
+    coord.reserve(5*n_residues);
+
+    Vector3f ca = Vector3f::Zero();
+    Vector3f dir = Vector3f::UnitX();
+    for(int r=0; r<n_residues; ++r){
+        if(r>0){
+            // Next CA at 0.38 nm in direction not far from previous one staying in the globule
+            Vector3f next;
+            for(int attempt=0; ; ++attempt){
+                Vector3f d = dir + Vector3f(norm(gen),norm(gen),norm(gen));
+                next = ca + 0.38*d.normalized();
+                if(next.norm()<R || attempt>100) { dir = d.normalized(); break; }
+            }
+            ca = next;
+        }
+        // Side vector perpendicular to the chain
+        Vector3f side = dir.cross(Vector3f(norm(gen),norm(gen),norm(gen))).normalized();
+
+        const string& resname = resnames[r%resnames.size()];
+        int resid = r+1;
+        auto add = [&](const string& name, int type, float charge, Vector3f_const_ref x){
+            atoms.push_back(make_atom(name,resname,resid,'A',type));
+            atoms.back().charge = charge;
+            coord.push_back(x);
+        };
+        add("N", type_N,-0.3, ca-0.14*dir+0.05*side);
+        add("CA",type_C, 0.1, ca);
+        add("C", type_C, 0.5, ca+0.15*dir+0.05*side);
+        add("O", type_O,-0.5, ca+0.2*dir+0.15*side);
+        add("CB",type_C, 0.2, ca-0.15*side);
+    }
+
+    // Put into the box with 1 nm margin
+    Vector3f lo(Vector3f::Constant(1e10)), hi(Vector3f::Constant(-1e10));
+    for(const auto& x: coord){
+        lo = lo.cwiseMin(x);
+        hi = hi.cwiseMax(x);
+    }
+    for(auto& x: coord) x += Vector3f::Constant(1.0)-lo;
+    Matrix3f box = (hi-lo+Vector3f::Constant(2.0)).asDiagonal();
+
+    return make_system(atoms,coord,box);
+}
+
+
+void pteros::make_synthetic_force_field(System &sys, float cutoff)
+{
+    Force_field& ff = sys.get_force_field();
+    ff.clear();
+
+    int N = sys.num_atoms();
+    ff.natoms = N;
+
+    // Exclusions inside residues
+    ff.exclusions.resize(N);
+    int b = 0;
+    for(int i=1;i<=N;++i){
+        if(i==N || sys.atom(i).resindex!=sys.atom(b).resindex){
+            for(int j=b;j<i;++j)
+                for(int k=b;k<i;++k)
+                    if(j!=k) ff.exclusions[j].insert(k);
+            b = i;
+        }
+    }
+
+    // LJ parameters from sigma and epsilon by Lorentz-Berthelot rules
+    const float sigma[num_types] = {0.315, 0.1, 0.35, 0.325, 0.374};
+    const float eps[num_types] = {0.636, 0.0, 0.276, 0.711, 0.836};
+    ff.LJ_C6.resize(num_types,num_types);
+    ff.LJ_C12.resize(num_types,num_types);
+    for(int i=0;i<num_types;++i){
+        for(int j=0;j<num_types;++j){
+            float s = 0.5*(sigma[i]+sigma[j]);
+            float e = sqrt(eps[i]*eps[j]);
+            ff.LJ_C6(i,j) = 4.0*e*pow(s,6);
+            ff.LJ_C12(i,j) = 4.0*e*pow(s,12);
+        }
+    }
+
+    ff.fudgeQQ = 0.5;
+    ff.rcoulomb = cutoff;
+    ff.rvdw = cutoff;
+    ff.rcoulomb_switch = 0;
+    ff.rvdw_switch = 0;
+    ff.epsilon_r = 1.0;
+    ff.epsilon_rf = 0.0;
+    ff.coulomb_type = "reaction-field";
+    ff.coulomb_modifier = "";
+    ff.vdw_type = "cut-off";
+    ff.vdw_modifier = "";
+    ff.setup_kernels();
+    ff.ready = true;
+}
+
+
+void pteros::add_synthetic_frames(System &sys, int n_frames, float step, unsigned seed)
+{
+    if(sys.num_frames()==0) throw Pteros_error("System has no frames!");
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> norm(0.0,step);
+
+    Frame fr = sys.frame(sys.num_frames()-1);
+    for(int f=0; f<n_frames; ++f){
+        for(auto& x: fr.coord) x += Vector3f(norm(gen),norm(gen),norm(gen));
+        fr.time += 1.0;
+        sys.frame_append(fr);
+    }
+}
+
+
+void pteros::write_synthetic_trajectory(const System &sys, const string &fname, int n_frames, float step, unsigned seed)
+{
+    if(sys.num_frames()==0) throw Pteros_error("System has no frames!");
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> norm(0.0,step);
+
+    // Work on a single-frame copy
+    System tmp;
+    tmp.atoms_add(vector<Atom>(sys.num_atoms()),sys.frame(sys.num_frames()-1).coord);
+    tmp.frame(0).box = sys.box(sys.num_frames()-1);
+    auto all = tmp.select_all();
+
+    auto f = Mol_file::open(fname,'w');
+    for(int fr=0; fr<n_frames; ++fr){
+        for(auto& x: tmp.frame(0).coord) x += Vector3f(norm(gen),norm(gen),norm(gen));
+        tmp.frame(0).time = fr;
+        f->write(all,Mol_file_content().traj(true));
+    }
+}
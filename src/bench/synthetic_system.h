@@ -0,0 +1,67 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#pragma once
+
+#include "pteros/core/system.h"
+
+namespace pteros {
+
+/**
+ Generators of synthetic systems for benchmarks.
+ Systems are deterministic for given size and seed, have a periodic box,
+ resindexes assigned and one frame.
+*/
+
+/// Box of 3-site water molecules at normal density on a jittered lattice.
+/// If triclinic is true the box is a skewed prism of the same volume.
+System make_water_box(int n_waters, bool triclinic = false, unsigned seed = 1);
+
+/// Flat lipid bilayer in XY plane with 20 atoms per lipid,
+/// sandwiched between two water slabs.
+System make_membrane(int n_lipids, int waters_per_lipid = 10, unsigned seed = 1);
+
+/// Compact random chain of residues with 5 atoms each (N,CA,C,O,CB)
+/// in a box with 1 nm margin.
+System make_protein(int n_residues, unsigned seed = 1);
+
+/// Sets up simple force field for synthetic system.
+/// Atoms of the same residue are excluded, coulomb is reaction-field, LJ is cut-off.
+void make_synthetic_force_field(System& sys, float cutoff = 1.0);
+
+/// Appends n_frames frames obtained by random walk of all atoms from the last frame.
+void add_synthetic_frames(System& sys, int n_frames, float step = 0.01, unsigned seed = 1);
+
+/// Writes trajectory of n_frames frames obtained by random walk of all atoms
+/// from the last frame of sys. Frames are generated and written one by one,
+/// so trajectory of any size could be written. Format is deduced from extension.
+void write_synthetic_trajectory(const System& sys, const std::string& fname, int n_frames,
+                                float step = 0.01, unsigned seed = 1);
+
+} // namespace
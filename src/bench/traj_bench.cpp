@@ -0,0 +1,293 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/pteros.h"
+#include "pteros/core/distance_search.h"
+#include "pteros/core/version.h"
+#include "pteros/core/profiling.h"
+#include "pteros/analysis/trajectory_reader.h"
+#include "pteros/analysis/task_plugin.h"
+#include "bench_runner.h"
+#include "synthetic_system.h"
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+string help(){
+    return
+R"(Usage: pteros_traj_bench [options]
+Throughput benchmark of trajectory processing pipeline on synthetic trajectories.
+-size <int>, default: 100000 - number of atoms (water box).
+-frames <int>, default: 100 - number of frames in trajectory.
+-format <xtc|trr|dcd ...>, default: xtc trr dcd - trajectory formats to test.
+-buffer <int ...>, default: 10 - frame buffer sizes to test.
+-threads <int ...>, optional - numbers of threads to test, passed to the reader as -nt.
+    Can't exceed the default number of threads. If not given the default is used.
+-serial <int>, default: 1 - number of serial tasks.
+-parallel - run single parallel task instead of serial tasks.
+-work <none|center|contacts>, default: center - work done by tasks on each frame.
+    center: center of mass of all atoms;
+    contacts: contacts within 0.3 nm in the first 10% of atoms.
+-spin <float>, default: 0 - additional busy work per frame in each task, microseconds.
+-tmp <dir>, default: /tmp - directory for synthetic trajectories.
+-keep - do not delete synthetic trajectories at the end.
+-profile - print per-stage timings of each run.
+    Requires Pteros compiled with WITH_PROFILING option.
+-json <file>, optional - write results in JSON format to this file.
+-help - print this help.
+
+For each run the report shows processing rate, time spent by the reader thread
+in reading frames and waiting for free space in the buffer (backpressure),
+time spent by the consumers waiting for frames and the buffer occupancy.
+)";
+}
+
+namespace {
+
+// Work done by benchmark tasks on each frame
+void do_work(const string& work, float spin, Selection& all, Selection& sub){
+    if(work=="center"){
+        auto c = all.center(true);
+        do_not_optimize(c);
+    } else if(work=="contacts"){
+        vector<Vector2i> pairs;
+        search_contacts(0.3,sub,pairs,false,true);
+        do_not_optimize(pairs);
+    } else if(work!="none"){
+        throw Pteros_error("Unknown work type '{}'!",work);
+    }
+
+    if(spin>0){
+        auto t0 = chrono::steady_clock::now();
+        while(chrono::duration<double,micro>(chrono::steady_clock::now()-t0).count()<spin);
+    }
+}
+
+TASK_SERIAL(Throughput_serial)
+protected:
+    void pre_process() override {
+        work = options("work","center").as_string();
+        spin = options("spin","0").as_float();
+        all = system.select_all();
+        sub = system.select(0,system.num_atoms()/10);
+    }
+
+    void process_frame(const Frame_info& info) override {
+        do_work(work,spin,all,sub);
+    }
+
+    void post_process(const Frame_info& info) override {}
+
+    string work;
+    float spin;
+    Selection all, sub;
+};
+
+TASK_PARALLEL(Throughput_parallel)
+protected:
+    void pre_process() override {
+        work = options("work","center").as_string();
+        spin = options("spin","0").as_float();
+        all = system.select_all();
+        sub = system.select(0,system.num_atoms()/10);
+    }
+
+    void process_frame(const Frame_info& info) override {
+        do_work(work,spin,all,sub);
+    }
+
+    void post_process(const Frame_info& info) override {}
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {}
+
+    string work;
+    float spin;
+    Selection all, sub;
+};
+
+// Runs trajectory reader on given files with given buffer size and number of threads
+Trajectory_reader_stats run_pipeline(Options& opt, const string& structure, const string& traj,
+                                     int buffer, int threads, int n_serial, bool parallel, bool profile)
+{
+    // Trajectory reader only accepts options from command line
+    vector<string> args = {"pteros_traj_bench","-f",structure,traj,"-buffer",to_string(buffer),
+                           "-nt",to_string(threads)};
+    if(profile) args.push_back("-profile");
+    vector<char*> argv;
+    for(auto& a: args) argv.push_back(&a[0]);
+    Options reader_opt;
+    parse_command_line(argv.size(),argv.data(),reader_opt);
+
+    Trajectory_reader engine(reader_opt);
+    if(parallel){
+        engine.add_task(new Throughput_parallel(opt));
+    } else {
+        for(int i=0;i<n_serial;++i) engine.add_task(new Throughput_serial(opt));
+    }
+    engine.run();
+    return engine.get_stats();
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[]){
+    try{
+        greeting("pteros_traj_bench");
+
+        Options opt;
+        parse_command_line(argc,argv,opt);
+
+        if(opt.has("help")){
+            cout << help();
+            return 0;
+        }
+
+        int size = opt("size","100000").as_int();
+        int n_frames = opt("frames","100").as_int();
+        auto formats = opt.has("format") ? opt("format").as_strings() : vector<string>{"xtc","trr","dcd"};
+        auto buffers = opt.has("buffer") ? opt("buffer").as_ints() : vector<int>{10};
+        auto threads = opt.has("threads") ? opt("threads").as_ints() : vector<int>{get_num_threads()};
+        int n_serial = opt("serial","1").as_int();
+        bool parallel = opt.has("parallel");
+        string work = opt("work","center").as_string();
+        float spin = opt("spin","0").as_float();
+        string tmp_dir = opt("tmp","/tmp").as_string();
+        bool keep = opt.has("keep");
+        string json_file = opt("json","").as_string();
+        bool profile = opt.has("profile");
+
+        if(n_serial<1 && !parallel) throw Pteros_error("At least one task is required!");
+
+        LOG()->info("Generating synthetic system of {} atoms...",size);
+        System sys = make_water_box(std::max(1,size/3));
+        string structure = tmp_dir+"/pteros_traj_bench.gro";
+        sys().write(structure);
+
+
+        struct Run {
+            string format;
+            int buffer;
+            int threads;
+            double write_time;
+            Trajectory_reader_stats st;
+        };
+        vector<Run> runs;
+
+        for(auto& fmt: formats){
+            string traj = tmp_dir+"/pteros_traj_bench."+fmt;
+            LOG()->info("Writing {} frames to '{}'...",n_frames,traj);
+            auto t0 = chrono::steady_clock::now();
+            write_synthetic_trajectory(sys,traj,n_frames);
+            double write_time = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+
+            for(int nt: threads){
+                // Report the number of threads actually used
+                nt = std::min(std::max(1,nt),get_num_threads());
+                for(int buf: buffers){
+                    LOG()->info("Processing {} with buffer {} in {} threads...",fmt,buf,nt);
+                    // Reader and tasks log a lot on each run
+                    set_log_level("warn");
+                    auto st = run_pipeline(opt,structure,traj,buf,nt,n_serial,parallel,profile);
+                    runs.push_back({fmt,buf,nt,write_time,st});
+                    set_log_level("info");
+                    if(profile && Profiler::is_compiled())
+                        LOG()->info("Profile of {} with buffer {} in {} threads:\n{}",fmt,buf,nt,
+                                    Profiler::instance().report(st.wall_time));
+                }
+            }
+
+            if(!keep) std::remove(traj.c_str());
+        }
+        if(!keep) std::remove(structure.c_str());
+
+        // Report
+        string tasks_descr = parallel ? "1 parallel" : fmt::format("{} serial",n_serial);
+        LOG()->info("Tasks: {}, work: {}, spin: {} us, atoms: {}, frames: {}",
+                    tasks_descr, work, spin, sys.num_atoms(), n_frames);
+        LOG()->info("{:>6} {:>6} {:>7} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>12} {:>10}",
+                    "format","buffer","threads","write,fr/s","fr/s","wall,s","read,s","rd_wait,s","cons_wait,s","occupancy","disp_wait,s");
+        for(auto& r: runs){
+            LOG()->info("{:>6} {:>6} {:>7} {:>10.1f} {:>10.1f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>7.2f}/{:<4} {:>10.3f}",
+                        r.format, r.buffer, r.threads, n_frames/r.write_time, r.st.frames_read/r.st.wall_time,
+                        r.st.wall_time, r.st.read_time, r.st.reader_wait, r.st.consumer_wait,
+                        r.st.mean_occupancy, r.st.max_occupancy, r.st.dispatch_wait);
+            for(int i=0; i<r.st.task_wait.size(); ++i)
+                LOG()->info("{:>20} task #{} waited for frames {:.3f}s","",i,r.st.task_wait[i]);
+        }
+
+        if(!json_file.empty()){
+            // Each run is a single timed call processing frames_read items
+            Bench_runner runner;
+            runner.add_context("version",_version_tag);
+            runner.add_context("git_revision",_git_revision);
+            runner.add_context("build_time",_build_time);
+            runner.add_context("hardware_threads",to_string(std::thread::hardware_concurrency()));
+            runner.add_context("atoms",to_string(sys.num_atoms()));
+            runner.add_context("frames",to_string(n_frames));
+            runner.add_context("tasks",tasks_descr);
+            runner.add_context("work",work);
+            runner.add_context("spin_us",fmt::format("{}",spin));
+            for(auto& r: runs){
+                Bench_result res;
+                res.name = fmt::format("{}/buffer:{}/threads:{}",r.format,r.buffer,r.threads);
+                res.times = {r.st.wall_time};
+                res.items = r.st.frames_read;
+                res.counters = {
+                    {"buffer",double(r.buffer)},
+                    {"threads",double(r.threads)},
+                    {"write_time",r.write_time},
+                    {"read_time",r.st.read_time},
+                    {"reader_wait",r.st.reader_wait},
+                    {"consumer_wait",r.st.consumer_wait},
+                    {"mean_occupancy",r.st.mean_occupancy},
+                    {"max_occupancy",double(r.st.max_occupancy)},
+                    {"dispatch_wait",r.st.dispatch_wait}
+                };
+                for(int i=0; i<r.st.task_wait.size(); ++i)
+                    res.counters[fmt::format("task_wait_{}",i)] = r.st.task_wait[i];
+                runner.add_result(res);
+            }
+
+            ofstream out(json_file);
+            if(!out) throw Pteros_error("Can't open '{}' for writing!",json_file);
+            runner.write_json(out);
+            LOG()->info("Results written to '{}'",json_file);
+        }
+
+    } catch(const Pteros_error& e) {
+        LOG()->error(e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -51,6 +51,18 @@ void search_contacts(float d, const Selection &sel1, const Selection &sel2, std:
 }
 
 
+void search_distances_histogram(float d, const Selection &sel, VectorXd &hist, bool periodic)
+{
+    Distance_search_contacts_1sel(d,sel,hist,periodic);
+}
+
+
+void search_distances_histogram(float d, const Selection &sel1, const Selection &sel2, VectorXd &hist, bool periodic)
+{
+    Distance_search_contacts_2sel(d,sel1,sel2,hist,periodic);
+}
+
+
 void search_within(float d, const Selection &src, const Selection &target, std::vector<int> &res, bool include_self, bool periodic)
 {
     Distance_search_within_sel(d,src,target,res,include_self,periodic);
@@ -70,6 +70,12 @@ namespace pteros {
 
 
         void get_nlist(int i, int j, int k, Nlist_t &nlist);
+
+        // Points inside the same cell could only be closer through periodic boundary
+        // if the cell spans the whole box in some dimension
+        bool central_cell_periodic() const {
+            return is_periodic && (NgridX==1 || NgridY==1 || NgridZ==1);
+        }
     };
 
 }
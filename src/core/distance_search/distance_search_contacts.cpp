@@ -29,7 +29,8 @@
 
 
 #include "distance_search_contacts.h"
-#include <thread>
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/thread_pool.h"
 
 using namespace std;
 using namespace pteros;
@@ -40,8 +41,13 @@ void Distance_search_contacts::do_search(){
     int nlist_size;
 
     // Search
-    result_pairs->clear();
-    if(result_distances) result_distances->clear();
+    if(result_hist){
+        if(result_hist->size()==0) throw Pteros_error("Histogram of distances should have non-zero size!");
+        hist_bin = cutoff/float(result_hist->size());
+    } else {
+        result_pairs->clear();
+        if(result_distances) result_distances->clear();
+    }
 
     // Init visited cells array
     for(i=0;i<NgridX;++i)
@@ -55,26 +61,16 @@ void Distance_search_contacts::do_search(){
     Vector3i dims(NgridX,NgridY,NgridZ);
     max_N = dims.maxCoeff(&max_dim);
 
-    int nt = std::min(max_N, int(std::thread::hardware_concurrency()));
-
-    if(nt==1){
-        deque<Vector2i> _bon;
-        deque<float> _dist_vec;
-        deque<float>* _dist_vec_ptr;
-        _dist_vec_ptr = result_distances ? &_dist_vec : nullptr;
-
-        do_part(0,0,NgridX,_bon,_dist_vec_ptr);
-
-        // Collect results
-        result_pairs->reserve(_bon.size());
+    int nt = std::min(max_N, get_num_threads());
 
-        copy(_bon.begin(),_bon.end(),back_inserter(*result_pairs));
-
-        if(result_distances){
-            result_distances->reserve(_dist_vec.size());
-            copy(_dist_vec.begin(),_dist_vec.end(),back_inserter(*result_distances));
-        }
+    // Prepare results for each thread
+    vector<Contacts_part> parts(nt);
+    if(result_hist){
+        for(auto& p: parts) p.hist = VectorXd::Zero(result_hist->size());
+    }
 
+    if(nt==1){
+        do_part(0,0,NgridX,parts[0]);
     } else {
         // Parallel searching
 
@@ -89,44 +85,29 @@ void Distance_search_contacts::do_search(){
         b[nt-1]=cur;
         e[nt-1]=dims(max_dim);
 
-        // Prepare arrays per each thread
-        vector< deque<Vector2i> > _bon(nt);
-        vector< deque<float> > _dist_vec(nt);
-        vector< deque<float>* > _dist_vec_ptr(nt);
-        for(int i=0;i<nt;++i) _dist_vec_ptr[i] = result_distances ? &_dist_vec[i] : nullptr;
-
-        // Launch threads
-        vector<thread> threads;
-        for(int i=0;i<nt;++i){
-            threads.emplace_back(
-                                   std::bind(
-                                       &Distance_search_contacts::do_part,
-                                       this,
-                                       max_dim,
-                                       b[i],
-                                       e[i],
-                                       ref(_bon[i]),
-                                       ref(_dist_vec_ptr[i])
-                                   )                                
-                             );
-        }
-
-        // Wait for threads
-        for(auto& t: threads) t.join();
+        // Run parts in thread pool
+        parallel_chunks(nt,[&](int i){
+            do_part(max_dim,b[i],e[i],parts[i]);
+        });
+    }
 
-        // Collect results
+    // Collect results
+    if(result_hist){
+        // Thread-local histograms are just summed up
+        for(auto& p: parts) *result_hist += p.hist;
+    } else {
         int sz = 0;
-        for(int i=0;i<nt;++i) sz+= _bon[i].size();
+        for(auto& p: parts) sz += p.bon.size();
 
         result_pairs->reserve(sz);
-        for(int i=0;i<nt;++i){
-            copy(_bon[i].begin(),_bon[i].end(),back_inserter(*result_pairs));
+        for(auto& p: parts){
+            copy(p.bon.begin(),p.bon.end(),back_inserter(*result_pairs));
         }
 
         if(result_distances){
             result_distances->reserve(sz);
-            for(int i=0;i<nt;++i)
-                copy(_dist_vec[i].begin(),_dist_vec[i].end(),back_inserter(*result_distances));
+            for(auto& p: parts)
+                copy(p.dist_vec.begin(),p.dist_vec.end(),back_inserter(*result_distances));
         }
     }
 }
@@ -136,10 +117,9 @@ void Distance_search_contacts::search_in_pair_of_cells(int x1, int y1, int z1, /
                              int x2, int y2, int z2, // cell 2
                              Grid& grid1,
                              Grid& grid2,
-                             deque<Vector2i>& bon,
-                             deque<float>* dist_vec, bool is_periodic)
+                             Contacts_part& part, bool is_periodic)
 {
-    int N1,N2,ind1,ind2,i1,i2;
+    int N1,N2,i1,i2;
     float d;
     float cutoff2 = cutoff*cutoff;
 
@@ -157,12 +137,7 @@ void Distance_search_contacts::search_in_pair_of_cells(int x1, int y1, int z1, /
             Vector3f* p = v1[i1].coor_ptr; // Coord of point in grid1
             for(i2=0;i2<N2;++i2){
                 d = box.distance_squared(*(v2[i2].coor_ptr),*p);
-                if(d<=cutoff2){
-                    ind1 = v1[i1].index; //index
-                    ind2 = v2[i2].index; //index
-                    bon.emplace_back(ind1,ind2);
-                    if(dist_vec) dist_vec->push_back(sqrt(d));
-                }
+                if(d<=cutoff2) add_pair(v1[i1].index, v2[i2].index, d, part);
             }
         }
 
@@ -172,12 +147,7 @@ void Distance_search_contacts::search_in_pair_of_cells(int x1, int y1, int z1, /
             Vector3f* p = v1[i1].coor_ptr; // Coord of point in grid1
             for(i2=0;i2<N2;++i2){
                 d = (*(v2[i2].coor_ptr)-*p).squaredNorm();
-                if(d<=cutoff2){
-                    ind1 = v1[i1].index; //index
-                    ind2 = v2[i2].index; //index
-                    bon.emplace_back(ind1,ind2);
-                    if(dist_vec) dist_vec->push_back(sqrt(d));
-                }
+                if(d<=cutoff2) add_pair(v1[i1].index, v2[i2].index, d, part);
             }
         }
 
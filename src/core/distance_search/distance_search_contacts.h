@@ -32,30 +32,51 @@
 #define DISTANCE_SEARCH_CONTACTS_H_INCLUDED
 
 #include "distance_search_base.h"
+#include <deque>
+#include <cmath>
 
 namespace pteros {       
 
+// Results found by single searching thread
+struct Contacts_part {
+    std::deque<Eigen::Vector2i> bon;
+    std::deque<float> dist_vec;
+    // Thread-local histogram of distances if binning on the fly is requested
+    Eigen::VectorXd hist;
+};
+
 class Distance_search_contacts: public Distance_search_base {
 public:
 protected:
     // wisited array
     boost::multi_array<bool, 3> visited;
     // Pointers for final results
-    std::vector<Eigen::Vector2i>* result_pairs;
-    std::vector<float>* result_distances;
+    std::vector<Eigen::Vector2i>* result_pairs = nullptr;
+    std::vector<float>* result_distances = nullptr;
+    // If not null distances are binned into this histogram instead of storing pairs
+    Eigen::VectorXd* result_hist = nullptr;
+    float hist_bin;
 
     void do_search();
-    virtual void do_part(int dim, int _b, int _e,
-                         std::deque<Eigen::Vector2i>& bon,
-                         std::deque<float>* dist_vec) = 0;
+    virtual void do_part(int dim, int _b, int _e, Contacts_part& part) = 0;
 
     void search_in_pair_of_cells(int x1, int y1, int z1,
                                  int x2, int y2, int z2,
                                  Grid &grid1,
                                  Grid &grid2,
-                                 std::deque<Eigen::Vector2i> &bon,
-                                 std::deque<float> *dist_vec,
+                                 Contacts_part& part,
                                  bool is_periodic);
+
+    // Stores found pair or bins its distance
+    inline void add_pair(int ind1, int ind2, float d2, Contacts_part& part){
+        if(result_hist){
+            int b = int(std::sqrt(d2)/hist_bin);
+            if(b<part.hist.size()) part.hist(b) += 1.0;
+        } else {
+            part.bon.emplace_back(ind1,ind2);
+            if(result_distances) part.dist_vec.push_back(std::sqrt(d2));
+        }
+    }
 };
 
 }
@@ -47,6 +47,21 @@ Distance_search_contacts_1sel::Distance_search_contacts_1sel(float d, const Sele
     cutoff = d;
     is_periodic = periodic;
     abs_index = absolute_index;
+    run(sel);
+}
+
+Distance_search_contacts_1sel::Distance_search_contacts_1sel(float d, const Selection &sel,
+                                                             VectorXd &hist,
+                                                             bool periodic){
+    result_hist = &hist;
+    cutoff = d;
+    is_periodic = periodic;
+    abs_index = false;
+    run(sel);
+}
+
+void Distance_search_contacts_1sel::run(const Selection &sel)
+{
     box = sel.box();
 
     create_grid(sel);
@@ -82,7 +97,7 @@ void Distance_search_contacts_1sel::create_grid(const Selection &sel)
     visited.resize( boost::extents[NgridX][NgridY][NgridZ] );
 }
 
-void Distance_search_contacts_1sel::do_part(int dim, int _b, int _e, std::deque<Vector2i> &bon, std::deque<float> *dist_vec)
+void Distance_search_contacts_1sel::do_part(int dim, int _b, int _e, Contacts_part& part)
 {
     Vector3i b(0,0,0);
     Vector3i e(NgridX,NgridY,NgridZ);
@@ -99,7 +114,7 @@ void Distance_search_contacts_1sel::do_part(int dim, int _b, int _e, std::deque<
             for(k=b(2);k<e(2);++k){
                 // Search in central cell
                 //get_central_1(i,j,k, sel, bon, dist_vec);
-                search_in_cell(i,j,k,bon,dist_vec,false);
+                search_in_cell(i,j,k,part,central_cell_periodic());
                 visited[i][j][k] = true;
                 // Get neighbour list locally
                 get_nlist(i,j,k,nlist);
@@ -121,14 +136,14 @@ void Distance_search_contacts_1sel::do_part(int dim, int _b, int _e, std::deque<
                             search_in_pair_of_cells(i,j,k,
                                                     cell(0),cell(1),cell(2),
                                                     grid1, grid1,
-                                                    bon,dist_vec,
+                                                    part,
                                                     nlist.wrapped[i1] && is_periodic);
                     } else {
                         // cell is in halo
                         search_in_pair_of_cells(i,j,k,
                                                 cell(0),cell(1),cell(2),
                                                 grid1, grid1,
-                                                bon,dist_vec,
+                                                part,
                                                 nlist.wrapped[i1] && is_periodic);
                     }
 
@@ -141,11 +156,10 @@ void Distance_search_contacts_1sel::do_part(int dim, int _b, int _e, std::deque<
 }
 
 void Distance_search_contacts_1sel::search_in_cell(int x, int y, int z,
-                    deque<Vector2i>& bon,
-                    deque<float>* dist_vec,
+                    Contacts_part& part,
                     bool is_periodic)
     {
-    int N,ind1,ind2,i1,i2;
+    int N,i1,i2;
     float d;
     float cutoff2 = cutoff*cutoff;
 
@@ -163,12 +177,7 @@ void Distance_search_contacts_1sel::search_in_cell(int x, int y, int z,
             Vector3f* p = v[i1].coor_ptr; // Coord of point in grid1
             for(i2=i1+1;i2<N;++i2){
                 d = box.distance_squared(*(v[i2].coor_ptr),*p);
-                if(d<=cutoff2){
-                    ind1 = v[i1].index; //index
-                    ind2 = v[i2].index; //index
-                    bon.emplace_back(ind1,ind2);
-                    if(dist_vec) dist_vec->push_back(sqrt(d));
-                }
+                if(d<=cutoff2) add_pair(v[i1].index, v[i2].index, d, part);
             }
         }
 
@@ -178,12 +187,7 @@ void Distance_search_contacts_1sel::search_in_cell(int x, int y, int z,
             Vector3f* p = v[i1].coor_ptr; // Coord of point in grid1
             for(i2=i1+1;i2<N;++i2){
                 d = (*(v[i2].coor_ptr)-*p).squaredNorm();
-                if(d<=cutoff2){
-                    ind1 = v[i1].index; //index
-                    ind2 = v[i2].index; //index
-                    bon.emplace_back(ind1,ind2);
-                    if(dist_vec) dist_vec->push_back(sqrt(d));
-                }
+                if(d<=cutoff2) add_pair(v[i1].index, v[i2].index, d, part);
             }
         }
 
@@ -42,16 +42,18 @@ public:
                                   bool absolute_index = false,
                                   bool periodic = false,
                                   std::vector<float> *dist_vec = nullptr);
+    // Bins distances into histogram instead of storing pairs
+    Distance_search_contacts_1sel(float d, const Selection& sel,
+                                  Eigen::VectorXd& hist,
+                                  bool periodic = false);
 protected:
+    void run(const Selection &sel);
     void create_grid(const Selection &sel);
 
-    void do_part(int dim, int _b, int _e,
-                 std::deque<Eigen::Vector2i>& bon,
-                 std::deque<float>* dist_vec) override;
+    void do_part(int dim, int _b, int _e, Contacts_part& part) override;
 
     void search_in_cell(int x, int y, int z,
-                        std::deque<Eigen::Vector2i> &bon,
-                        std::deque<float> *dist_vec,
+                        Contacts_part& part,
                         bool is_periodic);
 };
 
@@ -51,6 +51,24 @@ Distance_search_contacts_2sel::Distance_search_contacts_2sel(float d,
     cutoff = d;
     is_periodic = periodic;
     abs_index = absolute_index;
+    run(sel1,sel2);
+}
+
+Distance_search_contacts_2sel::Distance_search_contacts_2sel(float d,
+                                                             const Selection &sel1,
+                                                             const Selection &sel2,
+                                                             VectorXd &hist,
+                                                             bool periodic)
+{
+    result_hist = &hist;
+    cutoff = d;
+    is_periodic = periodic;
+    abs_index = false;
+    run(sel1,sel2);
+}
+
+void Distance_search_contacts_2sel::run(const Selection &sel1, const Selection &sel2)
+{
     box = sel1.box();
 
     create_grids(sel1,sel2);
@@ -103,7 +121,7 @@ void Distance_search_contacts_2sel::create_grids(const Selection &sel1, const Se
     visited.resize( boost::extents[NgridX][NgridY][NgridZ] );
 }
 
-void Distance_search_contacts_2sel::do_part(int dim, int _b, int _e, std::deque<Vector2i> &bon, std::deque<float> *dist_vec)
+void Distance_search_contacts_2sel::do_part(int dim, int _b, int _e, Contacts_part& part)
 {
     Vector3i b(0,0,0);
     Vector3i e(NgridX,NgridY,NgridZ);
@@ -119,11 +137,10 @@ void Distance_search_contacts_2sel::do_part(int dim, int _b, int _e, std::deque<
         for(j=b(1);j<e(1);++j){
             for(k=b(2);k<e(2);++k){
                 // Search in central cell
-                // Central cell is always non-periodic
                 search_in_pair_of_cells(i,j,k, i,j,k,
                                         grid1,grid2,
-                                        bon,dist_vec,
-                                        false);
+                                        part,
+                                        central_cell_periodic());
                 visited[i][j][k] = true;
                 // Get neighbour list locally
                 get_nlist(i,j,k,nlist);
@@ -150,12 +167,12 @@ void Distance_search_contacts_2sel::do_part(int dim, int _b, int _e, std::deque<
                             search_in_pair_of_cells(i,j,k,
                                                     s1,s2,s3,
                                                     grid1, grid2,
-                                                    bon,dist_vec,
+                                                    part,
                                                     nlist.wrapped[i1] && is_periodic);
                             search_in_pair_of_cells(s1,s2,s3,
                                                     i,j,k,
                                                     grid1, grid2,
-                                                    bon,dist_vec,
+                                                    part,
                                                     nlist.wrapped[i1] && is_periodic);
                         }
                     } else {
@@ -163,12 +180,12 @@ void Distance_search_contacts_2sel::do_part(int dim, int _b, int _e, std::deque<
                         search_in_pair_of_cells(i,j,k,
                                                 s1,s2,s3,
                                                 grid1, grid2,
-                                                bon,dist_vec,
+                                                part,
                                                 nlist.wrapped[i1] && is_periodic);
                         search_in_pair_of_cells(s1,s2,s3,
                                                 i,j,k,
                                                 grid1, grid2,
-                                                bon,dist_vec,
+                                                part,
                                                 nlist.wrapped[i1] && is_periodic);
                     }
 
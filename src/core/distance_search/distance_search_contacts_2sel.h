@@ -42,12 +42,15 @@ public:
                                   bool absolute_index = false,
                                   bool periodic = false,
                                   std::vector<float>* dist_vec = nullptr);
+    // Bins distances into histogram instead of storing pairs
+    Distance_search_contacts_2sel(float d, const Selection& sel1, const Selection& sel2,
+                                  Eigen::VectorXd& hist,
+                                  bool periodic = false);
 protected:
+    void run(const Selection &sel1, const Selection &sel2);
     void create_grids(const Selection &sel1, const Selection &sel2);
 
-    void do_part(int dim, int _b, int _e,
-                 std::deque<Eigen::Vector2i>& bon,
-                 std::deque<float>* dist_vec) override;
+    void do_part(int dim, int _b, int _e, Contacts_part& part) override;
 };
 
 }
@@ -29,7 +29,7 @@
 
 
 #include "distance_search_within_base.h"
-#include <thread>
+#include "pteros/core/thread_pool.h"
 
 using namespace std;
 using namespace pteros;
@@ -79,7 +79,7 @@ void Distance_search_within_base::do_search(int sel_size)
     Vector3i dims(NgridX,NgridY,NgridZ);
     max_N = dims.maxCoeff(&max_dim);
 
-    int nt = std::min(max_N, int(std::thread::hardware_concurrency()));
+    int nt = std::min(max_N, get_num_threads());
 
     if(nt>1){
         // Parallel search
@@ -95,22 +95,10 @@ void Distance_search_within_base::do_search(int sel_size)
         b[nt-1]=cur;
         e[nt-1]=dims(max_dim);
 
-        // Launch threads
-        vector<thread> threads;
-        for(int i=0;i<nt;++i){
-            threads.emplace_back(
-                                   std::bind(
-                                       &Distance_search_within_base::do_part,
-                                       this,
-                                       max_dim,
-                                       b[i],
-                                       e[i]
-                                   )                                
-                             );
-        }
-
-        // Wait for threads
-        for(auto& t: threads) t.join();
+        // Run parts in thread pool
+        parallel_chunks(nt,[&](int i){
+            do_part(max_dim,b[i],e[i]);
+        });
 
     } else {
         // Serial search, no need to launch separate thread
@@ -139,7 +127,7 @@ void Distance_search_within_base::do_part(int dim, int _b, int _e){
                 // Search in central cell
                 search_in_pair_of_cells(i,j,k, //src cell
                                         i,j,k, //target cell
-                                        false);
+                                        central_cell_periodic());
                 // Get nlist
                 get_nlist(i,j,k,nlist);
 
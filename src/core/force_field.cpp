@@ -181,7 +181,7 @@ void Force_field::setup_kernels(){
 }
 
 
-Vector2f Force_field::pair_energy(int at1, int at2, float r, float q1, float q2, int type1, int type2)
+Vector2f Force_field::pair_energy(int at1, int at2, float r, float q1, float q2, int type1, int type2) const
 {
     float c6,c12;
     // indexes have to be in increasing order
@@ -207,13 +207,64 @@ Vector2f Force_field::pair_energy(int at1, int at2, float r, float q1, float q2,
     }
 }
 
-float Force_field::get_cutoff(){
+float Force_field::get_cutoff() const{
     return std::min(rcoulomb,rvdw);
 }
 
-Force_field::Force_field():  ready(false) {}
+void Force_field::remap_atoms(const std::vector<int> &new_index, int new_natoms)
+{
+    int old_natoms = new_index.size();
+
+    // Exclusions are stored per atom. New indexes never exceed old ones,
+    // so the sets are moved down in place.
+    if(exclusions.size()==old_natoms){
+        for(int i=0;i<old_natoms;++i){
+            if(new_index[i]<0) continue;
+            unordered_set<int> s;
+            s.reserve(exclusions[i].size());
+            for(int j: exclusions[i]){
+                if(new_index[j]>=0) s.insert(new_index[j]);
+            }
+            exclusions[new_index[i]].swap(s);
+        }
+        exclusions.resize(new_natoms);
+    }
+
+    // Bonds
+    int n = 0;
+    for(const auto& b: bonds){
+        if(new_index[b(0)]>=0 && new_index[b(1)]>=0)
+            bonds[n++] = Vector2i(new_index[b(0)],new_index[b(1)]);
+    }
+    bonds.resize(n);
+
+    // 1-4 pairs. Order of atoms is preserved, so a<=b still holds.
+    unordered_map<int,int> pairs;
+    pairs.reserve(LJ14_pairs.size());
+    for(const auto& it: LJ14_pairs){
+        int a = new_index[it.first/natoms];
+        int b = new_index[it.first%natoms];
+        if(a>=0 && b>=0) pairs[a*new_natoms+b] = it.second;
+    }
+    LJ14_pairs.swap(pairs);
+
+    // Molecules are ranges of atoms, which shrink or disappear
+    n = 0;
+    for(const auto& m: molecules){
+        int b = m(0), e = m(1);
+        while(b<=e && new_index[b]<0) ++b;
+        while(e>=b && new_index[e]<0) --e;
+        if(b<=e) molecules[n++] = Vector2i(new_index[b],new_index[e]);
+    }
+    molecules.resize(n);
+
+    natoms = new_natoms;
+}
+
+Force_field::Force_field(): natoms(0), ready(false) {}
 
 Force_field::Force_field(const Force_field &other){
+    natoms = other.natoms;
     exclusions = other.exclusions;
     molecules = other.molecules;
     bonds = other.bonds;
@@ -240,6 +291,7 @@ Force_field::Force_field(const Force_field &other){
 }
 
 Force_field &Force_field::operator=(Force_field other){    
+    natoms = other.natoms;
     exclusions = other.exclusions;
     molecules = other.molecules;
     bonds = other.bonds;
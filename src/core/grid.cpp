@@ -30,6 +30,10 @@
 
 #include "pteros/core/grid.h"
 #include "pteros/core/pteros_error.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 using namespace std;
 using namespace pteros;
@@ -49,7 +53,10 @@ void Grid::clear()
 
 void Grid::resize(int X, int Y, int Z)
 {
-    data.resize( boost::extents[X][Y][Z] );
+    // If the size is the same cells keep their memory,
+    // so repopulating the grid in each frame doesn't reallocate it
+    if(data.shape()[0]!=X || data.shape()[1]!=Y || data.shape()[2]!=Z)
+        data.resize( boost::extents[X][Y][Z] );
     clear();
 }
 
@@ -105,24 +112,26 @@ void Grid::populate_periodic(const Selection &sel, const Periodic_box &box, bool
     int n1,n2,n3;
 
     // Periodic variant
-    Vector3f coor;
+    Vector3f coor, rel;
     Vector3f* ptr;
     Matrix3f m_inv = box.get_inv_matrix();
 
     for(int i=0;i<Natoms;++i){
         coor = sel.xyz(i);
+        // Get relative coordinates in box
+        rel = m_inv*coor;
         // See if atom i is in box and wrap if needed
-        if( !box.in_box(coor) ){
+        if( (rel.array()<0).any() || (rel.array()>1).any() ){
             box.wrap_point(coor);
             wrapped_atoms.push_back(coor);
             ptr = &*wrapped_atoms.rbegin();
+            rel = m_inv*coor;
         } else {
             ptr = sel.xyz_ptr(i);
         }
 
-        // Now we are sure that coor is wrapped
-        // Get relative coordinates in box [0:1)
-        coor = m_inv*coor;
+        // Now we are sure that coor is wrapped, relative coordinates are in [0:1)
+        coor = rel;
 
         n1 = floor(NX*coor(0));
         n2 = floor(NY*coor(1));
@@ -154,3 +163,231 @@ void Grid::populate_periodic(const Selection &sel, const Periodic_box &box, bool
 }
 
 
+
+//-------------------------------------------------------
+
+void Density_grid::create(Vector3f_const_ref min, Vector3f_const_ref max, float spacing)
+{
+    if(spacing<=0) throw Pteros_error("Grid spacing should be positive!");
+    if((max.array()<=min.array()).any()) throw Pteros_error("Invalid region of density grid!");
+
+    periodic = false;
+    for(int i=0;i<3;++i) n(i) = std::max(1,int(ceil((max(i)-min(i))/spacing)));
+    origin = min;
+    cell = Matrix3f::Identity()*spacing;
+    n_frames = 0;
+    data.assign(long(n(0))*n(1)*n(2),0.0);
+}
+
+void Density_grid::create(const Periodic_box &box, float spacing)
+{
+    if(spacing<=0) throw Pteros_error("Grid spacing should be positive!");
+    if(!box.is_periodic()) throw Pteros_error("Periodic density grid requires periodic box!");
+
+    periodic = true;
+    for(int i=0;i<3;++i) n(i) = std::max(1,int(round(box.get_vector(i).norm()/spacing)));
+    origin.fill(0.0);
+    box_sum.fill(0.0);
+    n_frames = 0;
+    data.assign(long(n(0))*n(1)*n(2),0.0);
+}
+
+void Density_grid::add(const Selection &sel, const std::vector<float> &weights, float sigma)
+{
+    if(!weights.empty() && weights.size()!=sel.size())
+        throw Pteros_error("Number of weights {} doesn't match selection size {}!",weights.size(),sel.size());
+
+    Matrix3f cell_m, m_inv;
+    Vector3f u;
+
+    if(periodic){
+        // Grid follows the current box
+        const Periodic_box& box = sel.box();
+        cell_m = box.get_matrix()*Vector3f(1.0/n(0),1.0/n(1),1.0/n(2)).asDiagonal();
+        box_sum += box.get_matrix();
+    } else {
+        cell_m = cell;
+    }
+    m_inv = cell_m.inverse();
+
+    for(int i=0;i<sel.size();++i){
+        // Continuous cell coordinates of atom
+        u = m_inv*(sel.xyz(i)-origin);
+        add_point(u, weights.empty() ? 1.0 : weights[i], sigma, cell_m, m_inv);
+    }
+
+    ++n_frames;
+}
+
+void Density_grid::add_point(Vector3f_const_ref u, float w, float sigma, Matrix3f_const_ref cell_m, Matrix3f_const_ref cell_inv)
+{
+    Vector3i c = u.array().floor().cast<int>();
+
+    if(sigma<=0){
+        // Plain binning
+        if(periodic){
+            for(int d=0;d<3;++d) c(d) = (c(d)%n(d)+n(d))%n(d);
+        } else if((c.array()<0).any() || (c.array()>=n.array()).any()){
+            return;
+        }
+        at(c(0),c(1),c(2)) += w;
+        return;
+    }
+
+    // Gaussian spreading over the cells within 3 sigma.
+    // Extent of stencil along each cell vector is given by the norms of rows of inverse matrix.
+    Vector3i r;
+    for(int d=0;d<3;++d) r(d) = int(ceil(3.0*sigma*cell_inv.row(d).norm()));
+
+    float s2 = 2.0*sigma*sigma;
+    float cutoff2 = 9.0*sigma*sigma;
+    thread_local std::vector<std::pair<Vector3i,float>> stencil;
+    stencil.clear();
+    float sum = 0.0;
+
+    // Vector from atom to the center of its own cell
+    Vector3f v0 = cell_m*((c.cast<float>().array()+0.5).matrix()-u);
+    Vector3f dv;
+    Vector3i ind;
+    for(int i=-r(0);i<=r(0);++i)
+        for(int j=-r(1);j<=r(1);++j)
+            for(int k=-r(2);k<=r(2);++k){
+                // Vector from atom to cell center
+                dv = v0 + cell_m.col(0)*i + cell_m.col(1)*j + cell_m.col(2)*k;
+                float d2 = dv.squaredNorm();
+                if(d2>cutoff2) continue;
+                float g = exp(-d2/s2);
+                sum += g;
+                stencil.emplace_back(c+Vector3i(i,j,k),g);
+            }
+
+    if(sum==0) return;
+
+    // Normalize to conserve the total weight.
+    // In non-periodic case the part outside the region is lost.
+    for(auto& it: stencil){
+        ind = it.first;
+        if(periodic){
+            for(int d=0;d<3;++d) ind(d) = (ind(d)%n(d)+n(d))%n(d);
+        } else if((ind.array()<0).any() || (ind.array()>=n.array()).any()){
+            continue;
+        }
+        at(ind(0),ind(1),ind(2)) += w*it.second/sum;
+    }
+}
+
+void Density_grid::merge(const Density_grid &other)
+{
+    if(other.n!=n || other.periodic!=periodic) throw Pteros_error("Can't merge incompatible density grids!");
+    for(long i=0;i<data.size();++i) data[i] += other.data[i];
+    if(periodic) box_sum += other.box_sum;
+    n_frames += other.n_frames;
+}
+
+Matrix3f Density_grid::average_cell() const
+{
+    if(periodic){
+        if(n_frames==0) throw Pteros_error("No frames in density grid!");
+        return box_sum/float(n_frames)*Vector3f(1.0/n(0),1.0/n(1),1.0/n(2)).asDiagonal();
+    } else {
+        return cell;
+    }
+}
+
+double Density_grid::density(int i, int j, int k) const
+{
+    if(n_frames==0) throw Pteros_error("No frames in density grid!");
+    return data[(long(i)*n(1)+j)*n(2)+k]/(n_frames*std::abs(average_cell().determinant()));
+}
+
+void Density_grid::write_dx(const string &fname) const
+{
+    if(n_frames==0) throw Pteros_error("No frames in density grid!");
+    Matrix3f c = average_cell();
+    double norm = 1.0/(n_frames*std::abs(c.determinant()));
+    // Grid points are in the centers of cells
+    Vector3f o = origin + c*Vector3f::Constant(0.5);
+
+    ofstream f(fname);
+    if(!f) throw Pteros_error("Can't open file '{}' for writing!",fname);
+
+    f << "# Density map written by Pteros (units per nm^3)" << endl;
+    f << fmt::format("object 1 class gridpositions counts {} {} {}\n",n(0),n(1),n(2));
+    f << fmt::format("origin {} {} {}\n",10*o(0),10*o(1),10*o(2));
+    for(int d=0;d<3;++d) f << fmt::format("delta {} {} {}\n",10*c(0,d),10*c(1,d),10*c(2,d));
+    f << fmt::format("object 2 class gridconnections counts {} {} {}\n",n(0),n(1),n(2));
+    f << fmt::format("object 3 class array type double rank 0 items {} data follows\n",data.size());
+    for(long i=0;i<data.size();++i){
+        f << data[i]*norm << ((i%3==2) ? "\n" : " ");
+    }
+    if(data.size()%3) f << endl;
+    f << "attribute \"dep\" string \"positions\"" << endl;
+    f << "object \"density\" class field" << endl;
+    f << "component \"positions\" value 1" << endl;
+    f << "component \"connections\" value 2" << endl;
+    f << "component \"data\" value 3" << endl;
+    f.close();
+}
+
+void Density_grid::write_ccp4(const string &fname) const
+{
+    if(n_frames==0) throw Pteros_error("No frames in density grid!");
+    Matrix3f c = average_cell();
+    double norm = 1.0/(n_frames*std::abs(c.determinant()));
+    Vector3f o = origin + c*Vector3f::Constant(0.5);
+
+    // Values with x changing fastest
+    vector<float> v(data.size());
+    long ind = 0;
+    for(int k=0;k<n(2);++k)
+        for(int j=0;j<n(1);++j)
+            for(int i=0;i<n(0);++i)
+                v[ind++] = data[(long(i)*n(1)+j)*n(2)+k]*norm;
+
+    float vmin = *std::min_element(v.begin(),v.end());
+    float vmax = *std::max_element(v.begin(),v.end());
+    double vmean = 0.0, vrms = 0.0;
+    for(float x: v) vmean += x;
+    vmean /= v.size();
+    for(float x: v) vrms += (x-vmean)*(x-vmean);
+    vrms = sqrt(vrms/v.size());
+
+    // Unit cell from cell vectors
+    Periodic_box b(c*n.cast<float>().asDiagonal());
+    Vector3f vec, ang;
+    b.to_vectors_angles(vec,ang);
+
+    // 1024 bytes header of 4-byte words
+    char header[1024];
+    std::fill(header,header+1024,0);
+    auto set_int = [&header](int word, int32_t val){ memcpy(header+4*word,&val,4); };
+    auto set_float = [&header](int word, float val){ memcpy(header+4*word,&val,4); };
+
+    for(int d=0;d<3;++d){
+        set_int(d,n(d));            // NC, NR, NS
+        set_int(7+d,n(d));          // NX, NY, NZ
+        set_float(10+d,10*vec(d));  // Cell lengths in A
+        set_float(13+d,ang(d));     // Cell angles in degrees
+        set_int(16+d,d+1);          // MAPC, MAPR, MAPS
+        set_float(49+d,10*o(d));    // Origin in A
+    }
+    set_int(3,2); // Mode: 32-bit float
+    set_float(19,vmin);
+    set_float(20,vmax);
+    set_float(21,vmean);
+    set_int(22,1); // Space group
+    memcpy(header+4*52,"MAP ",4);
+    // Machine stamp for little endian
+    header[4*53] = 0x44;
+    header[4*53+1] = 0x41;
+    set_float(54,vrms);
+    set_int(55,1); // Number of labels
+    std::string label = "Density map written by Pteros";
+    memcpy(header+4*56,label.data(),label.size());
+
+    ofstream f(fname, ios::binary);
+    if(!f) throw Pteros_error("Can't open file '{}' for writing!",fname);
+    f.write(header,1024);
+    f.write(reinterpret_cast<const char*>(v.data()),v.size()*sizeof(float));
+    f.close();
+}
@@ -0,0 +1,336 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/core/hbonds.h"
+#include "pteros/core/distance_search.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/logging.h"
+#include "pteros/core/utilities.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/profiling.h"
+#include <cctype>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Element from atomic number or from the first letter of atom name.
+// Only H, N and O are recognized by name, which is all we need here.
+int hbond_element(const Selection& sel, int i){
+    if(sel.atomic_number(i)>0) return sel.atomic_number(i);
+    for(char c: sel.name(i)){
+        if(isdigit(c)) continue;
+        switch(toupper(c)){
+        case 'H': return 1;
+        case 'N': return 7;
+        case 'O': return 8;
+        default: return 0;
+        }
+    }
+    return 0;
+}
+
+bool is_hbond_heavy_atom(int el){ return el==7 || el==8; }
+
+bool hbond_less(const Hbond& a, const Hbond& b){
+    return std::tie(a.donor,a.hydrogen,a.acceptor) < std::tie(b.donor,b.hydrogen,b.acceptor);
+}
+
+} // namespace
+
+
+Hbond_search::Hbond_search(): cutoff(0.35), cos_cutoff(cos(deg_to_rad(30))), periodic(true) {}
+
+Hbond_search::Hbond_search(const Selection &sel, float d, float angle, bool periodic, float bond_d)
+{
+    create(sel,d,angle,periodic,bond_d);
+}
+
+Hbond_search::Hbond_search(const Selection &donors, const Selection &acceptors, float d, float angle, bool periodic, float bond_d)
+{
+    create(donors,acceptors,d,angle,periodic,bond_d);
+}
+
+void Hbond_search::create(const Selection &sel, float d, float angle, bool periodic_, float bond_d)
+{
+    cutoff = d;
+    cos_cutoff = cos(deg_to_rad(angle));
+    periodic = periodic_;
+    classify(sel,sel,true,bond_d);
+}
+
+void Hbond_search::create(const Selection &don_sel, const Selection &acc_sel, float d, float angle, bool periodic_, float bond_d)
+{
+    cutoff = d;
+    cos_cutoff = cos(deg_to_rad(angle));
+    periodic = periodic_;
+    classify(don_sel,acc_sel,false,bond_d);
+}
+
+void Hbond_search::set_frame(int fr)
+{
+    donors.set_frame(fr);
+    acceptors.set_frame(fr);
+}
+
+void Hbond_search::set_system(const System &sys)
+{
+    int max_ind = -1;
+    if(donors.size()) max_ind = std::max(max_ind,donors.index(donors.size()-1));
+    if(acceptors.size()) max_ind = std::max(max_ind,acceptors.index(acceptors.size()-1));
+    if(max_ind>=sys.num_atoms())
+        throw Pteros_error("H-bond search refers to atom {} but system has only {} atoms!",max_ind,sys.num_atoms());
+
+    donors.modify(sys,donors.get_index());
+    acceptors.modify(sys,acceptors.get_index());
+}
+
+void Hbond_search::classify(const Selection &don_sel, const Selection &acc_sel, bool by_element, float bond_d)
+{
+    const System& sys = *don_sel.get_system();
+    if(acc_sel.get_system()!=don_sel.get_system())
+        throw Pteros_error("Donors and acceptors should belong to the same system!");
+
+    if(bond_d==0 && !(sys.force_field_ready() && sys.get_force_field().bonds.size())){
+        bond_d = 0.12;
+        LOG()->debug("No bonds in topology, hydrogens are assigned to donors within {} nm",bond_d);
+    }
+
+    // Donors with their hydrogens
+    vector<vector<int>> con = don_sel.get_internal_bonds(bond_d,periodic);
+
+    int n = don_sel.size();
+    vector<int> el(n);
+    for(int i=0;i<n;++i) el[i] = hbond_element(don_sel,i);
+
+    vector<int> don_ind;
+    h_start.assign(1,0);
+    hydrogens.clear();
+    for(int i=0;i<n;++i){
+        if(el[i]==1 || (by_element && !is_hbond_heavy_atom(el[i]))) continue;
+        int first = hydrogens.size();
+        for(int j: con[i]){
+            if(el[j]==1) hydrogens.push_back(don_sel.index(j));
+        }
+        if(hydrogens.size()>first){
+            // Bonds may come in any order, make it deterministic
+            sort(hydrogens.begin()+first,hydrogens.end());
+            don_ind.push_back(don_sel.index(i));
+            h_start.push_back(hydrogens.size());
+        }
+    }
+
+    // Acceptors
+    vector<int> acc_ind;
+    for(int i=0;i<acc_sel.size();++i){
+        int e = hbond_element(acc_sel,i);
+        if(e==1 || (by_element && !is_hbond_heavy_atom(e))) continue;
+        acc_ind.push_back(acc_sel.index(i));
+    }
+
+    donors.modify(sys,don_ind);
+    acceptors.modify(sys,acc_ind);
+    set_frame(don_sel.get_frame());
+
+    LOG()->debug("H-bond search: {} donors, {} hydrogens, {} acceptors",
+                 donors.size(),hydrogens.size(),acceptors.size());
+}
+
+void Hbond_search::search(std::vector<Hbond> &res) const
+{
+    PTEROS_PROFILE_SCOPE("hbonds.search");
+    res.clear();
+    if(donors.size()==0 || acceptors.size()==0) return;
+
+    // Candidate donor-acceptor pairs in local indexes
+    vector<Vector2i> pairs;
+    vector<float> dist;
+    search_contacts(cutoff,donors,acceptors,pairs,false,periodic,&dist);
+
+    const auto& coord = donors.get_system()->frame(donors.get_frame()).coord;
+    const auto& box = donors.box();
+
+    // Angle filter over all candidates. Each chunk fills its own part of the result.
+    int n = pairs.size();
+    int nch = num_parallel_chunks(n,256);
+    vector<vector<Hbond>> parts(nch);
+
+    auto filter = [&](auto shortest){
+        parallel_chunks(nch,[&](int c){
+            auto& part = parts[c];
+            int b = long(n)*c/nch;
+            int e = long(n)*(c+1)/nch;
+            for(int i=b;i<e;++i){
+                int d = pairs[i](0);
+                int D = donors.index(d);
+                int A = acceptors.index(pairs[i](1));
+                // Donor and acceptor selections may overlap
+                if(D==A || dist[i]==0) continue;
+                Vector3f da = shortest(coord[D],coord[A]);
+                for(int h=h_start[d]; h<h_start[d+1]; ++h){
+                    Vector3f dh = shortest(coord[D],coord[hydrogens[h]]);
+                    // Compare cosines to avoid acos for rejected candidates
+                    float cos_a = dh.dot(da)/(dh.norm()*dist[i]);
+                    if(cos_a>=cos_cutoff){
+                        part.push_back({D, hydrogens[h], A, dist[i],
+                                        rad_to_deg(acos(std::min(cos_a,1.0f)))});
+                    }
+                }
+            }
+        });
+    };
+
+    if(periodic && box.is_periodic()){
+        if(box.is_triclinic())
+            filter([&box](Vector3f_const_ref p1, Vector3f_const_ref p2){ return box.shortest_vector_t<true>(p1,p2); });
+        else
+            filter([&box](Vector3f_const_ref p1, Vector3f_const_ref p2){ return box.shortest_vector_t<false>(p1,p2); });
+    } else {
+        filter([](Vector3f_const_ref p1, Vector3f_const_ref p2)->Vector3f{ return p2-p1; });
+    }
+
+    size_t total = 0;
+    for(const auto& p: parts) total += p.size();
+    res.reserve(total);
+    for(const auto& p: parts) res.insert(res.end(),p.begin(),p.end());
+
+    // Order of candidate pairs depends on scheduling
+    sort(res.begin(),res.end(),hbond_less);
+    PTEROS_PROFILE_COUNT("hbonds.found",res.size());
+}
+
+//--------------------------------------------------------------------------
+
+void Hbond_lifetime::add_frame(int fr, const std::vector<Hbond> &hb)
+{
+    for(const auto& h: hb){
+        auto& v = bonds[{h.donor,h.hydrogen,h.acceptor}];
+        if(!v.empty() && v.back()>fr) sorted = false;
+        if(v.empty() || v.back()!=fr) v.push_back(fr);
+    }
+}
+
+void Hbond_lifetime::merge(const Hbond_lifetime &other)
+{
+    for(const auto& it: other.bonds){
+        auto& v = bonds[it.first];
+        v.insert(v.end(),it.second.begin(),it.second.end());
+    }
+    if(!other.bonds.empty()) sorted = false;
+}
+
+void Hbond_lifetime::sort_frames()
+{
+    if(sorted) return;
+    for(auto& it: bonds){
+        auto& v = it.second;
+        sort(v.begin(),v.end());
+        v.erase(unique(v.begin(),v.end()),v.end());
+    }
+    sorted = true;
+}
+
+std::vector<Hbond_stats> Hbond_lifetime::get_stats(bool keep_transient)
+{
+    sort_frames();
+    vector<Hbond_stats> res;
+    res.reserve(bonds.size());
+    for(const auto& it: bonds){
+        const auto& fr = it.second;
+        Hbond_stats st {it.first[0],it.first[1],it.first[2],int(fr.size()),0,0};
+        // Split frames into continuous intervals
+        int first = 0;
+        for(int i=1; i<=fr.size(); ++i){
+            if(i==fr.size() || fr[i]!=fr[i-1]+1){
+                // Interval [first:i-1] ends
+                if(i-1>first || keep_transient){
+                    st.mean_life_time += i-first;
+                    ++st.num_formed;
+                }
+                first = i;
+            }
+        }
+        if(st.num_formed==0) continue;
+        st.mean_life_time /= st.num_formed;
+        res.push_back(st);
+    }
+    return res;
+}
+
+void Hbond_lifetime::autocorrelation(int n_frames, int max_lag, VectorXf &intermittent, VectorXf &continuous)
+{
+    PTEROS_PROFILE_SCOPE("hbonds.autocorrelation");
+    sort_frames();
+    max_lag = std::min(max_lag,n_frames-1);
+    if(max_lag<0) throw Pteros_error("Need at least one frame for autocorrelation!");
+
+    vector<const vector<int>*> frames;
+    frames.reserve(bonds.size());
+    for(const auto& it: bonds) frames.push_back(&it.second);
+
+    // Sums over time origins for intermittent (first column) and continuous (second column) functions
+    MatrixX2d sums = parallel_reduce(0, int(frames.size()), MatrixX2d::Zero(max_lag+1,2).eval(),
+        [&](int b, int e, MatrixX2d& acc){
+            for(int k=b;k<e;++k){
+                const auto& fr = *frames[k];
+                int nf = fr.size();
+                // Intermittent: both frames fr[i] and fr[i]+lag are present
+                for(int lag=0; lag<=max_lag; ++lag){
+                    int j = 0;
+                    for(int i=0;i<nf;++i){
+                        int target = fr[i]+lag;
+                        while(j<nf && fr[j]<target) ++j;
+                        if(j==nf) break;
+                        if(fr[j]==target) acc(lag,0) += 1;
+                    }
+                }
+                // Continuous: interval of length L gives L-lag origins
+                int first = 0;
+                for(int i=1; i<=nf; ++i){
+                    if(i==nf || fr[i]!=fr[i-1]+1){
+                        int len = i-first;
+                        for(int lag=0; lag<std::min(len,max_lag+1); ++lag) acc(lag,1) += len-lag;
+                        first = i;
+                    }
+                }
+            }
+        },
+        [](const MatrixX2d& a, const MatrixX2d& b)->MatrixX2d{ return a+b; }, 64);
+
+    intermittent.resize(max_lag+1);
+    continuous.resize(max_lag+1);
+    for(int lag=0; lag<=max_lag; ++lag){
+        // Average over available time origins and normalize to lag 0
+        for(int c=0;c<2;++c){
+            double v = (sums(0,c)>0) ? sums(lag,c)*n_frames/(n_frames-lag)/sums(0,c) : 0.0;
+            if(c==0) intermittent(lag) = v; else continuous(lag) = v;
+        }
+    }
+}
@@ -0,0 +1,226 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "pteros/core/index_set.h"
+#include "pteros/core/pteros_error.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+int popcount64(uint64_t w){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(w);
+#else
+    int n = 0;
+    for(; w; ++n) w &= w-1;
+    return n;
+#endif
+}
+
+// Index of the lowest set bit, w should not be zero
+int lowest_bit64(uint64_t w){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(w);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i,w);
+    return i;
+#else
+    int i = 0;
+    while(!(w & 1)){ w >>= 1; ++i; }
+    return i;
+#endif
+}
+
+}
+
+namespace pteros {
+
+void sort_unique_index(vector<int> &ind)
+{
+    // Indexes are usually generated in ascending order, so check it first
+    for(size_t i=1; i<ind.size(); ++i){
+        if(ind[i]<=ind[i-1]){
+            sort(ind.begin(),ind.end());
+            ind.erase(unique(ind.begin(),ind.end()), ind.end());
+            return;
+        }
+    }
+}
+
+void index_union(vector<int> &a, const vector<int> &b)
+{
+    // b may be the same vector as a
+    if(b.empty() || &a==&b) return;
+    if(a.empty()){
+        a = b;
+        return;
+    }
+    // Fast path for incremental building when b goes after a
+    if(b.front()>a.back()){
+        a.insert(a.end(),b.begin(),b.end());
+        return;
+    }
+    // Merge from the back into extended a, so no temporary is needed
+    ptrdiff_t i = a.size()-1, j = b.size()-1, k = a.size()+b.size()-1;
+    a.resize(a.size()+b.size());
+    while(j>=0){
+        if(i>=0 && a[i]>b[j])
+            a[k--] = a[i--];
+        else
+            a[k--] = b[j--];
+    }
+    a.erase(unique(a.begin(),a.end()), a.end());
+}
+
+// Both intersection and difference scan a and search its elements in b.
+// If b is much larger than a, binary search is used instead of linear scan.
+template<class F>
+static void filter_by_index(vector<int> &a, const vector<int> &b, F keep)
+{
+    bool bisect = b.size() > 8*a.size();
+    size_t k = 0;
+    auto it = b.begin();
+    for(size_t i=0; i<a.size(); ++i){
+        int x = a[i];
+        if(bisect)
+            it = lower_bound(it,b.end(),x);
+        else
+            while(it!=b.end() && *it<x) ++it;
+        if(keep(it!=b.end() && *it==x)) a[k++] = x;
+    }
+    a.resize(k);
+}
+
+void index_intersection(vector<int> &a, const vector<int> &b)
+{
+    if(a.empty() || &a==&b) return;
+    if(b.empty() || b.back()<a.front() || b.front()>a.back()){
+        a.clear();
+        return;
+    }
+    filter_by_index(a,b,[](bool found){ return found; });
+}
+
+void index_difference(vector<int> &a, const vector<int> &b)
+{
+    if(&a==&b){
+        a.clear();
+        return;
+    }
+    if(a.empty() || b.empty() || b.back()<a.front() || b.front()>a.back()) return;
+    filter_by_index(a,b,[](bool found){ return !found; });
+}
+
+//----------------------------------------------------------------
+
+Index_mask::Index_mask(int n, const vector<int> &ind): Index_mask(n)
+{
+    set(ind);
+}
+
+void Index_mask::set(const vector<int> &ind)
+{
+    for(int i: ind){
+        if(i<0 || i>=N) throw Pteros_error("Index {} is out of range 0:{} of the mask!",i,N-1);
+        set(i);
+    }
+}
+
+void Index_mask::clear()
+{
+    std::fill(bits.begin(),bits.end(),0);
+}
+
+int Index_mask::count() const
+{
+    int n = 0;
+    for(auto w: bits) n += popcount64(w);
+    return n;
+}
+
+void Index_mask::invert()
+{
+    for(auto& w: bits) w = ~w;
+    // Clear bits beyond the end
+    if(N%64) bits.back() &= (uint64_t(1)<<(N%64))-1;
+}
+
+Index_mask &Index_mask::operator|=(const Index_mask &other)
+{
+    check_size(other);
+    for(size_t i=0; i<bits.size(); ++i) bits[i] |= other.bits[i];
+    return *this;
+}
+
+Index_mask &Index_mask::operator&=(const Index_mask &other)
+{
+    check_size(other);
+    for(size_t i=0; i<bits.size(); ++i) bits[i] &= other.bits[i];
+    return *this;
+}
+
+Index_mask &Index_mask::operator-=(const Index_mask &other)
+{
+    check_size(other);
+    for(size_t i=0; i<bits.size(); ++i) bits[i] &= ~other.bits[i];
+    return *this;
+}
+
+void Index_mask::to_index(vector<int> &ind) const
+{
+    ind.clear();
+    ind.reserve(count());
+    for(size_t i=0; i<bits.size(); ++i){
+        uint64_t w = bits[i];
+        while(w){
+            ind.push_back(i*64 + lowest_bit64(w));
+            w &= w-1; // Clear lowest set bit
+        }
+    }
+}
+
+vector<int> Index_mask::to_index() const
+{
+    vector<int> ind;
+    to_index(ind);
+    return ind;
+}
+
+void Index_mask::check_size(const Index_mask &other) const
+{
+    if(other.N!=N) throw Pteros_error("Masks of different size ({} and {})!",N,other.N);
+}
+
+}
@@ -57,8 +57,6 @@ TRR_file::~TRR_file()
 
 
 bool TRR_file::do_read(System *sys, Frame *frame, const Mol_file_content &what){
-    bool has_x, has_v, has_f, ok;
-
     if(step<0){
         // Read header only once on first step
         int xsz,vsz,fsz;
@@ -67,19 +65,15 @@ bool TRR_file::do_read(System *sys, Frame *frame, const Mol_file_content &what){
         has_v = (vsz>0);
         has_f = (fsz>0);
         if(!has_x) throw Pteros_error("Pteros can't read TRR files without coordinates!");
+        LOG()->debug("TRR file has: x({}), v({}), f({})",has_x,has_v,has_f);
     }
 
-    if(step<0) LOG()->debug("TRR file has: x({}), v({}), f({})",has_x,has_v,has_f);
-
     rvec* x = nullptr;
     rvec* v = nullptr;
     rvec* f = nullptr;
-    if(has_x){
-        frame->coord.resize(natoms);
-        x = (rvec*)frame->coord.data();
-    } else {
-        throw Pteros_error("Pteros can't read TRR files without coordinates!");
-    }
+
+    frame->coord.resize(natoms);
+    x = (rvec*)frame->coord.data();
 
     if(has_v){
         frame->vel.resize(natoms);
@@ -91,11 +85,16 @@ bool TRR_file::do_read(System *sys, Frame *frame, const Mol_file_content &what){
     }
 
     float lambda;
-    ok = read_trr(handle,natoms,&step,&frame->time,&lambda,box,x,v,f);
+    int ret = read_trr(handle,natoms,&step,&frame->time,&lambda,box,x,v,f);
+    if(ret == exdrENDOFFILE) return false; // End of file
+    if(ret != exdrOK){
+        LOG()->warn("TRR frame {} is corrupted!",step);
+        return false;
+    }
 
     // Get box
-    if(ok) gmx_box_to_pteros(box,frame->box);
-    return ok;
+    gmx_box_to_pteros(box,frame->box);
+    return true;
 }
 
 void TRR_file::do_write(const Selection &sel, const Mol_file_content &what)
@@ -38,12 +38,12 @@ namespace pteros {
 
 class TRR_file: public Mol_file {
 public:
-    TRR_file(std::string& fname): Mol_file(fname), handle(nullptr) {}
+    TRR_file(std::string& fname): Mol_file(fname), handle(nullptr), has_x(false), has_v(false), has_f(false) {}
     virtual void open(char open_mode);
     virtual ~TRR_file();
 
     virtual Mol_file_content get_content_type() const {
-        return Mol_file_content().traj(true);
+        return Mol_file_content().traj(true).vel(true).force(true);
     }
 
 protected:
@@ -56,6 +56,8 @@ private:
     XDRFILE* handle;
     matrix box;
     int step;
+    // Content of frames, which is detected on the first step
+    bool has_x, has_v, has_f;
 };
 
 }
@@ -33,6 +33,11 @@
 
 std::shared_ptr<spdlog::logger> pteros::create_logger(const std::string &name)
 {
+    // Loggers with the same name are reused, since registering them twice is an error.
+    // This happens if trajectory is processed several times in the same program.
+    auto existing = spdlog::get(name);
+    if(existing) return existing;
+
     auto log = std::make_shared<spdlog::logger>(name, Log::instance().console_sink);
     log->set_pattern(Log::instance().generic_pattern);    
     log->set_level(Log::instance().default_level);
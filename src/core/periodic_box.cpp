@@ -32,6 +32,7 @@
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <type_traits>
 #include "pteros/core/periodic_box.h"
 #include "pteros/core/selection.h"
 #include "pteros/core/pteros_error.h"
@@ -103,7 +104,7 @@ void Periodic_box::scale_vectors(Vector3f_const_ref scale)
 {
     if(!_is_periodic) throw Pteros_error("No periodicity! Can't scale!");
     for(int i=0;i<3;i++) _box.col(i) *= scale(i);
-    _box_inv = _box.inverse();
+    recompute_internals();
 }
 
 Matrix3f Periodic_box::get_inv_matrix() const {
@@ -150,14 +151,28 @@ float Periodic_box::volume(){
 
 void Periodic_box::wrap_point(Vector3f_ref point, Array3i_const_ref pbc, Vector3f_const_ref origin) const
 {
-    point = _box_inv*(point-origin);
-    for(int i=0;i<3;++i){
-        if(pbc(i)!=0){
-            point(i) -= round(point(i));
-            if(point(i)<0) point(i) += 1.0;
+    if(!_is_periodic) return;
+
+    if((pbc!=0).all()){
+        if(_is_triclinic)
+            wrap_point_t<true>(point,origin);
+        else
+            wrap_point_t<false>(point,origin);
+        return;
+    }
+
+    // Partial periodicity
+    if(_is_triclinic){
+        Vector3f p = _box_inv*(point-origin);
+        for(int i=0;i<3;++i){
+            if(pbc(i)!=0) p(i) -= floor(p(i));
+        }
+        point = _box*p + origin;
+    } else {
+        for(int i=0;i<3;++i){
+            if(pbc(i)!=0) point(i) -= _diag(i)*floor((point(i)-origin(i))*_diag_inv(i));
         }
     }
-    point = _box*point + origin;
 }
 
 bool Periodic_box::in_box(Vector3f_const_ref point, Vector3f_const_ref origin) const
@@ -178,19 +193,92 @@ Eigen::Vector3f Periodic_box::closest_image(Vector3f_const_ref point, Vector3f_c
 
 Vector3f Periodic_box::shortest_vector(Vector3f_const_ref point1, Vector3f_const_ref point2, Array3i_const_ref pbc) const
 {
-    if(_is_periodic){
+    if(!_is_periodic) return point2-point1;
+
+    if((pbc!=0).all()){
+        return _is_triclinic ? shortest_vector_t<true>(point1,point2)
+                             : shortest_vector_t<false>(point1,point2);
+    }
+
+    // Partial periodicity
+    if(_is_triclinic){
         Vector3f d = _box_inv*(point2-point1);
         for(int i=0;i<3;++i){
-            if(pbc(i)!=0){
-                d(i) -= round(d(i));
-            }
+            if(pbc(i)!=0) d(i) -= round(d(i));
         }
         return _box*d;
     } else {
-        return point2-point1;
+        Vector3f d = point2-point1;
+        for(int i=0;i<3;++i){
+            if(pbc(i)!=0) d(i) -= _diag(i)*round(d(i)*_diag_inv(i));
+        }
+        return d;
+    }
+}
+
+namespace {
+
+// Calls f(triclinic,mask) with both arguments converted to compile-time constants
+template<bool Triclinic, class F>
+void dispatch_pbc_mask(int mask, F&& f){
+    using T = std::integral_constant<bool,Triclinic>;
+    switch(mask){
+    case 0: f(T(),std::integral_constant<int,0>()); break;
+    case 1: f(T(),std::integral_constant<int,1>()); break;
+    case 2: f(T(),std::integral_constant<int,2>()); break;
+    case 3: f(T(),std::integral_constant<int,3>()); break;
+    case 4: f(T(),std::integral_constant<int,4>()); break;
+    case 5: f(T(),std::integral_constant<int,5>()); break;
+    case 6: f(T(),std::integral_constant<int,6>()); break;
+    default: f(T(),std::integral_constant<int,7>()); break;
     }
 }
 
+template<class F>
+void dispatch_pbc(bool triclinic, Array3i_const_ref pbc, F&& f){
+    int mask = (pbc(0)!=0) | ((pbc(1)!=0)<<1) | ((pbc(2)!=0)<<2);
+    if(triclinic)
+        dispatch_pbc_mask<true>(mask,f);
+    else
+        dispatch_pbc_mask<false>(mask,f);
+}
+
+}
+
+void Periodic_box::wrap_points(std::vector<Vector3f> &coord, const std::vector<int> &ind,
+                               Array3i_const_ref pbc, Vector3f_const_ref origin) const
+{
+    if(!_is_periodic) return;
+    int n = ind.size();
+    dispatch_pbc(_is_triclinic, pbc, [&](auto tric, auto mask){
+        for(int i=0;i<n;++i)
+            this->template wrap_point_t<decltype(tric)::value,decltype(mask)::value>(coord[ind[i]],origin);
+    });
+}
+
+void Periodic_box::closest_images(std::vector<Vector3f> &coord, const std::vector<int> &ind,
+                                  Vector3f_const_ref target, Array3i_const_ref pbc) const
+{
+    if(!_is_periodic) return;
+    int n = ind.size();
+    dispatch_pbc(_is_triclinic, pbc, [&](auto tric, auto mask){
+        for(int i=0;i<n;++i)
+            coord[ind[i]] = target + this->template shortest_vector_t<decltype(tric)::value,decltype(mask)::value>(target,coord[ind[i]]);
+    });
+}
+
+void Periodic_box::closest_images_to(std::vector<Vector3f> &coord, const std::vector<int> &ind,
+                                     const Ref<const Matrix3Xf> &targets, Array3i_const_ref pbc) const
+{
+    if(targets.cols()!=ind.size()) throw Pteros_error("Number of targets ({}) does not match number of points ({})!",targets.cols(),ind.size());
+    if(!_is_periodic) return;
+    int n = ind.size();
+    dispatch_pbc(_is_triclinic, pbc, [&](auto tric, auto mask){
+        for(int i=0;i<n;++i)
+            coord[ind[i]] = targets.col(i) + this->template shortest_vector_t<decltype(tric)::value,decltype(mask)::value>(targets.col(i),coord[ind[i]]);
+    });
+}
+
 // The code below is hacked from Gromacs 3.3.x and modified heavily
 
 #define epbcSCREW 1111
@@ -391,6 +479,8 @@ void Periodic_box::recompute_internals()
     if(!_is_periodic) return;
     _box_inv = _box.inverse();
     _is_triclinic = (_box(0,1)||_box(0,2)||_box(1,0)||_box(1,2)||_box(2,0)||_box(2,1));
+    _diag = _box.diagonal();
+    _diag_inv = _diag.cwiseInverse();
 }
 
 
@@ -0,0 +1,355 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "pteros/core/profiling.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/logging.h"
+#include <fstream>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+using namespace pteros;
+
+namespace {
+
+string json_escape(const string& s){
+    string res;
+    for(char c: s){
+        if(c=='"' || c=='\\') res += '\\';
+        if(c=='\n'){ res += "\\n"; continue; }
+        res += c;
+    }
+    return res;
+}
+
+}
+
+struct Profiler::Thread_data {
+    struct Region {
+        const char* name;
+        long count;
+        double total;
+        double min;
+        double max;
+    };
+
+    struct Counter {
+        const char* name;
+        long value;
+    };
+
+    struct Event {
+        const char* name;
+        double start; // in microseconds since profiler epoch
+        double duration;
+    };
+
+    int id;
+    string name;
+    // Number of regions is small, so linear search by pointer is the fastest
+    vector<Region> regions;
+    vector<Counter> counters;
+    vector<Event> events;
+};
+
+Profiler &Profiler::instance()
+{
+    static Profiler *inst = new Profiler();
+    return *inst;
+}
+
+bool Profiler::is_compiled()
+{
+#ifdef PTEROS_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+Profiler::Profiler(): enabled(false), tracing(false), epoch(Clock::now()) {}
+
+void Profiler::enable(bool on, bool trace)
+{
+    tracing = on && trace;
+    enabled = on;
+}
+
+Profiler::Thread_data *Profiler::thread_data()
+{
+    static thread_local Thread_data* data = nullptr;
+    if(!data){
+        lock_guard<std::mutex> lock(mutex);
+        threads.emplace_back(new Thread_data);
+        data = threads.back().get();
+        data->id = threads.size()-1;
+        data->name = fmt::format("thread #{}",data->id);
+    }
+    return data;
+}
+
+void Profiler::set_thread_name(const string &name)
+{
+    thread_data()->name = name;
+}
+
+void Profiler::add(const char *region, Clock::time_point t0, Clock::time_point t1)
+{
+    auto d = thread_data();
+    double dt = chrono::duration<double>(t1-t0).count();
+
+    auto it = find_if(d->regions.begin(),d->regions.end(),[region](const Thread_data::Region& r){ return r.name==region; });
+    if(it==d->regions.end()){
+        d->regions.push_back({region,1,dt,dt,dt});
+    } else {
+        ++it->count;
+        it->total += dt;
+        if(dt<it->min) it->min = dt;
+        if(dt>it->max) it->max = dt;
+    }
+
+    if(tracing.load(std::memory_order_relaxed)){
+        d->events.push_back({region,
+                             chrono::duration<double,micro>(t0-epoch).count(),
+                             dt*1e6});
+    }
+}
+
+void Profiler::count(const char *counter, long n)
+{
+    auto d = thread_data();
+    auto it = find_if(d->counters.begin(),d->counters.end(),[counter](const Thread_data::Counter& c){ return c.name==counter; });
+    if(it==d->counters.end()){
+        d->counters.push_back({counter,n});
+    } else {
+        it->value += n;
+    }
+}
+
+void Profiler::reset()
+{
+    lock_guard<std::mutex> lock(mutex);
+    for(auto& d: threads){
+        d->regions.clear();
+        d->counters.clear();
+        d->events.clear();
+    }
+    epoch = Clock::now();
+}
+
+vector<Profile_entry> Profiler::get_entries() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    vector<Profile_entry> res;
+    for(auto& d: threads){
+        // Identical names from different translation units may have different addresses
+        map<string,Profile_entry> merged;
+        for(auto& r: d->regions){
+            auto it = merged.find(r.name);
+            if(it==merged.end()){
+                merged[r.name] = {d->name,r.name,r.count,r.total,r.min,r.max};
+            } else {
+                auto& e = it->second;
+                e.count += r.count;
+                e.total += r.total;
+                e.min = std::min(e.min,r.min);
+                e.max = std::max(e.max,r.max);
+            }
+        }
+        vector<Profile_entry> thread_res;
+        for(auto& m: merged) thread_res.push_back(m.second);
+        sort(thread_res.begin(),thread_res.end(),
+             [](const Profile_entry& a, const Profile_entry& b){ return a.total>b.total; });
+        res.insert(res.end(),thread_res.begin(),thread_res.end());
+    }
+    return res;
+}
+
+vector<Profile_counter> Profiler::get_counters() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    vector<Profile_counter> res;
+    for(auto& d: threads){
+        map<string,long> merged;
+        for(auto& c: d->counters) merged[c.name] += c.value;
+        for(auto& m: merged) res.push_back({d->name,m.first,m.second});
+    }
+    return res;
+}
+
+string Profiler::report(double wall_time) const
+{
+    auto entries = get_entries();
+    auto counters = get_counters();
+
+    if(entries.empty() && counters.empty()) return "No profiling data recorded\n";
+
+    string s;
+    if(!entries.empty()){
+        s += fmt::format("{:<14} {:<24} {:>9} {:>10} {:>10} {:>10} {:>10} {:>7}\n",
+                         "Thread","Region","Count","Total,s","Mean,ms","Min,ms","Max,ms","%wall");
+        for(auto& e: entries){
+            s += fmt::format("{:<14} {:<24} {:>9} {:>10.4f} {:>10.4f} {:>10.4f} {:>10.4f} ",
+                             e.thread, e.region, e.count, e.total,
+                             1e3*e.total/e.count, 1e3*e.min, 1e3*e.max);
+            s += wall_time>0 ? fmt::format("{:>7.1f}\n",100.0*e.total/wall_time) : fmt::format("{:>7}\n","-");
+        }
+    }
+
+    if(!counters.empty()){
+        s += fmt::format("{:<14} {:<24} {:>12}\n","Thread","Counter","Value");
+        for(auto& c: counters){
+            s += fmt::format("{:<14} {:<24} {:>12}\n",c.thread,c.name,c.value);
+        }
+    }
+
+    return s;
+}
+
+void Profiler::write_chrome_trace(const string &fname) const
+{
+    ofstream f(fname);
+    if(!f) throw Pteros_error("Can't open file '{}' for writing profiling trace!",fname);
+
+    lock_guard<std::mutex> lock(mutex);
+    f << "{\"traceEvents\":[\n";
+    bool first = true;
+    for(auto& d: threads){
+        if(d->regions.empty() && d->events.empty()) continue;
+        // Thread name metadata
+        f << (first ? "" : ",\n")
+          << fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                         d->id, json_escape(d->name));
+        first = false;
+        for(auto& e: d->events){
+            f << fmt::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                             json_escape(e.name), d->id, e.start, e.duration);
+        }
+    }
+    f << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+Selection_profile *Selection_profiler::get_entry(const string &text)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto& e = entries[text];
+    e.text = text;
+    return &e;
+}
+
+void Selection_profiler::add_parse(Selection_profile *entry, double time, bool coord_dependent)
+{
+    lock_guard<std::mutex> lock(mutex);
+    ++entry->n_parsed;
+    entry->parse_time += time;
+    entry->coord_dependent = coord_dependent;
+}
+
+void Selection_profiler::add_eval(Selection_profile *entry, double time, int size, bool reevaluation,
+                                  const map<string, Selection_node_profile> &nodes)
+{
+    lock_guard<std::mutex> lock(mutex);
+    ++entry->n_evaluated;
+    if(reevaluation) ++entry->n_reevaluated;
+    entry->eval_time += time;
+    entry->total_size += size;
+    entry->last_size = size;
+    for(auto& it: nodes){
+        auto& n = entry->nodes[it.first];
+        n.count += it.second.count;
+        n.time += it.second.time;
+        n.self_time += it.second.self_time;
+    }
+}
+
+void Selection_profiler::reset()
+{
+    lock_guard<std::mutex> lock(mutex);
+    // Entries are not erased since parsers keep pointers to them
+    for(auto& it: entries){
+        it.second = Selection_profile();
+        it.second.text = it.first;
+    }
+}
+
+vector<Selection_profile> Selection_profiler::get_entries() const
+{
+    vector<Selection_profile> res;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for(auto& it: entries){
+            if(it.second.n_parsed || it.second.n_evaluated) res.push_back(it.second);
+        }
+    }
+    sort(res.begin(),res.end(),[](const Selection_profile& a, const Selection_profile& b){
+        return a.parse_time+a.eval_time > b.parse_time+b.eval_time;
+    });
+    return res;
+}
+
+string Selection_profiler::report(int max_entries) const
+{
+    auto sel = get_entries();
+    if(sel.empty()) return "No selections profiled\n";
+
+    string s;
+    s += fmt::format("{:>8} {:>10} {:>8} {:>8} {:>10} {:>10} {:>5}  {}\n",
+                     "Parsed","Parse,ms","Evals","Re-evals","Eval,ms","Mean size","Coord","Selection");
+    map<string,Selection_node_profile> nodes;
+    for(int i=0; i<sel.size(); ++i){
+        auto& e = sel[i];
+        if(max_entries<0 || i<max_entries){
+            s += fmt::format("{:>8} {:>10.3f} {:>8} {:>8} {:>10.3f} {:>10.1f} {:>5}  {}\n",
+                             e.n_parsed, 1e3*e.parse_time, e.n_evaluated, e.n_reevaluated,
+                             1e3*e.eval_time, e.n_evaluated ? double(e.total_size)/e.n_evaluated : 0.0,
+                             e.coord_dependent ? "yes" : "no", e.text);
+        }
+        for(auto& it: e.nodes){
+            auto& n = nodes[it.first];
+            n.count += it.second.count;
+            n.time += it.second.time;
+            n.self_time += it.second.self_time;
+        }
+    }
+    if(max_entries>=0 && sel.size()>max_entries)
+        s += fmt::format("... {} more selections\n", sel.size()-max_entries);
+
+    vector<pair<string,Selection_node_profile>> sorted_nodes(nodes.begin(),nodes.end());
+    sort(sorted_nodes.begin(),sorted_nodes.end(),[](const pair<string,Selection_node_profile>& a,
+                                                    const pair<string,Selection_node_profile>& b){
+        return a.second.self_time > b.second.self_time;
+    });
+    s += fmt::format("{:<20} {:>10} {:>12} {:>12}\n","AST node","Count","Self,ms","Total,ms");
+    for(auto& n: sorted_nodes){
+        s += fmt::format("{:<20} {:>10} {:>12.3f} {:>12.3f}\n",
+                         n.first, n.second.count, 1e3*n.second.self_time, 1e3*n.second.time);
+    }
+    return s;
+}
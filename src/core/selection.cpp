@@ -32,6 +32,7 @@
 #include <algorithm>
 #include <set>
 #include <map>
+#include <climits>
 #include <boost/algorithm/string.hpp> // String algorithms
 #include "pteros/core/atom.h"
 #include "pteros/core/selection.h"
@@ -41,6 +42,8 @@
 #include "selection_parser.h"
 #include "pteros/core/mol_file.h"
 #include "pteros/core/utilities.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/unwrap_plan.h"
 
 #ifdef USE_POWERSASA
 #include "power_sasa.h"
@@ -62,6 +65,17 @@ using namespace std;
 using namespace pteros;
 using namespace Eigen;
 
+namespace {
+
+// Weighted sum of vectors and sum of weights for parallel reductions
+using Weighted_sum = std::pair<Vector3f,float>;
+
+Weighted_sum add_weighted_sums(const Weighted_sum& a, const Weighted_sum& b){
+    return {a.first+b.first, a.second+b.second};
+}
+
+}
+
 
 void Selection::allocate_parser(){
     // Parse selection here
@@ -78,9 +92,7 @@ void Selection::allocate_parser(){
 void Selection::sort_and_remove_duplicates()
 {
     if(_index.size()){
-        sort(_index.begin(),_index.end());
-        vector<int>::iterator it = unique(_index.begin(), _index.end());
-        _index.resize( it - _index.begin() );
+        sort_unique_index(_index);
         if(_index[0]<0) throw Pteros_error("Negative index {} present in Selection!",_index[0]);
     } else {
         LOG()->debug("Selection '{}' is empty! Any call of its methods (except size()) will crash your program!", sel_text);
@@ -211,9 +223,8 @@ void Selection::append(const Selection &sel){
     if(!sel.system) throw Pteros_error("Can't append selection with undefined system!");
     if(sel.system!=system) throw Pteros_error("Can't append atoms from other system!");
 
-    copy(sel._index.begin(),sel._index.end(),back_inserter(_index));
-
-    sort_and_remove_duplicates();
+    // Both indexes are sorted, so merge them
+    index_union(_index,sel._index);
 
     sel_text = "";
     parser.reset();
@@ -223,30 +234,57 @@ void Selection::append(int ind){
     if(!system) throw Pteros_error("Can't append to selection with undefined system!");
     if(ind<0 || ind>=system->num_atoms()) throw Pteros_error("Appended index is out of range!");
 
-    if(find(_index.begin(),_index.end(),ind)==_index.end()){
+    // Appending in ascending order is the most common case
+    if(_index.empty() || ind>_index.back()){
         _index.push_back(ind);
-        sort(_index.begin(),_index.end());
+    } else {
+        auto it = lower_bound(_index.begin(),_index.end(),ind);
+        if(*it!=ind) _index.insert(it,ind);
     }
 
     sel_text = "";
     parser.reset();
 }
 
+void Selection::append(const std::vector<int> &ind)
+{
+    if(!system) throw Pteros_error("Can't append to selection with undefined system!");
+    if(ind.empty()) return;
+
+    vector<int> tmp(ind);
+    sort_unique_index(tmp);
+    if(tmp.front()<0 || tmp.back()>=system->num_atoms())
+        throw Pteros_error("Appended indexes are out of range!");
+
+    index_union(_index,tmp);
+
+    sel_text = "";
+    parser.reset();
+}
+
+void Selection::append(const Index_mask &mask)
+{
+    if(!system) throw Pteros_error("Can't append to selection with undefined system!");
+    if(mask.size()!=system->num_atoms())
+        throw Pteros_error("Mask size {} is not equal to the number of atoms {}!",mask.size(),system->num_atoms());
+
+    index_union(_index,mask.to_index());
+
+    sel_text = "";
+    parser.reset();
+}
+
 void Selection::remove(const Selection &sel)
 {
-    vector<int> tmp;
-    set_difference(_index.begin(),_index.end(),
-                   sel.index_begin(),sel.index_end(),back_inserter(tmp));
-    _index = tmp;
+    index_difference(_index,sel._index);
     sel_text = "";
     parser.reset();
 }
 
 void Selection::remove(int ind)
 {
-    vector<int> tmp;
-    remove_copy(_index.begin(),_index.end(),back_inserter(tmp),ind);
-    _index = tmp;
+    auto it = lower_bound(_index.begin(),_index.end(),ind);
+    if(it!=_index.end() && *it==ind) _index.erase(it);
     sel_text = "";
     parser.reset();
 }
@@ -417,6 +455,18 @@ void Selection::modify(std::vector<int>::iterator it1, std::vector<int>::iterato
     sort_and_remove_duplicates();
 }
 
+void Selection::modify(const Index_mask &mask){
+    if(system==nullptr) throw Pteros_error("Selection does not belong to any system!");
+    if(mask.size()!=system->num_atoms())
+        throw Pteros_error("Mask size {} is not equal to the number of atoms {}!",mask.size(),system->num_atoms());
+    // no parser needed
+    parser.reset();
+    // not textual
+    sel_text = "";
+    // Mask gives sorted index directly
+    mask.to_index(_index);
+}
+
 void Selection::modify(const std::function<void (const System &, int, std::vector<int> &)>& callback, int fr)
 {
     if(system==nullptr) throw Pteros_error("Selection does not belong to any system!");
@@ -524,6 +574,30 @@ Selection Selection::operator~() const {
     return res;
 }
 
+Selection &Selection::operator|=(const Selection &sel)
+{
+    if(frame!=sel.frame) throw Pteros_error("Can't take logical OR of selections pointing to different frames!");
+    append(sel);
+    return *this;
+}
+
+Selection &Selection::operator&=(const Selection &sel)
+{
+    if(system!=sel.system) throw Pteros_error("Can't take logical AND of selections belonging to different systems!");
+    if(frame!=sel.frame) throw Pteros_error("Can't take logical AND of selections pointing to different frames!");
+    index_intersection(_index,sel._index);
+    sel_text = "";
+    parser.reset();
+    return *this;
+}
+
+Selection &Selection::operator-=(const Selection &sel)
+{
+    if(system!=sel.system) throw Pteros_error("Can't remove atoms of selection belonging to different system!");
+    remove(sel);
+    return *this;
+}
+
 namespace pteros {
 
 Selection operator|(const Selection &sel1, const Selection &sel2){
@@ -538,6 +612,7 @@ Selection operator|(const Selection &sel1, const Selection &sel2){
     // Set frame
     res.frame = sel1.frame;
     // Combine indexes
+    res._index.reserve(sel1.size()+sel2.size());
     std::set_union(sel1._index.begin(),sel1._index.end(),
                    sel2._index.begin(),sel2._index.end(),
                    back_inserter(res._index));
@@ -556,6 +631,7 @@ Selection operator&(const Selection &sel1, const Selection &sel2){
     // Set frame
     res.frame = sel1.frame;
     // Combine indexes
+    res._index.reserve(std::min(sel1.size(),sel2.size()));
     std::set_intersection(sel1._index.begin(),sel1._index.end(),
                           sel2._index.begin(),sel2._index.end(),
                           back_inserter(res._index));
@@ -577,6 +653,7 @@ Selection operator-(const Selection &sel1, const Selection &sel2)
     res.sel_text = "";
     res.parser.reset();
     res.frame = sel1.frame;
+    res._index.reserve(sel1.size());
     std::set_difference(sel1._index.begin(),sel1._index.end(),
                         sel2._index.begin(),sel2._index.end(),
                         back_inserter(res._index));
@@ -641,6 +718,21 @@ void Selection::apply(){
     }
 }
 
+void Selection::evaluate(int fr, std::vector<int> &result) const
+{
+    if(fr<0 || fr >= system->num_frames())
+        throw Pteros_error("Invalid frame {} to evaluate! Valid range is 0:{}", fr, system->num_frames());
+
+    if(parser){
+        // Evaluate private copy of the parser, which shares immutable AST with the original.
+        // Parser state, which changes during evaluation, is local to this thread.
+        Selection_parser p(*parser);
+        p.apply_ast(fr, result);
+    } else {
+        result = _index;
+    }
+}
+
 void Selection::set_frame(int fr){
     if(fr<0 || fr >= system->num_frames())
         throw Pteros_error("Invalid frame {} to set! Valid range is 0:", fr, system->num_frames());
@@ -672,7 +764,7 @@ vector<T> Selection::get_##prop() const { \
     int i,n; \
     n = _index.size(); \
     tmp.resize(n); \
-    for(i=0; i<n; ++i) tmp[i] = system->atoms[_index[i]].prop; \
+    for(i=0; i<n; ++i) tmp[i] = system->atoms.get()[_index[i]].prop; \
     return tmp; \
 } \
 
@@ -683,7 +775,7 @@ vector<T> Selection::get_##prop(bool unique) const { \
     int i,n; \
     n = _index.size(); \
     tmp.resize(n); \
-    for(i=0; i<n; ++i) tmp[i] = system->atoms[_index[i]].prop; \
+    for(i=0; i<n; ++i) tmp[i] = system->atoms.get()[_index[i]].prop; \
     if(unique){ \
         vector<T> res; \
         unique_copy(tmp.begin(),tmp.end(), back_inserter(res)); \
@@ -839,7 +931,7 @@ void Selection::set_force(pteros::MatrixXf_const_ref data){
 
 float Selection::get_total_charge() const {
     float q = 0.0;
-    for(int i=0; i<size(); ++i) q += system->atoms[_index[i]].charge;
+    for(int i=0; i<size(); ++i) q += system->atoms.get()[_index[i]].charge;
     return q;
 }
 
@@ -895,91 +987,58 @@ Vector3f Selection::center(bool mass_weighted, Array3i_const_ref pbc, int pbc_at
     // in case of just one atom nothing to compute
     if(n==1) return xyz(0);
 
-    Vector3f res;
-    int i;
-
     process_pbc_atom(pbc_atom);
 
-    res.fill(0.0);
-
     if( (pbc==0).all() ){
         // Non-periodic variant
         if(mass_weighted){
-            float M = 0.0;
-            #pragma omp parallel
-            {                
-                Vector3f r(Vector3f::Zero());
-                #pragma omp for nowait reduction(+:M)
-                for(i=0; i<n; ++i){
-                    r += xyz(i)*mass(i);
-                    M += mass(i);
-                }
-                #pragma omp critical
-                {
-                    res += r;
-                }
-            }
-            if(M==0) throw Pteros_error("Selection has zero mass! Center of mass failed!");
-            return res/M;
+            auto s = parallel_reduce(0,n,Weighted_sum(Vector3f::Zero(),0.0f),
+                [this](int b, int e, Weighted_sum& acc){
+                    for(int i=b; i<e; ++i){
+                        acc.first += xyz(i)*mass(i);
+                        acc.second += mass(i);
+                    }
+                }, add_weighted_sums);
+            if(s.second==0) throw Pteros_error("Selection has zero mass! Center of mass failed!");
+            return s.first/s.second;
         } else {
-            #pragma omp parallel
-            {
-                Vector3f r(Vector3f::Zero()); // local to omp thread
-                #pragma omp for nowait
-                for(i=0; i<n; ++i) r += xyz(i);
-                #pragma omp critical
-                {
-                    res += r;
-                }
-            }
-
-            return res/n;
+            Vector3f r = parallel_reduce(0,n,Vector3f(Vector3f::Zero()),
+                [this](int b, int e, Vector3f& acc){
+                    for(int i=b; i<e; ++i) acc += xyz(i);
+                }, std::plus<Vector3f>());
+            return r/n;
         }
     } else {
         // Periodic center
         // We will find closest periodic images of all points
         // using leading point as a reference
         Vector3f ref_point = xyz(pbc_atom);
-        Periodic_box& b = system->box(frame);
+        Periodic_box& box = system->box(frame);
         if(mass_weighted){
-            float M = 0.0;
-            #pragma omp parallel
-            {                
-                Vector3f r(Vector3f::Zero());
-                #pragma omp for nowait reduction(+:M)
-                for(i=0; i<n; ++i){
-                    r += b.closest_image(xyz(i),ref_point,pbc) * mass(i);
-                    M += mass(i);
-                }
-                #pragma omp critical
-                {
-                    res += r;                    
-                }
-            }
-            if(M==0) throw Pteros_error("Selection has zero mass! Center of mass failed!");
-            return res/M;
+            auto s = parallel_reduce(0,n,Weighted_sum(Vector3f::Zero(),0.0f),
+                [&,this](int b, int e, Weighted_sum& acc){
+                    for(int i=b; i<e; ++i){
+                        acc.first += box.closest_image(xyz(i),ref_point,pbc) * mass(i);
+                        acc.second += mass(i);
+                    }
+                }, add_weighted_sums);
+            if(s.second==0) throw Pteros_error("Selection has zero mass! Center of mass failed!");
+            return s.first/s.second;
         } else {
-            #pragma omp parallel
-            {
-                Vector3f r(Vector3f::Zero()); // local to omp thread
-                #pragma omp for nowait
-                for(i=0; i<n; ++i)
-                    r += b.closest_image(xyz(i),ref_point,pbc);
-                #pragma omp critical
-                {
-                    res += r;
-                }
-            }
-            return res/n;
+            Vector3f r = parallel_reduce(0,n,Vector3f(Vector3f::Zero()),
+                [&,this](int b, int e, Vector3f& acc){
+                    for(int i=b; i<e; ++i) acc += box.closest_image(xyz(i),ref_point,pbc);
+                }, std::plus<Vector3f>());
+            return r/n;
         }
     }
 }
 
 // Plain translation
 void Selection::translate(Vector3f_const_ref v){
-    int i,n = _index.size();
-    #pragma omp parallel for
-    for(i=0; i<n; ++i) xyz(i) += v;
+    parallel_for(0,size(),[&,this](int b, int e){
+        for(int i=b; i<e; ++i) xyz(i) += v;
+    });
 }
 
 void Selection::translate_to(Vector3f_const_ref p, bool mass_weighted, Array3i_const_ref pbc, int pbc_atom){
@@ -1006,9 +1065,9 @@ float Selection::rmsd(int fr1, int fr2) const{
        fr2<0 || fr2>=system->num_frames())
         throw Pteros_error("RMSD requested for frames {}:{} while the valid range is 0:{}", fr1,fr2,system->num_frames()-1);
 
-    #pragma omp parallel for reduction(+:res)
-    for(int i=0; i<n; ++i)
-        res += (xyz(i,fr1)-xyz(i,fr2)).squaredNorm();
+    res = parallel_reduce(0,n,0.0f,[&,this](int b, int e, float& acc){
+        for(int i=b; i<e; ++i) acc += (xyz(i,fr1)-xyz(i,fr2)).squaredNorm();
+    }, std::plus<float>());
 
     return sqrt(res/n);
 }
@@ -1023,11 +1082,9 @@ float Selection::rmsd(int fr) const {
 
 // Apply transformation
 void Selection::apply_transform(const Affine3f &t){
-    int n = size();    
-    #pragma omp parallel for
-    for(int i=0; i<n; ++i){        
-        xyz(i) = t * xyz(i);
-    }
+    parallel_for(0,size(),[&,this](int b, int e){
+        for(int i=b; i<e; ++i) xyz(i) = t * xyz(i);
+    });
 }
 
 namespace pteros {
@@ -1067,7 +1124,8 @@ Vector2f non_bond_energy(const Selection& sel1,
 
     float d;
     if(cutoff==0){
-        d = sel1.get_system()->get_force_field().get_cutoff();
+        const System& sys = *sel1.get_system();
+        d = sys.get_force_field().get_cutoff();
     } else {
         d = cutoff;
     }
@@ -1098,9 +1156,9 @@ float rmsd(const Selection& sel1, int fr1, const Selection& sel2, int fr2){
                           fr1,fr2,sel1.system->num_frames()-1,sel2.system->num_frames()-1);
 
 
-    #pragma omp parallel for reduction(+:res)
-    for(int i=0; i<n1; ++i)
-        res += (sel1.xyz(i,fr1)-sel2.xyz(i,fr2)).squaredNorm();
+    res = parallel_reduce(0,n1,0.0f,[&](int b, int e, float& acc){
+        for(int i=b; i<e; ++i) acc += (sel1.xyz(i,fr1)-sel2.xyz(i,fr2)).squaredNorm();
+    }, std::plus<float>());
 
     return sqrt(res/n1);
 }
@@ -1141,18 +1199,10 @@ Affine3f fit_transform(const Selection& sel1, const Selection& sel2){
     N = sel1.size();
 
     //Calculate the matrix U
-    u.fill(0.0);
-    #pragma omp parallel
-    {
-        Matrix3f _u(Matrix3f::Zero());
-        #pragma omp for nowait
-        for(i=0;i<N;++i) // Over atoms in selection
-            _u += sel1.xyz(i)*sel2.xyz(i).transpose()*sel1.mass(i);
-        #pragma omp critical
-        {
-            u += _u;
-        }
-    }
+    u = parallel_reduce(0,N,Matrix3f(Matrix3f::Zero()),[&](int b, int e, Matrix3f& acc){
+        for(int i=b; i<e; ++i) // Over atoms in selection
+            acc += sel1.xyz(i)*sel2.xyz(i).transpose()*sel1.mass(i);
+    }, std::plus<Matrix3f>());
 
     //Construct omega
     for(r=0; r<6; r++){
@@ -1216,7 +1266,7 @@ Vector2f Selection::non_bond_energy(float cutoff, bool pbc) const
 {
     float d;
     if(cutoff==0){
-        d = system->get_force_field().get_cutoff();
+        d = system->force_field->get_cutoff();
     } else {
         d = cutoff;
     }
@@ -1278,33 +1328,20 @@ void Selection::fit(int fr1, int fr2){
 }
 
 void Selection::minmax(Vector3f_ref min, Vector3f_ref max) const {
-    int i,n,j;
-    Vector3f* p;
-    n = _index.size();
+    using Bounds = std::pair<Vector3f,Vector3f>;
+    Bounds init(Vector3f::Constant(1e10),Vector3f::Constant(-1e10));
 
-    float x_min, y_min, z_min, x_max, y_max, z_max;
-    x_min = y_min = z_min = 1e10;
-    x_max = y_max = z_max = -1e10;
-
-    #pragma omp parallel for reduction(min:x_min,y_min,z_min) reduction(max:x_max,y_max,z_max)
-    for(i=0; i<n; ++i){
-        p = xyz_ptr(i);
-        if((*p)(0)<x_min) x_min = (*p)(0);
-        if((*p)(0)>x_max) x_max = (*p)(0);
-        if((*p)(1)<y_min) y_min = (*p)(1);
-        if((*p)(1)>y_max) y_max = (*p)(1);
-        if((*p)(2)<z_min) z_min = (*p)(2);
-        if((*p)(2)>z_max) z_max = (*p)(2);
-    }
-
-    min(0) = x_min;
-    min(1) = y_min;
-    min(2) = z_min;
-
-    max(0) = x_max;
-    max(1) = y_max;
-    max(2) = z_max;
+    auto res = parallel_reduce(0,size(),init,[this](int b, int e, Bounds& acc){
+        for(int i=b; i<e; ++i){
+            acc.first = acc.first.cwiseMin(xyz(i));
+            acc.second = acc.second.cwiseMax(xyz(i));
+        }
+    }, [](const Bounds& a, const Bounds& b){
+        return Bounds(a.first.cwiseMin(b.first), a.second.cwiseMax(b.second));
+    });
 
+    min = res.first;
+    max = res.second;
 }
 
 //###############################################
@@ -1433,27 +1470,36 @@ std::vector<std::vector<int>> Selection::get_internal_bonds(float d, bool period
 void Selection::each_residue(std::vector<Selection>& sel) const {            
     sel.clear();
 
-    // Resindexes are contigous, so for each atom we search forward and backward to find
-    // all atoms of enclosing residue.
-
-    // Set of residues, which are already searched
-    set<int> used;
+    // Since our index is sorted, all atoms up to the end of found residue are skipped
+    const auto& atoms = system->atoms.get();
+    int i = 0;
+
+    // Take residue ranges directly if residues are contiguous
+    auto ranges = system->get_topology_ranges();
+    if(ranges->contiguous){
+        while(i<size()){
+            const auto& r = ranges->residues[atoms[_index[i]].resindex];
+            sel.emplace_back(*system,r(0),r(1));
+            while(i<size() && _index[i]<=r(1)) ++i;
+        }
+        return;
+    }
 
+    // Otherwise for each atom we search forward and backward to find
+    // all atoms of enclosing residue.
     int b,e; // Begin and end of current residue
     int ind;
-    for(int i=0; i<size(); ++i){
-        // Skip used
-        ind = resindex(i);
-        if(used.count(ind)) continue;
+    while(i<size()){
+        ind = atoms[_index[i]].resindex;
         // Starting global index
         b = e = index(i);
         // Go backward
-        while( b-1>=0 && system->atoms[b-1].resindex == ind){ --b; };
+        while( b-1>=0 && atoms[b-1].resindex == ind){ --b; };
         // Go forward
-        while( e+1<system->atoms.size() && system->atoms[e+1].resindex == ind){ ++e; };
+        while( e+1<atoms.size() && atoms[e+1].resindex == ind){ ++e; };
         sel.emplace_back(*system,b,e);
-        // Mark as used
-        used.insert(ind);
+        // Skip atoms of this residue
+        while(i<size() && _index[i]<=e) ++i;
     }
 }
 
@@ -1598,10 +1644,33 @@ void Selection::split_by_residue(std::vector<Selection> &res)
 {
     // We split selection into several by resindex
     res.clear();
+    const auto& atoms = system->atoms.get();
+
+    // Resindexes normally grow with atom index. In this case residues are
+    // contiguous pieces of our sorted index and could be taken directly.
+    bool ordered = true;
+    for(int i=1; i<size(); ++i){
+        if(atoms[_index[i]].resindex < atoms[_index[i-1]].resindex){
+            ordered = false;
+            break;
+        }
+    }
+
+    if(ordered){
+        int b = 0;
+        for(int i=1; i<=size(); ++i){
+            if(i==size() || atoms[_index[i]].resindex != atoms[_index[b]].resindex){
+                res.emplace_back(*system, _index.begin()+b, _index.begin()+i);
+                b = i;
+            }
+        }
+        return;
+    }
+
     // Map of resindexes to indexs in selections
     map<int,vector<int> > m;
     for(int i=0; i<size(); ++i){
-        m[resindex(i)].push_back(index(i));
+        m[atoms[_index[i]].resindex].push_back(index(i));
     }
     // Create selections
     map<int,vector<int> >::iterator it;
@@ -1612,24 +1681,23 @@ void Selection::split_by_residue(std::vector<Selection> &res)
 
 void Selection::split_by_molecule(std::vector<Selection> &res)
 {
-    if(!system->force_field.ready) throw Pteros_error("Can't split by molecule: no topology!");
+    if(!system->force_field->ready) throw Pteros_error("Can't split by molecule: no topology!");
 
-    map<int,vector<int>> m;
-    int bmol = 0;
-    for(int i=0;i<size();++i){
-        // Find molecule for this atom
-        for(int j=bmol; j<system->force_field.molecules.size(); ++j){
-            if(_index[i]>=system->force_field.molecules[j](0) && _index[i]<=system->force_field.molecules[j](1)){
-                bmol=j;
-                m[j].push_back(_index[i]);
-            }
+    // Molecules are contiguous and our index is sorted, so atoms
+    // of each molecule form contiguous pieces of the index
+    auto ranges = system->get_topology_ranges();
+    const auto& atom_mol = ranges->atom_molecule;
+    int i = 0;
+    while(i<size()){
+        int m = atom_mol[_index[i]];
+        if(m<0){
+            // Atom is not in any molecule
+            ++i;
+            continue;
         }
-    }
-
-    // Create selections
-    map<int,vector<int> >::iterator it;
-    for(it=m.begin();it!=m.end();it++){
-        res.emplace_back(*system, it->second.begin(), it->second.end());
+        int b = i;
+        while(i<size() && atom_mol[_index[i]]==m) ++i;
+        res.emplace_back(*system, _index.begin()+b, _index.begin()+i);
     }
 }
 
@@ -1637,15 +1705,16 @@ void Selection::split_by_chain(std::vector<Selection> &chains)
 {
     // We split selection into several by chain
     chains.clear();
-    // Map of resindexes to indexs in selections
-    map<char,vector<int> > m;
+    // Indexes for each possible chain character
+    vector<vector<int>> m(256);
+    const auto& atoms = system->atoms.get();
     for(int i=0; i<size(); ++i){
-        m[chain(i)].push_back(index(i));
+        m[(unsigned char)atoms[_index[i]].chain].push_back(index(i));
     }
-    // Create selections
-    map<char,vector<int> >::iterator it;
-    for(it=m.begin();it!=m.end();it++){
-        chains.emplace_back(*system, it->second.begin(), it->second.end());
+    // Create selections ordered by chain
+    for(int c=CHAR_MIN; c<=CHAR_MAX; ++c){
+        auto& ind = m[(unsigned char)c];
+        if(ind.size()) chains.emplace_back(*system, ind.begin(), ind.end());
     }
 }
 
@@ -1666,10 +1735,11 @@ void Selection::split_by_contiguous_index(std::vector<Selection> &parts)
 void Selection::split_by_contiguous_residue(std::vector<Selection> &parts)
 {
     parts.clear();
+    const Selection& s = *this;
     // Start first contiguous part
     int b = 0, i = 0;
     while(i<size()){
-        while(i+1<size() && (resindex(i+1)==resindex(i)+1 || resindex(i+1)==resindex(i)) ) ++i;
+        while(i+1<size() && (s.resindex(i+1)==s.resindex(i)+1 || s.resindex(i+1)==s.resindex(i)) ) ++i;
         // Part finished
         parts.emplace_back(*system,_index[b],_index[i]);
         b = i+1;
@@ -1679,55 +1749,47 @@ void Selection::split_by_contiguous_residue(std::vector<Selection> &parts)
 
 void Selection::inertia(Vector3f_ref moments, Matrix3f_ref axes, Array3i_const_ref pbc, int pbc_atom) const{
     int n = size();
-    int i;
     // Compute the central tensor of inertia. Place it into axes
 
     process_pbc_atom(pbc_atom);
 
-    float axes00=0.0, axes11=0.0, axes22=0.0, axes01=0.0, axes02=0.0, axes12=0.0;
-
     Vector3f c = center(true,pbc,pbc_atom);
 
+    // Diagonal and off-diagonal elements of inertia tensor
+    using Tensor_sum = std::pair<Vector3f,Vector3f>;
+    Tensor_sum init(Vector3f::Zero(),Vector3f::Zero());
+
+    auto add_point = [](Tensor_sum& acc, const Vector3f& d, float m){
+        acc.first(0) += m*( d(1)*d(1) + d(2)*d(2) );
+        acc.first(1) += m*( d(0)*d(0) + d(2)*d(2) );
+        acc.first(2) += m*( d(0)*d(0) + d(1)*d(1) );
+        acc.second(0) += m*d(0)*d(1);
+        acc.second(1) += m*d(0)*d(2);
+        acc.second(2) += m*d(1)*d(2);
+    };
+
+    auto add_sums = [](const Tensor_sum& a, const Tensor_sum& b){
+        return Tensor_sum(a.first+b.first, a.second+b.second);
+    };
+
+    Tensor_sum t;
     if( (pbc!=0).any() ){
         Vector3f anchor = xyz(pbc_atom);
-        Periodic_box& b = system->box(frame);
-        #pragma omp parallel
-        {
-            Vector3f p,d;
-            float m;            
-            #pragma omp for reduction(+:axes00,axes11,axes22,axes01,axes02,axes12)
-            for(i=0;i<n;++i){
+        Periodic_box& box = system->box(frame);
+        t = parallel_reduce(0,n,init,[&,this](int b, int e, Tensor_sum& acc){
+            for(int i=b; i<e; ++i){
                 // 0 point was used as an anchor in periodic center calculation,
                 // so we have to use it as an anchor here as well!
-                p = b.closest_image(xyz(i),anchor,pbc);
-                d = p-c;
-                m = mass(i);
-                axes00 += m*( d(1)*d(1) + d(2)*d(2) );
-                axes11 += m*( d(0)*d(0) + d(2)*d(2) );
-                axes22 += m*( d(0)*d(0) + d(1)*d(1) );
-                axes01 += m*d(0)*d(1);
-                axes02 += m*d(0)*d(2);
-                axes12 += m*d(1)*d(2);
+                add_point(acc, box.closest_image(xyz(i),anchor,pbc)-c, mass(i));
             }
-        }
+        }, add_sums);
     } else {
-        #pragma omp parallel
-        {
-            Vector3f d;
-            float m;
-            #pragma omp for reduction(+:axes00,axes11,axes22,axes01,axes02,axes12)
-            for(i=0;i<n;++i){
-                d = xyz(i)-c;
-                m = mass(i);
-                axes00 += m*( d(1)*d(1) + d(2)*d(2) );
-                axes11 += m*( d(0)*d(0) + d(2)*d(2) );
-                axes22 += m*( d(0)*d(0) + d(1)*d(1) );
-                axes01 += m*d(0)*d(1);
-                axes02 += m*d(0)*d(2);
-                axes12 += m*d(1)*d(2);
-            }
-        }
+        t = parallel_reduce(0,n,init,[&,this](int b, int e, Tensor_sum& acc){
+            for(int i=b; i<e; ++i) add_point(acc, xyz(i)-c, mass(i));
+        }, add_sums);
     }
+    float axes00 = t.first(0), axes11 = t.first(1), axes22 = t.first(2);
+    float axes01 = t.second(0), axes02 = t.second(1), axes12 = t.second(2);
     axes(0,0) = axes00;
     axes(1,1) = axes11;
     axes(2,2) = axes22;
@@ -1745,22 +1807,23 @@ void Selection::inertia(Vector3f_ref moments, Matrix3f_ref axes, Array3i_const_r
 float Selection::gyration(Array3i_const_ref pbc, int pbc_atom) const {
     process_pbc_atom(pbc_atom);
 
-    int n = size();
-    int i;
-    float d, a = 0.0, b = 0.0;
     Vector3f c = center(true,pbc,pbc_atom);
-
-    #pragma omp parallel for private(d) reduction(+:a,b)
-    for(i=0;i<n;++i){
-        if( (pbc!=0).any() ){
-            d = system->box(frame).distance(xyz(i),c,pbc);
-        } else {
-            d = (xyz(i)-c).norm();
-        }        
-        a += mass(i)*d*d;
-        b += mass(i);
-    }
-    return sqrt(a/b);
+    bool periodic = (pbc!=0).any();
+
+    // Sum of m*d^2 and sum of masses
+    Vector2f s = parallel_reduce(0,size(),Vector2f(Vector2f::Zero()),[&,this](int b, int e, Vector2f& acc){
+        float d;
+        for(int i=b; i<e; ++i){
+            if(periodic){
+                d = system->box(frame).distance(xyz(i),c,pbc);
+            } else {
+                d = (xyz(i)-c).norm();
+            }
+            acc(0) += mass(i)*d*d;
+            acc(1) += mass(i);
+        }
+    }, std::plus<Vector2f>());
+    return sqrt(s(0)/s(1));
 }
 
 Vector3f Selection::dipole(bool is_charged, Array3i_const_ref pbc, int pbc_atom) const {
@@ -1796,9 +1859,7 @@ float Selection::dihedral(int i, int j, int k, int l, Array3i_const_ref pbc) con
 }
 
 void Selection::wrap(Array3i_const_ref pbc){
-    for(int i=0;i<size();++i){
-        box().wrap_point(xyz(i),pbc);
-    }
+    box().wrap_points(system->traj[frame].coord,_index,pbc);
 }
 
 void Selection::unwrap(Array3i_const_ref pbc, int pbc_atom){
@@ -1809,76 +1870,14 @@ void Selection::unwrap(Array3i_const_ref pbc, int pbc_atom){
     } else {
         c = center(true,pbc,pbc_atom);
     }
-    for(int i=0;i<size();++i){
-        xyz(i) = box().closest_image(xyz(i),c,pbc);
-    }
+    box().closest_images(system->traj[frame].coord,_index,c,pbc);
 }
 
 int Selection::unwrap_bonds(float d, Array3i_const_ref pbc, int pbc_atom){
     process_pbc_atom(pbc_atom);
-    int Nparts = 1;
-
-    // a connectivity structure in the form con[i]->1,2,5...
-    vector<vector<int>> con = get_internal_bonds(d,true); // periodic by definition
-
-    // Mask of used atoms
-    VectorXi used(size());
-    used.fill(0);
-
-    // Queue of centers to consider
-    set<int> todo;
-
-    // Leading atom coordinates
-    Vector3f leading;
-
-    todo.insert(pbc_atom);
-    used[pbc_atom] = 1;
-    int Nused = 1;
-    Periodic_box& b = system->box(frame);
-
-    for(;;){
-        while(!todo.empty()){
-            // Get center from the queue
-            int cur = *(todo.begin());
-            todo.erase(todo.begin()); // And pop it from the queue
-            leading = xyz(cur);
-
-            // Find all atoms connected to this one
-            for(int i=0; i<con[cur].size(); ++i){
-                // We only add atoms, which were not yet used as centers
-                if(used(con[cur][i])==0){
-                    // Unwrap atom
-                    xyz(con[cur][i]) = b.closest_image(xyz(con[cur][i]),leading,pbc);
-                    // Add this atom to centers queue
-                    todo.insert(con[cur][i]);
-                    // Mark as used
-                    used[con[cur][i]] = 1;
-                    ++Nused;
-                }
-            }
-        }
-
-        if(Nused<size()){
-            // Find next not used atom and add to the queue
-            int i=0;
-            while(used(i)==1){
-                ++i;
-                if(i>=size()) throw Pteros_error("Wrong connectivity?");
-            }
-
-            todo.insert(i);
-            used[i] = 1;
-            Nused++;
-
-            Nparts++;
-        } else {
-            // Done. Exit loop.
-            break;
-        }
-
-    }
-
-    return Nparts;
+    Unwrap_plan plan(*this,d,pbc_atom);
+    plan.apply(*this,pbc);
+    return plan.num_pieces();
 }
 
 Eigen::Affine3f Selection::principal_transform(Array3i_const_ref pbc, int pbc_atom) const {
@@ -2076,8 +2075,8 @@ float Selection::sasa(float probe_r, vector<float> *area_per_atom, int n_sphere_
 
 
 void Selection::get_local_bonds_from_topology(vector<vector<int>>& con) const {
-    if(!system->force_field.ready) throw Pteros_error("No topology!");
-    if(system->force_field.bonds.size()==0) throw Pteros_error("No bonds in topology!");
+    if(!system->force_field->ready) throw Pteros_error("No topology!");
+    if(system->force_field->bonds.size()==0) throw Pteros_error("No bonds in topology!");
 
     con.clear();
     con.resize(size());
@@ -2088,12 +2087,14 @@ void Selection::get_local_bonds_from_topology(vector<vector<int>>& con) const {
     auto bit = std::begin(_index);    
     auto eit = std::end(_index);
 
-    for(int i=0;i<system->force_field.bonds.size();++i){
-        a1 = system->force_field.bonds[i](0);
-        a2 = system->force_field.bonds[i](1);
+    for(int i=0;i<system->force_field->bonds.size();++i){
+        a1 = system->force_field->bonds[i](0);
+        a2 = system->force_field->bonds[i](1);
         if(a1>=bind && a1<=eind && a2>=bind && a2<=eind){
-            auto it1 = std::find(bit,eit,a1);
-            auto it2 = std::find(it1,eit,a2);
+            // Index is sorted, so use binary search. Skip atoms not in selection.
+            auto it1 = std::lower_bound(bit,eit,a1);
+            auto it2 = std::lower_bound(bit,eit,a2);
+            if(*it1!=a1 || *it2!=a2) continue;
             con[it1-bit].push_back(it2-bit);
             con[it2-bit].push_back(it1-bit);
         }
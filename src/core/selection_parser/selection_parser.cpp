@@ -33,11 +33,13 @@
 #include "pteros/core/logging.h"
 #include "pteros/core/pteros_error.h"
 #include "pteros/core/distance_search.h"
+#include "pteros/core/index_set.h"
 #include <Eigen/Core>
 #include <boost/range/counting_range.hpp>
 #include <unordered_set>
 #include <regex>
 #include <list>
+#include <chrono>
 
 using namespace std;
 using namespace pteros;
@@ -154,7 +156,11 @@ bool is_node_coordinate_dependent(const std::shared_ptr<MyAst>& node){
 Selection_parser::Selection_parser(std::vector<int> *subset):
     has_coord(false),
     starting_subset(subset),
-    sys(nullptr)
+    sys(nullptr),
+    profile_entry(nullptr),
+    profiling(false),
+    n_applied(0),
+    child_time(0)
 {
 
 }
@@ -206,6 +212,13 @@ void Selection_parser::optimize(std::shared_ptr<MyAst>& node){
             // Put new second operand
             node->nodes[2] = operand2;
         }
+        // For AND put pure operand first. It is evaluated once and
+        // restricts the subset for coordinate-dependent second operand.
+        if(node->nodes.size()==3 && node->nodes[1]->token == "and"
+                && node->nodes[0]->is_coord_dependent
+                && !node->nodes[2]->is_coord_dependent){
+            std::swap(node->nodes[0],node->nodes[2]);
+        }
         break;
     }
 
@@ -237,6 +250,12 @@ void Selection_parser::precompute(std::shared_ptr<MyAst>& node){
 }
 
 void Selection_parser::create_ast(string& sel_str, System* system){
+    auto t0 = chrono::steady_clock::now();
+    // Evaluation of precomputed nodes is profiled too
+    auto prof = system->sel_profiler;
+    profiling = (bool)prof;
+    sel_text = sel_str;
+
     if (_parser.parse(sel_str.c_str(), tree)) {
         tree = peg::AstOptimizer(true,{"POINT","X","Y","Z"}).optimize(tree);
 
@@ -265,15 +284,66 @@ void Selection_parser::create_ast(string& sel_str, System* system){
 
     // proceed with optimizing pure nodes to precomputed if needed
     if(has_coord) precompute(tree);
+
+    profiling = false;
+    if(prof){
+        profiler = prof;
+        profile_entry = prof->get_entry(sel_str);
+        prof->add_parse(profile_entry,
+                            chrono::duration<double>(chrono::steady_clock::now()-t0).count(),
+                            has_coord);
+    }
 }
 
 void Selection_parser::apply_ast(size_t fr, vector<int>& result){
     frame = fr;
+    // Profiler is looked up on each evaluation, so switching profiling on or off
+    // in the System affects existing selections
+    auto prof = sys->sel_profiler;
+    profiling = (bool)prof;
+    if(!prof){
+        node_stats.clear();
+        eval_node(tree,result);
+        return;
+    }
+
+    // Profiling is switched on after parsing or restarted
+    if(profiler.lock()!=prof){
+        profiler = prof;
+        profile_entry = prof->get_entry(sel_text);
+    }
+
+    auto t0 = chrono::steady_clock::now();
     eval_node(tree,result);
+    double t = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+    profiling = false;
+    // Node statistics also include evaluation of precomputed nodes during parsing
+    prof->add_eval(profile_entry, t, result.size(), n_applied>0, node_stats);
+    node_stats.clear();
+    ++n_applied;
 }
 
-
 void Selection_parser::eval_node(const std::shared_ptr<MyAst> &node, std::vector<int>& result){
+    if(!profiling){
+        eval_node_impl(node,result);
+        return;
+    }
+
+    // Accumulate total and self time of the node
+    double parent_child_time = child_time;
+    child_time = 0;
+    auto t0 = chrono::steady_clock::now();
+    eval_node_impl(node,result);
+    double t = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+    auto& s = node_stats[node->name];
+    ++s.count;
+    s.time += t;
+    s.self_time += t-child_time;
+    child_time = parent_child_time + t;
+}
+
+
+void Selection_parser::eval_node_impl(const std::shared_ptr<MyAst> &node, std::vector<int>& result){
     using namespace peg::udl;
 
     result.clear();
@@ -421,10 +491,8 @@ void Selection_parser::eval_node(const std::shared_ptr<MyAst> &node, std::vector
             for(int at: *current_subset) body(at);
         }
 
-        // Sort unique
-        sort(result.begin(),result.end());
-        vector<int>::iterator it = unique(result.begin(), result.end());
-        result.resize( it - result.begin() );
+        // Sort unique (result is usually sorted already)
+        sort_unique_index(result);
 
         break;
     }
@@ -506,9 +574,7 @@ void Selection_parser::eval_node(const std::shared_ptr<MyAst> &node, std::vector
             }
         } // index if
 
-        sort(result.begin(),result.end());
-        vector<int>::iterator it = unique(result.begin(), result.end());
-        result.resize( it - result.begin() );
+        sort_unique_index(result);
 
         break;
     }
@@ -517,24 +583,21 @@ void Selection_parser::eval_node(const std::shared_ptr<MyAst> &node, std::vector
     case "LOGICAL_EXPR"_:
     {
         if(node->nodes[1]->token == "or") {
-            vector<int> res1,res2;
-            eval_node(node->nodes[0],res1);
+            // Merge second operand into the first in place
+            vector<int> res2;
+            eval_node(node->nodes[0],result);
             eval_node(node->nodes[2],res2);
-            std::set_union(res1.begin(),res1.end(),res2.begin(),res2.end(),back_inserter(result));
+            index_union(result,res2);
 
         } else if(node->nodes[1]->token == "and") {
-            // Optimize to put pure node first
-            bool pure1 = !node->nodes[0]->is_coord_dependent;
-            bool pure2 = !node->nodes[2]->is_coord_dependent;
-
-            if(pure2 && !pure1) std::swap(node->nodes[0],node->nodes[2]);
-
+            // Pure operand is put first by optimize()
             vector<int> res1,res2;
             eval_node(node->nodes[0],res1);
             current_subset = &res1; // Set subset for second
             eval_node(node->nodes[2],res2); // Is using filled current subset
 
-            std::set_intersection(res1.begin(),res1.end(),res2.begin(),res2.end(),back_inserter(result));
+            index_intersection(res1,res2);
+            result.swap(res1);
 
             // Reset subset
             if(starting_subset){
@@ -564,63 +627,75 @@ void Selection_parser::eval_node(const std::shared_ptr<MyAst> &node, std::vector
 
         } else if(node->nodes[0]->name == "BY"){
             if(node->nodes[0]->token == "residue"){
-                // First make a set of resids we need to search
-                std::unordered_set<int> resind;
-                for(auto at: res) resind.insert(sys->atoms[at].resindex);
-
-                // Now cycle over all atoms in the starting subset if present (not current subset!!!)
-                if(starting_subset){
-                    for(int at: *starting_subset) // over starting subset
-                        if(resind.count(sys->atoms[at].resindex)) result.push_back(at);
+                // Without subset whole residues could be taken directly from
+                // precomputed ranges. res is sorted and residues are contiguous,
+                // so the result is sorted.
+                auto ranges = sys->get_topology_ranges();
+                if(!starting_subset && ranges->contiguous){
+                    int i = 0;
+                    while(i<res.size()){
+                        const auto& r = ranges->residues[sys->atoms[res[i]].resindex];
+                        for(int at=r(0); at<=r(1); ++at) result.push_back(at);
+                        while(i<res.size() && res[i]<=r(1)) ++i;
+                    }
                 } else {
-                    for(int at=0;at<Natoms;++at) // over all atoms
-                        if(resind.count(sys->atoms[at].resindex)) result.push_back(at);
+                    // First make a mask of resindexes we need to search
+                    int max_resind = -1;
+                    for(auto at: res) max_resind = std::max(max_resind,sys->atoms[at].resindex);
+                    Index_mask resind(max_resind+1);
+                    for(auto at: res) resind.set(sys->atoms[at].resindex);
+
+                    auto check = [&](int at){
+                        int r = sys->atoms[at].resindex;
+                        return r<=max_resind && resind.test(r);
+                    };
+
+                    // Now cycle over all atoms in the starting subset if present (not current subset!!!)
+                    // Atoms are visited in ascending order, so result is sorted.
+                    if(starting_subset){
+                        for(int at: *starting_subset) // over starting subset
+                            if(check(at)) result.push_back(at);
+                    } else {
+                        for(int at=0;at<Natoms;++at) // over all atoms
+                            if(check(at)) result.push_back(at);
+                    }
                 }
-                std::sort(result.begin(),result.end());
 
             } else if(node->nodes[0]->token == "chain") {
-                // First make a set of chains we need to search
-                std::unordered_set<char> chains;
-                for(auto at: res) chains.insert(sys->atoms[at].chain);
+                // First make a table of chains we need to search
+                bool chains[256] = {false};
+                for(auto at: res) chains[(unsigned char)sys->atoms[at].chain] = true;
+
+                auto check = [&](int at){ return chains[(unsigned char)sys->atoms[at].chain]; };
 
                 // Now cycle over all atoms in the starting subset if present (not current subset!!!)
+                // Atoms are visited in ascending order, so result is sorted.
                 if(starting_subset){
                     for(int at: *starting_subset) // over starting subset
-                        if(chains.count(sys->atoms[at].chain)) result.push_back(at);
+                        if(check(at)) result.push_back(at);
                 } else {
                     for(int at=0;at<Natoms;++at) // over all atoms
-                        if(chains.count(sys->atoms[at].chain)) result.push_back(at);
+                        if(check(at)) result.push_back(at);
                 }
-                std::sort(result.begin(),result.end());
 
             } else if(node->nodes[0]->token == "mol") {
-                if(!sys->force_field.ready) throw Pteros_error("Can't select by molecule: no topology!");
-
-                // set of mols we need to include
-                std::unordered_set<int> mols;
+                if(!sys->force_field->ready) throw Pteros_error("Can't select by molecule: no topology!");
 
-                // go over res and add mol is we need it
+                // Both res and molecules are ordered by atom index,
+                // so we walk over them simultaneously and add whole molecules
+                const auto& molecules = sys->force_field->molecules;
+                int j = 0;
                 for(auto at: res){
-                    // Cycle over all molecules in the system
-                    for(int j=0; j<sys->force_field.molecules.size(); ++j){ // Over molecules
-                        if(at>=sys->force_field.molecules[j](0) && at<=sys->force_field.molecules[j](1)){
-                            mols.insert(j);
-                            break;
-                        }
+                    while(j<molecules.size() && molecules[j](1)<at) ++j;
+                    if(j==molecules.size()) break;
+                    if(at>=molecules[j](0)){
+                        for(int a=molecules[j](0); a<=molecules[j](1); ++a) result.push_back(a);
+                        ++j;
                     }
                 }
 
-                // Now add all chosen molecules
-                for(int m: mols)
-                    for(int at=sys->force_field.molecules[m](0); at<=sys->force_field.molecules[m](1); ++at)
-                        result.push_back(at);
-
-                // Sort and restrict to starting subset (!) if needed
-                sort(result.begin(),result.end());
-                if(starting_subset)
-                    std::set_intersection(result.begin(),result.end(),
-                                          starting_subset->begin(),starting_subset->end(),
-                                          back_inserter(result));
+                // Restrict to starting subset (!) if needed
+                if(starting_subset) index_intersection(result,*starting_subset);
 
             } // mol
         } //BY
@@ -79,11 +79,12 @@ private:
     std::shared_ptr<MyAst> tree;
 
     // AST evaluation stuff
-    System* sys;
+    const System* sys;
     int Natoms;
     int frame;    
 
     void eval_node(const std::shared_ptr<MyAst> &node, std::vector<int>& result);
+    void eval_node_impl(const std::shared_ptr<MyAst> &node, std::vector<int>& result);
     std::function<float(int)> get_numeric(const std::shared_ptr<MyAst>& node);
     Eigen::Vector3f get_vector(const std::shared_ptr<MyAst> &node);
 
@@ -92,6 +93,20 @@ private:
 
     void precompute(std::shared_ptr<MyAst> &node);
     void optimize(std::shared_ptr<MyAst> &node);
+
+    // Profiling stuff. Profiler of the System is looked up on each evaluation.
+    // Profiler, to which profile_entry belongs. Not owned, since profiling could be switched off.
+    std::weak_ptr<Selection_profiler> profiler;
+    Selection_profile* profile_entry;
+    std::string sel_text;
+    // True while profiled parsing or evaluation is running
+    bool profiling;
+    // Number of evaluations done by this parser
+    int n_applied;
+    // Node statistics accumulated since last evaluation
+    std::map<std::string,Selection_node_profile> node_stats;
+    // Time spent in children of currently evaluated node
+    double child_time;
 };
 
 }
@@ -37,6 +37,7 @@
 #include "pteros/core/distance_search.h"
 #include "pteros/core/mol_file.h"
 #include "pteros/core/utilities.h"
+#include "pteros/core/thread_pool.h"
 #include "selection_parser.h"
 #include "pteros/core/logging.h"
 #include <utility>
@@ -67,6 +68,9 @@ System::System(const System& other){
     atoms = other.atoms;
     traj = other.traj;
     force_field = other.force_field;
+    // Ranges are valid for shared topology
+    std::lock_guard<std::mutex> lock(other.topo_ranges_mutex);
+    topo_ranges = other.topo_ranges;
 }
 
 System::System(const Selection &sel){
@@ -81,6 +85,9 @@ System& System::operator=(const System& other){
     atoms = other.atoms;
     traj = other.traj;
     force_field = other.force_field;
+    // Ranges are valid for shared topology
+    std::lock_guard<std::mutex> lock(other.topo_ranges_mutex);
+    topo_ranges = other.topo_ranges;
     return *this;
 }
 
@@ -88,7 +95,9 @@ System& System::operator=(const System& other){
 void System::clear(){
     atoms.clear();
     traj.clear();
-    force_field.clear();
+    // Don't copy shared force field just to clear it
+    force_field.reset();
+    force_field.mut().clear();
     filter.clear();
     filter_text = "";
 }
@@ -504,6 +513,58 @@ void System::sort_by_resindex()
     }
 }
 
+std::shared_ptr<const Topology_ranges> System::get_topology_ranges() const
+{
+    std::lock_guard<std::mutex> lock(topo_ranges_mutex);
+
+    if(topo_ranges
+            && topo_ranges->atoms_version==atoms.version()
+            && topo_ranges->ff_version==force_field.version()) return topo_ranges;
+
+    auto r = std::make_shared<Topology_ranges>();
+    r->atoms_version = atoms.version();
+    r->ff_version = force_field.version();
+    r->contiguous = true;
+
+    int max_resind = -1;
+    for(const auto& a: atoms) max_resind = std::max(max_resind,a.resindex);
+    r->residues.resize(max_resind+1,Vector2i(-1,-1));
+
+    for(int i=0; i<atoms.size(); ++i){
+        int resind = atoms[i].resindex;
+        if(resind<0){
+            r->contiguous = false;
+            continue;
+        }
+        auto& range = r->residues[resind];
+        if(range(0)<0){
+            range.fill(i);
+        } else {
+            if(range(1)!=i-1) r->contiguous = false;
+            range(1) = i;
+        }
+    }
+
+    if(force_field->ready){
+        r->atom_molecule.resize(atoms.size(),-1);
+        const auto& molecules = force_field->molecules;
+        for(int m=0; m<molecules.size(); ++m)
+            for(int i=molecules[m](0); i<=molecules[m](1); ++i) r->atom_molecule[i] = m;
+    }
+
+    topo_ranges = r;
+    return topo_ranges;
+}
+
+Vector2i System::residue_range(int resind) const
+{
+    auto r = get_topology_ranges();
+    if(!r->contiguous) throw Pteros_error("Residues are not contiguous, call sort_by_resindex() first!");
+    if(resind<0 || resind>=r->residues.size() || r->residues[resind](0)<0)
+        throw Pteros_error("No residue with resindex {}!",resind);
+    return r->residues[resind];
+}
+
 void System::clear_vel()
 {
     for(int j=0; j<traj.size(); ++j) traj[j].vel.clear();
@@ -514,6 +575,32 @@ void System::clear_force()
     for(int j=0; j<traj.size(); ++j) traj[j].force.clear();
 }
 
+void System::set_selection_profiling(bool on)
+{
+    if(on){
+        if(!sel_profiler) sel_profiler = std::make_shared<Selection_profiler>();
+    } else {
+        sel_profiler.reset();
+    }
+}
+
+vector<Selection_profile> System::get_selection_profile() const
+{
+    if(!sel_profiler) return {};
+    return sel_profiler->get_entries();
+}
+
+string System::selection_profile_report(int max_entries) const
+{
+    if(!sel_profiler) return "Selection profiling is off\n";
+    return sel_profiler->report(max_entries);
+}
+
+void System::reset_selection_profile()
+{
+    if(sel_profiler) sel_profiler->reset();
+}
+
 Selection System::atoms_dup(const vector<int>& ind){
     // Sanity check
     if(!ind.size()) throw Pteros_error("No atoms to duplicate!");
@@ -583,9 +670,7 @@ Selection System::atoms_add(const vector<Atom>& atm, const vector<Vector3f>& crd
     return Selection(*this,first_added,last_added);
 }
 
-void System::atoms_delete(const std::vector<int> &ind){
-    int i,fr;
-
+std::vector<int> System::atoms_delete(const std::vector<int> &ind){
     // Sanity check
     if(!ind.size()) throw Pteros_error("No atoms to delete!");
     for(int i=0; i<ind.size(); ++i){
@@ -593,34 +678,49 @@ void System::atoms_delete(const std::vector<int> &ind){
             throw Pteros_error("Index {} for atom is out of range (0:{})!",ind[i],atoms.size()-1);
     }
 
-    // Mark atoms for deletion by assigning negative mass
-    for(i=0;i<ind.size();++i)
-        atoms[ind[i]].mass = -1.0;
-
-    // Cycle over all atoms and keep only those with positive mass
-    vector<pteros::Atom> tmp = atoms;
-    atoms.clear();
-    for(i=0;i<tmp.size();++i){
-        if(tmp[i].mass>=0) atoms.push_back(tmp[i]);
+    // Mark deleted atoms and compute new indexes of the rest
+    vector<int> new_index(atoms.size(),0);
+    for(int i: ind) new_index[i] = -1;
+    int n = 0;
+    for(int i=0;i<new_index.size();++i){
+        if(new_index[i]>=0) new_index[i] = n++;
     }
 
-    // Now cycle over trajectory and keep only corresponding coordinates
-    Frame tmpv;
-    for(fr=0; fr<num_frames(); ++fr){
-        // Make a copy
-        tmpv = traj[fr];
-
-        traj[fr].coord.clear();
-        traj[fr].vel.clear();
-        traj[fr].force.clear();
-        for(i=0;i<tmp.size();++i){
-            if(tmp[i].mass>=0){
-                traj[fr].coord.push_back(tmpv.coord[i]);
-                if(traj[fr].has_vel()) traj[fr].vel.push_back(tmpv.vel[i]);
-                if(traj[fr].has_force()) traj[fr].force.push_back(tmpv.force[i]);
-            }
-        }
+    compact_atoms(new_index,n);
+
+    return new_index;
+}
+
+void System::compact_atoms(const std::vector<int> &new_index, int new_natoms)
+{
+    int old_natoms = atoms.size();
+
+    // New indexes never exceed old ones, so forward copy is safe
+    for(int i=0;i<old_natoms;++i){
+        if(new_index[i]>=0 && new_index[i]!=i) atoms[new_index[i]] = std::move(atoms[i]);
     }
+    atoms.resize(new_natoms);
+
+    // Frames are independent
+    parallel_chunks(traj.size(),[&,this](int fr){
+        Frame& f = traj[fr];
+        bool do_coord = (f.coord.size()==old_natoms);
+        bool do_vel = (f.vel.size()==old_natoms);
+        bool do_force = (f.force.size()==old_natoms);
+        for(int i=0;i<old_natoms;++i){
+            int ind = new_index[i];
+            if(ind<0 || ind==i) continue;
+            if(do_coord) f.coord[ind] = f.coord[i];
+            if(do_vel) f.vel[ind] = f.vel[i];
+            if(do_force) f.force[ind] = f.force[i];
+        }
+        // Capacity is kept, so atoms could be added back without reallocation
+        if(do_coord) f.coord.resize(new_natoms);
+        if(do_vel) f.vel.resize(new_natoms);
+        if(do_force) f.force.resize(new_natoms);
+    });
+
+    force_field.mut().remap_atoms(new_index,new_natoms);
 }
 
 void System::atom_move(int i, int j)
@@ -971,9 +1071,10 @@ void System::keep(const string &sel_str)
 void System::keep(const Selection &sel)
 {
     if(sel.get_system()!=this) throw Pteros_error("keep needs selection from the same system!");
-    System tmp;
-    tmp.append(sel);
-    *this = tmp;
+    vector<int> new_index(num_atoms(),-1);
+    for(int i=0;i<sel.size();++i) new_index[sel.index(i)] = i;
+    compact_atoms(new_index,sel.size());
+    if(num_atoms()) assign_resindex();
 }
 
 void System::remove(const string &sel_str)
@@ -985,9 +1086,7 @@ void System::remove(const string &sel_str)
 void System::remove(Selection &sel)
 {
     if(sel.get_system()!=this) throw Pteros_error("remove needs selection from the same system!");
-    System tmp;
-    tmp.append(~sel);
-    *this = tmp;
+    keep(~sel);
     sel.clear();
 }
 
@@ -1182,31 +1281,23 @@ inline float Coulomb_en_kernel(float q1, float q2, float r_inv){
 namespace pteros {
 
 Vector2f get_energy_for_list(const vector<Vector2i>& pairs, const vector<float>& dist, const System& sys, vector<Vector2f>* pair_en){
-    Force_field& ff = const_cast<System&>(sys).get_force_field();
+    const Force_field& ff = sys.get_force_field();
     Vector2f e_total(0,0);
 
     if(pair_en) pair_en->resize(pairs.size());
 
-    #pragma omp parallel
-    {
+    e_total = parallel_reduce(0,pairs.size(),e_total,[&](int b, int e, Vector2f& eloc){
         int at1,at2;
-        Vector2f eloc(0,0);
-        #pragma omp for nowait
-        for(int i=0;i<pairs.size();++i){
+        for(int i=b;i<e;++i){
             at1 = pairs[i](0);
             at2 = pairs[i](1);
-            auto e = ff.pair_energy(at1, at2, dist[i],
+            auto en = ff.pair_energy(at1, at2, dist[i],
                                 sys.atom(at1).charge, sys.atom(at2).charge,
                                 sys.atom(at1).type,   sys.atom(at2).type);
-            if(pair_en) (*pair_en)[i] = e;
-            eloc += e;
+            if(pair_en) (*pair_en)[i] = en;
+            eloc += en;
         }
-
-        #pragma omp critical
-        {
-            e_total += eloc;
-        }
-    }
+    }, std::plus<Vector2f>());
     return e_total;
 }
 
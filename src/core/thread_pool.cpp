@@ -0,0 +1,276 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "pteros/core/thread_pool.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <exception>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+using namespace std;
+using namespace pteros;
+
+namespace {
+
+// Thread limit of the current thread, 0 if not set
+thread_local int local_limit = 0;
+
+// Single parallel loop. Chunks are claimed by atomic counter
+// by the calling thread and by at most max_workers idle workers.
+struct Job {
+    Job(const function<void(int)>& f, int n, int max_w):
+        body(f), n_chunks(n), max_workers(max_w), limit(local_limit), joined(0), next(0), finished(0) {}
+
+    const function<void(int)>& body;
+    int n_chunks;
+    int max_workers;
+    // Thread limit of the caller, applies to nested loops in workers
+    int limit;
+    // Number of workers, which joined the job. Guarded by the pool mutex.
+    int joined;
+    atomic<int> next;
+    atomic<int> finished;
+    mutex m;
+    condition_variable cond;
+    exception_ptr error;
+
+    // Runs chunks until all of them are claimed
+    void work(){
+        while(true){
+            int c = next.fetch_add(1);
+            if(c>=n_chunks) return;
+            try {
+                body(c);
+            } catch(...) {
+                lock_guard<mutex> lock(m);
+                if(!error) error = current_exception();
+            }
+            if(finished.fetch_add(1)+1==n_chunks){
+                lock_guard<mutex> lock(m);
+                cond.notify_all();
+            }
+        }
+    }
+
+    bool exhausted() const { return next.load()>=n_chunks; }
+};
+
+using Job_ptr = shared_ptr<Job>;
+
+class Thread_pool {
+public:
+    Thread_pool(int n_workers): stop(false) {
+        for(int i=0; i<n_workers; ++i) workers.emplace_back(&Thread_pool::worker_body,this);
+    }
+
+    ~Thread_pool(){
+        {
+            lock_guard<mutex> lock(m);
+            stop = true;
+        }
+        cond.notify_all();
+        for(auto& t: workers) t.join();
+    }
+
+    int num_workers() const { return workers.size(); }
+
+    void run(int n_chunks, const function<void(int)>& body, int max_workers){
+        auto job = make_shared<Job>(body,n_chunks,max_workers);
+        {
+            lock_guard<mutex> lock(m);
+            jobs.push_back(job);
+        }
+        cond.notify_all();
+
+        // Calling thread works too. If all workers are busy it will do everything itself.
+        job->work();
+        remove(job);
+
+        // Wait for the chunks taken by workers
+        {
+            unique_lock<mutex> lock(job->m);
+            job->cond.wait(lock,[&job]{ return job->finished.load()==job->n_chunks; });
+        }
+
+        if(job->error) rethrow_exception(job->error);
+    }
+
+    // Used after fork
+    mutex m;
+
+private:
+    void worker_body(){
+        unique_lock<mutex> lock(m);
+        Job_ptr job;
+        while(true){
+            cond.wait(lock,[this,&job]{ return stop || (job=find_job())!=nullptr; });
+            if(stop) return;
+            ++job->joined;
+            lock.unlock();
+            int saved = local_limit;
+            local_limit = job->limit;
+            job->work();
+            local_limit = saved;
+            remove(job);
+            job.reset();
+            lock.lock();
+        }
+    }
+
+    // Should be called with locked m.
+    // Most recent job first, this is the innermost loop if loops are nested.
+    Job_ptr find_job(){
+        for(auto it=jobs.rbegin(); it!=jobs.rend(); ++it){
+            if((*it)->joined<(*it)->max_workers && !(*it)->exhausted()) return *it;
+        }
+        return nullptr;
+    }
+
+    void remove(const Job_ptr& job){
+        lock_guard<mutex> lock(m);
+        auto it = find(jobs.begin(),jobs.end(),job);
+        if(it!=jobs.end()) jobs.erase(it);
+    }
+
+    vector<thread> workers;
+    condition_variable cond;
+    deque<Job_ptr> jobs;
+    bool stop;
+};
+
+int default_num_threads(){
+    const char* env = getenv("PTEROS_NUM_THREADS");
+    if(env){
+        int n = atoi(env);
+        if(n>0) return n;
+    }
+    return std::max(1u,std::thread::hardware_concurrency());
+}
+
+// Global settings
+mutex pool_mutex;
+atomic<int> global_num_threads(0); // 0 means not initialized yet
+Thread_pool* pool = nullptr;
+
+#ifndef _WIN32
+// Worker threads do not exist in the child process after fork.
+// The pool of the parent is abandoned (not destroyed) and new one is created on demand.
+void atfork_prepare(){
+    pool_mutex.lock();
+    if(pool) pool->m.lock();
+}
+
+void atfork_parent(){
+    if(pool) pool->m.unlock();
+    pool_mutex.unlock();
+}
+
+void atfork_child(){
+    if(pool) pool->m.unlock();
+    pool = nullptr;
+    pool_mutex.unlock();
+}
+#endif
+
+// Should be called with locked pool_mutex
+void init_unlocked(){
+    if(global_num_threads.load()==0){
+        global_num_threads = default_num_threads();
+#ifndef _WIN32
+        pthread_atfork(atfork_prepare,atfork_parent,atfork_child);
+#endif
+    }
+}
+
+int global_threads(){
+    int n = global_num_threads.load(memory_order_relaxed);
+    if(n>0) return n;
+    lock_guard<mutex> lock(pool_mutex);
+    init_unlocked();
+    return global_num_threads.load();
+}
+
+Thread_pool* get_pool(){
+    lock_guard<mutex> lock(pool_mutex);
+    init_unlocked();
+    int nt = global_num_threads.load();
+    if(!pool && nt>1) pool = new Thread_pool(nt-1);
+    return pool;
+}
+
+}
+
+void pteros::set_num_threads(int n)
+{
+    if(n<=0) n = default_num_threads();
+    lock_guard<mutex> lock(pool_mutex);
+    init_unlocked();
+    if(n==global_num_threads.load()) return;
+    global_num_threads = n;
+    // Pool will be recreated with new size on demand
+    delete pool;
+    pool = nullptr;
+}
+
+int pteros::get_num_threads()
+{
+    int nt = global_threads();
+    return local_limit>0 ? std::min(local_limit,nt) : nt;
+}
+
+Thread_limit::Thread_limit(int n): saved(local_limit)
+{
+    local_limit = std::max(1,n);
+}
+
+Thread_limit::~Thread_limit()
+{
+    local_limit = saved;
+}
+
+void pteros::parallel_chunks(int n_chunks, const std::function<void(int)> &body)
+{
+    if(n_chunks<=0) return;
+    int nt = get_num_threads();
+    Thread_pool* p = n_chunks>1 && nt>1 ? get_pool() : nullptr;
+    if(!p){
+        for(int c=0; c<n_chunks; ++c) body(c);
+        return;
+    }
+    // Calling thread and nt-1 workers
+    p->run(n_chunks,body,nt-1);
+}
@@ -0,0 +1,131 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "pteros/core/unwrap_plan.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/thread_pool.h"
+#include "pteros/core/profiling.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+Unwrap_plan::Unwrap_plan(const Selection &sel, float d, int pbc_atom)
+{
+    create(sel,d,pbc_atom);
+}
+
+void Unwrap_plan::create(const Selection &sel, float d, int pbc_atom)
+{
+    int n = sel.size();
+    if(pbc_atom>=n) throw Pteros_error("Wrong pbc atom {} for selection with {} atoms!",pbc_atom,n);
+    if(pbc_atom<0) pbc_atom = n/2;
+
+    order.clear();
+    parent.clear();
+    piece_start.clear();
+    max_index = -1;
+    if(n==0) return;
+    // Selection index is sorted
+    max_index = sel.index(n-1);
+
+    order.reserve(n);
+    parent.reserve(n);
+
+    // a connectivity structure in the form con[i]->1,2,5...
+    vector<vector<int>> con = sel.get_internal_bonds(d,true); // periodic by definition
+
+    // Local parent of each atom, -2 for not visited yet
+    vector<int> local_parent(n,-2);
+    // Order of traversal in local indexes. Also serves as a queue for BFS.
+    vector<int> local_order;
+    local_order.reserve(n);
+
+    int next_root = 0; // Candidate for the root of the next piece
+    int root = pbc_atom;
+    while(true){
+        piece_start.push_back(local_order.size());
+        local_parent[root] = -1;
+        local_order.push_back(root);
+
+        // BFS over connected piece
+        for(int q=piece_start.back(); q<local_order.size(); ++q){
+            int cur = local_order[q];
+            for(int i: con[cur]){
+                if(local_parent[i]==-2){
+                    local_parent[i] = cur;
+                    local_order.push_back(i);
+                }
+            }
+        }
+
+        if(local_order.size()==n) break;
+
+        // Next piece starts from the first not visited atom
+        while(local_parent[next_root]!=-2) ++next_root;
+        root = next_root;
+    }
+    piece_start.push_back(n);
+
+    // Convert to absolute indexes
+    for(int i: local_order){
+        order.push_back(sel.index(i));
+        parent.push_back(local_parent[i]>=0 ? sel.index(local_parent[i]) : -1);
+    }
+}
+
+void Unwrap_plan::apply(System &sys, int fr, Array3i_const_ref pbc) const
+{
+    PTEROS_PROFILE_SCOPE("unwrap_plan.apply");
+
+    if(fr<0 || fr>=sys.num_frames()) throw Pteros_error("Invalid frame {} for unwrapping!",fr);
+    if(max_index>=sys.num_atoms())
+        throw Pteros_error("Unwrap plan does not match the system!");
+
+    const Periodic_box& box = sys.box(fr);
+    auto& coord = sys.frame(fr).coord;
+
+    // Pieces are independent, so process them in parallel
+    // with roughly 1024 atoms per chunk
+    int npieces = num_pieces();
+    int grain = max(1, int(1024L*npieces/max(1,num_atoms())));
+    parallel_for(0,npieces,[&](int b, int e){
+        for(int p=b; p<e; ++p){
+            // Root doesn't move, parents always go before children
+            for(int k=piece_start[p]+1; k<piece_start[p+1]; ++k){
+                coord[order[k]] = box.closest_image(coord[order[k]],coord[parent[k]],pbc);
+            }
+        }
+    }, grain);
+}
+
+void Unwrap_plan::apply(Selection &sel, Array3i_const_ref pbc) const
+{
+    apply(*sel.get_system(), sel.get_frame(), pbc);
+}
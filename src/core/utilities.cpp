@@ -31,11 +31,14 @@
 #include "pteros/core/utilities.h"
 #include "pteros/core/pteros_error.h"
 #include "pteros/core/version.h"
+#include "pteros/core/thread_pool.h"
 #include <fstream>
 // Periodic table from VMD molfile plugins
 #include "periodic_table.h"
 #include <iostream>
 #include <string>
+#include <random>
+#include <Eigen/Dense>
 
 using namespace std;
 using namespace pteros;
@@ -225,6 +228,7 @@ void Histogram::create(float minval, float maxval, int n)
     val.fill(0.0);
     pos.resize(nbins);
     d = (maxv-minv)/float(nbins);
+    inv_d = 1.0/d;
     for(int i=0;i<nbins;++i) pos(i) = minv+0.5*d+d*i;
 
     normalized = false;
@@ -232,25 +236,63 @@ void Histogram::create(float minval, float maxval, int n)
 
 int Histogram::get_bin(float v)
 {
-    return floor((v-minv)/d);
+    return floor((v-minv)*inv_d);
 }
 
 void Histogram::add(float v,float  weight)
 {
     if(normalized) throw Pteros_error("Can't add value to normalized histogram!");
-    int b = floor((v-minv)/d);
+    int b = floor((v-minv)*inv_d);
     if(b>=0 && b<nbins) val(b) += weight;
 }
 
 void Histogram::add(const std::vector<float>& v)
 {
-    for(auto& val: v) add(val);
+    add(v.data(),v.size());
+}
+
+void Histogram::add(const std::vector<float> &v, const std::vector<float> &weights)
+{
+    if(v.size()!=weights.size())
+        throw Pteros_error("Number of values {} and weights {} are different!",v.size(),weights.size());
+    add(v.data(),v.size(),weights.data());
+}
+
+void Histogram::add(const float *v, int n, const float *weights)
+{
+    if(normalized) throw Pteros_error("Can't add value to normalized histogram!");
+
+    // Small batches are not worth spawning threads
+    if(n<10000){
+        bin_values(v,n,weights,val);
+        return;
+    }
+
+    // Each chunk fills its own local histogram
+    val += parallel_reduce(0,n,VectorXd(VectorXd::Zero(nbins)),[&,this](int b, int e, VectorXd& local){
+        bin_values(v+b,e-b,weights ? weights+b : nullptr,local);
+    }, std::plus<VectorXd>(), 10000);
+}
+
+void Histogram::bin_values(const float *v, int n, const float *weights, VectorXd &res) const
+{
+    if(weights){
+        for(int i=0;i<n;++i){
+            int b = floor((v[i]-minv)*inv_d);
+            if(b>=0 && b<nbins) res(b) += weights[i];
+        }
+    } else {
+        for(int i=0;i<n;++i){
+            int b = floor((v[i]-minv)*inv_d);
+            if(b>=0 && b<nbins) res(b) += 1.0;
+        }
+    }
 }
 
 void Histogram::add_cylindrical(float r, float w, float sector, float cyl_h)
 {
     if(normalized) throw Pteros_error("Can't add value to normalized histogram!");
-    int b = floor((r-minv)/d);
+    int b = floor((r-minv)*inv_d);
     if(b>=0 && b<nbins){
         float r1 = pos(b)-0.5*d;
         float r2 = pos(b)+0.5*d;
@@ -258,6 +300,23 @@ void Histogram::add_cylindrical(float r, float w, float sector, float cyl_h)
     }
 }
 
+void Histogram::merge(const Histogram &other)
+{
+    if(other.nbins!=nbins || other.minv!=minv || other.maxv!=maxv)
+        throw Pteros_error("Can't merge histograms with different binning!");
+    if(normalized || other.normalized)
+        throw Pteros_error("Can't merge normalized histograms!");
+    val += other.val;
+}
+
+Histogram Histogram::empty_copy() const
+{
+    Histogram h(*this);
+    h.val.fill(0.0);
+    h.normalized = false;
+    return h;
+}
+
 void Histogram::normalize(float norm)
 {
     if(norm){
@@ -318,6 +377,7 @@ void Histogram2D::create(float minval1, float maxval1, int n1, float minval2, fl
 
     d(0) = (maxv(0)-minv(0))/float(nbins(0));
     d(1) = (maxv(1)-minv(1))/float(nbins(1));
+    inv_d = d.cwiseInverse();
 
     normalized = false;
 }
@@ -325,11 +385,38 @@ void Histogram2D::create(float minval1, float maxval1, int n1, float minval2, fl
 void Histogram2D::add(float v1, float v2, float weight)
 {
     if(normalized) throw Pteros_error("Can't add value to normalized histogram!");
-    int b1 = floor((v1-minv(0))/d(0));
-    int b2 = floor((v2-minv(1))/d(1));
+    int b1 = floor((v1-minv(0))*inv_d(0));
+    int b2 = floor((v2-minv(1))*inv_d(1));
     if(b1>=0 && b1<nbins(0) && b2>=0 && b2<nbins(1)) val(b1,b2) += weight;
 }
 
+void Histogram2D::add(const float *v1, const float *v2, int n, const float *weights)
+{
+    if(normalized) throw Pteros_error("Can't add value to normalized histogram!");
+    for(int i=0;i<n;++i){
+        int b1 = floor((v1[i]-minv(0))*inv_d(0));
+        int b2 = floor((v2[i]-minv(1))*inv_d(1));
+        if(b1>=0 && b1<nbins(0) && b2>=0 && b2<nbins(1)) val(b1,b2) += weights ? weights[i] : 1.0;
+    }
+}
+
+void Histogram2D::merge(const Histogram2D &other)
+{
+    if(other.nbins!=nbins || other.minv!=minv || other.maxv!=maxv)
+        throw Pteros_error("Can't merge histograms with different binning!");
+    if(normalized || other.normalized)
+        throw Pteros_error("Can't merge normalized histograms!");
+    val += other.val;
+}
+
+Histogram2D Histogram2D::empty_copy() const
+{
+    Histogram2D h(*this);
+    h.val.fill(0.0);
+    h.normalized = false;
+    return h;
+}
+
 void Histogram2D::normalize(float norm)
 {
     if(norm){
@@ -351,3 +438,168 @@ void Histogram2D::save_to_file(const string &fname)
     f.close();
 }
 
+//----------------------------------
+
+Covariance_accumulator::Covariance_accumulator(int dim, bool full_matrix, bool keep_samples, int block_size)
+{
+    create(dim,full_matrix,keep_samples,block_size);
+}
+
+void Covariance_accumulator::create(int dim, bool full_matrix, bool keep_samples, int block_size)
+{
+    if(dim<=0) throw Pteros_error("Invalid dimension {} of covariance accumulator!",dim);
+    if(block_size<=0) throw Pteros_error("Invalid block size {} of covariance accumulator!",block_size);
+
+    n_dim = dim;
+    blk_size = block_size;
+    with_matrix = full_matrix;
+    with_samples = keep_samples;
+    n = 0;
+    n_buf = 0;
+
+    mu.resize(n_dim);
+    mu.fill(0.0);
+    if(with_matrix){
+        m2.resize(n_dim,n_dim);
+        m2.fill(0.0);
+    } else {
+        m2.resize(0,0);
+    }
+    buf.resize(n_dim,blk_size);
+    samples.clear();
+}
+
+void Covariance_accumulator::add(const Eigen::Ref<const VectorXf> &x)
+{
+    if(x.size()!=n_dim) throw Pteros_error("Sample of size {} added to covariance accumulator of size {}!",x.size(),n_dim);
+    buf.col(n_buf) = x.cast<double>();
+    if(++n_buf==blk_size) flush();
+}
+
+void Covariance_accumulator::add(const Eigen::Ref<const VectorXd> &x)
+{
+    if(x.size()!=n_dim) throw Pteros_error("Sample of size {} added to covariance accumulator of size {}!",x.size(),n_dim);
+    buf.col(n_buf) = x;
+    if(++n_buf==blk_size) flush();
+}
+
+void Covariance_accumulator::merge(const Covariance_accumulator &other)
+{
+    if(other.n_dim!=n_dim || other.with_matrix!=with_matrix || other.with_samples!=with_samples)
+        throw Pteros_error("Can't merge incompatible covariance accumulators!");
+
+    // Combine flushed statistics
+    if(other.n>0){
+        if(n==0){
+            mu = other.mu;
+            if(with_matrix) m2.triangularView<Upper>() = other.m2;
+        } else {
+            double nn = n+other.n;
+            VectorXd delta = other.mu-mu;
+            if(with_matrix){
+                m2.triangularView<Upper>() += other.m2;
+                m2.selfadjointView<Upper>().rankUpdate(delta, double(n)*double(other.n)/nn);
+            }
+            mu += delta*(other.n/nn);
+        }
+        n += other.n;
+        samples.insert(samples.end(),other.samples.begin(),other.samples.end());
+    }
+
+    // Unflushed samples of other are added as a separate block
+    add_block(other.buf.leftCols(other.n_buf));
+}
+
+const VectorXd &Covariance_accumulator::mean()
+{
+    flush();
+    return mu;
+}
+
+MatrixXd Covariance_accumulator::covariance()
+{
+    if(!with_matrix) throw Pteros_error("Covariance accumulator was created without full matrix!");
+    flush();
+    if(n==0) throw Pteros_error("No samples in covariance accumulator!");
+    MatrixXd c = m2.selfadjointView<Upper>();
+    return c/double(n);
+}
+
+void Covariance_accumulator::pca(VectorXd &eigenvalues, MatrixXd &eigenvectors, int n_comp, int oversampling, int n_power_iter)
+{
+    flush();
+    if(n==0) throw Pteros_error("No samples in covariance accumulator!");
+    if(n_comp<=0 || n_comp>n_dim) n_comp = n_dim;
+
+    if(with_samples){
+        // Randomized subspace iteration. Covariance matrix is never formed,
+        // only its products with thin matrices are computed from stored samples.
+        // The rank of covariance matrix can't exceed the number of samples.
+        int l = std::min(n_comp+oversampling, n_dim);
+        l = std::min<long>(l, n);
+        n_comp = std::min(n_comp, l);
+
+        std::mt19937 gen(1234);
+        std::normal_distribution<double> distr;
+        MatrixXd q(n_dim,l);
+        for(int j=0;j<l;++j) for(int i=0;i<n_dim;++i) q(i,j) = distr(gen);
+
+        for(int it=0; it<=n_power_iter; ++it){
+            HouseholderQR<MatrixXd> qr(samples_product(q));
+            q = qr.householderQ()*MatrixXd::Identity(n_dim,l);
+        }
+
+        // Rayleigh-Ritz projection onto the subspace
+        MatrixXd t = q.transpose()*samples_product(q)/double(n);
+        SelfAdjointEigenSolver<MatrixXd> solver(t);
+        eigenvalues = solver.eigenvalues().reverse().head(n_comp);
+        eigenvectors = q * solver.eigenvectors().rowwise().reverse().leftCols(n_comp);
+
+    } else if(with_matrix){
+        SelfAdjointEigenSolver<MatrixXd> solver(covariance());
+        eigenvalues = solver.eigenvalues().reverse().head(n_comp);
+        eigenvectors = solver.eigenvectors().rowwise().reverse().leftCols(n_comp);
+    } else {
+        throw Pteros_error("PCA requires either full matrix or stored samples in covariance accumulator!");
+    }
+}
+
+void Covariance_accumulator::flush()
+{
+    add_block(buf.leftCols(n_buf));
+    n_buf = 0;
+}
+
+void Covariance_accumulator::add_block(const Eigen::Ref<const MatrixXd> &block)
+{
+    int k = block.cols();
+    if(k==0) return;
+
+    VectorXd block_mu = block.rowwise().mean();
+
+    if(with_matrix){
+        // Scatter of the block around its own mean by single rank-k update
+        MatrixXd centered = block.colwise()-block_mu;
+        m2.selfadjointView<Upper>().rankUpdate(centered);
+    }
+
+    if(with_samples) samples.push_back(block.cast<float>());
+
+    // Chan et al. pairwise update of mean and scatter matrix
+    double nn = n+k;
+    VectorXd delta = block_mu-mu;
+    if(with_matrix && n>0) m2.selfadjointView<Upper>().rankUpdate(delta, double(n)*double(k)/nn);
+    mu += delta*(k/nn);
+    n += k;
+}
+
+MatrixXd Covariance_accumulator::samples_product(const MatrixXd &m) const
+{
+    MatrixXd res(MatrixXd::Zero(n_dim,m.cols()));
+    for(const auto& s: samples){
+        MatrixXd centered = s.cast<double>().colwise()-mu;
+        res.noalias() += centered*(centered.transpose()*m);
+    }
+    return res;
+}
+
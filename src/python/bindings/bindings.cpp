@@ -1,6 +1,7 @@
 #include "pteros/core/selection.h"
 #include "pteros/core/logging.h"
 #include "pteros/core/utilities.h"
+#include "pteros/core/thread_pool.h"
 #include "pteros/core/pteros_error.h"
 #include "bindings_util.h"
 #include "pteros/core/version.h"
@@ -48,6 +49,8 @@ PYBIND11_MODULE(_pteros, m) {
         .def("critical",[](spdlog::logger* log, const string& str){log->critical(str);})
     ;
     m.def("set_log_level",&set_log_level);
+    m.def("set_num_threads",&set_num_threads,"n"_a);
+    m.def("get_num_threads",&get_num_threads);
 
     m.def("angle_between_vectors",&angle_between_vectors);
     m.def("project_vector",&project_vector);
@@ -70,6 +73,9 @@ PYBIND11_MODULE(_pteros, m) {
             .def(py::init<float,float,int>())
             .def("add",py::overload_cast<float,float>(&Histogram::add),"value"_a,"weight"_a=1.0)
             .def("add",py::overload_cast<const vector<float>&>(&Histogram::add))
+            .def("add",py::overload_cast<const vector<float>&,const vector<float>&>(&Histogram::add),"values"_a,"weights"_a)
+            .def("merge",&Histogram::merge)
+            .def("empty_copy",&Histogram::empty_copy)
             .def("add_cylindrical",&Histogram::add_cylindrical)
             .def("normalize",&Histogram::normalize,"norm"_a=0)
             .def("value",&Histogram::value)
@@ -84,8 +90,29 @@ PYBIND11_MODULE(_pteros, m) {
 
     py::class_<Histogram2D>(m,"Histogram2D")
             .def(py::init<float,float,int,float,float,int>())
-            .def("add",&Histogram2D::add,"v1"_a,"v2"_a,"weight"_a=1.0)
+            .def("add",py::overload_cast<float,float,float>(&Histogram2D::add),"v1"_a,"v2"_a,"weight"_a=1.0)
+            .def("merge",&Histogram2D::merge)
+            .def("empty_copy",&Histogram2D::empty_copy)
             .def("normalize",&Histogram2D::normalize,"norm"_a=0)
             .def("save_to_file",&Histogram2D::save_to_file)
     ;
+
+    py::class_<Covariance_accumulator>(m,"Covariance_accumulator")
+            .def(py::init<int,bool,bool,int>(),"dim"_a,"full_matrix"_a=true,"keep_samples"_a=false,"block_size"_a=64)
+            .def("add",py::overload_cast<const Eigen::Ref<const Eigen::VectorXd>&>(&Covariance_accumulator::add))
+            .def("merge",&Covariance_accumulator::merge)
+            .def_property_readonly("num_samples",&Covariance_accumulator::num_samples)
+            .def_property_readonly("dim",&Covariance_accumulator::dim)
+            .def("mean",&Covariance_accumulator::mean)
+            .def("covariance",&Covariance_accumulator::covariance,py::call_guard<py::gil_scoped_release>())
+            .def("pca",[](Covariance_accumulator* c, int n_comp, int oversampling, int n_power_iter){
+                Eigen::VectorXd eigenvalues;
+                Eigen::MatrixXd eigenvectors;
+                {
+                    py::gil_scoped_release release;
+                    c->pca(eigenvalues,eigenvectors,n_comp,oversampling,n_power_iter);
+                }
+                return py::make_tuple(eigenvalues,eigenvectors);
+            },"n_comp"_a=-1,"oversampling"_a=10,"n_power_iter"_a=3)
+    ;
 }
@@ -29,6 +29,7 @@
 
 
 #include "pteros/core/distance_search.h"
+#include "pteros/core/hbonds.h"
 #include "bindings_util.h"
 
 namespace py = pybind11;
@@ -50,7 +51,10 @@ void make_bindings_Distance_search(py::module& m){
         std::vector<float>* dist_vec_ptr = do_dist_vec ? new std::vector<float> : nullptr;
         std::vector<Vector2i>* pairs_ptr = new std::vector<Vector2i>;
 
-        search_contacts(d,sel,*pairs_ptr,absolute_index,periodic,dist_vec_ptr);
+        {
+            py::gil_scoped_release release;
+            search_contacts(d,sel,*pairs_ptr,absolute_index,periodic,dist_vec_ptr);
+        }
 
         // Interpret pairs array as 1D array of ints first and convert to py::array
         // Pass size*2 explicitly to ensure correct size
@@ -80,7 +84,10 @@ void make_bindings_Distance_search(py::module& m){
     {
         std::vector<float>* dist_vec_ptr = do_dist_vec ? new std::vector<float> : nullptr;
         std::vector<Vector2i>* pairs_ptr = new std::vector<Vector2i>;
-        search_contacts(d,sel1,sel2,*pairs_ptr,absolute_index,periodic,dist_vec_ptr);
+        {
+            py::gil_scoped_release release;
+            search_contacts(d,sel1,sel2,*pairs_ptr,absolute_index,periodic,dist_vec_ptr);
+        }
 
         if(pairs_ptr->size()){
             // Interpret pairs array as 1D array of ints first
@@ -104,6 +111,26 @@ void make_bindings_Distance_search(py::module& m){
     }, "d"_a, "sel1"_a, "sel2"_a, "abs_ind"_a=false, "periodic"_a=false,"do_distances"_a=false);
 
 
+    m.def("search_distances_histogram",[](float d, const Selection& sel, int nbins, bool periodic){
+        VectorXd hist = VectorXd::Zero(nbins);
+        {
+            py::gil_scoped_release release;
+            search_distances_histogram(d,sel,hist,periodic);
+        }
+        return hist;
+    }, "d"_a, "sel"_a, "nbins"_a, "periodic"_a=false);
+
+
+    m.def("search_distances_histogram",[](float d, const Selection& sel1, const Selection& sel2, int nbins, bool periodic){
+        VectorXd hist = VectorXd::Zero(nbins);
+        {
+            py::gil_scoped_release release;
+            search_distances_histogram(d,sel1,sel2,hist,periodic);
+        }
+        return hist;
+    }, "d"_a, "sel1"_a, "sel2"_a, "nbins"_a, "periodic"_a=false);
+
+
     m.def("search_within",[](float d,
           const Selection& src,
           const Selection& target,
@@ -112,29 +139,68 @@ void make_bindings_Distance_search(py::module& m){
           )
     {
         std::vector<int>* res_ptr = new std::vector<int>;
-        search_within(d,src,target,*res_ptr,include_self,periodic);
+        {
+            py::gil_scoped_release release;
+            search_within(d,src,target,*res_ptr,include_self,periodic);
+        }
         return vector_to_array<int>(res_ptr);
     }, "d"_a, "src"_a, "target"_a, "include_self"_a=true, "periodic"_a=false);
 
 
     py::class_<Distance_search_within>(m, "Distance_search_within")
-            .def(py::init<float,const Selection&,bool,bool>(), "d"_a,"src"_a,"abs_ind"_a=false,"periodic"_a=false)
-            .def("setup",&Distance_search_within::setup, "d"_a,"src"_a,"abs_ind"_a=false,"periodic"_a=false)
+            .def(py::init<float,const Selection&,bool,bool>(), "d"_a,"src"_a,"abs_ind"_a=false,"periodic"_a=false, py::call_guard<py::gil_scoped_release>())
+            .def("setup",&Distance_search_within::setup, "d"_a,"src"_a,"abs_ind"_a=false,"periodic"_a=false, py::call_guard<py::gil_scoped_release>())
 
             .def("search_within",[](Distance_search_within* obj, Vector3f_const_ref coord)
                 {
                    std::vector<int>* res_ptr = new std::vector<int>;
-                   obj->search_within(coord,*res_ptr);
+                   {
+                       py::gil_scoped_release release;
+                       obj->search_within(coord,*res_ptr);
+                   }
                    return vector_to_array<int>(res_ptr);
                 })
 
             .def("search_within",[](Distance_search_within* obj, const Selection& target, bool include_self)
                 {
                     std::vector<int>* res_ptr = new std::vector<int>;
-                    obj->search_within(target,*res_ptr,include_self);
+                    {
+                        py::gil_scoped_release release;
+                        obj->search_within(target,*res_ptr,include_self);
+                    }
                     return vector_to_array<int>(res_ptr);
                 },"target"_a, "include_self"_a=true)
     ;
-}
 
 
+    py::class_<Hbond_search>(m, "Hbond_search")
+            .def(py::init<>())
+            .def(py::init<const Selection&,float,float,bool,float>(),
+                 "sel"_a,"d"_a=0.35,"angle"_a=30,"periodic"_a=true,"bond_d"_a=0, py::call_guard<py::gil_scoped_release>())
+            .def(py::init<const Selection&,const Selection&,float,float,bool,float>(),
+                 "donors"_a,"acceptors"_a,"d"_a=0.35,"angle"_a=30,"periodic"_a=true,"bond_d"_a=0, py::call_guard<py::gil_scoped_release>())
+            .def("set_frame",&Hbond_search::set_frame)
+            .def_property_readonly("num_donors",&Hbond_search::num_donors)
+            .def_property_readonly("num_hydrogens",&Hbond_search::num_hydrogens)
+            .def_property_readonly("num_acceptors",&Hbond_search::num_acceptors)
+            .def_property_readonly("donors",&Hbond_search::get_donors)
+            .def_property_readonly("acceptors",&Hbond_search::get_acceptors)
+            // Returns (N,3) array of donor, hydrogen and acceptor indexes, distances and angles
+            .def("search",[](const Hbond_search* obj)
+                {
+                    vector<Hbond> res;
+                    {
+                        py::gil_scoped_release release;
+                        obj->search(res);
+                    }
+                    MatrixXi ind(res.size(),3);
+                    VectorXf dist(res.size()), ang(res.size());
+                    for(int i=0;i<res.size();++i){
+                        ind.row(i) << res[i].donor, res[i].hydrogen, res[i].acceptor;
+                        dist(i) = res[i].dist;
+                        ang(i) = res[i].angle;
+                    }
+                    return py::make_tuple(ind,dist,ang);
+                })
+    ;
+}
@@ -29,6 +29,7 @@
 
 
 #include "pteros/core/system.h"
+#include "pteros/core/pteros_error.h"
 #include "bindings_util.h"
 
 namespace py = pybind11;
@@ -36,12 +37,30 @@ using namespace pteros;
 using namespace std;
 using namespace pybind11::literals;
 
+// Property returning Nx3 numpy view over the frame storage.
+// Assignment copies the data from (N,3) or (3,N) array resizing the storage if needed.
+#define DEF_FRAME_VIEW(_name) \
+    .def_property(#_name, \
+        [](py::object self){ return vector3f_view(self.cast<Frame&>()._name, self); }, \
+        [](Frame* fr, const py::array_t<float, py::array::forcecast>& arr){ \
+            bool tr = vector3f_is_transposed(arr); \
+            int n = tr ? arr.shape(1) : arr.shape(0); \
+            fr->_name.resize(n); \
+            auto r = arr.unchecked<2>(); \
+            for(int i=0;i<n;++i) \
+                fr->_name[i] = tr ? Eigen::Vector3f(r(0,i),r(1,i),r(2,i)) : Eigen::Vector3f(r(i,0),r(i,1),r(i,2)); \
+        })
+
 void make_bindings_Frame(py::module& m){
 
     py::class_<Frame>(m, "Frame")
+        .def(py::init<>())
         .def_readwrite("time", &Frame::time)
         .def_readwrite("box", &Frame::box)
-        .def_readwrite("coord", &Frame::coord)
+        // Coordinates, velocities and forces are exposed as writable Nx3 numpy views
+        DEF_FRAME_VIEW(coord)
+        DEF_FRAME_VIEW(vel)
+        DEF_FRAME_VIEW(force)
         .def("has_vel",&Frame::has_vel)
         .def("has_force",&Frame::has_force)
     ;
@@ -83,20 +83,21 @@ void make_bindings_Membrane(py::module& m){
     ;
 
     py::class_<Membrane>(m,"Membrane")
-        .def(py::init<System*,const std::vector<Lipid_descr>&>())
-        .def(py::init<System*,const std::vector<Lipid_descr>&,int>())
-        .def(py::init<System*,const std::vector<Lipid_descr>&,int,bool>())
+        .def(py::init<System*,const std::vector<Lipid_descr>&>(), py::call_guard<py::gil_scoped_release>())
+        .def(py::init<System*,const std::vector<Lipid_descr>&,int>(), py::call_guard<py::gil_scoped_release>())
+        .def(py::init<System*,const std::vector<Lipid_descr>&,int,bool>(), py::call_guard<py::gil_scoped_release>())
 
         .def("compute_properties",&Membrane::compute_properties,
              "d"_a,
              "use_external_normal"_a=false,
              "external_pivot"_a=Eigen::Vector3f::Zero(),
-             "external_dist_dim"_a=Eigen::Vector3i::Ones()
+             "external_dist_dim"_a=Eigen::Vector3i::Ones(),
+             py::call_guard<py::gil_scoped_release>()
             )
-        .def("compute_averages",&Membrane::compute_averages)
-        .def("write_averages",&Membrane::write_averages)
-        .def("write_vmd_arrows",&Membrane::write_vmd_arrows)
-        .def("write_smoothed",&Membrane::write_smoothed)
+        .def("compute_averages",&Membrane::compute_averages, py::call_guard<py::gil_scoped_release>())
+        .def("write_averages",&Membrane::write_averages, py::call_guard<py::gil_scoped_release>())
+        .def("write_vmd_arrows",&Membrane::write_vmd_arrows, py::call_guard<py::gil_scoped_release>())
+        .def("write_smoothed",&Membrane::write_smoothed, py::call_guard<py::gil_scoped_release>())
         .def("num_lipids",&Membrane::num_lipids)
         .def("get_lipid",&Membrane::get_lipid,py::return_value_policy::reference_internal)        
         .def_readonly("lipids",&Membrane::lipids)
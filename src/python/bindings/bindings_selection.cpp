@@ -29,6 +29,7 @@
 
 
 #include "pteros/core/selection.h"
+#include "pteros/core/unwrap_plan.h"
 #include "pteros/core/pteros_error.h"
 #include "bindings_util.h"
 
@@ -41,6 +42,45 @@ using namespace pybind11::literals;
 #define DEF_PROPERTY(_name,_dtype) \
     .def_property(#_name, [](Atom_proxy* obj){return obj->_name();}, [](Atom_proxy* obj,const _dtype& val){obj->_name()=val;})
 
+// Gathering of Nx3 array of selected atoms for the current frame
+// and scattering it back into the frame storage
+#define DEF_GATHER_SCATTER(_name,_field) \
+    .def("get_" #_name, [](Selection* sel){ \
+            const Frame& fr = sel->get_system()->frame(sel->get_frame()); \
+            if(fr._field.empty() && sel->size()) throw Pteros_error("System has no " #_field "!"); \
+            return vector3f_gather(fr._field, sel->index_begin(), sel->index_end()); \
+        }) \
+    .def("set_" #_name, [](Selection* sel, const py::array_t<float, py::array::forcecast>& arr){ \
+            System* sys = sel->get_system(); \
+            Frame& fr = sys->frame(sel->get_frame()); \
+            if(fr._field.empty()) fr._field.resize(sys->num_atoms(),Eigen::Vector3f::Zero()); \
+            vector3f_scatter(fr._field, sel->index_begin(), sel->index_end(), arr); \
+        })
+
+// Numeric fields of selected atoms are gathered into typed numpy array
+// and scattered back from any array convertible to this type
+#define DEF_ATOM_FIELD(_name,_type) \
+    .def("get_" #_name, [](Selection* sel){ \
+            return atom_field_gather(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::_name); \
+        }) \
+    .def("set_" #_name, py::overload_cast<_type>(&Selection::set_##_name)) \
+    .def("set_" #_name, [](Selection* sel, const py::array_t<_type, py::array::forcecast>& arr){ \
+            atom_field_scatter(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::_name, arr); \
+        })
+
+// Textual fields of selected atoms are also available as numpy arrays
+// of fixed-width byte strings. Setter from array is tried before the list one.
+#define DEF_ATOM_STRING_FIELD(_name) \
+    .def("get_" #_name, &Selection::get_##_name,"unique"_a=false) \
+    .def("get_" #_name "_array", [](Selection* sel){ \
+            return atom_string_gather(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::_name); \
+        }) \
+    .def("set_" #_name, py::overload_cast<string>(&Selection::set_##_name)) \
+    .def("set_" #_name, [](Selection* sel, const py::array& arr){ \
+            atom_string_scatter(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::_name, arr); \
+        }) \
+    .def("set_" #_name, py::overload_cast<const std::vector<string>&>(&Selection::set_##_name))
+
 void make_bindings_Selection(py::module& m){
 
     using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
@@ -88,10 +128,14 @@ void make_bindings_Selection(py::module& m){
         .def(py::self & py::self)
         .def(py::self - py::self)
         .def(~py::self)
+        .def(py::self |= py::self)
+        .def(py::self &= py::self)
+        .def(py::self -= py::self)
 
         // Modification
         .def("append", py::overload_cast<const Selection&>(&Selection::append))
         .def("append", py::overload_cast<int>(&Selection::append))
+        .def("append", py::overload_cast<const std::vector<int>&>(&Selection::append))
         .def("remove", py::overload_cast<const Selection&>(&Selection::remove))
         .def("remove", py::overload_cast<int>(&Selection::remove))
         .def("invert",&Selection::invert)
@@ -127,49 +171,36 @@ void make_bindings_Selection(py::module& m){
         .def("set_chain",py::overload_cast<char>(&Selection::set_chain))
         .def("set_chain",py::overload_cast<const std::vector<char>&>(&Selection::set_chain))
 
-        .def("get_resid",&Selection::get_resid,"unique"_a=false)
+        .def("get_resid",[](Selection* sel, bool unique){
+                if(unique) return py::array(py::array_t<int>(py::cast(sel->get_resid(true))));
+                return py::array(atom_field_gather(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::resid));
+            },"unique"_a=false)
         .def("set_resid",py::overload_cast<int>(&Selection::set_resid))
-        .def("set_resid",py::overload_cast<const std::vector<int>&>(&Selection::set_resid))
-
-        .def("get_resindex",&Selection::get_resindex,"unique"_a=false)
-
-        .def("get_name",&Selection::get_name,"unique"_a=false)
-        .def("set_name",py::overload_cast<string>(&Selection::set_name))
-        .def("set_name",py::overload_cast<const std::vector<string>&>(&Selection::set_name))
-
-        .def("get_resname",&Selection::get_resname,"unique"_a=false)
-        .def("set_resname",py::overload_cast<string>(&Selection::set_resname))
-        .def("set_resname",py::overload_cast<const std::vector<string>&>(&Selection::set_resname))
-
-        .def("get_xyz", [](Selection* sel){ return sel->get_xyz(true); }) // pass true for row-major matrix
-        .def("set_xyz", &Selection::set_xyz) // detects raw-major matrix internally
-
-        .def("get_vel", [](Selection* sel){ return sel->get_vel(true); }) // pass true for row-major matrix
-        .def("set_vel", &Selection::set_vel) // detects raw-major matrix internally
-
-        .def("get_force", [](Selection* sel){ return sel->get_force(true); }) // pass true for row-major matrix
-        .def("set_force", &Selection::set_force) // detects raw-major matrix internally
+        .def("set_resid",[](Selection* sel, const py::array_t<int, py::array::forcecast>& arr){
+                atom_field_scatter(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::resid, arr);
+            })
 
-        .def("get_mass",&Selection::get_mass)
-        .def("set_mass",py::overload_cast<float>(&Selection::set_mass))
-        .def("set_mass",py::overload_cast<const std::vector<float>&>(&Selection::set_mass))
+        .def("get_resindex",[](Selection* sel, bool unique){
+                if(unique) return py::array(py::array_t<int>(py::cast(sel->get_resindex(true))));
+                return py::array(atom_field_gather(*sel->get_system(), sel->index_begin(), sel->index_end(), &Atom::resindex));
+            },"unique"_a=false)
 
-        .def("get_beta",&Selection::get_beta)
-        .def("set_beta",py::overload_cast<float>(&Selection::set_beta))
-        .def("set_beta",py::overload_cast<const std::vector<float>&>(&Selection::set_beta))
+        DEF_ATOM_STRING_FIELD(name)
+        DEF_ATOM_STRING_FIELD(resname)
 
-        .def("get_occupancy",&Selection::get_occupancy)
-        .def("set_occupancy",py::overload_cast<float>(&Selection::set_occupancy))
-        .def("set_occupancy",py::overload_cast<const std::vector<float>&>(&Selection::set_occupancy))
+        // Coordinates, velocities and forces are gathered directly into new numpy array
+        // and scattered back from it without intermediate Eigen matrices
+        DEF_GATHER_SCATTER(xyz,coord)
+        DEF_GATHER_SCATTER(vel,vel)
+        DEF_GATHER_SCATTER(force,force)
 
-        .def("get_charge",&Selection::get_charge)
+        DEF_ATOM_FIELD(mass,float)
+        DEF_ATOM_FIELD(beta,float)
+        DEF_ATOM_FIELD(occupancy,float)
+        DEF_ATOM_FIELD(charge,float)
         .def("get_total_charge",&Selection::get_total_charge)
-        .def("set_charge",py::overload_cast<float>(&Selection::set_charge))
-        .def("set_charge",py::overload_cast<const std::vector<float>&>(&Selection::set_charge))
 
-        .def("get_tag",&Selection::get_tag,"unique"_a=false)
-        .def("set_tag",py::overload_cast<string>(&Selection::set_tag))
-        .def("set_tag",py::overload_cast<const std::vector<string>&>(&Selection::set_tag))
+        DEF_ATOM_STRING_FIELD(tag)
 
         // Properties
         .def("center",&Selection::center,"mass_weighted"_a=false,"pbc"_a=noPBC,"pbc_atom"_a=-1)
@@ -185,7 +216,11 @@ void make_bindings_Selection(py::module& m){
             vol_ptr = do_total_volume ? &vol : nullptr;
             area_per_atom_ptr = do_area_per_atom ? &area_per_atom : nullptr;
             volume_per_atom_ptr = do_vol_per_atom ? &volume_per_atom : nullptr;
-            float a = sel->powersasa(probe_r,area_per_atom_ptr,vol_ptr,volume_per_atom_ptr);
+            float a;
+            {
+                py::gil_scoped_release release;
+                a = sel->powersasa(probe_r,area_per_atom_ptr,vol_ptr,volume_per_atom_ptr);
+            }
             py::list ret;
             ret.append(a);            
             if(do_area_per_atom) ret.append(area_per_atom);
@@ -198,7 +233,11 @@ void make_bindings_Selection(py::module& m){
             std::vector<float> area_per_atom;
             std::vector<float> *area_per_atom_ptr;
             area_per_atom_ptr = do_area_per_atom ? &area_per_atom : nullptr;
-            float a = sel->sasa(probe_r,area_per_atom_ptr,n_sphere_points);
+            float a;
+            {
+                py::gil_scoped_release release;
+                a = sel->sasa(probe_r,area_per_atom_ptr,n_sphere_points);
+            }
             py::list ret;
             ret.append(a);
             if(do_area_per_atom) ret.append(area_per_atom);
@@ -207,7 +246,7 @@ void make_bindings_Selection(py::module& m){
 
         .def("average_structure", [](Selection* sel, int b, int e){
                 return sel->average_structure(b,e,true); // pass true for row-major matrix
-            }, "b"_a=0, "e"_a=-1)
+            }, "b"_a=0, "e"_a=-1, py::call_guard<py::gil_scoped_release>())
 
         .def("atom_traj", [](Selection* sel, int i, int b, int e){
                 return sel->atom_traj(i,b,e,true); // pass true for row-major matrix
@@ -246,13 +285,13 @@ void make_bindings_Selection(py::module& m){
         // Fitting and rmsd
         .def("rmsd",py::overload_cast<int>(&Selection::rmsd,py::const_))
         .def("rmsd",py::overload_cast<int,int>(&Selection::rmsd,py::const_))
-        .def("fit_trajectory",&Selection::fit_trajectory, "ref_frame"_a=0, "b"_a=0, "e"_a=-1)
-        .def("fit",&Selection::fit)
+        .def("fit_trajectory",&Selection::fit_trajectory, "ref_frame"_a=0, "b"_a=0, "e"_a=-1, py::call_guard<py::gil_scoped_release>())
+        .def("fit",&Selection::fit, py::call_guard<py::gil_scoped_release>())
 
         .def("fit_transform", [](Selection* sel, int fr1, int fr2){
                 Matrix4f m = sel->fit_transform(fr1,fr2).matrix().transpose();
                 return m;
-            })
+            }, py::call_guard<py::gil_scoped_release>())
 
         .def("apply_transform", [](Selection* sel, const Eigen::Ref<const Eigen::Matrix4f>& m){
                 Affine3f t(m.transpose());
@@ -260,10 +299,10 @@ void make_bindings_Selection(py::module& m){
             })
 
         // Energy
-        .def("non_bond_energy", &Selection::non_bond_energy, "cutoff"_a=0.0, "pbc"_a=true)
+        .def("non_bond_energy", &Selection::non_bond_energy, "cutoff"_a=0.0, "pbc"_a=true, py::call_guard<py::gil_scoped_release>())
 
         // IO
-        .def("write", py::overload_cast<string,int,int>(&Selection::write), "fname"_a, "b"_a=0, "e"_a=-1)
+        .def("write", py::overload_cast<string,int,int>(&Selection::write), "fname"_a, "b"_a=0, "e"_a=-1, py::call_guard<py::gil_scoped_release>())
 
         // Util
         .def("is_large",&Selection::is_large)
@@ -339,8 +378,8 @@ void make_bindings_Selection(py::module& m){
         // since no means to bind templated return value!
 
         // dssp
-        .def("dssp", py::overload_cast<string>(&Selection::dssp, py::const_))
-        .def("dssp", py::overload_cast<>(&Selection::dssp, py::const_))
+        .def("dssp", py::overload_cast<string>(&Selection::dssp, py::const_), py::call_guard<py::gil_scoped_release>())
+        .def("dssp", py::overload_cast<>(&Selection::dssp, py::const_), py::call_guard<py::gil_scoped_release>())
 
         // Accessors
         .def_property("box", [](Selection* obj){return obj->box();}, [](Selection* obj,const Periodic_box& val){obj->box()=val;})
@@ -353,18 +392,30 @@ void make_bindings_Selection(py::module& m){
     m.def("rmsd",[](const Selection& sel1, const Selection& sel2){ return rmsd(sel1,sel2); });
     m.def("rmsd",[](const Selection& sel1, int fr1, const Selection& sel2, int fr2){ return rmsd(sel1,fr1,sel2,fr2); });
 
-    m.def("fit",[](Selection& sel1, const Selection& sel2){ fit(sel1,sel2); });
+    m.def("fit",[](Selection& sel1, const Selection& sel2){ fit(sel1,sel2); }, py::call_guard<py::gil_scoped_release>());
     m.def("fit_transform",[](Selection& sel1, const Selection& sel2){
         Matrix4f m = fit_transform(sel1,sel2).matrix().transpose();
         return m;
-    });
+    }, py::call_guard<py::gil_scoped_release>());
 
     m.def("non_bond_energy", [](const Selection& sel1, const Selection& sel2,float cutoff,int fr,bool pbc){
         return non_bond_energy(sel1,sel2,cutoff,fr,pbc);
-    },"sel1"_a, "sel2"_a, "cutoff"_a=0.0, "fr"_a=-1, "pbc"_a=fullPBC);
+    },"sel1"_a, "sel2"_a, "cutoff"_a=0.0, "fr"_a=-1, "pbc"_a=fullPBC, py::call_guard<py::gil_scoped_release>());
 
     m.def("copy_coord",[](const Selection& sel1, int fr1, Selection& sel2, int fr2){ return copy_coord(sel1,fr1,sel2,fr2); });
     m.def("copy_coord",[](const Selection& sel1, Selection& sel2){ return copy_coord(sel1,sel2); });
+
+    py::class_<Unwrap_plan>(m, "Unwrap_plan")
+        .def(py::init<>())
+        .def(py::init<const Selection&,float,int>(),"sel"_a,"d"_a=0.0,"pbc_atom"_a=-1)
+        .def("create",&Unwrap_plan::create,"sel"_a,"d"_a=0.0,"pbc_atom"_a=-1)
+        .def("apply",py::overload_cast<Selection&,Array3i_const_ref>(&Unwrap_plan::apply, py::const_),
+             "sel"_a,"pbc"_a=fullPBC, py::call_guard<py::gil_scoped_release>())
+        .def("apply",py::overload_cast<System&,int,Array3i_const_ref>(&Unwrap_plan::apply, py::const_),
+             "sys"_a,"fr"_a,"pbc"_a=fullPBC, py::call_guard<py::gil_scoped_release>())
+        .def("num_pieces",&Unwrap_plan::num_pieces)
+        .def("num_atoms",&Unwrap_plan::num_atoms)
+    ;
 }
 
 
@@ -29,6 +29,7 @@
 
 
 #include "pteros/core/selection.h"
+#include "pteros/core/pteros_error.h"
 #include "bindings_util.h"
 
 namespace py = pybind11;
@@ -37,6 +38,15 @@ using namespace std;
 using namespace Eigen;
 using namespace pybind11::literals;
 
+// Method returning writable Nx3 numpy view over the frame storage.
+// View is valid until the atoms are added or deleted.
+#define DEF_SYSTEM_VIEW(_name) \
+    .def(#_name, [](py::object self, int fr){ \
+            System& s = self.cast<System&>(); \
+            if(fr<0 || fr>=s.num_frames()) throw Pteros_error("Invalid frame {} for system with {} frames!",fr,s.num_frames()); \
+            return vector3f_view(s.frame(fr)._name, self); \
+        }, "fr"_a=0)
+
 void make_bindings_System(py::module& m){
 
     py::class_<System>(m, "System")
@@ -67,8 +77,9 @@ void make_bindings_System(py::module& m){
         })
 
         // Loading
+        // GIL is released while reading, on_frame callback acquires it again when called
         .def("load", py::overload_cast<string,int,int,int,std::function<bool(System*,int)>>(&System::load),
-             "fname"_a, "b"_a=0, "e"_a=-1, "skip"_a=0, "on_frame"_a=nullptr)
+             "fname"_a, "b"_a=0, "e"_a=-1, "skip"_a=0, "on_frame"_a=nullptr, py::call_guard<py::gil_scoped_release>())
 
         // Selecting
         .def("__call__", py::overload_cast<>(&System::operator()), py::keep_alive<0,1>())
@@ -116,6 +127,11 @@ void make_bindings_System(py::module& m){
         .def("getVel", py::overload_cast<int,int>(&System::vel, py::const_), "i"_a, "fr"_a=0)
         .def("setVel", [](System* s,Vector3f_const_ref v,int i,int fr){ s->vel(i,fr)=v; }, "vel"_a, "i"_a, "fr"_a=0)
 
+        // Zero-copy Nx3 numpy views over the coordinates, velocities and forces of given frame
+        DEF_SYSTEM_VIEW(coord)
+        DEF_SYSTEM_VIEW(vel)
+        DEF_SYSTEM_VIEW(force)
+
         .def("getAtom", py::overload_cast<int>(&System::atom, py::const_))
         .def("setAtom", [](System* s, int i, const Atom& a){ s->atom(i)=a; })
 
@@ -144,6 +160,14 @@ void make_bindings_System(py::module& m){
         .def("force_field_ready", &System::force_field_ready)
         .def("assign_resindex", &System::assign_resindex, "start"_a=0)
         .def("sort_by_resindex", &System::sort_by_resindex)
+        .def("num_residues", &System::num_residues)
+        .def("residue_range", &System::residue_range)
+
+        // Selection profiling
+        .def("set_selection_profiling", &System::set_selection_profiling, "on"_a)
+        .def("is_selection_profiling", &System::is_selection_profiling)
+        .def("selection_profile_report", &System::selection_profile_report, "max_entries"_a=20)
+        .def("reset_selection_profile", &System::reset_selection_profile)
 
     ;
 }
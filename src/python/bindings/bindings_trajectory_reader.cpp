@@ -31,6 +31,8 @@
 #include "pteros/analysis/trajectory_reader.h"
 #include "pteros/analysis/options.h"
 #include "pteros/analysis/task_plugin.h"
+#include "pteros/analysis/correlation.h"
+#include "pteros/analysis/residence.h"
 #include "bindings_util.h"
 
 namespace py = pybind11;
@@ -84,8 +86,62 @@ public:
             info              /* Argument(s) */
         );
     }
+    void before_spawn() override {
+        py::gil_scoped_acquire acquire;
+        PYBIND11_OVERLOAD(
+            void, /* Return type */
+            Task_plugin,      /* Parent class */
+            before_spawn,          /* Name of function in C++ (must match Python name) */
+                          /* Argument(s) */
+        );
+    }
+
+    // Result of worker process is pickled
+    string get_result() override {
+        py::gil_scoped_acquire acquire;
+        py::function f = py::get_overload(static_cast<const Task_plugin*>(this),"get_result");
+        if(!f) return "";
+        return py::module::import("pickle").attr("dumps")(f()).cast<string>();
+    }
+
+    // Results of worker processes are unpickled and passed to Python as a list
+    void collect_results(const vector<string>& results, int n_frames) override {
+        py::gil_scoped_acquire acquire;
+        py::function f = py::get_overload(static_cast<const Task_plugin*>(this),"collect_results");
+        if(!f) return;
+        auto loads = py::module::import("pickle").attr("loads");
+        py::list l;
+        for(auto& r: results) l.append(loads(py::bytes(r)));
+        f(l,n_frames);
+    }
+
 protected:
-    bool is_parallel() override { return false; }
+    // Task is parallel if its class has attribute parallel=True
+    bool is_parallel() override {
+        py::gil_scoped_acquire acquire;
+        auto self = py::cast(static_cast<Task_plugin*>(this),py::return_value_policy::reference);
+        return py::hasattr(self,"parallel") && self.attr("parallel").cast<bool>();
+    }
+
+    // Python tasks can't run in threads because of GIL, so workers are forked
+    bool is_multiprocess() override { return true; }
+
+    // GIL is held across fork() and the interpreter state is fixed up after it
+    void before_fork() override {
+        fork_gil.reset(new py::gil_scoped_acquire);
+        PyOS_BeforeFork();
+    }
+
+    void after_fork(bool is_child) override {
+        if(is_child)
+            PyOS_AfterFork_Child();
+        else
+            PyOS_AfterFork_Parent();
+        fork_gil.reset();
+    }
+
+private:
+    std::unique_ptr<py::gil_scoped_acquire> fork_gil;
 };
 
 
@@ -141,6 +197,61 @@ void make_bindings_Trajectory_reader(py::module& m){
         .def("set_pbc_atom",&Jump_remover::set_pbc_atom)
     ;
 
+    py::class_<Time_correlation> tc(m,"Time_correlation");
+    py::enum_<Time_correlation::Storage>(tc,"Storage")
+        .value("Float",Time_correlation::Float)
+        .value("Half",Time_correlation::Half)
+        .value("Disk",Time_correlation::Disk)
+        .export_values()
+    ;
+    tc.def(py::init<int,int,Time_correlation::Storage>(),"n_series"_a,"n_dim"_a=1,"storage"_a=Time_correlation::Float)
+        .def("add_frame",&Time_correlation::add_frame)
+        .def("merge",&Time_correlation::merge)
+        .def_property_readonly("num_series",&Time_correlation::num_series)
+        .def_property_readonly("num_dim",&Time_correlation::num_dim)
+        .def_property_readonly("num_frames",&Time_correlation::num_frames)
+        .def("autocorrelation",&Time_correlation::autocorrelation,
+             "max_lag"_a=-1,"subtract_mean"_a=false,"normalize"_a=false, py::call_guard<py::gil_scoped_release>())
+        .def("autocorrelation_per_series",&Time_correlation::autocorrelation_per_series,
+             "max_lag"_a=-1,"subtract_mean"_a=false,"normalize"_a=false, py::call_guard<py::gil_scoped_release>())
+        .def("cross_correlation",&Time_correlation::cross_correlation,
+             "i"_a,"j"_a,"max_lag"_a=-1,"subtract_mean"_a=false, py::call_guard<py::gil_scoped_release>())
+    ;
+
+    py::class_<Multi_tau_correlator>(m,"Multi_tau_correlator")
+        .def(py::init<int,int,int,int,int>(),"n_series"_a,"n_dim"_a=1,"p"_a=16,"m"_a=2,"n_levels"_a=20)
+        .def("add_frame",&Multi_tau_correlator::add_frame)
+        .def("get_result",[](const Multi_tau_correlator* obj){
+            Eigen::VectorXd lags, corr;
+            obj->get_result(lags,corr);
+            return py::make_tuple(lags,corr);
+        })
+    ;
+
+    py::class_<Residence_stats>(m,"Residence_stats")
+        .def_readonly("num_frames",&Residence_stats::num_frames)
+        .def_readonly("num_visits",&Residence_stats::num_visits)
+        .def_readonly("mean_time",&Residence_stats::mean_time)
+        .def_readonly("max_time",&Residence_stats::max_time)
+    ;
+
+    py::class_<Residence_tracker>(m,"Residence_tracker")
+        .def(py::init<int>(),"n"_a)
+        .def("add_frame",&Residence_tracker::add_frame)
+        .def("merge",&Residence_tracker::merge)
+        .def_property_readonly("num_molecules",&Residence_tracker::num_molecules)
+        .def_property_readonly("num_frames",&Residence_tracker::num_frames)
+        .def("get_visits",&Residence_tracker::get_visits,"i"_a,"tolerance"_a=0)
+        .def("get_stats",&Residence_tracker::get_stats,"tolerance"_a=0)
+        .def("occupancy",&Residence_tracker::occupancy)
+        .def("exchange",[](const Residence_tracker* obj, int tolerance){
+            Eigen::VectorXi entered, left;
+            obj->exchange(entered,left,tolerance);
+            return py::make_tuple(entered,left);
+        },"tolerance"_a=0)
+        .def("survival_probability",&Residence_tracker::survival_probability,
+             "max_lag"_a=-1,"tolerance"_a=0, py::call_guard<py::gil_scoped_release>())
+    ;
 }
 
 
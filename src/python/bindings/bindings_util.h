@@ -36,6 +36,11 @@
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <pybind11/operators.h>
+#include <pybind11/numpy.h>
+#include <Eigen/Core>
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/system.h"
+#include <cstring>
 
 
 namespace py = pybind11;
@@ -48,4 +53,119 @@ py::array vector_to_array(std::vector<T>* ptr, size_t sz=-1){
     return py::array(sz, ptr->data(), capsule);
 }
 
+// Aux function to create writable Nx3 py::array on top of the storage of
+// std::vector<Vector3f> (coordinates, velocities or forces of the frame).
+// No data is copied. The array keeps base object alive, so the storage
+// remains valid as long as the vector is not resized.
+inline py::array vector3f_view(std::vector<Eigen::Vector3f>& v, py::handle base){
+    return py::array_t<float>({v.size(), size_t(3)},
+                              {sizeof(Eigen::Vector3f), sizeof(float)},
+                              v.empty() ? nullptr : v[0].data(),
+                              base);
+}
+
+// Aux function to gather Nx3 array from std::vector<Vector3f> using the range of indexes.
+// Performs single copy directly into numpy storage.
+inline py::array_t<float> vector3f_gather(const std::vector<Eigen::Vector3f>& v,
+                                          std::vector<int>::const_iterator b,
+                                          std::vector<int>::const_iterator e){
+    py::array_t<float> arr({size_t(e-b), size_t(3)});
+    auto r = arr.mutable_unchecked<2>();
+    for(size_t i=0; b!=e; ++b, ++i){
+        const Eigen::Vector3f& p = v[*b];
+        r(i,0) = p(0);
+        r(i,1) = p(1);
+        r(i,2) = p(2);
+    }
+    return arr;
+}
+
+// Aux function to check the layout of coordinate-like array of n vectors.
+// Returns false for (n,3) arrays and true for transposed (3,n) arrays, which were
+// accepted by older versions of the bindings. (n,3) is preferred if n==3.
+// If n<0 the number of vectors is deduced from the array.
+inline bool vector3f_is_transposed(const py::array_t<float, py::array::forcecast>& arr, long n=-1){
+    if(arr.ndim()==2){
+        if(arr.shape(1)==3 && (n<0 || arr.shape(0)==n)) return false;
+        if(arr.shape(0)==3 && (n<0 || arr.shape(1)==n)) return true;
+    }
+    if(n<0) throw pteros::Pteros_error("Array of shape (N,3) or (3,N) is expected!");
+    throw pteros::Pteros_error("Array of shape ({},3) or (3,{}) is expected!",n,n);
+}
+
+// Aux function to scatter Nx3 (or 3xN) array back to std::vector<Vector3f> using the range of indexes.
+// Array is only converted if it is not a float array already. Any memory order is accepted.
+inline void vector3f_scatter(std::vector<Eigen::Vector3f>& v,
+                             std::vector<int>::const_iterator b,
+                             std::vector<int>::const_iterator e,
+                             const py::array_t<float, py::array::forcecast>& arr){
+    bool tr = vector3f_is_transposed(arr,e-b);
+    auto r = arr.unchecked<2>();
+    if(tr){
+        for(size_t i=0; b!=e; ++b, ++i) v[*b] = Eigen::Vector3f(r(0,i),r(1,i),r(2,i));
+    } else {
+        for(size_t i=0; b!=e; ++b, ++i) v[*b] = Eigen::Vector3f(r(i,0),r(i,1),r(i,2));
+    }
+}
+
+// Aux function to gather numeric field of atoms into new typed numpy array
+// using the range of indexes.
+template<class T>
+py::array_t<T> atom_field_gather(const pteros::System& sys,
+                                 std::vector<int>::const_iterator b,
+                                 std::vector<int>::const_iterator e,
+                                 T pteros::Atom::* field){
+    py::array_t<T> arr(size_t(e-b));
+    T* p = arr.mutable_data();
+    for(; b!=e; ++b, ++p) *p = sys.atom(*b).*field;
+    return arr;
+}
+
+// Aux function to scatter numeric array back to the field of atoms
+// using the range of indexes.
+template<class T>
+void atom_field_scatter(pteros::System& sys,
+                        std::vector<int>::const_iterator b,
+                        std::vector<int>::const_iterator e,
+                        T pteros::Atom::* field,
+                        const py::array_t<T, py::array::forcecast>& arr){
+    if(arr.ndim()!=1 || arr.shape(0)!=e-b)
+        throw pteros::Pteros_error("Array of size {} is expected!",e-b);
+    auto r = arr.template unchecked<1>();
+    for(size_t i=0; b!=e; ++b, ++i) sys.atom(*b).*field = r(i);
+}
+
+// Aux function to gather textual field of atoms into numpy array
+// of fixed-width byte strings (dtype S<n>) using the range of indexes.
+// Width is determined by the longest string.
+inline py::array atom_string_gather(const pteros::System& sys,
+                                    std::vector<int>::const_iterator b,
+                                    std::vector<int>::const_iterator e,
+                                    std::string pteros::Atom::* field){
+    size_t w = 1;
+    for(auto it=b; it!=e; ++it) w = std::max(w, (sys.atom(*it).*field).size());
+    py::array arr(py::dtype::from_args(py::str("S"+std::to_string(w))), {size_t(e-b)});
+    char* p = (char*)arr.mutable_data();
+    std::memset(p, 0, (e-b)*w);
+    for(; b!=e; ++b, p+=w){
+        const std::string& str = sys.atom(*b).*field;
+        std::memcpy(p, str.data(), str.size());
+    }
+    return arr;
+}
 
+// Aux function to scatter numpy array of strings back to the textual field of atoms
+// using the range of indexes. Unicode arrays are converted to byte strings first.
+inline void atom_string_scatter(pteros::System& sys,
+                                std::vector<int>::const_iterator b,
+                                std::vector<int>::const_iterator e,
+                                std::string pteros::Atom::* field,
+                                py::array arr){
+    if(arr.dtype().attr("kind").cast<std::string>()!="S") arr = arr.attr("astype")("S");
+    if(arr.ndim()!=1 || arr.shape(0)!=e-b)
+        throw pteros::Pteros_error("Array of size {} is expected!",e-b);
+    arr = py::array::ensure(arr, py::array::c_style);
+    size_t w = arr.itemsize();
+    const char* p = (const char*)arr.data();
+    for(; b!=e; ++b, p+=w) sys.atom(*b).*field = std::string(p, strnlen(p,w));
+}
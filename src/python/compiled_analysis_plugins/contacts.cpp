@@ -40,13 +40,18 @@ using namespace std;
 using namespace pteros;
 using namespace Eigen;
 
+// Contact data accumulated by each task instance
 struct Contact {
-    vector<Vector2i> life_fr; // Intervals of frames[first:last]
-    vector<Vector2f> life_time; // Intervals of life time [first:last]
+    vector<int> frames; // Valid frames where contact is present
     Vector2f energy;
     int num_energy;
+};
+
+// Final statistics of the contact
+struct Contact_stats {
     float mean_life_time;
     int num_formed;
+    Vector2f energy;
 };
 
 
@@ -56,8 +61,10 @@ struct comparator {
     }
 };
 
+using Contact_map = map<Vector2i,Contact,comparator>;
+
 
-TASK_SERIAL(contacts)
+TASK_PARALLEL(contacts)
 public:
 
 
@@ -86,28 +93,20 @@ Options:
 
 protected:
 
-    void pre_process() override {
-        sel1.modify(system, options("sel1").as_string());
-        sel2.modify(system, options("sel2").as_string());
-        all.modify(system, "all");
+    void before_spawn() override {
+        sel1_text = options("sel1").as_string();
+        sel2_text = options("sel2").as_string();
 
-        // Check if selection overlap        
-        if(check_selection_overlap({sel1,sel2})) throw Pteros_error("Selections could not overlap!");
+        // Temporary selections for checking, not cloned to instances
+        Selection s1(system, sel1_text);
+        Selection s2(system, sel2_text);
+
+        // Check if selection overlap
+        if(check_selection_overlap({s1,s2})) throw Pteros_error("Selections could not overlap!");
 
         // Set periodicity
         periodic = options("periodic","false").as_bool();
 
-        /*
-        // Removing jumps for both selections if requested
-        float unwrap_d = options("unwrap","-1").as_float();
-        if(unwrap_d>=0){
-            // Add our selections to nojump list
-            jump_remover.add_atoms(sel1);
-            jump_remover.add_atoms(sel2);
-            jump_remover.set_unwrap_dist(unwrap_d);
-        }
-        */
-
         // Contacts cutoff
         cutoff = options("cutoff","0").as_float();
         // If zero cutoff given search for maximal sum of VDW distances
@@ -115,10 +114,10 @@ protected:
             log->info("Computing largest sum VDW distances...");
             float maxd = 0.0, vdw1, vdw2;
             int i,j;
-            for(i=0; i<sel1.size(); ++i){                
-                vdw1 = sel1.vdw(i);
-                for(j=0;j<sel2.size();++j){
-                    vdw2 = sel2.vdw(j);
+            for(i=0; i<s1.size(); ++i){
+                vdw1 = s1.vdw(i);
+                for(j=0;j<s2.size();++j){
+                    vdw2 = s2.vdw(j);
                     if(vdw1+vdw2 > maxd) maxd = vdw1+vdw2;
                 }
             }
@@ -127,16 +126,22 @@ protected:
             float pad = options("padding","0.1").as_float();
             cutoff = maxd + pad;
         } else if(cutoff==0) {
-            cutoff = system.get_force_field().get_cutoff();
+            const System& sys = system;
+            cutoff = sys.get_force_field().get_cutoff();
         } else {
-            float d = system.get_force_field().get_cutoff();
+            const System& sys = system;
+            float d = sys.get_force_field().get_cutoff();
             if(cutoff!=d) log->warn("Requested cutoff {} is different from cutoff in ff {}!",cutoff,d);
         }
 
         // Keep transient contacts lasting only 1 frame?
         keep_transient = options("transient","false").as_bool();
+    }
 
-        en_f.open(options("en_file",fmt::format("energy_{}.dat",get_id())).as_string());
+    void pre_process() override {
+        sel1.modify(system, sel1_text);
+        sel2.modify(system, sel2_text);
+        all.modify(system, "all");
     }     
 
     void process_frame(const pteros::Frame_info &info) override {
@@ -151,7 +156,7 @@ protected:
         search_contacts(cutoff,sel1,sel2,bon,true,periodic,&dist_vec); // global indexes returned!
 
         Vector2f total_en(0,0);
-        pair_en.resize(bon.size());
+        pair_en.resize(bon.size(),Vector2f::Zero());
 
         // Get energies if possible
         if(system.force_field_ready()){
@@ -167,152 +172,58 @@ protected:
             sort(c.data(), c.data()+c.size());
 
             for(int n=0; n<2; ++n){
-                // ATOM MAP
-                int a = c[n];
-                if(atom_map.count(a)){
-                    // already present
-                    atom_map[a] += 1;
-                } else {
-                    // new atom
-                    atom_map[a] = 1;
-                }
-
-                // RES MAP
-                int r = all.resindex(c[n]);
-                if(res_map.count(r)){
-                    // already present
-                    res_map[r] += 1;
-                } else {
-                    // new residue
-                    res_map[r] = 1;
-                }
+                atom_map[c[n]] += 1;
+                res_map[all.resindex(c[n])] += 1;
             }
 
-            // ATOM CONTACTS
-            // See if this contact was already found before
-            if(atom_contacts.count(c)){
-                // Already present
-                auto& cur = atom_contacts[c];
-                cur.energy += pair_en[i];
-                ++cur.num_energy;
-                if( cur.life_fr.back()[1] == info.valid_frame-1 ){
-                    // Interval continues
-                    cur.life_fr.back()[1] = info.valid_frame;
-                    cur.life_time.back()[1] = info.absolute_time;
-                } else {
-                    // New interval starts
-                    cur.life_fr.emplace_back(info.valid_frame,info.valid_frame);
-                    cur.life_time.emplace_back(info.absolute_time,info.absolute_time);
-                }
-            } else {
-                // New contact
-                Contact cur;
-                cur.life_time.emplace_back(info.absolute_time,info.absolute_time);
-                cur.life_fr.emplace_back(info.valid_frame,info.valid_frame);
-                cur.energy = pair_en[i];;
-                cur.num_energy = 1;
-                atom_contacts[c] = cur;
-            }
-
-            // RESIDUE CONTACTS
-
-            // Get pair of residues
-            Vector2i r(all.resindex(c(0)), all.resindex(c(1)));
-
-            //See if this contact was already found before
-            if(res_contacts.count(r)){
-                // Already present
-                auto& cur = res_contacts[r];
-                cur.energy += pair_en[i];
-                ++cur.num_energy;
-                if( cur.life_fr.back()[1] == info.valid_frame-1 ){
-                    // Interval continues
-                    cur.life_fr.back()[1] = info.valid_frame;
-                    cur.life_time.back()[1] = info.absolute_time;
-                } else if(info.valid_frame - cur.life_fr.back()[1] > 1) {
-                    // New interval starts
-                    cur.life_fr.emplace_back(info.valid_frame,info.valid_frame);
-                    cur.life_time.emplace_back(info.absolute_time,info.absolute_time);
-                }
-            } else {
-                // New contact
-                Contact cur;
-                cur.life_time.emplace_back(info.absolute_time,info.absolute_time);
-                cur.life_fr.emplace_back(info.valid_frame,info.valid_frame);
-                cur.energy = pair_en[i];
-                cur.num_energy = 1;
-                res_contacts[r] = cur;
-            }
-
-
+            // Frames come to each instance in increasing order
+            add_contact(atom_contacts[c], info.valid_frame, pair_en[i]);
+            add_contact(res_contacts[Vector2i(all.resindex(c(0)), all.resindex(c(1)))], info.valid_frame, pair_en[i]);
         }        
 
-        en_f << info.absolute_time << " " << total_en.sum() << " " << total_en.transpose() << endl;
+        frame_time[info.valid_frame] = info.absolute_time;
+        energy[info.valid_frame] = total_en;
     }
 
     void post_process(const pteros::Frame_info &info) override {
-        en_f.close();
-
-        // Analyze atom contacts
-        auto it = atom_contacts.begin();
-        while (it != atom_contacts.end()) {
-            auto& c = it->second;
-
-            if(c.num_energy) c.energy /= (float)c.num_energy;
-
-            c.mean_life_time = 0;
-            c.num_formed = 0;
-
-            for(auto& t: c.life_time){
-                c.mean_life_time += t(1)-t(0);
-                if(t(0)!=t(1) || keep_transient) ++c.num_formed;
-            }
-
-            if(c.num_formed == 0 && !keep_transient) {
-                it = atom_contacts.erase(it);
-            } else {
-                c.mean_life_time /= c.num_formed;
+    }
 
-                it++;
-            }
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        // Merge data of all instances
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<contacts*>(it.get());
+            merge_contacts(atom_contacts, h->atom_contacts);
+            merge_contacts(res_contacts, h->res_contacts);
+            for(const auto& a: h->atom_map) atom_map[a.first] += a.second;
+            for(const auto& r: h->res_map) res_map[r.first] += r.second;
+            frame_time.insert(h->frame_time.begin(),h->frame_time.end());
+            energy.insert(h->energy.begin(),h->energy.end());
         }
 
-        // Analyze residue contacts
-        it = res_contacts.begin();
-        while (it != res_contacts.end()) {
-            auto& c = it->second;
-
-            if(c.num_energy) c.energy /= (float)c.num_energy;
-
-            c.mean_life_time = 0;
-            c.num_formed = 0;
-
-            for(auto& t: c.life_time){
-                c.mean_life_time += t(1)-t(0);
-                if(t(0)!=t(1) || keep_transient) ++c.num_formed;
-            }
+        // Master instance may not consume any frames, so selection is made here
+        Selection all(system,"all");
 
-            if(c.num_formed == 0 && !keep_transient) {
-                it = atom_contacts.erase(it);
-            } else {
-                c.mean_life_time /= c.num_formed;
-
-                it++;
-            }
+        // Energy time series
+        ofstream f(options("en_file",fmt::format("energy_{}.dat",get_id())).as_string());
+        for(const auto& it: energy){
+            f << frame_time[it.first] << " " << it.second.sum() << " " << it.second.transpose() << endl;
         }
+        f.close();
 
         // Output atom contacts
-        ofstream f(options("oa",fmt::format("atom_contacts_stats_{}.dat",get_id())).as_string());
+        f.open(options("oa",fmt::format("atom_contacts_stats_{}.dat",get_id())).as_string());
         f << "# ATOMS" << endl;
         f << "#i\tj\tn_formed\tlife_t\ten" << endl;
-        for(const auto& it: atom_contacts){
+        for(auto& it: atom_contacts){
+            Contact_stats st;
+            if(!compute_stats(it.second,st)) continue;
             int i = it.first(0);
             int j = it.first(1);
-            f << sel1.index(i)+1 << ":" << all.name(i) << ":" << all.resname(i) << "\t"
-              << sel2.index(j)+1 << ":" << all.name(j) << ":" << all.resname(j) << "\t"
-              << it.second.num_formed << "\t"
-              << it.second.mean_life_time << "\t"
-              << it.second.energy.sum() << endl;
+            f << i+1 << ":" << all.name(i) << ":" << all.resname(i) << "\t"
+              << j+1 << ":" << all.name(j) << ":" << all.resname(j) << "\t"
+              << st.num_formed << "\t"
+              << st.mean_life_time << "\t"
+              << st.energy.sum() << endl;
         }
         f.close();
 
@@ -320,13 +231,13 @@ protected:
         f.open(options("or",fmt::format("res_contacts_stats_{}.dat",get_id())).as_string());
         f << "# RESIDUES" << endl;
         f << "#i\tj\tn_formed\tlife_t\ten" << endl;
-        for(const auto& it: res_contacts){
-            int i = it.first(0);
-            int j = it.first(1);
-            f << i << "\t" << j << "\t"
-              << it.second.num_formed << "\t"
-              << it.second.mean_life_time << "\t"
-              << it.second.energy.sum() << endl;
+        for(auto& it: res_contacts){
+            Contact_stats st;
+            if(!compute_stats(it.second,st)) continue;
+            f << it.first(0) << "\t" << it.first(1) << "\t"
+              << st.num_formed << "\t"
+              << st.mean_life_time << "\t"
+              << st.energy.sum() << endl;
         }
         f.close();
 
@@ -335,7 +246,7 @@ protected:
         for(const auto& it: atom_map) if(maxv<it.second) maxv=it.second;
 
         for(const auto& it: atom_map){
-            all.beta(it.first) = 100.0*it.second/float(info.valid_frame)/maxv;
+            all.beta(it.first) = 100.0*it.second/float(n_frames)/maxv;
         }
         all.write(fmt::format("atom_map_{}.pdb",get_id()));
 
@@ -344,28 +255,82 @@ protected:
         for(const auto& it: res_map) if(maxv<it.second) maxv=it.second;
 
         for(const auto& it: res_map){
-            all("resindex "+to_string(it.first)).set_beta( 100.0*it.second/float(info.valid_frame)/maxv );
+            all("resindex "+to_string(it.first)).set_beta( 100.0*it.second/float(n_frames)/maxv );
         }
         all.write(fmt::format("res_map_{}.pdb",get_id()));
     }
 
 private:    
     Selection sel1, sel2, all;
+    string sel1_text, sel2_text;
     float cutoff;
     bool periodic;
-    map<Vector2i,Contact,comparator> atom_contacts;
-    map<Vector2i,Contact,comparator> res_contacts;
     bool keep_transient;
 
-    ofstream en_f;
+    Contact_map atom_contacts;
+    Contact_map res_contacts;
 
     // Per atom life time heat map
     map<int,float> atom_map;
     // Per residue life time heat map
     map<int,float> res_map;
+    // Time of each valid frame
+    map<int,float> frame_time;
+    // Total energy for each frame
+    map<int,Vector2f> energy;
+
+    void add_contact(Contact& cur, int fr, const Vector2f& en){
+        if(cur.frames.empty()){
+            // New contact
+            cur.energy = en;
+            cur.num_energy = 1;
+        } else {
+            cur.energy += en;
+            ++cur.num_energy;
+        }
+        // Several atom pairs may give the same residue contact in one frame
+        if(cur.frames.empty() || cur.frames.back()!=fr) cur.frames.push_back(fr);
+    }
+
+    void merge_contacts(Contact_map& target, const Contact_map& src){
+        for(const auto& it: src){
+            auto& cur = target[it.first];
+            if(cur.frames.empty()){
+                cur = it.second;
+            } else {
+                cur.frames.insert(cur.frames.end(),it.second.frames.begin(),it.second.frames.end());
+                cur.energy += it.second.energy;
+                cur.num_energy += it.second.num_energy;
+            }
+        }
+    }
+
+    // Splits frames into continuous intervals. Returns false if contact is discarded.
+    bool compute_stats(Contact& c, Contact_stats& st){
+        sort(c.frames.begin(),c.frames.end());
+
+        st.energy = c.energy/float(c.num_energy);
+        st.mean_life_time = 0;
+        st.num_formed = 0;
+
+        int first = 0;
+        for(int i=1; i<=c.frames.size(); ++i){
+            if(i==c.frames.size() || c.frames[i]!=c.frames[i-1]+1){
+                // Interval [first:i-1] ends
+                if(i-1>first || keep_transient){
+                    st.mean_life_time += frame_time[c.frames[i-1]] - frame_time[c.frames[first]];
+                    ++st.num_formed;
+                }
+                first = i;
+            }
+        }
+
+        if(st.num_formed==0) return false;
+        st.mean_life_time /= st.num_formed;
+        return true;
+    }
 };
 
 
 CREATE_COMPILED_PLUGIN(contacts)
 
-
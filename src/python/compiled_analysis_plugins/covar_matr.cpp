@@ -29,98 +29,141 @@
 
 
 #include "pteros/python/compiled_plugin.h"
+#include "pteros/core/utilities.h"
 #include <fstream>
 
 using namespace std;
 using namespace pteros;
 using namespace Eigen;
 
-class covar_matr: public pteros::Compiled_plugin_base {
+TASK_PARALLEL(covar_matr)
 public:
-    covar_matr(pteros::Trajectory_processor* pr, const pteros::Options& opt): Compiled_plugin_base(pr,opt) {}
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes covariance matrix of atomic fluctuations
+    and optionally performs principal component analysis.
+    Selection should be coordinate-independent.
+Output:
+    File covar_matr_id<id>.dat with NxN matrix of traces of 3x3 blocks
+    of covariance matrix.
+    With -write_whole the file covar_matr_id<id>-whole.dat with 3Nx3N matrix
+    is also written.
+    With -pca the files covar_matr_id<id>-eigvals.dat and
+    covar_matr_id<id>-eigvecs.dat are written.
+Options:
+    -sel <string>
+        Selection text
+    -align <true|false>, default: true
+        Fit each frame to the first frame of the structure file
+    -write_whole <true|false>, default: false
+        Write the whole 3Nx3N matrix
+    -pca <int>, default: 0
+        Number of principal components to compute (0 - no PCA)
+    -matrix <true|false>, default: true
+        Compute and write covariance matrix. If false, PCA is computed
+        by randomized algorithm without forming the 3Nx3N matrix,
+        which is the only feasible way for very large selections.
+)";
+    }
 
 protected:
 
-    void pre_process(){
-        do_align = options("align","true").as_bool();        
-        sel.modify(system,options("selection").as_string() );
+    void before_spawn() override {
+        do_align = options("align","true").as_bool();
+        sel_text = options("sel").as_string();
 
+        // Frame 1 is the reference for fitting. It is cloned to all instances.
+        if(do_align && system.frame(0).coord.empty())
+            throw Pteros_error("Structure file with coordinates is required for fitting!");
         system.frame_dup(0);
 
-        N = sel.size();
+        N = Selection(system,sel_text).size();
+
+        n_pca = options("pca","0").as_int();
+        do_matrix = options("matrix","true").as_bool();
+        if(!do_matrix && n_pca<=0) throw Pteros_error("Nothing to compute without -matrix and -pca!");
+
+        // Accumulator is cloned to all instances
+        covar.create(3*N, do_matrix, !do_matrix);
+    }
 
-        matr.resize(3*N,3*N); matr.fill(0.0);
-        mean.resize(3,N); mean.fill(0.0);
+    void pre_process() override {
+        sel.modify(system,sel_text);
     }
 
-    void process_frame(const Frame_info &info){
+    void process_frame(const Frame_info &info) override {
         // Align if requested
         if(do_align) sel.fit(0,1);
 
-        int i,j;
-        // Do accumulation
-        for(i=0;i<N;++i){
-            mean.col(i) += sel.XYZ(i);
-            for(j=i;j<N;++j){
-                matr.block<3,3>(3*i,3*j) += sel.XYZ(i) * sel.XYZ(j).transpose();
-            }
-        }
+        // Coordinates of the frame as a single 3N vector
+        MatrixXf x = sel.get_xyz();
+        covar.add(Map<VectorXf>(x.data(),3*N));
     }
 
-    void post_process(const Frame_info &info){
-        string fname;
+    void post_process(const Frame_info &info) override {
+    }
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<covar_matr*>(it.get());
+            covar.merge(h->covar);
+        }
+
         ofstream f;
 
-        float T = float(info.valid_frame+1);
+        if(do_matrix){
+            MatrixXd matr = covar.covariance();
 
-        // Get average
-        mean /= T;
-        matr.triangularView<Eigen::Upper>() /= T;
+            if(options("write_whole","false").as_bool()){
+                // Output whole matrix
+                f.open(fmt::format("covar_matr_id{}-whole.dat",get_id()));
+                f << "# Covariance matrix (3N*3N)" << endl;
+                f << matr << endl;
+                f.close();
+            }
 
-        int i,j;
-        // Now compute covariance
-        for(i=0;i<N;++i){
-            for(j=i;j<N;++j){
-                matr.block<3,3>(3*i,3*j) -= mean.col(i)*mean.col(j).transpose();
+            // Output matrix of diagonal elements only (cov(x)+cov(y)+cov(z))
+            MatrixXd m(N,N);
+            for(int i=0;i<N;++i){
+                for(int j=0;j<N;++j){
+                    m(i,j) = matr.block<3,3>(3*i,3*j).trace();
+                }
             }
+
+            f.open(fmt::format("covar_matr_id{}.dat",get_id()));
+            f << "# Covariance matrix (N*N) of selection '" << sel_text << "'" << endl;
+            f << m << endl;
+            f.close();
         }
 
-        // Make simmetric
-        matr.triangularView<Eigen::StrictlyLower>() = matr.triangularView<Eigen::StrictlyUpper>().transpose();
+        if(n_pca>0){
+            VectorXd eigvals;
+            MatrixXd eigvecs;
+            covar.pca(eigvals,eigvecs,n_pca);
 
-        bool write_whole = options("write_whole","false").as_bool();
-        if(write_whole){
-            // Output whole matrix
-            fname = label+"-whole.dat";
-            f.open(fname.c_str());
-            f << "# Covariance matrix (3N*3N)" << endl;
-            f << matr << endl;
+            f.open(fmt::format("covar_matr_id{}-eigvals.dat",get_id()));
+            f << "# Eigenvalues of covariance matrix of selection '" << sel_text << "'" << endl;
+            f << eigvals << endl;
             f.close();
-        }
 
-        // Output matrix of diagonal elements only (cov(x)+cov(y)+cov(z))
-        Eigen::MatrixXd m(N,N);
-        for(i=0;i<N;++i){
-            for(j=0;j<N;++j){
-                m(i,j) = matr.block<3,3>(3*i,3*j).trace();
-            }
+            f.open(fmt::format("covar_matr_id{}-eigvecs.dat",get_id()));
+            f << "# Eigenvectors (3N*n_pca) of covariance matrix" << endl;
+            f << eigvecs << endl;
+            f.close();
         }
-
-        fname = label+".dat";
-        f.open(fname.c_str());
-        f << "# Covariance matrix (N*N)" << endl;
-        f << m << endl;
-        f.close();
     }
 
 private:
     bool do_align;
+    bool do_matrix;
+    int n_pca;
     int N;
-    MatrixXf matr;
-    MatrixXf mean;
+    Covariance_accumulator covar;
     Selection sel;
+    string sel_text;
 };
 
 CREATE_COMPILED_PLUGIN(covar_matr)
 
-
@@ -0,0 +1,154 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+#include "pteros/python/compiled_plugin.h"
+#include "pteros/core/grid.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+TASK_PARALLEL(density)
+public:
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes volumetric density map of selected atoms averaged over trajectory.
+    Coordinate-dependent selections are updated for each frame.
+Output:
+    File density_id<id>.dx (OpenDX) or density_id<id>.ccp4 (CCP4/MRC)
+    with density in units of weight per nm^3. Coordinates are in Angstroms.
+Options:
+    -sel <string>
+        Selection text
+    -weight <count|mass|charge>, default: count
+        Weight of each atom
+    -spacing <float>, default: 0.1
+        Grid spacing in nm
+    -sigma <float>, default: 0
+        If positive each atom is spread by Gaussian of given width in nm
+    -fit_sel <string>, default: none
+        If given, each frame is fitted by this selection to the structure file
+        and the grid covers the fixed region instead of periodic box.
+    -region <xmin ymin zmin xmax ymax zmax>, default: whole box
+        Fixed region covered by the grid.
+        Default is the periodic box or, if it is not periodic or fitting
+        is requested, the bounding box of the structure.
+    -format <dx|ccp4>, default: dx
+        Output format
+)";
+    }
+
+protected:
+
+    void before_spawn() override {
+        sel_text = options("sel").as_string();
+        weight = options("weight","count").as_string();
+        if(weight!="count" && weight!="mass" && weight!="charge")
+            throw Pteros_error("Weight should be count, mass or charge, not '{}'!",weight);
+        sigma = options("sigma","0").as_float();
+        format = options("format","dx").as_string();
+        if(format!="dx" && format!="ccp4") throw Pteros_error("Unknown output format '{}'!",format);
+
+        float spacing = options("spacing","0.1").as_float();
+        fit_text = options("fit_sel","").as_string();
+
+        if(fit_text!=""){
+            // Frame 1 is the reference for fitting. It is cloned to all instances.
+            if(system.frame(0).coord.empty())
+                throw Pteros_error("Structure file with coordinates is required for fitting!");
+            system.frame_dup(0);
+            // Fitted selection should not be broken over periodic boundaries
+            jump_remover.add_atoms(Selection(system,fit_text));
+        }
+
+        // Grid is cloned to all instances
+        vector<float> region;
+        if(options.has("region")) region = options("region").as_floats();
+        if(region.size()==6){
+            grid.create(Vector3f(region[0],region[1],region[2]),Vector3f(region[3],region[4],region[5]),spacing);
+        } else if(region.empty()){
+            if(fit_text=="" && system.box(0).is_periodic()){
+                grid.create(system.box(0),spacing);
+            } else {
+                if(system.frame(0).coord.empty())
+                    throw Pteros_error("Structure file with coordinates is required to set grid region!");
+                Vector3f min,max;
+                Selection(system,"all").minmax(min,max);
+                grid.create(min,max,spacing);
+            }
+        } else {
+            throw Pteros_error("Region should be given by 6 numbers!");
+        }
+    }
+
+    void pre_process() override {
+        sel.modify(system,sel_text);
+        if(fit_text!="") fit_sel.modify(system,fit_text);
+    }
+
+    void process_frame(const Frame_info &info) override {
+        if(sel.coord_dependent()) sel.apply();
+
+        if(fit_text!="") sel.apply_transform(fit_sel.fit_transform(0,1));
+
+        if(weight=="mass"){
+            grid.add(sel,sel.get_mass(),sigma);
+        } else if(weight=="charge"){
+            grid.add(sel,sel.get_charge(),sigma);
+        } else {
+            grid.add(sel,{},sigma);
+        }
+    }
+
+    void post_process(const Frame_info &info) override {
+    }
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<density*>(it.get());
+            grid.merge(h->grid);
+        }
+
+        if(format=="dx"){
+            grid.write_dx(fmt::format("density_id{}.dx",get_id()));
+        } else {
+            grid.write_ccp4(fmt::format("density_id{}.ccp4",get_id()));
+        }
+    }
+
+private:
+    Density_grid grid;
+    Selection sel, fit_sel;
+    string sel_text, fit_text, weight, format;
+    float sigma;
+};
+
+CREATE_COMPILED_PLUGIN(density)
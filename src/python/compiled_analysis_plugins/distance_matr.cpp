@@ -29,183 +29,214 @@
 
 
 #include "pteros/python/compiled_plugin.h"
+#include "pteros/core/thread_pool.h"
 #include <fstream>
-#include "pteros/core/distance_search.h"
 
 using namespace std;
 using namespace pteros;
 using namespace Eigen;
 
-class distance_matr: public pteros::Compiled_plugin_base {
+TASK_SERIAL(distance_matr)
 public:
-    distance_matr(pteros::Trajectory_processor* pr, const pteros::Options& opt): Compiled_plugin_base(pr,opt) {}
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes statistics of pairwise distances between selected atoms
+    or residues: mean, dispersion, skewness and kurtosis.
+    Selection should be coordinate-independent.
+Output:
+    Files distance_matr_id<id>-mean.dat, distance_matr_id<id>-disp.dat,
+    distance_matr_id<id>-skew.dat and distance_matr_id<id>-kurtosis.dat
+    depending on -max_moment.
+Options:
+    -sel <string>
+        Selection text
+    -max_moment <int>, default: 4
+        Highest moment to compute (1 to 4)
+    -dist <float>, default: 0
+        If positive only the pairs within this distance are accounted for
+        and the pairs of atoms closer than 4 in sequence are skipped.
+    -residues <true|false>, default: false
+        Compute distances between centers of masses of residues
+        instead of individual atoms. Periodicity is not accounted for.
+)";
+    }
 
 protected:
 
-    void pre_process(){
+    void pre_process() override {
         // See if computation of pairs within given distance is requested (0 means not requested)
         dist = options("dist","0.0").as_float();
-        max_moment = options("max_moment","4.0").as_int();
-        if(max_moment<1 || max_moment>4) throw Pteros_error("Moments from 1 to 4 are supported");        
-        sel.modify(system,options("selection").as_string() );
+        max_moment = options("max_moment","4").as_int();
+        if(max_moment<1 || max_moment>4) throw Pteros_error("Moments from 1 to 4 are supported");
+        sel.modify(system,options("sel").as_string());
+
+        // Groups of atoms which give a single point in distance matrix
+        groups.clear();
+        if(options("residues","false").as_bool()){
+            int cur = -1;
+            const Selection& s = sel;
+            for(int i=0;i<s.size();++i){
+                if(s.resindex(i)!=cur){
+                    groups.emplace_back();
+                    cur = s.resindex(i);
+                }
+                groups.back().push_back(i);
+            }
+        }
 
-        system.frame_dup(0);
+        N = groups.empty() ? sel.size() : groups.size();
+        if(N<2) throw Pteros_error("At least two points are required for distance matrix!");
 
-        N = sel.size();
-        if(max_moment>=1){
-            x1.resize(N,N);
-            x1.fill(0.0);
-        }
-        if(max_moment>=2){
-            x2.resize(N,N);
-            x2.fill(0.0);
-        }
-        if(max_moment>=3){
-            x3.resize(N,N);
-            x3.fill(0.0);
-        }
-        if(max_moment==4){
-            x4.resize(N,N);
-            x4.fill(0.0);
-        }
+        // Only pairs i<j are stored in packed form
+        long n_pairs = long(N)*(N-1)/2;
+        x.resize(max_moment);
+        for(auto& m: x) m = VectorXd::Zero(n_pairs);
+        if(dist>0) num = VectorXd::Zero(n_pairs);
 
-        if(dist>0){
-            num.resize(N,N);
-            num.fill(0);
-        }
+        coord.resize(N,3);
+        n_frames = 0;
     }
 
-    void process_frame(const Frame_info &info){
-
-        // Do accumulation
-        int i,j;
-        float r;
-        if(dist>0){
-            vector<Eigen::Vector2i> bon;
-            search_contacts(dist,sel,bon);
-            for(i=0;i<bon.size();++i){
-                if(abs(bon[i](0)-bon[i](1))>4){
-                    r = (sel.XYZ(bon[i](0))-sel.XYZ(bon[i](1))).norm();
-                    if(max_moment>=1) x1(bon[i](0),bon[i](1)) += r;
-                    if(max_moment>=2) x2(bon[i](0),bon[i](1)) += r*r;
-                    if(max_moment>=3) x3(bon[i](0),bon[i](1)) += r*r*r;
-                    if(max_moment==4) x4(bon[i](0),bon[i](1)) += r*r*r*r;
-                    ++num(bon[i](0),bon[i](1));
-                }
-            }
+    void process_frame(const Frame_info &info) override {
+        // Gather coordinates into contiguous buffer with separate x,y,z columns
+        if(groups.empty()){
+            for(int i=0;i<N;++i) coord.row(i) = sel.xyz(i).transpose();
         } else {
-            Eigen::Vector3f p;
-            for(i=0;i<N-1;++i){
-                p = sel.XYZ(i);
-                for(j=i+1;j<N;++j){
-                    r = (sel.XYZ(j)-p).norm();
-                    if(max_moment>=1) x1(i,j) += r;
-                    if(max_moment>=2) x2(i,j) += r*r;
-                    if(max_moment>=3) x3(i,j) += r*r*r;
-                    if(max_moment==4) x4(i,j) += r*r*r*r;
+            const Selection& s = sel;
+            for(int i=0;i<N;++i){
+                Vector3f c(Vector3f::Zero());
+                float m = 0.0;
+                for(int ind: groups[i]){
+                    c += s.xyz(ind)*s.mass(ind);
+                    m += s.mass(ind);
                 }
+                coord.row(i) = (c/m).transpose();
             }
         }
-    }
 
-    void post_process(const Frame_info &info){
-        string fname;
-        ofstream f;
-
-        float T = float(info.valid_frame+1);
-
-        if(dist>0){
-            // Compute mean and dispersion
-            if(max_moment>=1)
-                x1 = (num.array() > 0).select(x1.array()/num.array(), 0.0);
-            if(max_moment>=2)
-                x2 = (num.array() > 0).select(x2.array()/num.array() - x1.array()*x1.array(), 0.0);
-            if(max_moment>=3)
-                x3 = (num.array() > 0).select(
-                        2.0*x1.array()*x1.array()*x1.array() - 3.0*x1.array()*x2.array() + x3.array()/T
-                  ,0.0);
-            if(max_moment==4)
-                x4 = (num.array() > 0).select(
-                    -3.0*x1.array().pow(4) + 6.0*x1.array().pow(2)*x2.array()
-                    -4.0*x1.array()*x3.array() + x4.array()/T
-                  ,0.0);
-
-        } else {
-            // Finish computing mean. Place it to x
-            if(max_moment>=1)
-                x1 = x1.array()/T;
-            // Finish computing variance. Place it to x2
-            if(max_moment>=2)
-                x2 = x2.array()/T - x1.array()*x1.array();
-            // Compute mu3
-            if(max_moment>=3)
-                x3 = 2.0*x1.array()*x1.array()*x1.array() - 3.0*x1.array()*x2.array() + x3.array()/T;
-            // Compute mu4
-            if(max_moment>=4)
-                x4 = -3.0*x1.array().pow(4) + 6.0*x1.array().pow(2)*x2.array()
-                    -4.0*x1.array()*x3.array() + x4.array()/T;
+        switch(max_moment){
+            case 1: accumulate_tiles<1>(); break;
+            case 2: accumulate_tiles<2>(); break;
+            case 3: accumulate_tiles<3>(); break;
+            case 4: accumulate_tiles<4>(); break;
         }
 
-        if(max_moment>=3){
-            // Compute skewness and place to x3
-            x3 = (x2.array() != 0).select(x3.array()/x2.array().pow(3/2), 0.0);
-        }
-        if(max_moment>=4){
-            // Compute kurtosis and place to x4
-            x4 = (x2.array() != 0).select(x4.array()/x2.array().pow(2)-3.0, 0.0);
-        }
-
-        if(max_moment>=1) x1.triangularView<Eigen::StrictlyLower>() = x1.triangularView<Eigen::StrictlyUpper>().transpose();
-        if(max_moment>=2) x2.triangularView<Eigen::StrictlyLower>() = x2.triangularView<Eigen::StrictlyUpper>().transpose();
-        if(max_moment>=3) x3.triangularView<Eigen::StrictlyLower>() = x3.triangularView<Eigen::StrictlyUpper>().transpose();
-        if(max_moment==4) x4.triangularView<Eigen::StrictlyLower>() = x4.triangularView<Eigen::StrictlyUpper>().transpose();
-
-        // Output
-        fname = label+"-mean.dat";
-        f.open(fname.c_str());
-        f << "# Mean distance matrix" << endl;
-        f << x1 << endl;
-        f.close();
-
-        if(max_moment>=2){
-            fname = label+"-disp.dat";
-            f.open(fname.c_str());
-            f << "# Distance dispersion matrix" << endl;
-            f << x2 << endl;
-            f.close();
-        }
-
-        if(max_moment>=3){
-            fname = label+"-skew.dat";
-            f.open(fname.c_str());
-            f << "# Distance skewness matrix" << endl;
-            f << x3 << endl;
-            f.close();
-        }
+        ++n_frames;
+    }
 
-        /*
-        // Skewness profile
-        VectorXf v = x3.colwise().sum();
-        v = 100.0*(v.array()-v.minCoeff())/(v.maxCoeff()-v.minCoeff());
-        for(int i=0; i<N; ++i) sel[0].Beta(i) = v(i);
-        sel[0].write("colored-skewness.pdb");
-        */
-        if(max_moment==4){
-            fname = label+"-kurtosis.dat";
-            f.open(fname.c_str());
-            f << "# Distance kurtosis matrix" << endl;
-            f << x4 << endl;
+    void post_process(const Frame_info &info) override {
+        // Normalization: number of frames where each pair was found or just number of frames
+        VectorXd T = (dist>0) ? num : VectorXd::Constant(x[0].size(),n_frames);
+        T = (T.array()>0).select(T.array(),1.0);
+
+        // Raw moments
+        for(int k=0;k<max_moment;++k) x[k] = x[k].array()/T.array();
+
+        // Central moments from raw moments
+        ArrayXd m1 = x[0].array();
+        if(max_moment>=2) x[1] = x[1].array() - m1*m1;
+        if(max_moment>=3) x[2] = x[2].array() - 3.0*m1*x[1].array() - m1.pow(3);
+        if(max_moment>=4) x[3] = x[3].array() - 4.0*m1*(x[2].array()+3.0*m1*x[1].array()+m1.pow(3))
+                                 + 6.0*m1.pow(2)*(x[1].array()+m1*m1) - 3.0*m1.pow(4);
+
+        // Skewness and kurtosis
+        if(max_moment>=3) x[2] = (x[1].array()!=0).select(x[2].array()/x[1].array().pow(1.5), 0.0);
+        if(max_moment>=4) x[3] = (x[1].array()!=0).select(x[3].array()/x[1].array().pow(2)-3.0, 0.0);
+
+        // Output of full symmetric matrices unpacked row by row
+        const vector<string> suffix {"mean","disp","skew","kurtosis"};
+        const vector<string> title {"Mean distance","Distance dispersion","Distance skewness","Distance kurtosis"};
+        for(int k=0;k<max_moment;++k){
+            ofstream f(fmt::format("distance_matr_id{}-{}.dat",get_id(),suffix[k]));
+            f << "# " << title[k] << " matrix of selection '" << sel.get_text() << "'" << endl;
+            for(int i=0;i<N;++i){
+                for(int j=0;j<N;++j){
+                    double v = (i==j) ? 0.0 : x[k](pair_index(std::min(i,j),std::max(i,j)));
+                    f << v << " ";
+                }
+                f << endl;
+            }
             f.close();
         }
     }
 
 private:
     float dist;
-    int max_moment, N;
+    int max_moment, N, n_frames;
     Selection sel;
-    MatrixXf x1,x2,x3,x4,num;
+    // Atom indexes in selection forming residues (empty if atoms are used)
+    vector<vector<int>> groups;
+    // Coordinates gathered on each frame
+    Matrix<float,Dynamic,3> coord;
+    // Sums of powers of distances for packed upper triangle of matrix
+    vector<VectorXd> x;
+    VectorXd num;
+
+    // Size of square tiles of distance matrix
+    static const int tile_size = 128;
+
+    long pair_index(int i, int j) const {
+        return long(i)*(2*N-i-1)/2 + (j-i-1);
+    }
+
+    // Distances are computed for square tiles, which keep coordinates in cache.
+    // Each tile row is owned by single thread, so accumulators are updated without locking.
+    // Pairs for fixed i are contiguous in packed storage, so inner loop is vectorized.
+    template<int M>
+    void accumulate_tiles(){
+        int n_tiles = (N+tile_size-1)/tile_size;
+        const float* cx = coord.col(0).data();
+        const float* cy = coord.col(1).data();
+        const float* cz = coord.col(2).data();
+        double* s1 = x[0].data();
+        double* s2 = (M>1) ? x[1].data() : nullptr;
+        double* s3 = (M>2) ? x[2].data() : nullptr;
+        double* s4 = (M>3) ? x[3].data() : nullptr;
+        double* cnt = num.data();
+        float cutoff = dist;
+        // Pairs closer than 4 in sequence are skipped only with cutoff
+        int min_sep = (dist>0) ? 5 : 1;
+
+        // Tiles are distributed dynamically among threads of the pool
+        parallel_chunks(n_tiles,[&](int ti){
+            int i0 = ti*tile_size;
+            int i1 = std::min(N,i0+tile_size);
+            for(int tj=ti; tj<n_tiles; ++tj){
+                int j1 = std::min(N,(tj+1)*tile_size);
+                for(int i=i0; i<i1; ++i){
+                    int j0 = std::max(tj*tile_size,i+min_sep);
+                    if(j0>=j1) continue;
+                    long p = pair_index(i,j0)-j0;
+                    float xi = cx[i], yi = cy[i], zi = cz[i];
+                    if(cutoff>0){
+                        #pragma omp simd
+                        for(int j=j0; j<j1; ++j){
+                            float dx = cx[j]-xi, dy = cy[j]-yi, dz = cz[j]-zi;
+                            double r = std::sqrt(dx*dx+dy*dy+dz*dz);
+                            double w = (r<=cutoff) ? 1.0 : 0.0;
+                            cnt[p+j] += w;
+                            s1[p+j] += w*r;
+                            if(M>1) s2[p+j] += w*r*r;
+                            if(M>2) s3[p+j] += w*r*r*r;
+                            if(M>3) s4[p+j] += w*r*r*r*r;
+                        }
+                    } else {
+                        #pragma omp simd
+                        for(int j=j0; j<j1; ++j){
+                            float dx = cx[j]-xi, dy = cy[j]-yi, dz = cz[j]-zi;
+                            double r = std::sqrt(dx*dx+dy*dy+dz*dz);
+                            s1[p+j] += r;
+                            if(M>1) s2[p+j] += r*r;
+                            if(M>2) s3[p+j] += r*r*r;
+                            if(M>3) s4[p+j] += r*r*r*r;
+                        }
+                    }
+                }
+            }
+        });
+    }
 };
 
 CREATE_COMPILED_PLUGIN(distance_matr)
-
-
@@ -30,6 +30,7 @@
 
 #include "pteros/python/compiled_plugin.h"
 #include <fstream>
+#include <map>
 #include "pteros/core/distance_search.h"
 #include "pteros/core/system.h"
 
@@ -38,7 +39,7 @@ using namespace pteros;
 using namespace Eigen;
 
 
-TASK_SERIAL(energy)
+TASK_PARALLEL(energy)
 public:
 
     string help() override {
@@ -49,7 +50,7 @@ R"(Purpose:
     If two selections are provided computes their interaction energy.
     Coordinate-dependent selections are updated for each frame.
 Output:
-    File ebergy_<id>.dat containing the following columns:
+    File energy_<id>.dat containing the following columns:
     time total q lj
 Options:
     -cutoff <float>, default: value from force field
@@ -62,39 +63,26 @@ Options:
     }
 protected:
 
-    void pre_process() override {
+    void before_spawn() override {
         if(!system.force_field_ready()) throw Pteros_error("Need valid force field to compute energy!");
 
         cutoff = options("cutoff","0").as_float();
         is_periodic = options("periodic","true").as_bool();
 
-        // Get selections
-        std::vector<string> sels = options("sel").as_strings();
-        if(sels.size()<1 || sels.size()>2) throw Pteros_error("Either 1 or 2 selections should be passed");
-        if(sels.size()==1){            
-            sel1.modify(system,sels[0]);
-            is_self_energy = true;            
-        } else {            
-            sel1.modify(system,sels[0]);
-            sel2.modify(system,sels[1]);
-            is_self_energy = false;
-            if(check_selection_overlap({sel1,sel2})) throw Pteros_error("Selections could not overlap!");
-        }
-
-        // Output        
-        out.open(fmt::format("energy_{}.dat",get_id()));
+        // Get selection texts
+        sel_texts = options("sel").as_strings();
+        if(sel_texts.size()<1 || sel_texts.size()>2) throw Pteros_error("Either 1 or 2 selections should be passed");
+        is_self_energy = (sel_texts.size()==1) ? true : false;
+    }
 
+    void pre_process() override {
         if(is_self_energy){
-            out << "# Interaction self-energy of selection" << endl
-              << "# '" << sel1.get_text() << "'" << endl;
+            sel1.modify(system,sel_texts[0]);
         } else {
-            out << "# Interaction energy of selections" << endl
-              << "# '" << sel1.get_text() << "'" << endl
-              << "# '" << sel2.get_text() << "'" << endl;
+            sel1.modify(system,sel_texts[0]);
+            sel2.modify(system,sel_texts[1]);
+            if(check_selection_overlap({sel1,sel2})) throw Pteros_error("Selections could not overlap!");
         }
-        out << "# cutoff: " << cutoff << endl;
-
-        out << "# time total q lj" << endl;
     }
 
     void process_frame(const Frame_info &info) override {
@@ -108,10 +96,40 @@ protected:
             sel2.apply();
             e = non_bond_energy(sel1,sel2,cutoff,0,is_periodic);
         }
-        out << info.absolute_time << " " << e.sum() << " " << e.transpose() << endl;
+
+        data[info.valid_frame] = {info.absolute_time,e};
     }
 
     void post_process(const Frame_info& info) override {
+    }
+
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        // Results are ordered by frame
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<energy*>(it.get());
+            data.insert(h->data.begin(),h->data.end());
+        }
+
+        // Output
+        ofstream out(fmt::format("energy_{}.dat",get_id()));
+
+        if(is_self_energy){
+            out << "# Interaction self-energy of selection" << endl
+              << "# '" << sel_texts[0] << "'" << endl;
+        } else {
+            out << "# Interaction energy of selections" << endl
+              << "# '" << sel_texts[0] << "'" << endl
+              << "# '" << sel_texts[1] << "'" << endl;
+        }
+
+        out << "# cutoff: " << cutoff << endl;
+        out << "# time total q lj" << endl;
+
+        for(const auto& it: data){
+            out << it.second.time << " " << it.second.e.sum() << " " << it.second.e.transpose() << endl;
+        }
+
         out.close();
     }
 
@@ -120,7 +138,14 @@ private:
     bool is_self_energy;
     float cutoff;    
     bool is_periodic;
-    ofstream out;
+
+    struct Energy_point {
+        float time;
+        Vector2f e;
+    };
+    // Time and energy for each valid frame
+    map<int,Energy_point> data;
+    std::vector<string> sel_texts;
 };
 
 CREATE_COMPILED_PLUGIN(energy)
@@ -0,0 +1,219 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+
+#include "pteros/python/compiled_plugin.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/hbonds.h"
+#include <fstream>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+
+TASK_PARALLEL(hbonds)
+public:
+
+    string help() override {
+        return
+R"(Purpose:
+    Analyzes hydrogen bonds.
+    H-bond D-H...A exists if donor-acceptor distance is smaller than cutoff
+    and H-D-A angle is smaller than angle cutoff.
+Output:
+    hbonds_number_<id>.dat - number of H-bonds in each frame.
+    hbonds_stats_<id>.dat - occupancy and life time of each H-bond (if -lifetime is true).
+    hbonds_acf_<id>.dat - intermittent and continuous autocorrelation functions
+        of H-bond existence (if -lifetime is true).
+Options:
+    -sel, default: all
+        Selection where donors (N,O with hydrogens) and acceptors (N,O)
+        are determined automatically.
+    -donors, -acceptors
+        Explicit donor and acceptor selections. Override -sel if given.
+        All heavy atoms with hydrogens are donors and all heavy atoms are acceptors.
+        Donor selection should include hydrogens.
+    -d <float>, default: 0.35
+        Donor-acceptor distance cutoff in nm.
+    -angle <float>, default: 30
+        Hydrogen-donor-acceptor angle cutoff in degrees.
+    -periodic <true|false>, default: true
+        Account for periodicity.
+    -bond_d <float>, default: 0
+        Cutoff for finding donor-hydrogen bonds by distance.
+        If 0 bonds from topology are used if available and 0.12 nm cutoff otherwise.
+    -lifetime <true|false>, default: true
+        Track individual H-bonds to compute their life times and autocorrelation.
+    -max_lag <int>, default: 100
+        Largest lag in frames for autocorrelation functions.
+    -transient <true|false>, default: true
+        If false the H-bonds lasting for single frame only are not counted in life times.
+    -on <file>, default: hbonds_number_<id>.dat
+        Output file for the number of H-bonds.
+    -os <file>, default: hbonds_stats_<id>.dat
+        Output file for occupancy and life time of H-bonds.
+    -oa <file>, default: hbonds_acf_<id>.dat
+        Output file for autocorrelation functions.
+Note:
+    If selections are coordinate-dependent donors and acceptors are classified in each frame.
+)";
+    }
+
+protected:
+
+    void before_spawn() override {
+        explicit_sel = options.has("donors") || options.has("acceptors");
+        if(explicit_sel){
+            don_text = options("donors").as_string();
+            acc_text = options("acceptors").as_string();
+        } else {
+            don_text = acc_text = options("sel","all").as_string();
+        }
+
+        cutoff = options("d","0.35").as_float();
+        angle = options("angle","30").as_float();
+        periodic = options("periodic","true").as_bool();
+        bond_d = options("bond_d","0").as_float();
+        do_lifetime = options("lifetime","true").as_bool();
+
+        // Classify atoms once using the structure file, so that all instances
+        // get the same donors and hydrogens whatever their first frame is
+        don_sel.modify(system,don_text);
+        acc_sel.modify(system,acc_text);
+        create_search();
+    }
+
+    void pre_process() override {
+        don_sel.modify(system,don_text);
+        acc_sel.modify(system,acc_text);
+        // Search is cloned from master instance
+        search.set_system(system);
+    }
+
+    void process_frame(const pteros::Frame_info &info) override {
+        // Classify again if selections depend on coordinates
+        if(don_sel.coord_dependent() || acc_sel.coord_dependent()){
+            don_sel.apply();
+            acc_sel.apply();
+            create_search();
+        }
+
+        vector<Hbond> res;
+        search.search(res);
+
+        num_hbonds[info.valid_frame] = res.size();
+        frame_time[info.valid_frame] = info.absolute_time;
+        if(do_lifetime) lifetime.add_frame(info.valid_frame,res);
+    }
+
+    void post_process(const pteros::Frame_info &info) override {
+    }
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        // Merge data of all instances
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<hbonds*>(it.get());
+            num_hbonds.insert(h->num_hbonds.begin(),h->num_hbonds.end());
+            frame_time.insert(h->frame_time.begin(),h->frame_time.end());
+            lifetime.merge(h->lifetime);
+        }
+
+        // Number of H-bonds in each frame
+        ofstream f(options("on",fmt::format("hbonds_number_{}.dat",get_id())).as_string());
+        f << "#time\tN" << endl;
+        double mean = 0;
+        for(const auto& it: num_hbonds){
+            f << frame_time[it.first] << "\t" << it.second << endl;
+            mean += it.second;
+        }
+        f.close();
+        if(!num_hbonds.empty()) log->info("Mean number of H-bonds: {}",mean/num_hbonds.size());
+
+        if(!do_lifetime || num_hbonds.empty()) return;
+
+        // Average time step to convert frames to time
+        float dt = 0.0;
+        if(frame_time.size()>1)
+            dt = (frame_time.rbegin()->second - frame_time.begin()->second)/float(frame_time.size()-1);
+
+        // Master instance may not consume any frames, so selection is made here
+        const Selection all(system,"all");
+        auto label = [&](int i){
+            return fmt::format("{}:{}:{}{}",i+1,all.name(i),all.resname(i),all.resid(i));
+        };
+
+        auto stats = lifetime.get_stats(options("transient","true").as_bool());
+        f.open(options("os",fmt::format("hbonds_stats_{}.dat",get_id())).as_string());
+        f << "#donor\thydrogen\tacceptor\toccupancy(%)\tn_formed\tlife_t" << endl;
+        for(const auto& st: stats){
+            f << label(st.donor) << "\t" << label(st.hydrogen) << "\t" << label(st.acceptor) << "\t"
+              << 100.0*st.num_frames/float(n_frames) << "\t"
+              << st.num_formed << "\t"
+              << st.mean_life_time*dt << endl;
+        }
+        f.close();
+        log->info("{} distinct H-bonds found",lifetime.num_bonds());
+
+        VectorXf c_int, c_cont;
+        lifetime.autocorrelation(n_frames,options("max_lag","100").as_int(),c_int,c_cont);
+        f.open(options("oa",fmt::format("hbonds_acf_{}.dat",get_id())).as_string());
+        f << "#time\tintermittent\tcontinuous" << endl;
+        for(int i=0;i<c_int.size();++i){
+            f << i*dt << "\t" << c_int(i) << "\t" << c_cont(i) << endl;
+        }
+        f.close();
+    }
+
+private:
+    Selection don_sel, acc_sel;
+    string don_text, acc_text;
+    bool explicit_sel;
+    float cutoff, angle, bond_d;
+    bool periodic;
+    bool do_lifetime;
+
+    Hbond_search search;
+    Hbond_lifetime lifetime;
+
+    // Number of H-bonds in each valid frame
+    map<int,int> num_hbonds;
+    // Time of each valid frame
+    map<int,float> frame_time;
+
+    void create_search(){
+        if(explicit_sel)
+            search.create(don_sel,acc_sel,cutoff,angle,periodic,bond_d);
+        else
+            search.create(don_sel,cutoff,angle,periodic,bond_d);
+    }
+};
+
+
+CREATE_COMPILED_PLUGIN(hbonds)
@@ -0,0 +1,299 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+
+
+#include "pteros/python/compiled_plugin.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/analysis/msd.h"
+#include <fstream>
+#include <map>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+
+TASK_SERIAL(msd)
+public:
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes mean square displacement (MSD) of atoms or centers of mass
+    of residues or molecules averaged over all time origins.
+    Optionally computes velocity autocorrelation function (VACF).
+    Both are computed by FFT in O(T log T) time per point.
+    Selection should be coordinate-independent.
+Output:
+    File msd_id<id>.dat containing the following columns:
+    time MSD(all points) [MSD(species1) MSD(species2)...]
+    Diffusion coefficients from linear fit of MSD are reported in the file header.
+    If -vacf is true the file vacf_id<id>.dat with the same columns for VACF.
+Options:
+    -sel <string>
+        Selection text
+    -mode <atom|residue|molecule>, default: atom
+        Points for MSD: atoms, centers of mass of selected atoms in each residue
+        or in each molecule. Molecule mode requires topology.
+    -species <none|resname|name>, default: resname
+        MSD is also computed separately for points with the same residue name
+        or the same atom name (atom mode only).
+    -dims <string>, default: xyz
+        Dimensions to consider. Use xy for lateral diffusion in membranes.
+    -remove_drift <true|false>, default: false
+        Subtract mean displacement of all points in each frame.
+    -nojump <distance>, default: 0
+        Residues and molecules are unwrapped with given distance on the first frame.
+        Zero means use topology if present or find unwrap distance automatically.
+        Jumps over periodic boundaries are always removed.
+    -vacf <true|false>, default: false
+        Compute VACF. Trajectory should contain velocities.
+    -max_lag <int>, default: -1
+        Largest lag in frames written to output. -1 means all lags.
+    -fit <begin end>, default: 0.1 0.5
+        Range of lags for fitting diffusion coefficient
+        as fractions of the largest lag.
+)";
+    }
+
+protected:
+
+    void pre_process() override {
+        sel.modify(system,options("sel").as_string());
+        if(sel.size()==0) throw Pteros_error("Empty selection!");
+
+        string mode = options("mode","atom").as_string();
+        string species = options("species","resname").as_string();
+        if(species!="none" && species!="resname" && species!="name")
+            throw Pteros_error("Species should be none, resname or name, not '{}'!",species);
+
+        // Points as groups of atoms with weights
+        point_start.assign(1,0);
+        point_atoms.clear();
+        point_weights.clear();
+        vector<string> point_species;
+
+        if(mode=="atom"){
+            const Selection& s = sel;
+            for(int i=0;i<s.size();++i){
+                point_atoms.push_back(s.index(i));
+                point_weights.push_back(1.0);
+                point_start.push_back(point_atoms.size());
+                point_species.push_back(species=="name" ? s.name(i) : s.resname(i));
+            }
+        } else if(mode=="residue" || mode=="molecule"){
+            if(species=="name") throw Pteros_error("Species by name are only possible in atom mode!");
+            vector<Selection> parts;
+            if(mode=="residue"){
+                sel.split_by_residue(parts);
+            } else {
+                if(!system.force_field_ready()) throw Pteros_error("Molecule mode requires topology!");
+                sel.split_by_molecule(parts);
+            }
+            for(const auto& p: parts){
+                float m = 0;
+                for(int i=0;i<p.size();++i) m += p.mass(i);
+                for(int i=0;i<p.size();++i){
+                    point_atoms.push_back(p.index(i));
+                    point_weights.push_back(m>0 ? p.mass(i)/m : 1.0/p.size());
+                }
+                point_start.push_back(point_atoms.size());
+                point_species.push_back(p.resname(0));
+            }
+        } else {
+            throw Pteros_error("Mode should be atom, residue or molecule, not '{}'!",mode);
+        }
+
+        int n = point_start.size()-1;
+        log->info("Computing MSD for {} points in {} mode",n,mode);
+
+        // Groups of species
+        group.clear();
+        species_names.clear();
+        if(species!="none"){
+            map<string,int> ids;
+            for(const auto& s: point_species){
+                auto it = ids.find(s);
+                if(it==ids.end()){
+                    it = ids.emplace(s,species_names.size()).first;
+                    species_names.push_back(s);
+                }
+                group.push_back(it->second);
+            }
+            // Single species is the same as all points
+            if(species_names.size()<2){
+                group.clear();
+                species_names.clear();
+            }
+        }
+
+        // Dimensions
+        string d = options("dims","xyz").as_string();
+        dims.fill(0);
+        for(char c: d){
+            if(c=='x') dims(0) = 1;
+            else if(c=='y') dims(1) = 1;
+            else if(c=='z') dims(2) = 1;
+            else throw Pteros_error("Wrong dimension '{}', should be x, y or z!",c);
+        }
+        if(dims.sum()==0) throw Pteros_error("No dimensions for MSD!");
+
+        remove_drift = options("remove_drift","false").as_bool();
+        do_vacf = options("vacf","false").as_bool();
+
+        pos.reset(n);
+        vel.reset(do_vacf ? n : 0);
+        frame_time.clear();
+
+        // Atoms should not jump over periodic boundaries
+        jump_remover.add_atoms(sel);
+        jump_remover.set_unwrap_dist(mode=="atom" ? -1 : options("nojump","0").as_float());
+    }
+
+    void process_frame(const pteros::Frame_info &info) override {
+        const auto& fr = system.frame(0);
+        int n = pos.num_points();
+        Matrix3Xf p(3,n);
+        compute_points(fr.coord,p);
+        if(remove_drift) p.colwise() -= p.rowwise().mean();
+        pos.add_frame(p);
+
+        if(do_vacf){
+            if(!fr.has_vel()) throw Pteros_error("Trajectory has no velocities, VACF is not possible!");
+            compute_points(fr.vel,p);
+            vel.add_frame(p);
+        }
+
+        frame_time.push_back(info.absolute_time);
+    }
+
+    void post_process(const pteros::Frame_info &info) override {
+        int n = pos.num_frames();
+        if(n==0) return;
+        float dt = (n>1) ? (frame_time.back()-frame_time.front())/float(n-1) : 0.0;
+        int max_lag = options("max_lag","-1").as_int();
+        if(max_lag<0 || max_lag>=n) max_lag = n-1;
+
+        // All points and each species
+        MatrixXd msd_all = msd_fft(pos,dims);
+        MatrixXd data(n,1+species_names.size());
+        data.col(0) = msd_all.col(0);
+        if(species_names.size()) data.rightCols(species_names.size()) = msd_fft(pos,dims,group);
+
+        // Diffusion coefficients from linear fit of MSD(t) = 2*N_dim*D*t
+        vector<float> fit = options("fit","0.1 0.5").as_floats();
+        if(fit.size()!=2 || fit[0]<0 || fit[1]>1 || fit[0]>=fit[1])
+            throw Pteros_error("Fit range should be two fractions 0<=begin<end<=1!");
+        int b = fit[0]*max_lag;
+        int e = fit[1]*max_lag;
+
+        ofstream f(fmt::format("msd_id{}.dat",get_id()));
+        f << "# MSD of selection '" << sel.get_text() << "'" << endl;
+        f << "# Dimensions: " << dims.transpose() << endl;
+        if(e>b && dt>0){
+            f << "# Diffusion coefficients (1e-5 cm^2/s) from fit over " << b*dt << ":" << e*dt << " ps:" << endl;
+            for(int c=0;c<data.cols();++c){
+                // Least squares slope
+                VectorXd t = VectorXd::LinSpaced(e-b+1,b*dt,e*dt);
+                VectorXd y = data.col(c).segment(b,e-b+1);
+                double tm = t.mean();
+                double slope = (t.array()-tm).matrix().dot((y.array()-y.mean()).matrix()) / (t.array()-tm).square().sum();
+                // nm^2/ps -> 1e-5 cm^2/s
+                double D = 1000.0*slope/(2.0*dims.sum());
+                f << "#   " << column_name(c) << ": " << D << endl;
+                log->info("D({}) = {} 1e-5 cm^2/s",column_name(c),D);
+            }
+        }
+        write_columns(f,data,dt,max_lag,"MSD(nm^2)");
+        f.close();
+
+        if(do_vacf){
+            MatrixXd vdata(n,1+species_names.size());
+            vdata.col(0) = vector_autocorrelation_fft(vel,dims).col(0);
+            if(species_names.size()) vdata.rightCols(species_names.size()) = vector_autocorrelation_fft(vel,dims,group);
+
+            f.open(fmt::format("vacf_id{}.dat",get_id()));
+            f << "# VACF of selection '" << sel.get_text() << "'" << endl;
+            // Green-Kubo: D = 1/N_dim * integral of VACF (trapezoidal rule)
+            if(dt>0){
+                f << "# Diffusion coefficients (1e-5 cm^2/s) from integral of VACF:" << endl;
+                for(int c=0;c<vdata.cols();++c){
+                    double integral = dt*(vdata.col(c).head(max_lag+1).sum() - 0.5*(vdata(0,c)+vdata(max_lag,c)));
+                    f << "#   " << column_name(c) << ": " << 1000.0*integral/dims.sum() << endl;
+                }
+            }
+            write_columns(f,vdata,dt,max_lag,"VACF(nm^2/ps^2)");
+            f.close();
+        }
+    }
+
+private:
+    Selection sel;
+    // Atoms of point i are point_atoms[point_start[i]:point_start[i+1]]
+    vector<int> point_start;
+    vector<int> point_atoms;
+    vector<float> point_weights;
+    // Species of each point and their names
+    vector<int> group;
+    vector<string> species_names;
+
+    Array3i dims;
+    bool remove_drift;
+    bool do_vacf;
+
+    Vector_series pos;
+    Vector_series vel;
+    vector<float> frame_time;
+
+    // Weighted averages of given per-atom vectors for all points
+    void compute_points(const vector<Vector3f>& v, Matrix3Xf& res){
+        for(int i=0;i<res.cols();++i){
+            res.col(i).fill(0);
+            for(int j=point_start[i]; j<point_start[i+1]; ++j)
+                res.col(i) += point_weights[j]*v[point_atoms[j]];
+        }
+    }
+
+    string column_name(int c){
+        return c==0 ? "all" : species_names[c-1];
+    }
+
+    void write_columns(ofstream& f, const MatrixXd& data, float dt, int max_lag, const string& what){
+        f << "# time(ps) " << what << ":";
+        for(int c=0;c<data.cols();++c) f << " " << column_name(c);
+        f << endl;
+        for(int i=0;i<=max_lag;++i){
+            f << i*dt;
+            for(int c=0;c<data.cols();++c) f << " " << data(i,c);
+            f << endl;
+        }
+    }
+};
+
+CREATE_COMPILED_PLUGIN(msd)
@@ -31,8 +31,8 @@
 #include "pteros/python/compiled_plugin.h"
 #include "pteros/core/pteros_error.h"
 #include "pteros/core/distance_search.h"
-#include <boost/lexical_cast.hpp>
 #include <fstream>
+#include <algorithm>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846264338327950288
@@ -42,99 +42,259 @@ using namespace std;
 using namespace pteros;
 using namespace Eigen;
 
-class rdf: public pteros::Compiled_plugin_base {
+// Points between which RDF is computed:
+// either atoms of selection or centers of its residues or molecules
+class Rdf_points {
 public:
-    rdf(pteros::Trajectory_processor* pr, const pteros::Options& opt): Compiled_plugin_base(pr,opt) {}
-
-    string help(){
-        return  "Purpose:\n"
-                "\tComputes radial distribution function of two selections.\n"
-                "Output:\n"
-                "\tFile <label>.dat containing the following columns:\n"
-                "\ttime RMSD\n"
-                "\tAlso reports mean RMSD in the file header.\n"
-                "Options:\n"
-                "\t-selection <string>\n"
-                "\t\tSelection text\n"
-                "\t-nojump <true|false>. Default: true\n"
-                "\t\tRemove jumps of atoms over periodic box boundary.\n"
-                "\t\tSetting this to false is only meaningful is very special cases."
-                ;
+    Rdf_points(System& sys, const string& text, const string& center, bool molecules){
+        sel.modify(sys,text);
+        if(center=="none"){
+            mode = 0;
+        } else if(center=="cog"){
+            mode = 1;
+        } else if(center=="com"){
+            mode = 2;
+        } else {
+            throw Pteros_error("Center type should be none, cog or com, not '{}'!",center);
+        }
+        by_molecule = molecules;
+        if(by_molecule && mode && !sys.force_field_ready())
+            throw Pteros_error("Centers of molecules require topology!");
+    }
+
+    // Reports the errors, which otherwise appear only when the frames are processed.
+    // Selection itself is already evaluated on the first frame in constructor.
+    void check() const {
+        if(mode && !sel.coord_dependent() && sel.size()==0)
+            throw Pteros_error("No points for RDF in selection '{}'!",sel.get_text());
+    }
+
+    // True if the points are made of the same atoms in the same way.
+    // Selections should be updated for current frame.
+    bool same_as(const Rdf_points& other) const {
+        return mode==other.mode && sel.size()==other.sel.size()
+                && std::equal(sel.index_begin(),sel.index_end(),other.sel.index_begin());
+    }
+
+    // Updates the points for current frame
+    Selection update(bool periodic){
+        if(sel.coord_dependent()) sel.apply();
+        if(mode==0) return sel;
+
+        // Groups only change if selection is coordinate-dependent
+        if(groups.empty() || sel.coord_dependent()) make_groups();
+        if(groups.empty()) throw Pteros_error("No points for RDF in selection '{}'!",sel.get_text());
+
+        // Centers of all groups are computed in single pass
+        const Periodic_box& box = sel.box();
+        const System& sys = *sel.get_system();
+        const auto& crd = sys.frame(sel.get_frame()).coord;
+        vector<Vector3f> c(groups.size());
+        for(int g=0; g<groups.size(); ++g){
+            const Vector3f& ref = crd[groups[g][0]];
+            Vector3f sum(Vector3f::Zero());
+            float m = 0.0;
+            for(int ind: groups[g]){
+                float w = (mode==2) ? sys.atom(ind).mass : 1.0;
+                // Unwrap atoms of group relative to its first atom
+                sum += w * (periodic ? box.closest_image(crd[ind],ref) : crd[ind]);
+                m += w;
+            }
+            c[g] = sum/m;
+            if(periodic) box.wrap_point(c[g]);
+        }
+
+        // Centers are kept as atoms of auxiliary system
+        if(centers.num_atoms()!=c.size()){
+            centers.clear();
+            centers.atoms_add(vector<Atom>(c.size()),c);
+        } else {
+            centers.frame(0).coord = c;
+        }
+        centers.box(0) = box;
+        return Selection(centers,0,c.size()-1);
+    }
+
+private:
+    Selection sel;
+    int mode;
+    bool by_molecule;
+    vector<vector<int>> groups;
+    System centers;
+
+    void make_groups(){
+        groups.clear();
+        int cur = -1;
+        int mol = 0;
+        const System& sys = *sel.get_system();
+        const Selection& s = sel;
+        const auto& molecules = sys.get_force_field().molecules;
+        for(int i=0; i<sel.size(); ++i){
+            int g;
+            if(by_molecule){
+                // Indexes are sorted, so molecules are searched incrementally
+                while(mol<molecules.size() && sel.index(i)>molecules[mol](1)) ++mol;
+                g = mol;
+            } else {
+                g = s.resindex(i);
+            }
+            if(g!=cur){
+                groups.emplace_back();
+                cur = g;
+            }
+            groups.back().push_back(sel.index(i));
+        }
+    }
+};
+
+
+TASK_PARALLEL(rdf)
+public:
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes radial distribution functions and coordination numbers
+    for one or several pairs of selections in single pass over trajectory.
+    Coordinate-dependent selections are updated for each frame.
+    Distances are binned on the fly during neighbour search.
+Output:
+    File rdf_id<id>.dat containing the following columns:
+    r rdf_0(r) cn_0(r) rdf_1(r) cn_1(r) ...
+    where cn(r) is the average number of points of sel2 within r
+    from the points of sel1.
+Options:
+    -sel1 <string...>
+    -sel2 <string...>
+        Selection texts. RDF is computed for each pair sel1[i]-sel2[i].
+        If only one sel2 is given it is used for all sel1.
+    -center1 <none|cog|com>, default: none
+    -center2 <none|cog|com>, default: none
+        Use centers of geometry or masses of residues or molecules of
+        corresponding selection instead of individual atoms.
+    -group <residue|molecule>, default: residue
+        Groups of atoms for which centers are computed.
+        Molecules require topology.
+    -bins <int>, default: 50
+        Number of bins
+    -max <float>, default: half of the smallest box extent
+        Maximal distance
+    -periodic <true|false>, default: true
+        Account for periodicity.
+)";
     }
 
 protected:
 
-    void pre_process(){                        
-        sel1.modify(system,options("sel1").as_string() );
-        sel2.modify(system,options("sel2").as_string() );
-        do_cm = options("cm","false").as_bool();
+    void before_spawn() override {
+        sel1_text = options("sel1").as_strings();
+        sel2_text = options("sel2").as_strings();
+        if(sel2_text.size()==1) sel2_text.resize(sel1_text.size(),sel2_text[0]);
+        if(sel1_text.size()!=sel2_text.size())
+            throw Pteros_error("Number of sel1 ({}) and sel2 ({}) should be the same!",sel1_text.size(),sel2_text.size());
+
         n_bins = options("bins","50").as_int();
-        min_dist = options("min","0.0").as_float();
-        // Max dist will be set later when we get the box dimension
-        mass_weighted = options("mass_weighted","true").as_bool();
+        max_dist = options("max",fmt::format("{}",0.5*system.box(0).extents().minCoeff())).as_float();
+        bin_sz = max_dist/float(n_bins);
+        periodic = options("periodic","true").as_bool();
 
-        data.resize(n_bins);
-        data.fill(0.0);
+        center1 = options("center1","none").as_string();
+        center2 = options("center2","none").as_string();
+        by_molecule = (options("group","residue").as_string()=="molecule");
+        // Check all selections and points settings before spawning instances
+        for(int k=0; k<sel1_text.size(); ++k){
+            Rdf_points(system,sel1_text[k],center1,by_molecule).check();
+            Rdf_points(system,sel2_text[k],center2,by_molecule).check();
+        }
 
-        max_dist = 0.5*options("max",
-                           boost::lexical_cast<string>(system.Box(0).extents().minCoeff())
-                          ).as_float();
-        bin_sz = (max_dist-min_dist)/float(n_bins);
-    }     
+        // Shell volumes are computed exactly rather than as 4*pi*r^2*dr,
+        // which matters for the first bins
+        shell_vol.resize(n_bins);
+        for(int i=0; i<n_bins; ++i) shell_vol[i] = 4.0/3.0*M_PI*(pow((i+1)*bin_sz,3)-pow(i*bin_sz,3));
+
+        // Accumulators are cloned to all instances
+        data.resize(sel1_text.size(),VectorXd::Zero(n_bins));
+        cn.resize(sel1_text.size(),VectorXd::Zero(n_bins));
+    }
 
-    void process_frame(const pteros::Frame_info &info){        
-        float d;
+    void pre_process() override {
+        for(int k=0; k<sel1_text.size(); ++k){
+            points1.emplace_back(system,sel1_text[k],center1,by_molecule);
+            points2.emplace_back(system,sel2_text[k],center2,by_molecule);
+        }
+    }
 
-        sel1.apply();
-        sel2.apply();
+    void process_frame(const pteros::Frame_info &info) override {
+        float volume = system.box(0).volume();
+        VectorXd hist(n_bins);
 
-        density = (sel1.size()*sel2.size())/system.Box(0).volume();
+        for(int k=0; k<points1.size(); ++k){
+            Selection p1 = points1[k].update(periodic);
+            Selection p2 = points2[k].update(periodic);
+            double n1 = p1.size();
+            double density;
 
-        vector<Vector2i> bon;
-        vector<float> dist_vec;
-        search_contacts(max_dist,sel1,sel2,bon,true,true,&dist_vec);
+            hist.fill(0.0);
+            if(points1[k].same_as(points2[k])){
+                // The same set of points. Each pair is found once, but is counted for both points.
+                search_distances_histogram(max_dist,p1,hist,periodic);
+                hist *= 2.0;
+                density = (n1-1)/volume;
+            } else {
+                search_distances_histogram(max_dist,p1,p2,hist,periodic);
+                density = p2.size()/volume;
+            }
 
+            if(n1==0 || density==0) continue;
 
-        // Atom-atom rdf
-        int bin;
-        float r;
-        for(int i=0;i<dist_vec.size();++i){
-            bin = int(floor(dist_vec[i]/bin_sz));
-            if(bin<n_bins){
-                r = (0.5+bin)*bin_sz;
-                data[bin] += 1.0/( 4.0*M_PI*r*r*density*bin_sz );
+            double cum = 0.0;
+            for(int i=0; i<n_bins; ++i){
+                cum += hist[i];
+                data[k][i] += hist[i]/(n1*density*shell_vol[i]);
+                cn[k][i] += cum/n1;
             }
         }
+    }
 
+    void post_process(const pteros::Frame_info &info) override {
     }
 
-    void post_process(const pteros::Frame_info &info){        
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<rdf*>(it.get());
+            for(int k=0; k<data.size(); ++k){
+                data[k] += h->data[k];
+                cn[k] += h->cn[k];
+            }
+        }
+
         // Output
-        string fname = label+".dat";                      
-
-        ofstream f(fname.c_str());
-        f << "# RDF of selections [" << sel1.get_text() << "] and ["
-          << sel2.get_text() << "]"
-          << endl;        
-        for(int i=0; i<data.size(); ++i){
-            float r = 0.5*bin_sz+i*bin_sz;
-            f << r << " " << data[i]/(float)info.valid_frame << endl;
+        ofstream f(fmt::format("rdf_id{}.dat",get_id()));
+        for(int k=0; k<sel1_text.size(); ++k){
+            f << "# " << k << ": RDF of selections [" << sel1_text[k] << "] and [" << sel2_text[k] << "]" << endl;
+        }
+        f << "# r rdf_0(r) cn_0(r) ..." << endl;
+        for(int i=0; i<n_bins; ++i){
+            f << (0.5+i)*bin_sz;
+            // Coordination number is given at the outer edge of the bin
+            for(int k=0; k<data.size(); ++k) f << " " << data[k][i]/double(n_frames) << " " << cn[k][i]/double(n_frames);
+            f << endl;
         }
         f.close();
     }
 
 private:
-    VectorXf data;
-    pteros::Selection sel1, sel2;
-    bool do_cm;
-    bool mass_weighted;
+    vector<VectorXd> data, cn;
+    vector<Rdf_points> points1, points2;
+    vector<string> sel1_text, sel2_text;
+    string center1, center2;
+    bool by_molecule;
+    VectorXd shell_vol;
     float bin_sz;
     int n_bins;
-    float min_dist, max_dist;
-    float density;
+    float max_dist;
+    bool periodic;
 };
 
 
 CREATE_COMPILED_PLUGIN(rdf)
-
-
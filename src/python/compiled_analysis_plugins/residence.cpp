@@ -0,0 +1,254 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "pteros/python/compiled_plugin.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/distance_search_within.h"
+#include "pteros/analysis/residence.h"
+#include <fstream>
+#include <memory>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+
+TASK_PARALLEL(residence)
+public:
+
+    string help() override {
+        return
+R"(Purpose:
+    Computes residence times of solvent molecules or ions in the region
+    within given distance from the site (solvation shell, binding pocket, etc.)
+    Molecule is inside if any of its atoms is within cutoff from any site atom.
+Output:
+    residence_number_<id>.dat - number of molecules inside, number of molecules
+        entered and left the region in each frame (excursions within
+        tolerance are not counted).
+    residence_survival_<id>.dat - survival probability S(t): probability that
+        the molecule, which is inside at some time, stays inside continuously
+        for time t. Residence time is the integral of S(t).
+    residence_stats_<id>.dat - occupancy, number of visits, mean and longest
+        visit for each molecule, which visited the region.
+Options:
+    -site <string>
+        Selection of the site. Could be coordinate-dependent.
+    -solvent <string>, default: resname SOL HOH WAT TIP3
+        Selection of solvent. Should be coordinate-independent.
+    -mode <residue|molecule|atom>, default: residue
+        Units, which are tracked: residues, molecules from topology
+        or individual atoms (for ions).
+    -d <float>, default: 0.35
+        Cutoff distance in nm.
+    -periodic <true|false>, default: true
+        Account for periodicity.
+    -tolerance <int>, default: 0
+        Excursions out of the region not longer than this number of frames
+        are ignored.
+    -max_lag <int>, default: 100
+        Largest lag in frames for survival probability. -1 means all lags.
+    -on <file>, default: residence_number_<id>.dat
+        Output file for the number of molecules inside, entered and left.
+    -os <file>, default: residence_survival_<id>.dat
+        Output file for survival probability.
+    -ost <file>, default: residence_stats_<id>.dat
+        Output file for statistics of each molecule.
+)";
+    }
+
+protected:
+
+    void before_spawn() override {
+        // Default is not passed to options since it contains spaces
+        solvent_text = options.has("solvent") ? options("solvent").as_string() : "resname SOL HOH WAT TIP3";
+        site_text = options("site").as_string();
+        solvent.modify(system,solvent_text);
+        if(solvent.size()==0) throw Pteros_error("Empty solvent selection!");
+        if(solvent.coord_dependent()) throw Pteros_error("Solvent selection should be coordinate-independent!");
+        site.modify(system,site_text);
+
+        cutoff = options("d","0.35").as_float();
+        periodic = options("periodic","true").as_bool();
+
+        // Unit of each solvent atom, computed once and cloned to all instances
+        string mode = options("mode","residue").as_string();
+        unit_of.resize(solvent.size());
+        unit_label.clear();
+        if(mode=="atom"){
+            const Selection& s = solvent;
+            for(int i=0;i<s.size();++i){
+                unit_of[i] = i;
+                unit_label.push_back(fmt::format("{}:{}:{}{}",s.index(i)+1,s.name(i),
+                                                 s.resname(i),s.resid(i)));
+            }
+        } else if(mode=="residue" || mode=="molecule"){
+            vector<Selection> parts;
+            if(mode=="residue"){
+                solvent.split_by_residue(parts);
+            } else {
+                if(!system.force_field_ready()) throw Pteros_error("Molecule mode requires topology!");
+                solvent.split_by_molecule(parts);
+            }
+            vector<int> abs_unit(system.num_atoms(),-1);
+            for(int u=0;u<parts.size();++u){
+                const Selection& p = parts[u];
+                for(int i=0;i<p.size();++i) abs_unit[p.index(i)] = u;
+                unit_label.push_back(fmt::format("{}{}",p.resname(0),p.resid(0)));
+            }
+            for(int i=0;i<solvent.size();++i) unit_of[i] = abs_unit[solvent.index(i)];
+        } else {
+            throw Pteros_error("Mode should be residue, molecule or atom, not '{}'!",mode);
+        }
+
+        log->info("Tracking {} solvent units in {} mode",unit_label.size(),mode);
+        tracker.create(unit_label.size());
+    }
+
+    void pre_process() override {
+        solvent.modify(system,solvent_text);
+        site.modify(system,site_text);
+        // Each instance has its own search object. Its grid keeps the memory
+        // between frames unless the number of cells changes.
+        search = make_shared<Distance_search_within>();
+        inside_mark.assign(unit_label.size(),false);
+    }
+
+    void process_frame(const pteros::Frame_info &info) override {
+        if(site.coord_dependent()) site.apply();
+
+        inside.clear();
+        if(site.size()>0){
+            // Grid is repopulated since solvent moves
+            search->setup(cutoff,solvent,false,periodic);
+            search->search_within(site,found,true);
+            // Collapse atoms to units
+            for(int i: found){
+                int u = unit_of[i];
+                if(!inside_mark[u]){
+                    inside_mark[u] = true;
+                    inside.push_back(u);
+                }
+            }
+            for(int u: inside) inside_mark[u] = false;
+        }
+
+        tracker.add_frame(info.valid_frame,inside);
+        frame_time[info.valid_frame] = info.absolute_time;
+    }
+
+    void post_process(const pteros::Frame_info &info) override {
+    }
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        // Merge data of all instances
+        for(const auto& it: tasks){
+            auto r = dynamic_cast<residence*>(it.get());
+            frame_time.insert(r->frame_time.begin(),r->frame_time.end());
+            tracker.merge(r->tracker);
+        }
+        if(frame_time.empty()) return;
+
+        // Average time step to convert frames to time
+        float dt = 0.0;
+        if(frame_time.size()>1)
+            dt = (frame_time.rbegin()->second - frame_time.begin()->second)/float(frame_time.size()-1);
+
+        int tol = options("tolerance","0").as_int();
+
+        VectorXi num = tracker.occupancy();
+        VectorXi entered, left;
+        tracker.exchange(entered,left,tol);
+
+        ofstream f(options("on",fmt::format("residence_number_{}.dat",get_id())).as_string());
+        f << "#time\tN\tentered\tleft" << endl;
+        int i = 0;
+        for(const auto& it: frame_time){
+            f << it.second << "\t" << num(i) << "\t" << entered(i) << "\t" << left(i) << endl;
+            ++i;
+        }
+        f.close();
+
+        VectorXd surv = tracker.survival_probability(options("max_lag","100").as_int(),tol);
+        f.open(options("os",fmt::format("residence_survival_{}.dat",get_id())).as_string());
+        f << "#time\tS(t)" << endl;
+        for(int lag=0;lag<surv.size();++lag) f << lag*dt << "\t" << surv(lag) << endl;
+        f.close();
+
+        auto stats = tracker.get_stats(tol);
+        f.open(options("ost",fmt::format("residence_stats_{}.dat",get_id())).as_string());
+        f << "#unit\toccupancy(%)\tn_visits\tmean_t\tmax_t" << endl;
+        int n_visited = 0;
+        double total_visits = 0, total_time = 0;
+        for(int u=0;u<stats.size();++u){
+            const auto& st = stats[u];
+            if(st.num_visits==0) continue;
+            ++n_visited;
+            total_visits += st.num_visits;
+            total_time += st.mean_time*st.num_visits;
+            f << unit_label[u] << "\t"
+              << 100.0*st.num_frames/float(num.size()) << "\t"
+              << st.num_visits << "\t"
+              << st.mean_time*dt << "\t"
+              << st.max_time*dt << endl;
+        }
+        f.close();
+
+        // Residence time as the integral of survival probability (trapezoidal rule)
+        double tau = 0;
+        for(int lag=1;lag<surv.size();++lag) tau += 0.5*(surv(lag-1)+surv(lag))*dt;
+
+        log->info("Mean number of molecules inside: {}",num.cast<double>().mean());
+        log->info("{} of {} molecules visited the region",n_visited,stats.size());
+        if(total_visits>0) log->info("Mean visit: {}",total_time/total_visits*dt);
+        if(num.size()>1) log->info("Exchange rate: {} entries per frame",entered.sum()/float(num.size()-1));
+        log->info("Residence time from S(t) up to lag {}: {}",surv.size()-1,tau);
+    }
+
+private:
+    Selection solvent, site;
+    string solvent_text, site_text;
+    float cutoff;
+    bool periodic;
+
+    // Unit of each solvent atom (local index)
+    vector<int> unit_of;
+    vector<string> unit_label;
+
+    shared_ptr<Distance_search_within> search;
+    vector<int> found, inside;
+    // Marks units already found in current frame
+    vector<bool> inside_mark;
+
+    Residence_tracker tracker;
+    // Time of each valid frame
+    map<int,float> frame_time;
+};
+
+
+CREATE_COMPILED_PLUGIN(residence)
@@ -29,11 +29,12 @@
 
 #include "pteros/python/compiled_plugin.h"
 #include <fstream>
+#include <map>
 
 using namespace std;
 using namespace pteros;
 
-TASK_SERIAL(secondary)
+TASK_PARALLEL(secondary)
 public:    
 
     string help() override {
@@ -41,12 +42,14 @@ public:
 R"(Purpose:
     Computes DSSP secondary structure for the system
 Output:
-    File <label>.dat containing the following columns:
-    time,DSSP
-    There is no space after ','! Spaces are DSSP codes themselves.
+    File dssp_<id>.dat containing the following columns:
+    frame N :DSSP
+    There is no space after ':'! Spaces are DSSP codes themselves.
 
-    The file dssp_map_<label>.dat is then written with -map option.
+    The file dssp_map_<id>.dat is then written with -map option.
 Options:
+    -sel <string>, default: protein
+        Selection text
     -onlynum <boolean>
         Output only the number of structured residues
     -map <boolean>
@@ -58,76 +61,83 @@ Options:
     }
 
 protected:
-    void pre_process() override {
-        sel.modify(system, options("sel","protein").as_string());
-
-        jump_remover.add_atoms(sel);
-
-
+    void before_spawn() override {
+        sel_text = options("sel","protein").as_string();
         onlynum = options("onlynum","false").as_bool();
         do_map = options("map","false").as_bool();
 
-        // Output        
-        f.open(options("out",fmt::format("dssp_{}.dat",get_id())).as_string());
-        f << "#frame N :DSSP_code_string. NO space after ':'!" << endl;               
+        // Jump remover is initialized here for parallel tasks and cloned around
+        jump_remover.add_atoms(Selection(system,sel_text));
+    }
+
+    void pre_process() override {
+        sel.modify(system, sel_text);
     }
 
     void process_frame(const Frame_info &info) override {
-        string s = sel.dssp();
-        // Count all structured residues
-        int N = std::count_if(s.begin(), s.end(), [](char c){return c!='T' && c!='S' && c!=' ';});
-        f << info.valid_frame << " " << N;
-        if(onlynum){
-            f << endl;
-        } else {
-            f << " :" << s << endl;
+        data[info.valid_frame] = sel.dssp();
+    }
+
+    void post_process(const Frame_info &info) override {
+    }
+
+    void collect_data(const std::vector<std::shared_ptr<Task_base>>& tasks, int n_frames) override {
+        // Results are ordered by frame
+        for(const auto& it: tasks){
+            auto h = dynamic_cast<secondary*>(it.get());
+            data.insert(h->data.begin(),h->data.end());
         }
 
-        if(do_map){
-            // Convert all helices to 1, all beta sheets to 2, all the rest to 0
-            vector<int> cur;
-            for(char c: s){
-                switch(c){
-                case 'G':
-                case 'H':
-                case 'I':
-                    cur.push_back(1);
-                    break;
-                case 'E':
-                case 'B':
-                    cur.push_back(2);
-                    break;
-                default:
-                    cur.push_back(0);
-                }
+        // Output
+        ofstream f(options("out",fmt::format("dssp_{}.dat",get_id())).as_string());
+        f << "#frame N :DSSP_code_string. NO space after ':'!" << endl;
+        for(const auto& it: data){
+            const string& s = it.second;
+            // Count all structured residues
+            int N = std::count_if(s.begin(), s.end(), [](char c){return c!='T' && c!='S' && c!=' ';});
+            f << it.first << " " << N;
+            if(onlynum){
+                f << endl;
+            } else {
+                f << " :" << s << endl;
             }
-            dssp_map.push_back(cur);
         }
-    }
-
-    void post_process(const Frame_info &info) override {
         f.close();
 
         // Write map if asked
         if(do_map){
+            // Convert all helices to 1, all beta sheets to 2, all the rest to 0
             f.open(options("out_map",fmt::format("dssp_map_{}.dat",get_id())).as_string());
-            for(int fr=0;fr<dssp_map.size();++fr){
-                for(int i=0;i<dssp_map[fr].size();++i) f << dssp_map[fr][i] << " ";
+            for(const auto& it: data){
+                for(char c: it.second){
+                    switch(c){
+                    case 'G':
+                    case 'H':
+                    case 'I':
+                        f << "1 ";
+                        break;
+                    case 'E':
+                    case 'B':
+                        f << "2 ";
+                        break;
+                    default:
+                        f << "0 ";
+                    }
+                }
                 f << endl;
             }
             f.close();
         }
-    }    
+    }
 
 private:
     bool onlynum;
     bool do_map;
-    ofstream f;
     Selection sel;
+    string sel_text;
 
-    vector<vector<int>> dssp_map;
+    // DSSP strings for each valid frame
+    map<int,string> data;
 };
 
 CREATE_COMPILED_PLUGIN(secondary)
-
-
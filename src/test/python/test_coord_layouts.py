@@ -0,0 +1,57 @@
+# Tests of the layouts of coordinate arrays accepted by the python bindings.
+# Run with the directory of _pteros module in PYTHONPATH.
+
+import unittest
+import numpy as np
+from _pteros import System, Frame, Atom
+
+
+def make_system(n):
+    s = System()
+    s.atoms_add([Atom() for i in range(n)], [np.zeros(3,dtype=np.float32) for i in range(n)])
+    return s
+
+
+class Test_coord_layouts(unittest.TestCase):
+
+    def setUp(self):
+        self.sys = make_system(5)
+        self.sel = self.sys.select_all()
+        self.data = np.arange(15, dtype=np.float32).reshape(5,3)
+
+    def test_rows(self):
+        self.sel.set_xyz(self.data)
+        np.testing.assert_array_equal(self.sel.get_xyz(), self.data)
+
+    def test_fortran_order(self):
+        self.sel.set_xyz(np.asfortranarray(self.data))
+        np.testing.assert_array_equal(self.sel.get_xyz(), self.data)
+
+    def test_transposed(self):
+        # Legacy (3,N) layout
+        self.sel.set_xyz(np.ascontiguousarray(self.data.T))
+        np.testing.assert_array_equal(self.sel.get_xyz(), self.data)
+        self.sel.set_vel(self.data.T)
+        np.testing.assert_array_equal(self.sel.get_vel(), self.data)
+        self.sel.set_force(self.data.T.astype(np.float64))
+        np.testing.assert_array_equal(self.sel.get_force(), self.data)
+
+    def test_wrong_shape(self):
+        with self.assertRaises(Exception):
+            self.sel.set_xyz(np.zeros((4,3),dtype=np.float32))
+
+    def test_frame(self):
+        fr = Frame()
+        fr.coord = self.data
+        np.testing.assert_array_equal(fr.coord, self.data)
+        fr.coord = self.data.T
+        np.testing.assert_array_equal(fr.coord, self.data)
+
+    def test_view(self):
+        v = self.sys.coord(0)
+        v[:] = self.data
+        np.testing.assert_array_equal(self.sel.get_xyz(), self.data)
+
+
+if __name__ == '__main__':
+    unittest.main()
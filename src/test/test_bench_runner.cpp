@@ -0,0 +1,147 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "bench/bench_runner.h"
+#include "pteros/core/pteros_error.h"
+#include <sstream>
+
+using namespace std;
+using namespace pteros;
+
+BOOST_AUTO_TEST_SUITE(bench_runner)
+
+BOOST_AUTO_TEST_CASE(statistics)
+{
+    Bench_result r;
+    r.times = {3.0, 1.0, 2.0};
+    BOOST_CHECK_EQUAL(r.min(),1.0);
+    BOOST_CHECK_EQUAL(r.median(),2.0);
+    BOOST_CHECK_EQUAL(r.mean(),2.0);
+
+    r.times = {4.0, 1.0, 2.0, 3.0};
+    BOOST_CHECK_EQUAL(r.median(),2.5);
+    BOOST_CHECK_EQUAL(r.mean(),2.5);
+}
+
+BOOST_AUTO_TEST_CASE(filter)
+{
+    Bench_runner all(0.0,1);
+    BOOST_CHECK(all.enabled("search_contacts/water/pbc"));
+
+    Bench_runner runner(0.0,2,"water/.*pbc");
+    BOOST_CHECK(runner.enabled("search_contacts/water/pbc"));
+    BOOST_CHECK(runner.enabled("search_contacts/water/nopbc"));
+    BOOST_CHECK(!runner.enabled("search_contacts/membrane/pbc"));
+
+    int n_calls = 0;
+    runner.run("center/membrane/pbc",[&]{ ++n_calls; });
+    BOOST_CHECK_EQUAL(n_calls,0);
+    BOOST_CHECK(runner.get_results().empty());
+
+    runner.run("center/water/pbc",[&]{ ++n_calls; });
+    BOOST_REQUIRE_EQUAL(runner.get_results().size(),1);
+    const auto& r = runner.get_results()[0];
+    BOOST_CHECK_EQUAL(r.times.size(),2);
+    // Calibration call plus two repetitions
+    BOOST_CHECK_EQUAL(n_calls,1+2*r.iterations);
+}
+
+BOOST_AUTO_TEST_CASE(json_output)
+{
+    Bench_runner runner(0.0,3);
+    runner.add_context("version","1.0 \"test\"");
+    runner.add_context("size","100");
+    runner.run("first",[]{});
+    runner.run("second\\items",[]{}, 100);
+
+    ostringstream out;
+    runner.write_json(out);
+
+    // Output should be valid JSON
+    namespace pt = boost::property_tree;
+    pt::ptree root;
+    istringstream in(out.str());
+    BOOST_REQUIRE_NO_THROW(pt::read_json(in,root));
+
+    BOOST_CHECK_EQUAL(root.get<string>("context.version"),"1.0 \"test\"");
+    BOOST_CHECK_EQUAL(root.get<int>("context.size"),100);
+
+    vector<pt::ptree> benchmarks;
+    for(auto& it: root.get_child("benchmarks")) benchmarks.push_back(it.second);
+    BOOST_REQUIRE_EQUAL(benchmarks.size(),2);
+
+    const auto& results = runner.get_results();
+    for(int i=0;i<2;++i){
+        const auto& b = benchmarks[i];
+        BOOST_CHECK_EQUAL(b.get<string>("name"),results[i].name);
+        BOOST_CHECK_EQUAL(b.get<int>("iterations"),results[i].iterations);
+        BOOST_CHECK_EQUAL(b.get<int>("repetitions"),3);
+        BOOST_CHECK_EQUAL(b.get<string>("time_unit"),"s");
+        BOOST_CHECK_CLOSE(b.get<double>("median_time"),results[i].median(),1e-4);
+        BOOST_CHECK_CLOSE(b.get<double>("min_time"),results[i].min(),1e-4);
+    }
+    // Items are only written if given
+    BOOST_CHECK(!benchmarks[0].get_optional<double>("items"));
+    BOOST_CHECK_EQUAL(benchmarks[1].get<double>("items"),100);
+    BOOST_CHECK(benchmarks[1].get_optional<double>("items_per_second"));
+}
+
+// Results measured outside of run() with additional counters
+BOOST_AUTO_TEST_CASE(added_results)
+{
+    Bench_runner runner;
+    Bench_result r;
+    r.name = "xtc/buffer:10/threads:2";
+    BOOST_CHECK_THROW(runner.add_result(r),Pteros_error);
+
+    r.times = {2.0};
+    r.items = 100;
+    r.counters = {{"read_time",0.5},{"wait \"reader\"",0.25}};
+    runner.add_result(r);
+    BOOST_REQUIRE_EQUAL(runner.get_results().size(),1);
+
+    ostringstream out;
+    runner.write_json(out);
+    namespace pt = boost::property_tree;
+    pt::ptree root;
+    istringstream in(out.str());
+    BOOST_REQUIRE_NO_THROW(pt::read_json(in,root));
+
+    const auto& b = root.get_child("benchmarks").begin()->second;
+    BOOST_CHECK_EQUAL(b.get<string>("name"),r.name);
+    BOOST_CHECK_EQUAL(b.get<int>("iterations"),1);
+    BOOST_CHECK_EQUAL(b.get<double>("median_time"),2.0);
+    BOOST_CHECK_EQUAL(b.get<double>("items_per_second"),50.0);
+    BOOST_CHECK_EQUAL(b.get<double>("read_time"),0.5);
+    BOOST_CHECK_EQUAL(b.get<double>("wait \"reader\""),0.25);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,203 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "test_utils.h"
+#include "pteros/core/selection.h"
+#include <thread>
+
+using namespace std;
+using namespace pteros;
+
+BOOST_AUTO_TEST_SUITE(copy_on_write)
+
+BOOST_AUTO_TEST_CASE(single_thread)
+{
+    Cow_vector<int> a(vector<int>{1,2,3});
+    Cow_vector<int> b = a;
+    BOOST_CHECK(a.is_shared());
+    b[0] = 10;
+    BOOST_CHECK(!a.is_shared());
+    BOOST_CHECK_EQUAL(a[0],1);
+    BOOST_CHECK_EQUAL(b.get()[0],10);
+}
+
+// Iterators of shared storage stay valid for insert and erase
+BOOST_AUTO_TEST_CASE(insert_erase_shared)
+{
+    Cow_vector<int> a(vector<int>{1,2,3,4});
+    Cow_vector<int> b = a;
+    vector<int> extra{7,8};
+    b.insert(b.cbegin()+1,extra.begin(),extra.end());
+    BOOST_CHECK((b.get()==vector<int>{1,7,8,2,3,4}));
+    BOOST_CHECK((a.get()==vector<int>{1,2,3,4}));
+
+    Cow_vector<int> c = a;
+    c.erase(c.cbegin()+1,c.cbegin()+3);
+    BOOST_CHECK((c.get()==vector<int>{1,4}));
+    BOOST_CHECK((a.get()==vector<int>{1,2,3,4}));
+}
+
+// Reading through selections and proxies does not copy the topology
+// and does not invalidate topology ranges
+BOOST_AUTO_TEST_CASE(reads_do_not_detach)
+{
+    System sys = make_random_system(100);
+    auto ranges = sys.get_topology_ranges();
+    System copy = sys;
+    Selection sel(copy,"all");
+
+    float m = 0;
+    for(int i=0;i<sel.size();++i) m += static_cast<const Selection&>(sel).mass(i);
+    for(const auto& a: sel) m += a.mass();
+    vector<Selection> res;
+    sel.split_by_residue(res);
+    sel.split_by_chain(res);
+    sel.split_by_contiguous_residue(res);
+
+    BOOST_CHECK(sys.is_topology_shared());
+    BOOST_CHECK(sys.get_topology_ranges()==ranges);
+}
+
+// Proxy writes to the atom of its own system even if the system
+// was copied after the proxy was created
+BOOST_AUTO_TEST_CASE(proxy_writes_after_copy)
+{
+    System sys = make_random_system(10);
+    Selection sel(sys,"all");
+    Atom_proxy p = sel[3];
+    System copy = sys;
+    p.name() = "X";
+    BOOST_CHECK_EQUAL(sys.atom(3).name,"X");
+    BOOST_CHECK_EQUAL(copy.atom(3).name,"A");
+}
+
+// Copies of the System are modified concurrently.
+// Each copy should only see its own modifications.
+BOOST_AUTO_TEST_CASE(concurrent_mutation_of_clones)
+{
+    System sys = make_random_system(1000);
+    for(int i=0;i<sys.num_atoms();++i) sys.atom(i).mass = 0.0;
+    sys.get_force_field().fudgeQQ = 0.0;
+
+    auto mutate = [](System& s, float m, const string& name){
+        for(int i=0;i<s.num_atoms();++i){
+            s.atom(i).mass = m;
+            s.atom(i).name = name;
+        }
+        s.get_force_field().fudgeQQ = m;
+    };
+
+    auto check = [](const System& s, float m, const string& name){
+        bool ok = s.get_force_field().fudgeQQ==m;
+        for(int i=0;i<s.num_atoms();++i)
+            ok = ok && s.atom(i).mass==m && s.atom(i).name==name;
+        return ok;
+    };
+
+    for(int rep=0; rep<50; ++rep){
+        System copy1 = sys;
+        System copy2 = sys;
+        BOOST_REQUIRE(copy1.is_topology_shared());
+
+        std::thread t1(mutate,std::ref(copy1),1.0f,"C1");
+        std::thread t2(mutate,std::ref(copy2),2.0f,"C2");
+        t1.join();
+        t2.join();
+
+        BOOST_CHECK(check(copy1,1.0f,"C1"));
+        BOOST_CHECK(check(copy2,2.0f,"C2"));
+        // Original is not affected
+        BOOST_CHECK(check(sys,0.0f,"A"));
+    }
+
+    // The last owner modifies in place, while another owner releases the storage concurrently
+    for(int rep=0; rep<50; ++rep){
+        // copy1 and copy2 are the only owners
+        System copy1 = sys;
+        mutate(copy1,3.0f,"C3");
+        System copy2 = copy1;
+        std::thread t1(mutate,std::ref(copy1),1.0f,"C1");
+        std::thread t2([&copy2](){ copy2 = System(); });
+        t1.join();
+        t2.join();
+        BOOST_CHECK(check(copy1,1.0f,"C1"));
+        BOOST_CHECK(check(sys,0.0f,"A"));
+    }
+}
+
+// Coordinate-dependent selections on one System are applied from several threads
+// and give the same result as serial evaluation
+BOOST_AUTO_TEST_CASE(concurrent_apply)
+{
+    const int n_frames = 8;
+    System sys = make_random_system(500,n_frames);
+    vector<string> texts {"x<1.5 and y>1", "within 0.5 of resid 1 to 20",
+                          "dist point 1.5 1.5 1.5 < 1.0", "by residue within 0.3 pbc of index 10"};
+
+    // Serial reference
+    vector<vector<vector<int>>> ref(texts.size(),vector<vector<int>>(n_frames));
+    for(int t=0;t<texts.size();++t){
+        Selection sel(sys,texts[t]);
+        for(int fr=0;fr<n_frames;++fr){
+            sel.set_frame(fr);
+            ref[t][fr] = sel.get_index();
+        }
+    }
+
+    const int n_threads = 4;
+    vector<vector<Selection>> sels(n_threads);
+    for(auto& s: sels) for(auto& txt: texts) s.emplace_back(sys,txt);
+    auto ranges = sys.get_topology_ranges();
+
+    vector<int> n_bad(n_threads,0);
+    vector<thread> threads;
+    for(int th=0;th<n_threads;++th){
+        threads.emplace_back([&,th](){
+            for(int rep=0;rep<5;++rep){
+                for(int fr=0;fr<n_frames;++fr){
+                    // Threads visit frames in different order
+                    int f = (fr+th)%n_frames;
+                    for(int t=0;t<texts.size();++t){
+                        Selection& sel = sels[th][t];
+                        sel.set_frame(f);
+                        sel.apply();
+                        if(sel.get_index()!=ref[t][f]) ++n_bad[th];
+                    }
+                }
+            }
+        });
+    }
+    for(auto& t: threads) t.join();
+
+    for(int th=0;th<n_threads;++th) BOOST_CHECK_EQUAL(n_bad[th],0);
+    // Reads did not invalidate topology ranges
+    BOOST_CHECK(sys.get_topology_ranges()==ranges);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,185 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/analysis/correlation.h"
+#include "pteros/core/pteros_error.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Observable of n_series vectors of dimension n_dim in n_frames frames.
+// Frames are in columns. Values have non-zero mean.
+MatrixXf make_values(int n_series, int n_dim, int n_frames){
+    MatrixXf v = MatrixXf::Random(n_series*n_dim,n_frames);
+    v.array() += 0.5;
+    return v;
+}
+
+// Direct summation of <a_i(0).a_j(t)> over time origins
+VectorXd correlation_direct(const MatrixXd& v, int n_dim, int i, int j, bool subtract_mean){
+    int n = v.cols();
+    MatrixXd x = v.middleRows(i*n_dim,n_dim);
+    MatrixXd y = v.middleRows(j*n_dim,n_dim);
+    if(subtract_mean){
+        x.colwise() -= x.rowwise().mean();
+        y.colwise() -= y.rowwise().mean();
+    }
+    VectorXd res(n);
+    for(int m=0;m<n;++m){
+        double sum = 0;
+        for(int t=0;t<n-m;++t) sum += x.col(t).dot(y.col(t+m));
+        res(m) = sum/(n-m);
+    }
+    return res;
+}
+
+// Fills two stores with even and odd frames in reverse order and merges them
+Time_correlation fill_merged(const MatrixXf& v, int n_series, int n_dim, Time_correlation::Storage st){
+    Time_correlation c1(n_series,n_dim,st), c2(n_series,n_dim,st);
+    for(int fr=v.cols()-1;fr>=0;--fr){
+        if(fr%2) c1.add_frame(fr,v.col(fr)); else c2.add_frame(fr,v.col(fr));
+    }
+    c1.merge(c2);
+    return c1;
+}
+
+double rel_error(const VectorXd& a, const VectorXd& b){
+    BOOST_REQUIRE_EQUAL(a.size(),b.size());
+    return (a-b).cwiseAbs().maxCoeff()/b.cwiseAbs().maxCoeff();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(time_correlation)
+
+BOOST_AUTO_TEST_CASE(storages_vs_direct_sum)
+{
+    int ns = 5, nd = 3, n = 101;
+    MatrixXf v = make_values(ns,nd,n);
+
+    auto check = [&](Time_correlation::Storage st, MatrixXd ref_values, double tol){
+        auto c = fill_merged(v,ns,nd,st);
+        BOOST_REQUIRE_EQUAL(c.num_frames(),n);
+
+        VectorXd ref_avg = VectorXd::Zero(n);
+        VectorXd ref_cov = VectorXd::Zero(n);
+        MatrixXd per = c.autocorrelation_per_series();
+        MatrixXd per_norm = c.autocorrelation_per_series(10,true,true);
+        for(int s=0;s<ns;++s){
+            VectorXd r = correlation_direct(ref_values,nd,s,s,false);
+            ref_avg += r/ns;
+            ref_cov += correlation_direct(ref_values,nd,s,s,true)/ns;
+            BOOST_CHECK_SMALL(rel_error(per.col(s),r),tol);
+            VectorXd rc = correlation_direct(ref_values,nd,s,s,true);
+            BOOST_CHECK_SMALL(rel_error(per_norm.col(s),rc.head(11)/rc(0)),tol);
+        }
+        BOOST_CHECK_SMALL(rel_error(c.autocorrelation(),ref_avg),tol);
+        BOOST_CHECK_SMALL(rel_error(c.autocorrelation(-1,true),ref_cov),tol);
+        VectorXd norm = c.autocorrelation(20,false,true);
+        BOOST_REQUIRE_EQUAL(norm.size(),21);
+        BOOST_CHECK_SMALL(rel_error(norm,ref_avg.head(21)/ref_avg(0)),tol);
+
+        BOOST_CHECK_SMALL(rel_error(c.cross_correlation(1,3),correlation_direct(ref_values,nd,1,3,false)),tol);
+        BOOST_CHECK_SMALL(rel_error(c.cross_correlation(4,0,30,true),
+                                    correlation_direct(ref_values,nd,4,0,true).head(31)),tol);
+    };
+
+    MatrixXd exact = v.cast<double>();
+    check(Time_correlation::Float,exact,1e-9);
+    check(Time_correlation::Disk,exact,1e-9);
+    // Half precision is exact for values rounded to half
+    MatrixXd rounded = v.unaryExpr([](float x){ return float(Eigen::half(x)); }).cast<double>();
+    check(Time_correlation::Half,rounded,1e-9);
+    BOOST_CHECK_SMALL(rel_error(fill_merged(v,ns,nd,Time_correlation::Half).autocorrelation(),
+                                fill_merged(v,ns,nd,Time_correlation::Float).autocorrelation()),1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(copy_and_merge)
+{
+    MatrixXf v = make_values(2,1,10);
+    for(auto st: {Time_correlation::Float, Time_correlation::Half, Time_correlation::Disk}){
+        Time_correlation c(2,1,st);
+        for(int fr=0;fr<5;++fr) c.add_frame(fr,v.col(fr));
+        // Copy has its own storage
+        Time_correlation copy = c;
+        for(int fr=5;fr<10;++fr) copy.add_frame(fr,v.col(fr));
+        BOOST_CHECK_EQUAL(c.num_frames(),5);
+        BOOST_CHECK_EQUAL(copy.num_frames(),10);
+
+        MatrixXd s;
+        copy.get_series(1,2,s);
+        BOOST_REQUIRE_EQUAL(s.rows(),10);
+        BOOST_CHECK_CLOSE(s(7,0),v(1,7),0.1);
+
+        BOOST_CHECK_THROW(c.merge(c),Pteros_error);
+        BOOST_CHECK_EQUAL(c.num_frames(),5);
+        BOOST_CHECK_THROW(c.merge(Time_correlation(3,1,st)),Pteros_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(missing_frames)
+{
+    Time_correlation c(1);
+    VectorXf val(1);
+    val << 1.0;
+    c.add_frame(0,val);
+    c.add_frame(2,val);
+    BOOST_CHECK_THROW(c.autocorrelation(),Pteros_error);
+    BOOST_CHECK_THROW(Time_correlation().autocorrelation(),Pteros_error);
+    BOOST_CHECK_THROW(c.add_frame(3,VectorXf::Zero(2)),Pteros_error);
+}
+
+BOOST_AUTO_TEST_CASE(multi_tau)
+{
+    int ns = 3, nd = 2, n = 500, p = 16;
+    MatrixXf v = make_values(ns,nd,n);
+    Multi_tau_correlator mt(ns,nd,p,2,6);
+    for(int fr=0;fr<n;++fr) mt.add_frame(v.col(fr));
+
+    VectorXd lags, corr;
+    mt.get_result(lags,corr);
+    BOOST_REQUIRE_GT(lags.size(),p);
+    BOOST_CHECK_EQUAL(lags(p),p);
+
+    // First p lags are not averaged and are the same as direct sum
+    VectorXd ref = VectorXd::Zero(n);
+    MatrixXd exact = v.cast<double>();
+    for(int s=0;s<ns;++s) ref += correlation_direct(exact,nd,s,s,false)/ns;
+    for(int j=0;j<p;++j){
+        BOOST_CHECK_EQUAL(lags(j),j);
+        BOOST_CHECK_CLOSE(corr(j),ref(j),1e-6);
+    }
+    // Lags are increasing
+    for(int j=1;j<lags.size();++j) BOOST_CHECK_GT(lags(j),lags(j-1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,251 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/core/hbonds.h"
+#include "test_utils.h"
+#include <cmath>
+#include <tuple>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Water molecules with O-H bond of 0.1 nm and H-O-H angle of 104.5 degrees
+class Water_builder {
+public:
+    // Adds water with oxygen at o. First hydrogen points along dir1,
+    // second one is rotated from dir1 by 104.5 degrees around up (made orthogonal to dir1).
+    void add(Vector3f_const_ref o, Vector3f_const_ref dir1, Vector3f_const_ref up = Vector3f::UnitZ()){
+        Vector3f d1 = dir1.normalized();
+        Vector3f axis = up-up.dot(d1)*d1;
+        if(axis.norm()<1e-3) axis = d1.unitOrthogonal();
+        Vector3f d2 = AngleAxisf(104.5*M_PI/180.0,axis.normalized())*d1;
+        int resid = atoms.size()/3+1;
+        for(auto name: {"OW","HW1","HW2"}){
+            Atom a;
+            a.name = name;
+            a.resname = "SOL";
+            a.resid = resid;
+            a.resindex = resid-1;
+            a.mass = 1.0;
+            atoms.push_back(a);
+        }
+        crd.push_back(o);
+        crd.push_back(o+0.1*d1);
+        crd.push_back(o+0.1*d2);
+    }
+
+    System make(float box) const {
+        System sys;
+        sys.atoms_add(atoms,crd);
+        sys.box(0).set_matrix(box*Matrix3f::Identity());
+        return sys;
+    }
+
+private:
+    vector<Atom> atoms;
+    vector<Vector3f> crd;
+};
+
+// Direct search over all oxygen pairs and all hydrogens of donor.
+// Waters are consecutive O,H,H triplets.
+vector<array<int,3>> hbonds_direct(const System& sys, float d, float angle, bool periodic){
+    vector<array<int,3>> res;
+    const auto& box = sys.box(0);
+    auto vec = [&](int i, int j)->Vector3f {
+        return periodic ? box.shortest_vector(sys.xyz(i),sys.xyz(j)) : Vector3f(sys.xyz(j)-sys.xyz(i));
+    };
+    int nw = sys.num_atoms()/3;
+    for(int w=0;w<nw;++w){
+        int D = 3*w;
+        for(int h: {D+1,D+2}){
+            for(int a=0;a<nw;++a){
+                int A = 3*a;
+                if(A==D) continue;
+                Vector3f da = vec(D,A);
+                Vector3f dh = vec(D,h);
+                if(da.norm()>d) continue;
+                float ang = acos(da.dot(dh)/da.norm()/dh.norm())*180.0/M_PI;
+                if(ang<=angle) res.push_back({D,h,A});
+            }
+        }
+    }
+    sort(res.begin(),res.end());
+    return res;
+}
+
+vector<array<int,3>> triplets(const vector<Hbond>& hb){
+    vector<array<int,3>> res;
+    for(auto& h: hb) res.push_back({h.donor,h.hydrogen,h.acceptor});
+    return res;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(hbonds)
+
+BOOST_AUTO_TEST_CASE(water_cluster)
+{
+    Water_builder b;
+    Vector3f h1dir = Vector3f::UnitX();
+    Vector3f h2dir = AngleAxisf(104.5*M_PI/180.0,Vector3f::UnitZ())*h1dir;
+    // Acceptor with hydrogens pointing away from donor, so that it doesn't donate back
+    auto add_acceptor = [&](Vector3f_const_ref donor, Vector3f_const_ref dir, float d){
+        b.add(donor+d*dir,dir,Vector3f::UnitY());
+    };
+
+    // Water 0 at (1,1,1) donates both hydrogens
+    Vector3f o0(1,1,1);
+    b.add(o0,h1dir);
+    // Water 1 accepts along H1 of water 0: d=0.28, angle 0
+    add_acceptor(o0,h1dir,0.28);
+    // Water 2 is along H2 of water 0 but too far: d=0.36
+    add_acceptor(o0,h2dir,0.36);
+
+    // Water 3 at (2,2,2) donates both hydrogens
+    Vector3f o3(2,2,2);
+    b.add(o3,h1dir);
+    // Water 4 is close to H1 direction of water 3 but the angle is too large: d=0.3, angle 35
+    add_acceptor(o3,AngleAxisf(-35*M_PI/180.0,Vector3f::UnitZ())*h1dir,0.3);
+    // Water 5 accepts from H2 of water 3: d=0.29, angle 25
+    Vector3f axis = h2dir.cross(Vector3f::UnitZ());
+    add_acceptor(o3,AngleAxisf(25*M_PI/180.0,axis)*h2dir,0.29);
+    System sys = b.make(3.0);
+
+    Hbond_search hb(Selection(sys,"all"));
+    BOOST_CHECK_EQUAL(hb.num_donors(),6);
+    BOOST_CHECK_EQUAL(hb.num_hydrogens(),12);
+    BOOST_CHECK_EQUAL(hb.num_acceptors(),6);
+
+    vector<Hbond> res;
+    hb.search(res);
+    BOOST_REQUIRE_EQUAL(res.size(),2);
+    BOOST_CHECK_EQUAL(res[0].donor,0);
+    BOOST_CHECK_EQUAL(res[0].hydrogen,1);
+    BOOST_CHECK_EQUAL(res[0].acceptor,3);
+    BOOST_CHECK_CLOSE(res[0].dist,0.28,1e-3);
+    BOOST_CHECK_SMALL(res[0].angle,0.1f);
+    BOOST_CHECK_EQUAL(res[1].donor,9);
+    BOOST_CHECK_EQUAL(res[1].hydrogen,11);
+    BOOST_CHECK_EQUAL(res[1].acceptor,15);
+    BOOST_CHECK_CLOSE(res[1].dist,0.29,1e-3);
+    BOOST_CHECK_CLOSE(res[1].angle,25.0,1e-2);
+
+    BOOST_CHECK(triplets(res)==hbonds_direct(sys,0.35,30,true));
+}
+
+BOOST_AUTO_TEST_CASE(across_boundary)
+{
+    Water_builder b;
+    b.add(Vector3f(2.9,1,1),Vector3f::UnitX());
+    b.add(Vector3f(0.18,1,1),Vector3f::UnitX());
+    System sys = b.make(3.0);
+
+    vector<Hbond> res;
+    Hbond_search(Selection(sys,"all"),0.35,30,true).search(res);
+    BOOST_REQUIRE_EQUAL(res.size(),1);
+    BOOST_CHECK_EQUAL(res[0].acceptor,3);
+    BOOST_CHECK_CLOSE(res[0].dist,0.28,1e-2);
+
+    Hbond_search(Selection(sys,"all"),0.35,30,false).search(res);
+    BOOST_CHECK(res.empty());
+}
+
+
+// Ice-like lattice of randomly oriented waters
+BOOST_AUTO_TEST_CASE(water_lattice)
+{
+    Water_builder b;
+    int n = 10;
+    float step = 0.3;
+    for(int i=0;i<n;++i)
+        for(int j=0;j<n;++j)
+            for(int k=0;k<n;++k)
+                b.add(step*Vector3f(i,j,k)+0.03*Vector3f::Random(),
+                      Vector3f::Random(),Vector3f::Random());
+    System sys = b.make(n*step);
+
+    for(bool periodic: {true,false}){
+        for(float angle: {30.0f,50.0f}){
+            vector<Hbond> res;
+            Hbond_search hb(Selection(sys,"all"),0.35,angle,periodic);
+            BOOST_CHECK_EQUAL(hb.num_hydrogens(),2*n*n*n);
+            hb.search(res);
+            auto ref = hbonds_direct(sys,0.35,angle,periodic);
+            BOOST_CHECK_GT(ref.size(),0);
+            BOOST_CHECK_EQUAL(res.size(),ref.size());
+            BOOST_CHECK(triplets(res)==ref);
+        }
+    }
+
+    // Explicit donors and acceptors
+    vector<Hbond> res;
+    Hbond_search(Selection(sys,"resid 1 to 500"),Selection(sys,"name OW"),0.35,30).search(res);
+    auto ref = hbonds_direct(sys,0.35,30,true);
+    ref.erase(remove_if(ref.begin(),ref.end(),[](const array<int,3>& t){ return t[0]>=1500; }),ref.end());
+    BOOST_CHECK(triplets(res)==ref);
+}
+
+BOOST_AUTO_TEST_CASE(lifetime)
+{
+    // Single bond present in frames 0,1,2,5,7,8 of 10 given out of order in two accumulators
+    vector<Hbond> hb {{0,1,3,0.28,0.0}};
+    Hbond_lifetime acc1, acc2;
+    for(int fr: {5,0,2}) acc1.add_frame(fr,hb);
+    for(int fr: {8,1,7}) acc2.add_frame(fr,hb);
+    acc1.merge(acc2);
+    BOOST_CHECK_EQUAL(acc1.num_bonds(),1);
+
+    auto st = acc1.get_stats();
+    BOOST_REQUIRE_EQUAL(st.size(),1);
+    BOOST_CHECK_EQUAL(st[0].num_frames,6);
+    BOOST_CHECK_EQUAL(st[0].num_formed,3);
+    BOOST_CHECK_CLOSE(st[0].mean_life_time,2.0,1e-4);
+
+    // Single-frame interval at frame 5 is ignored
+    st = acc1.get_stats(false);
+    BOOST_CHECK_EQUAL(st[0].num_formed,2);
+    BOOST_CHECK_CLOSE(st[0].mean_life_time,2.5,1e-4);
+
+    VectorXf inter, cont;
+    acc1.autocorrelation(10,3,inter,cont);
+    BOOST_REQUIRE_EQUAL(inter.size(),4);
+    BOOST_CHECK_CLOSE(inter(0),1.0,1e-4);
+    BOOST_CHECK_CLOSE(cont(0),1.0,1e-4);
+    // Lag 1: pairs (0,1),(1,2),(7,8) of 6 at lag 0, 9 time origins of 10
+    BOOST_CHECK_CLOSE(inter(1),3.0*10/9/6,1e-4);
+    BOOST_CHECK_CLOSE(cont(1),3.0*10/9/6,1e-4);
+    // Lag 2: intermittent (0,2),(5,7), continuous only (0,2)
+    BOOST_CHECK_CLOSE(inter(2),2.0*10/8/6,1e-4);
+    BOOST_CHECK_CLOSE(cont(2),1.0*10/8/6,1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,259 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/core/index_set.h"
+#include "pteros/core/selection.h"
+#include "pteros/core/pteros_error.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <iterator>
+#include <random>
+
+using namespace std;
+using namespace pteros;
+
+namespace {
+
+// Sorted unique index, where each of n atoms is present with probability p
+vector<int> random_index(mt19937& gen, int n, double p){
+    bernoulli_distribution take(p);
+    vector<int> ind;
+    for(int i=0;i<n;++i) if(take(gen)) ind.push_back(i);
+    return ind;
+}
+
+vector<int> ref_union(const vector<int>& a, const vector<int>& b){
+    vector<int> res;
+    set_union(a.begin(),a.end(),b.begin(),b.end(),back_inserter(res));
+    return res;
+}
+
+vector<int> ref_intersection(const vector<int>& a, const vector<int>& b){
+    vector<int> res;
+    set_intersection(a.begin(),a.end(),b.begin(),b.end(),back_inserter(res));
+    return res;
+}
+
+vector<int> ref_difference(const vector<int>& a, const vector<int>& b){
+    vector<int> res;
+    set_difference(a.begin(),a.end(),b.begin(),b.end(),back_inserter(res));
+    return res;
+}
+
+// Atoms in residues of 3, chains of 10 residues and molecules of 2 residues
+System make_topology_system(int n){
+    System sys = make_random_system(n);
+    for(int i=0;i<n;++i){
+        sys.atom(i).resid = i/3+1;
+        sys.atom(i).chain = 'A'+i/30;
+    }
+    sys.assign_resindex();
+    auto& ff = sys.get_force_field();
+    for(int i=0;i<n;i+=6) ff.molecules.emplace_back(i,std::min(i+5,n-1));
+    ff.ready = true;
+    return sys;
+}
+
+// Indexes of all atoms, for which pred is true
+template<class F>
+vector<int> select_if(const System& sys, F pred){
+    vector<int> res;
+    for(int i=0;i<sys.num_atoms();++i) if(pred(i)) res.push_back(i);
+    return res;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(index_set)
+
+BOOST_AUTO_TEST_CASE(sort_unique)
+{
+    vector<int> a {5,1,3,3,9,1};
+    sort_unique_index(a);
+    BOOST_CHECK((a==vector<int>{1,3,5,9}));
+    vector<int> b {1,2,3};
+    sort_unique_index(b);
+    BOOST_CHECK((b==vector<int>{1,2,3}));
+    vector<int> c;
+    sort_unique_index(c);
+    BOOST_CHECK(c.empty());
+}
+
+// Random inputs of different density and size ratio, including
+// disjoint ranges and one index much smaller than the other (binary search path)
+BOOST_AUTO_TEST_CASE(against_std_set_operations)
+{
+    mt19937 gen(42);
+    vector<pair<double,double>> densities {{0.5,0.5},{0.05,0.9},{0.9,0.01},{0.001,0.5},{0.5,0.001}};
+    for(auto d: densities){
+        for(int rep=0;rep<20;++rep){
+            auto a = random_index(gen,2000,d.first);
+            auto b = random_index(gen,2000,d.second);
+            // Sometimes shift b after the end of a
+            if(rep%5==0) for(auto& x: b) x += 2000;
+
+            auto u = a;
+            index_union(u,b);
+            BOOST_CHECK(u==ref_union(a,b));
+
+            auto in = a;
+            index_intersection(in,b);
+            BOOST_CHECK(in==ref_intersection(a,b));
+
+            auto df = a;
+            index_difference(df,b);
+            BOOST_CHECK(df==ref_difference(a,b));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(empty_operands)
+{
+    vector<int> a {1,4,7};
+    vector<int> e;
+
+    auto r = a; index_union(r,e); BOOST_CHECK(r==a);
+    r = e; index_union(r,a); BOOST_CHECK(r==a);
+    r = a; index_intersection(r,e); BOOST_CHECK(r.empty());
+    r = e; index_intersection(r,a); BOOST_CHECK(r.empty());
+    r = a; index_difference(r,e); BOOST_CHECK(r==a);
+    r = e; index_difference(r,a); BOOST_CHECK(r.empty());
+}
+
+BOOST_AUTO_TEST_CASE(aliasing)
+{
+    mt19937 gen(1);
+    auto a = random_index(gen,1000,0.3);
+
+    auto r = a; index_union(r,r); BOOST_CHECK(r==a);
+    r = a; index_intersection(r,r); BOOST_CHECK(r==a);
+    r = a; index_difference(r,r); BOOST_CHECK(r.empty());
+}
+
+BOOST_AUTO_TEST_CASE(mask)
+{
+    mt19937 gen(7);
+    // Size not divisible by 64 to check the tail of the last word
+    const int n = 1000;
+    auto a = random_index(gen,n,0.3);
+    auto b = random_index(gen,n,0.6);
+
+    Index_mask ma(n,a), mb(n,b);
+    BOOST_CHECK_EQUAL(ma.size(),n);
+    BOOST_CHECK_EQUAL(ma.count(),a.size());
+    BOOST_CHECK(ma.to_index()==a);
+    for(int i=0;i<n;++i) BOOST_CHECK_EQUAL(ma.test(i),binary_search(a.begin(),a.end(),i));
+
+    auto m = ma; m |= mb; BOOST_CHECK(m.to_index()==ref_union(a,b));
+    m = ma; m &= mb; BOOST_CHECK(m.to_index()==ref_intersection(a,b));
+    m = ma; m -= mb; BOOST_CHECK(m.to_index()==ref_difference(a,b));
+
+    vector<int> all(n);
+    for(int i=0;i<n;++i) all[i] = i;
+    m = ma; m.invert();
+    BOOST_CHECK(m.to_index()==ref_difference(all,a));
+    BOOST_CHECK_EQUAL(m.count(),n-a.size());
+
+    m = ma;
+    m.reset(a.front());
+    m.set(a.front());
+    BOOST_CHECK(m.to_index()==a);
+    m.clear();
+    BOOST_CHECK_EQUAL(m.count(),0);
+    BOOST_CHECK(m.to_index().empty());
+
+    BOOST_CHECK_THROW(m |= Index_mask(n+1),Pteros_error);
+    BOOST_CHECK_THROW(m.set(vector<int>{n}),Pteros_error);
+}
+
+BOOST_AUTO_TEST_CASE(selection_in_place_operators)
+{
+    System sys = make_random_system(500);
+    mt19937 gen(3);
+    for(int rep=0;rep<10;++rep){
+        auto a = random_index(gen,500,0.4);
+        auto b = random_index(gen,500,0.2);
+        Selection sa(sys,a), sb(sys,b);
+
+        Selection s = sa; s |= sb; BOOST_CHECK(s.get_index()==ref_union(a,b));
+        s = sa; s &= sb; BOOST_CHECK(s.get_index()==ref_intersection(a,b));
+        s = sa; s -= sb; BOOST_CHECK(s.get_index()==ref_difference(a,b));
+
+        s = sa; s |= s; BOOST_CHECK(s.get_index()==a);
+        s = sa; s &= s; BOOST_CHECK(s.get_index()==a);
+        s = sa; s -= s; BOOST_CHECK(s.get_index().empty());
+
+        s = sa; s.append(Index_mask(500,b)); BOOST_CHECK(s.get_index()==ref_union(a,b));
+        s.modify(Index_mask(500,b)); BOOST_CHECK(s.get_index()==b);
+        BOOST_CHECK(sa.get_mask().to_index()==a);
+    }
+
+    Selection s(sys,"all");
+    BOOST_CHECK_THROW(s.append(Index_mask(499)),Pteros_error);
+    System other = make_random_system(10);
+    Selection so(other,"all");
+    BOOST_CHECK_THROW(s &= so,Pteros_error);
+    BOOST_CHECK_THROW(s -= so,Pteros_error);
+}
+
+// Parser paths, which combine operands with index operations
+BOOST_AUTO_TEST_CASE(parser_logical_and_by)
+{
+    System sys = make_topology_system(300);
+    auto ev = [&](const string& txt){ return Selection(sys,txt).get_index(); };
+    const auto& crd = sys.frame(0).coord;
+
+    BOOST_CHECK(ev("x<1.5 or resid 10 to 40")==ref_union(ev("x<1.5"),ev("resid 10 to 40")));
+    // Coordinate-dependent operand first is reordered by optimizer
+    BOOST_CHECK(ev("within 0.5 of index 0 and resid 1 to 50")
+                ==ref_intersection(ev("within 0.5 of index 0"),ev("resid 1 to 50")));
+    BOOST_CHECK(ev("x<1 and not resid 1 to 20")==ref_difference(ev("x<1"),ev("resid 1 to 20")));
+
+    auto near = ev("x<0.5");
+    vector<bool> res_used(sys.num_atoms(),false), chain_used(256,false);
+    for(int i: near){
+        res_used[sys.atom(i).resindex] = true;
+        chain_used[(unsigned char)sys.atom(i).chain] = true;
+    }
+    auto by_res = select_if(sys,[&](int i){ return res_used[sys.atom(i).resindex]; });
+    BOOST_CHECK(ev("by residue x<0.5")==by_res);
+    BOOST_CHECK(ev("resid 1 to 30 and by residue x<0.5")==ref_intersection(by_res,ev("resid 1 to 30")));
+
+    auto by_chain = select_if(sys,[&](int i){ return bool(chain_used[(unsigned char)sys.atom(i).chain]); });
+    BOOST_CHECK(ev("by chain x<0.5")==by_chain);
+
+    auto by_mol = select_if(sys,[&](int i){
+        for(int a=i/6*6; a<std::min(i/6*6+6,sys.num_atoms()); ++a) if(crd[a](0)<0.5) return true;
+        return false;
+    });
+    BOOST_CHECK(ev("by mol x<0.5")==by_mol);
+    BOOST_CHECK(ev("resid 1 to 30 and by mol x<0.5")==ref_intersection(by_mol,ev("resid 1 to 30")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/analysis/msd.h"
+#include "pteros/analysis/correlation.h"
+#include "pteros/core/pteros_error.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Random walks of n_points points in n_frames frames
+Vector_series make_walks(int n_points, int n_frames){
+    Vector_series s(n_points);
+    Matrix3Xf pos = 5.0*Matrix3Xf::Random(3,n_points);
+    for(int fr=0;fr<n_frames;++fr){
+        s.add_frame(pos);
+        pos += 0.1*Matrix3Xf::Random(3,n_points);
+    }
+    return s;
+}
+
+// Direct O(T^2) summation over time origins
+MatrixXd msd_direct(const Vector_series& s, Array3i_const_ref dims, const vector<int>& group, bool msd){
+    int n = s.num_frames();
+    int ng = group.empty() ? 1 : *max_element(group.begin(),group.end())+1;
+    MatrixXd res = MatrixXd::Zero(n,ng);
+    VectorXd num = VectorXd::Zero(ng);
+    VectorXd x(n);
+    for(int p=0;p<s.num_points();++p){
+        int g = group.empty() ? 0 : group[p];
+        num(g) += 1;
+        for(int d=0;d<3;++d){
+            if(!dims(d)) continue;
+            s.get_series(p,d,x);
+            for(int m=0;m<n;++m){
+                double sum = 0;
+                for(int t=0;t<n-m;++t)
+                    sum += msd ? (x(t+m)-x(t))*(x(t+m)-x(t)) : x(t)*x(t+m);
+                res(m,g) += sum/(n-m);
+            }
+        }
+    }
+    for(int g=0;g<ng;++g) res.col(g) /= num(g);
+    return res;
+}
+
+void check_close(const MatrixXd& a, const MatrixXd& b){
+    BOOST_REQUIRE_EQUAL(a.rows(),b.rows());
+    BOOST_REQUIRE_EQUAL(a.cols(),b.cols());
+    double err = (a-b).cwiseAbs().maxCoeff()/b.cwiseAbs().maxCoeff();
+    BOOST_CHECK_SMALL(err,1e-9);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(msd)
+
+BOOST_AUTO_TEST_CASE(fft_correlator)
+{
+    // Length is not a power of two
+    for(int n: {1,2,7,100}){
+        VectorXd x = VectorXd::Random(n);
+        VectorXd y = VectorXd::Random(n);
+        VectorXd c(n), ref(n);
+        Fft_correlator corr(n);
+        BOOST_CHECK_EQUAL(corr.size(),n);
+
+        corr.correlation(x,y,c);
+        for(int m=0;m<n;++m) ref(m) = x.head(n-m).dot(y.tail(n-m));
+        BOOST_CHECK_SMALL((c-ref).cwiseAbs().maxCoeff(),1e-12);
+
+        corr.autocorrelation(x,c);
+        for(int m=0;m<n;++m) ref(m) = x.head(n-m).dot(x.tail(n-m));
+        BOOST_CHECK_SMALL((c-ref).cwiseAbs().maxCoeff(),1e-12);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(msd_vs_direct_sum)
+{
+    auto s = make_walks(20,137);
+    check_close(msd_fft(s),msd_direct(s,fullPBC,{},true));
+    // Lateral MSD
+    Array3i xy(1,1,0);
+    check_close(msd_fft(s,xy),msd_direct(s,xy,{},true));
+    // Groups
+    vector<int> group(20);
+    for(int i=0;i<20;++i) group[i] = i%3;
+    auto res = msd_fft(s,fullPBC,group);
+    BOOST_CHECK_EQUAL(res.cols(),3);
+    check_close(res,msd_direct(s,fullPBC,group,true));
+    BOOST_CHECK_EQUAL(res(0,1),0.0);
+}
+
+BOOST_AUTO_TEST_CASE(autocorrelation_vs_direct_sum)
+{
+    auto s = make_walks(15,64);
+    check_close(vector_autocorrelation_fft(s),msd_direct(s,fullPBC,{},false));
+    Array3i z(0,0,1);
+    vector<int> group(15,0);
+    group[3] = 1;
+    check_close(vector_autocorrelation_fft(s,z,group),msd_direct(s,z,group,false));
+}
+
+BOOST_AUTO_TEST_CASE(single_frame_and_errors)
+{
+    auto s = make_walks(3,1);
+    auto res = msd_fft(s);
+    BOOST_REQUIRE_EQUAL(res.rows(),1);
+    BOOST_CHECK_EQUAL(res(0,0),0.0);
+
+    Vector_series empty(3);
+    BOOST_CHECK_THROW(msd_fft(empty),Pteros_error);
+    BOOST_CHECK_THROW(msd_fft(s,fullPBC,{0,1}),Pteros_error);
+    BOOST_CHECK_THROW(s.add_frame(Matrix3Xf::Zero(3,2)),Pteros_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
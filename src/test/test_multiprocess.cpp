@@ -0,0 +1,259 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/analysis/trajectory_reader.h"
+#include "pteros/core/selection.h"
+#include "pteros/core/mol_file.h"
+#include "pteros/core/pteros_error.h"
+#include "pteros/core/logging.h"
+#include "pteros/core/thread_pool.h"
+#include "test_utils.h"
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+
+using namespace std;
+using namespace pteros;
+
+namespace {
+
+// Parallel task running in forked worker processes.
+// Counts frames and frames with velocities. Worker dies on crash_frame.
+class Frame_counter: public Task_base {
+public:
+    Frame_counter(int crash = -1): crash_frame(crash) {}
+    Frame_counter* clone() const override { return new Frame_counter(*this); }
+
+    void pre_process() override {}
+
+    void process_frame(const Frame_info& info) override {
+        if(info.valid_frame==crash_frame) _exit(3);
+        ++n;
+        if(system.frame(0).has_vel()) ++n_vel;
+        sum += info.valid_frame;
+    }
+
+    void post_process(const Frame_info& info) override {}
+
+    void collect_results(const vector<string>& results, int n_frames) override {
+        total = n_frames;
+        for(auto& r: results){
+            istringstream s(r);
+            int a, b;
+            long c;
+            s >> a >> b >> c;
+            n += a;
+            n_vel += b;
+            sum += c;
+        }
+    }
+
+    int n = 0, n_vel = 0, total = 0;
+    long sum = 0;
+
+protected:
+    bool is_parallel() override { return true; }
+    bool is_multiprocess() override { return true; }
+    string get_result() override { return fmt::format("{} {} {}",n,n_vel,sum); }
+    void set_id(int id) override {
+        task_id = id;
+        log = create_logger(fmt::format("counter.{}",id));
+    }
+
+    int crash_frame;
+};
+
+// Serial task, which records the number of threads available to it
+class Thread_counter: public Task_base {
+public:
+    Thread_counter* clone() const override { return new Thread_counter(*this); }
+    void pre_process() override {}
+    void process_frame(const Frame_info& info) override { nt = get_num_threads(); }
+    void post_process(const Frame_info& info) override {}
+    int nt = 0;
+protected:
+    bool is_parallel() override { return false; }
+};
+
+// Records the largest number of threads running the loop body at once
+struct Concurrency_probe {
+    atomic<int> running{0};
+    atomic<int> max_running{0};
+
+    void run(int n_chunks){
+        parallel_chunks(n_chunks,[this](int){
+            int r = running.fetch_add(1)+1;
+            int m = max_running.load();
+            while(r>m && !max_running.compare_exchange_weak(m,r)){}
+            this_thread::sleep_for(chrono::milliseconds(2));
+            running.fetch_sub(1);
+        });
+    }
+};
+
+// Serial task, which runs a parallel loop on each frame
+class Loop_runner: public Task_base {
+public:
+    Loop_runner* clone() const override { return new Loop_runner(); }
+    void pre_process() override {}
+    void process_frame(const Frame_info& info) override { probe.run(16); }
+    void post_process(const Frame_info& info) override {}
+    Concurrency_probe probe;
+protected:
+    bool is_parallel() override { return false; }
+};
+
+// Pool of 4 threads regardless of the hardware
+struct Four_threads {
+    Four_threads(): saved(get_num_threads()) { set_num_threads(4); }
+    ~Four_threads(){ set_num_threads(saved); }
+    int saved;
+};
+
+// Structure and trajectories with and without velocities
+struct Trajectory_fixture {
+    Trajectory_fixture(){
+        System sys = make_random_system(50,30,3.0,true);
+        auto all = sys.select_all();
+        all.write("multiprocess.gro",0,0);
+        all.write("multiprocess.trr",0,29);
+        all.write("multiprocess.xtc",0,29);
+    }
+    ~Trajectory_fixture(){
+        for(auto f: {"multiprocess.gro","multiprocess.trr","multiprocess.xtc"}) remove(f);
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(multiprocess, Trajectory_fixture)
+
+BOOST_AUTO_TEST_CASE(all_frames_with_velocities)
+{
+    auto task = make_shared<Frame_counter>();
+    Trajectory_reader reader(make_options({"-f","multiprocess.gro","multiprocess.trr","-nt","3","-buffer","4"}));
+    reader.add_task(task);
+    reader.run();
+    BOOST_CHECK_EQUAL(task->total,30);
+    BOOST_CHECK_EQUAL(task->n,30);
+    BOOST_CHECK_EQUAL(task->n_vel,30);
+    BOOST_CHECK_EQUAL(task->sum,29*30/2);
+}
+
+BOOST_AUTO_TEST_CASE(no_velocities_in_xtc)
+{
+    auto task = make_shared<Frame_counter>();
+    Trajectory_reader reader(make_options({"-f","multiprocess.gro","multiprocess.xtc","-nt","3"}));
+    reader.add_task(task);
+    reader.run();
+    BOOST_CHECK_EQUAL(task->n,30);
+    BOOST_CHECK_EQUAL(task->n_vel,0);
+}
+
+BOOST_AUTO_TEST_CASE(content_flags)
+{
+    BOOST_CHECK(Mol_file::recognize("a.trr")->get_content_type().vel());
+    BOOST_CHECK(!Mol_file::recognize("a.xtc")->get_content_type().vel());
+}
+
+// Worker dies while the buffer has free space.
+// Should be reported as error rather than hang.
+BOOST_AUTO_TEST_CASE(dead_worker)
+{
+    auto task = make_shared<Frame_counter>(2);
+    Trajectory_reader reader(make_options({"-f","multiprocess.gro","multiprocess.trr","-nt","3","-buffer","100"}));
+    reader.add_task(task);
+    BOOST_CHECK_THROW(reader.run(),Pteros_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(thread_limit, Trajectory_fixture)
+
+// -nt applies to task threads and only for the duration of run()
+BOOST_AUTO_TEST_CASE(scoped_to_run)
+{
+    int nt = get_num_threads();
+    auto t1 = make_shared<Thread_counter>();
+    auto t2 = make_shared<Thread_counter>();
+    Trajectory_reader reader(make_options({"-f","multiprocess.gro","multiprocess.xtc","-nt","1"}));
+    reader.add_task(t1);
+    reader.add_task(t2);
+    reader.run();
+    BOOST_CHECK_EQUAL(t1->nt,1);
+    BOOST_CHECK_EQUAL(t2->nt,1);
+    BOOST_CHECK_EQUAL(get_num_threads(),nt);
+}
+
+// Limit caps the threads, which actually run the loop, not only get_num_threads()
+BOOST_AUTO_TEST_CASE(caps_running_threads)
+{
+    Four_threads four;
+    {
+        Concurrency_probe probe;
+        probe.run(64);
+        BOOST_CHECK_LE(probe.max_running.load(),4);
+    }
+    for(int n: {1,2,3}){
+        Thread_limit lim(n);
+        Concurrency_probe probe;
+        probe.run(64);
+        BOOST_CHECK_LE(probe.max_running.load(),n);
+    }
+}
+
+// Nested loops in workers inherit the limit of the outer loop
+BOOST_AUTO_TEST_CASE(caps_nested_loops)
+{
+    Four_threads four;
+    Thread_limit lim(2);
+    atomic<int> max_nt{0};
+    parallel_chunks(8,[&max_nt](int){
+        int nt = get_num_threads();
+        int m = max_nt.load();
+        while(nt>m && !max_nt.compare_exchange_weak(m,nt)){}
+        this_thread::sleep_for(chrono::milliseconds(2));
+    });
+    BOOST_CHECK_EQUAL(max_nt.load(),2);
+}
+
+BOOST_AUTO_TEST_CASE(caps_running_threads_of_task)
+{
+    Four_threads four;
+    auto task = make_shared<Loop_runner>();
+    Trajectory_reader reader(make_options({"-f","multiprocess.gro","multiprocess.xtc","-nt","2"}));
+    reader.add_task(task);
+    reader.run();
+    BOOST_CHECK_LE(task->probe.max_running.load(),2);
+    BOOST_CHECK_EQUAL(get_num_threads(),4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
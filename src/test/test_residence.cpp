@@ -0,0 +1,227 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/analysis/residence.h"
+#include "pteros/core/pteros_error.h"
+#include <random>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Presence of molecules (rows) in frames (columns)
+using Presence = Matrix<bool,Dynamic,Dynamic>;
+
+vector<int> inside_in_frame(const Presence& p, int fr){
+    vector<int> res;
+    for(int m=0;m<p.rows();++m) if(p(m,fr)) res.push_back(m);
+    return res;
+}
+
+// Fills the absences not longer than tolerance between presences
+Presence bridge(const Presence& p, int tolerance){
+    Presence res = p;
+    for(int m=0;m<p.rows();++m){
+        int last = -1; // Last frame where molecule is present
+        for(int fr=0;fr<p.cols();++fr){
+            if(!p(m,fr)) continue;
+            if(last>=0 && fr-last-1<=tolerance)
+                for(int k=last+1;k<fr;++k) res(m,k) = true;
+            last = fr;
+        }
+    }
+    return res;
+}
+
+// Survival probability by direct counting over all molecules and time origins
+VectorXd survival_direct(const Presence& p, int tolerance){
+    Presence b = bridge(p,tolerance);
+    int n = p.cols();
+    VectorXd res(n);
+    for(int lag=0;lag<n;++lag){
+        double stay = 0, total = 0;
+        for(int m=0;m<p.rows();++m){
+            for(int t=0;t+lag<n;++t){
+                if(!b(m,t)) continue;
+                ++total;
+                bool all = true;
+                for(int k=t;k<=t+lag;++k) all = all && b(m,k);
+                if(all) ++stay;
+            }
+        }
+        res(lag) = total>0 ? stay/total : 0.0;
+    }
+    return res;
+}
+
+// Molecule 0 is inside in frames 0-2, 5-6 and 9, molecule 1 in frames 3-4
+// and molecule 2 in all 10 frames
+Presence hand_made(){
+    Presence p = Presence::Constant(3,10,false);
+    for(int fr: {0,1,2,5,6,9}) p(0,fr) = true;
+    for(int fr: {3,4}) p(1,fr) = true;
+    p.row(2).fill(true);
+    return p;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(residence)
+
+BOOST_AUTO_TEST_CASE(out_of_order_and_merge)
+{
+    Presence p = hand_made();
+    // Single tracker with frames out of order
+    Residence_tracker t(3);
+    for(int fr: {9,0,5,2,7,1,3,8,6,4}) t.add_frame(fr,inside_in_frame(p,fr));
+    // Two trackers merged
+    Residence_tracker t1(3), t2(3);
+    for(int fr: {9,5,7,1,3}) t1.add_frame(fr,inside_in_frame(p,fr));
+    for(int fr: {0,2,8,6,4}) t2.add_frame(fr,inside_in_frame(p,fr));
+    t1.merge(t2);
+
+    for(auto tr: {&t,&t1}){
+        BOOST_CHECK_EQUAL(tr->num_frames(),10);
+        auto v = tr->get_visits(0);
+        BOOST_REQUIRE_EQUAL(v.size(),3);
+        BOOST_CHECK(v[0]==Vector2i(0,3));
+        BOOST_CHECK(v[1]==Vector2i(5,7));
+        BOOST_CHECK(v[2]==Vector2i(9,10));
+        BOOST_CHECK(tr->get_visits(1)==vector<Vector2i>{Vector2i(3,5)});
+        BOOST_CHECK(tr->get_visits(2)==vector<Vector2i>{Vector2i(0,10)});
+        BOOST_CHECK(tr->get_visits(0,2)==vector<Vector2i>{Vector2i(0,10)});
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hand_computed)
+{
+    Presence p = hand_made();
+    Residence_tracker t(3);
+    for(int fr=0;fr<10;++fr) t.add_frame(fr,inside_in_frame(p,fr));
+
+    VectorXi occ(10);
+    occ << 2,2,2,2,2,2,2,1,1,2;
+    BOOST_CHECK(t.occupancy()==occ);
+
+    auto st = t.get_stats();
+    BOOST_CHECK_EQUAL(st[0].num_frames,6);
+    BOOST_CHECK_EQUAL(st[0].num_visits,3);
+    BOOST_CHECK_CLOSE(st[0].mean_time,2.0,1e-4);
+    BOOST_CHECK_EQUAL(st[0].max_time,3);
+    BOOST_CHECK_EQUAL(st[1].num_visits,1);
+    BOOST_CHECK_EQUAL(st[1].max_time,2);
+    BOOST_CHECK_EQUAL(st[2].max_time,10);
+    // Both absences of molecule 0 last 2 frames
+    st = t.get_stats(2);
+    BOOST_CHECK_EQUAL(st[0].num_frames,6);
+    BOOST_CHECK_EQUAL(st[0].num_visits,1);
+    BOOST_CHECK_EQUAL(st[0].max_time,10);
+
+    VectorXi entered, left, ref_entered(10), ref_left(10);
+    t.exchange(entered,left);
+    ref_entered << 0,0,0,1,0,1,0,0,0,1;
+    ref_left    << 0,0,0,1,0,1,0,1,0,0;
+    BOOST_CHECK(entered==ref_entered);
+    BOOST_CHECK(left==ref_left);
+    // With tolerance only molecule 1 enters and leaves
+    t.exchange(entered,left,2);
+    ref_entered << 0,0,0,1,0,0,0,0,0,0;
+    ref_left    << 0,0,0,0,0,1,0,0,0,0;
+    BOOST_CHECK(entered==ref_entered);
+    BOOST_CHECK(left==ref_left);
+
+    // Lag 1: 13 continuous stays of 16 origins, lag 2: 9 of 15
+    VectorXd s = t.survival_probability(2);
+    BOOST_REQUIRE_EQUAL(s.size(),3);
+    BOOST_CHECK_CLOSE(s(0),1.0,1e-6);
+    BOOST_CHECK_CLOSE(s(1),13.0/16.0,1e-6);
+    BOOST_CHECK_CLOSE(s(2),9.0/15.0,1e-6);
+    BOOST_CHECK_SMALL((t.survival_probability()-survival_direct(p,0)).cwiseAbs().maxCoeff(),1e-12);
+    BOOST_CHECK_SMALL((t.survival_probability(-1,2)-survival_direct(p,2)).cwiseAbs().maxCoeff(),1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(random_vs_direct)
+{
+    std::mt19937 gen(42);
+    std::bernoulli_distribution inside(0.6);
+    int nm = 30, n = 80;
+    Presence p(nm,n);
+    for(int m=0;m<nm;++m) for(int fr=0;fr<n;++fr) p(m,fr) = inside(gen);
+
+    // Frames start from non-zero frame and are split between two trackers
+    Residence_tracker t1(nm), t2(nm);
+    for(int fr=n-1;fr>=0;--fr){
+        auto& t = (fr%3) ? t1 : t2;
+        t.add_frame(fr+5,inside_in_frame(p,fr));
+    }
+    t1.merge(t2);
+    BOOST_CHECK_EQUAL(t1.num_frames(),n);
+
+    VectorXi occ = p.cast<int>().colwise().sum().transpose();
+    BOOST_CHECK(t1.occupancy()==occ);
+
+    for(int tol: {0,1,3}){
+        VectorXd s = t1.survival_probability(-1,tol);
+        BOOST_CHECK_SMALL((s-survival_direct(p,tol)).cwiseAbs().maxCoeff(),1e-12);
+
+        Presence b = bridge(p,tol);
+        VectorXi entered, left;
+        t1.exchange(entered,left,tol);
+        for(int fr=1;fr<n;++fr){
+            int e = 0, l = 0;
+            for(int m=0;m<nm;++m){
+                if(b(m,fr) && !b(m,fr-1)) ++e;
+                if(!b(m,fr) && b(m,fr-1)) ++l;
+            }
+            BOOST_CHECK_EQUAL(entered(fr),e);
+            BOOST_CHECK_EQUAL(left(fr),l);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    Residence_tracker t(2);
+    BOOST_CHECK_THROW(t.occupancy(),Pteros_error);
+    t.add_frame(0,{0});
+    BOOST_CHECK_THROW(t.add_frame(0,{1}),Pteros_error);
+    BOOST_CHECK_THROW(t.add_frame(1,{2}),Pteros_error);
+    t.add_frame(3,{1});
+    // Frames 1 and 2 are missing
+    BOOST_CHECK_THROW(t.get_stats(),Pteros_error);
+
+    Residence_tracker other(2);
+    other.add_frame(3,{0});
+    BOOST_CHECK_THROW(t.merge(other),Pteros_error);
+    BOOST_CHECK_THROW(t.merge(Residence_tracker(3)),Pteros_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "test_utils.h"
+#include "pteros/core/selection.h"
+
+using namespace std;
+using namespace pteros;
+
+BOOST_AUTO_TEST_SUITE(selection_profiling)
+
+// Returns profile of given selection text, n_evaluated is -1 if not found
+static Selection_profile find_entry(const System& sys, const string& text){
+    for(auto& p: sys.get_selection_profile()) if(p.text==text) return p;
+    Selection_profile p;
+    p.n_evaluated = -1;
+    return p;
+}
+
+BOOST_AUTO_TEST_CASE(switched_on_after_parsing)
+{
+    System sys = make_random_system(100,2);
+    Selection sel(sys,"x<1.5");
+    sys.set_selection_profiling(true);
+    sel.set_frame(1);
+    sel.apply();
+
+    auto p = find_entry(sys,"x<1.5");
+    BOOST_REQUIRE_NE(p.n_evaluated, -1);
+    BOOST_CHECK_EQUAL(p.n_parsed, 0);
+    BOOST_CHECK_EQUAL(p.n_evaluated, 2);
+    BOOST_CHECK_EQUAL(p.last_size, sel.size());
+}
+
+BOOST_AUTO_TEST_CASE(switched_off_after_parsing)
+{
+    System sys = make_random_system(100,2);
+    sys.set_selection_profiling(true);
+    Selection sel(sys,"x<1.5");
+    auto p = find_entry(sys,"x<1.5");
+    BOOST_REQUIRE_NE(p.n_evaluated, -1);
+    BOOST_CHECK_EQUAL(p.n_parsed, 1);
+    BOOST_CHECK_EQUAL(p.n_evaluated, 1);
+
+    sys.set_selection_profiling(false);
+    sel.set_frame(1);
+    BOOST_CHECK(sys.get_selection_profile().empty());
+
+    // Restarted profiling accounts only new evaluations
+    sys.set_selection_profiling(true);
+    sel.apply();
+    p = find_entry(sys,"x<1.5");
+    BOOST_REQUIRE_NE(p.n_evaluated, -1);
+    BOOST_CHECK_EQUAL(p.n_parsed, 0);
+    BOOST_CHECK_EQUAL(p.n_evaluated, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
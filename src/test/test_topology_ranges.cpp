@@ -0,0 +1,196 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/core/selection.h"
+#include "pteros/core/pteros_error.h"
+#include "test_utils.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// 60 atoms in 20 contiguous residues of 3 atoms and 10 molecules of 2 residues
+System make_residue_system(){
+    System sys = make_random_system(60);
+    for(int i=0;i<sys.num_atoms();++i) sys.atom(i).resid = i/3+1;
+    sys.assign_resindex();
+    auto& ff = sys.get_force_field();
+    for(int i=0;i<sys.num_atoms();i+=6) ff.molecules.emplace_back(i,i+5);
+    ff.ready = true;
+    return sys;
+}
+
+vector<vector<int>> indexes(const vector<Selection>& sels){
+    vector<vector<int>> res;
+    for(const auto& s: sels) res.push_back(s.get_index());
+    return res;
+}
+
+// All atoms with the same resindex as any atom of sel
+vector<int> by_residue_direct(const Selection& sel){
+    const System& sys = *sel.get_system();
+    vector<int> res;
+    for(int i=0;i<sys.num_atoms();++i){
+        for(int j=0;j<sel.size();++j){
+            if(sys.atom(i).resindex==sel.resindex(j)){
+                res.push_back(i);
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(topology_ranges)
+
+BOOST_AUTO_TEST_CASE(residues)
+{
+    System sys = make_residue_system();
+    BOOST_CHECK_EQUAL(sys.num_residues(),20);
+    BOOST_CHECK(sys.get_topology_ranges()->contiguous);
+    for(int r=0;r<20;++r) BOOST_CHECK(sys.residue_range(r)==Vector2i(3*r,3*r+2));
+    BOOST_CHECK_THROW(sys.residue_range(20),Pteros_error);
+    BOOST_CHECK_THROW(sys.residue_range(-1),Pteros_error);
+
+    const auto& mol = sys.get_topology_ranges()->atom_molecule;
+    BOOST_REQUIRE_EQUAL(mol.size(),60);
+    for(int i=0;i<60;++i) BOOST_CHECK_EQUAL(mol[i],i/6);
+}
+
+BOOST_AUTO_TEST_CASE(each_residue_contiguous)
+{
+    System sys = make_residue_system();
+    Selection sel(sys,vector<int>{1,2,7,30,59});
+    vector<Selection> res;
+    sel.each_residue(res);
+    BOOST_CHECK((indexes(res)==vector<vector<int>>{{0,1,2},{6,7,8},{30,31,32},{57,58,59}}));
+}
+
+BOOST_AUTO_TEST_CASE(each_residue_non_contiguous)
+{
+    System sys = make_residue_system();
+    // Residue 0 is split by atom of residue 1
+    sys.atom(1).resindex = 1;
+    sys.atom(3).resindex = 0;
+    BOOST_CHECK(!sys.get_topology_ranges()->contiguous);
+    BOOST_CHECK_THROW(sys.residue_range(0),Pteros_error);
+
+    Selection sel(sys,vector<int>{0,10});
+    vector<Selection> res;
+    sel.each_residue(res);
+    // Atoms of residue adjacent to the atom are found
+    BOOST_CHECK((indexes(res)==vector<vector<int>>{{0},{9,10,11}}));
+}
+
+BOOST_AUTO_TEST_CASE(split_by_molecule)
+{
+    System sys = make_residue_system();
+    Selection sel(sys,vector<int>{0,5,6,20,21,40});
+    vector<Selection> res;
+    sel.split_by_molecule(res);
+    BOOST_CHECK((indexes(res)==vector<vector<int>>{{0,5},{6},{20,21},{40}}));
+
+    // Atoms outside of molecules are skipped
+    sys.get_force_field().molecules.resize(3);
+    res.clear();
+    sel.split_by_molecule(res);
+    BOOST_CHECK((indexes(res)==vector<vector<int>>{{0,5},{6}}));
+
+    sys.get_force_field().ready = false;
+    BOOST_CHECK_THROW(sel.split_by_molecule(res),Pteros_error);
+}
+
+BOOST_AUTO_TEST_CASE(parser_by_residue)
+{
+    System sys = make_residue_system();
+    for(string txt: {"x<1","index 0 7 59","resid 3 and x<1.5"}){
+        Selection sel(sys,txt);
+        BOOST_CHECK(Selection(sys,"by residue ("+txt+")").get_index()==by_residue_direct(sel));
+        // With starting subset
+        Selection sub(sys,"resid 1 to 10 and by residue ("+txt+")");
+        auto expected = by_residue_direct(sel);
+        expected.erase(remove_if(expected.begin(),expected.end(),[](int i){ return i>=30; }),expected.end());
+        BOOST_CHECK(sub.get_index()==expected);
+    }
+
+    // Non-contiguous residues
+    sys.atom(1).resindex = 1;
+    sys.atom(3).resindex = 0;
+    BOOST_CHECK((Selection(sys,"by residue index 0").get_index()==vector<int>{0,2,3}));
+}
+
+BOOST_AUTO_TEST_CASE(cache_invalidation)
+{
+    System sys = make_residue_system();
+    auto r1 = sys.get_topology_ranges();
+
+    // Read-only access keeps the cache
+    const System& csys = sys;
+    float m = 0;
+    for(int i=0;i<csys.num_atoms();++i) m += csys.atom(i).mass;
+    Selection sel(sys,"all");
+    for(const auto& a: sel) m += a.mass();
+    vector<Selection> res;
+    sel.each_residue(res);
+    sel.split_by_residue(res);
+    sel.split_by_molecule(res);
+    Selection(sys,"by residue index 5");
+    BOOST_CHECK(sys.get_topology_ranges()==r1);
+
+    // Atom modification rebuilds residues
+    for(int i=0;i<sys.num_atoms();++i) sys.atom(i).resid = i/6+1;
+    sys.assign_resindex();
+    auto r2 = sys.get_topology_ranges();
+    BOOST_CHECK(r2!=r1);
+    BOOST_CHECK_EQUAL(sys.num_residues(),10);
+    BOOST_CHECK(sys.residue_range(1)==Vector2i(6,11));
+
+    // Force field modification rebuilds molecules
+    sys.get_force_field().molecules = {Vector2i(0,29),Vector2i(30,59)};
+    auto r3 = sys.get_topology_ranges();
+    BOOST_CHECK(r3!=r2);
+    BOOST_CHECK_EQUAL(r3->atom_molecule[29],0);
+    BOOST_CHECK_EQUAL(r3->atom_molecule[30],1);
+
+    // Deleting atoms rebuilds everything. Resindexes are not reassigned.
+    sys.atoms_delete({0,1,2,3,4,5});
+    BOOST_CHECK_EQUAL(sys.num_residues(),10);
+    BOOST_CHECK_THROW(sys.residue_range(0),Pteros_error);
+    BOOST_CHECK(sys.residue_range(1)==Vector2i(0,5));
+    auto r4 = sys.get_topology_ranges();
+    BOOST_CHECK_EQUAL(r4->atom_molecule.size(),54);
+    BOOST_CHECK_EQUAL(r4->atom_molecule[23],0);
+    BOOST_CHECK_EQUAL(r4->atom_molecule[24],1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,171 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "pteros/core/unwrap_plan.h"
+#include "pteros/core/pteros_error.h"
+#include "test_utils.h"
+#include <set>
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+namespace {
+
+// Reference unwrapping by bonds, which walks the bonds of each frame anew.
+// This is the algorithm used by Selection::unwrap_bonds() before Unwrap_plan.
+int unwrap_bonds_direct(Selection& sel, int pbc_atom){
+    vector<vector<int>> con = sel.get_internal_bonds(0,true);
+    vector<int> used(sel.size(),0);
+    const Periodic_box& b = sel.box();
+    int Nparts = 1;
+    int Nused = 1;
+    set<int> todo;
+    todo.insert(pbc_atom);
+    used[pbc_atom] = 1;
+    for(;;){
+        while(!todo.empty()){
+            int cur = *todo.begin();
+            todo.erase(todo.begin());
+            for(int i: con[cur]){
+                if(used[i]) continue;
+                sel.xyz(i) = b.closest_image(sel.xyz(i),sel.xyz(cur),fullPBC);
+                todo.insert(i);
+                used[i] = 1;
+                ++Nused;
+            }
+        }
+        if(Nused==sel.size()) break;
+        int i = 0;
+        while(used[i]) ++i;
+        todo.insert(i);
+        used[i] = 1;
+        ++Nused;
+        ++Nparts;
+    }
+    return Nparts;
+}
+
+// Linear chains of chain_len atoms with bonds in topology.
+// Each frame contains different random walks wrapped into the box.
+System make_chains(int nchains, int chain_len, int nframes){
+    float box = 3.0;
+    System sys = make_random_system(nchains*chain_len,nframes,box);
+    auto& ff = sys.get_force_field();
+    for(int c=0;c<nchains;++c){
+        for(int i=0;i<chain_len-1;++i) ff.bonds.push_back(Vector2i(c*chain_len+i,c*chain_len+i+1));
+    }
+    ff.ready = true;
+
+    for(int fr=0;fr<nframes;++fr){
+        auto& crd = sys.frame(fr).coord;
+        for(int c=0;c<nchains;++c){
+            // Start from random point, step is 0.15 nm
+            for(int i=1;i<chain_len;++i)
+                crd[c*chain_len+i] = crd[c*chain_len+i-1]+0.15*Vector3f::Random().normalized();
+        }
+    }
+
+    Selection all(sys,"all");
+    for(int fr=0;fr<nframes;++fr){
+        all.set_frame(fr);
+        all.wrap();
+    }
+    return sys;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(unwrap_plan)
+
+BOOST_AUTO_TEST_CASE(matches_direct_unwrap)
+{
+    int nframes = 5;
+    System sys = make_chains(20,30,nframes);
+    System ref = sys;
+    System orig = sys;
+    Selection sel(sys,"all");
+    Selection ref_sel(ref,"all");
+
+    // Plan is created once and reused in all frames
+    int pbc_atom = sel.size()/2;
+    Unwrap_plan plan(sel,0,pbc_atom);
+    BOOST_CHECK_EQUAL(plan.num_atoms(),sel.size());
+
+    for(int fr=0;fr<nframes;++fr){
+        sel.set_frame(fr);
+        ref_sel.set_frame(fr);
+        plan.apply(sel);
+        int nparts = unwrap_bonds_direct(ref_sel,pbc_atom);
+        BOOST_CHECK_EQUAL(plan.num_pieces(),nparts);
+        BOOST_CHECK_SMALL((sel.get_xyz()-ref_sel.get_xyz()).cwiseAbs().maxCoeff(), 1e-5f);
+    }
+
+    // Chains crossed the box boundaries, so unwrapping did change coordinates
+    Selection orig_sel(orig,"all");
+    orig_sel.set_frame(nframes-1);
+    BOOST_CHECK_GT((orig_sel.get_xyz()-sel.get_xyz()).cwiseAbs().maxCoeff(), 1.0f);
+
+    // All bonds are unbroken
+    float max_bond = 0;
+    for(auto& b: sys.get_force_field().bonds)
+        max_bond = std::max(max_bond,(sys.xyz(b(0),nframes-1)-sys.xyz(b(1),nframes-1)).norm());
+    BOOST_CHECK_LE(max_bond,0.1501);
+}
+
+BOOST_AUTO_TEST_CASE(matches_unwrap_bonds)
+{
+    System sys = make_chains(10,50,1);
+    System ref = sys;
+    System sys2 = sys;
+    Selection sel(sys,"index 100-399");
+    Selection ref_sel(ref,"index 100-399");
+
+    Unwrap_plan plan(sel);
+    plan.apply(sel);
+    int nparts = unwrap_bonds_direct(ref_sel,ref_sel.size()/2);
+    BOOST_CHECK_EQUAL(plan.num_pieces(),nparts);
+    BOOST_CHECK_EQUAL(nparts,6);
+    BOOST_CHECK_SMALL((sel.get_xyz()-ref_sel.get_xyz()).cwiseAbs().maxCoeff(), 1e-5f);
+
+    // Selection::unwrap_bonds() gives the same
+    Selection sel2(sys2,"index 100-399");
+    BOOST_CHECK_EQUAL(sel2.unwrap_bonds(0),nparts);
+    BOOST_CHECK_SMALL((sel2.get_xyz()-ref_sel.get_xyz()).cwiseAbs().maxCoeff(), 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE(mismatched_system)
+{
+    System sys = make_chains(2,10,1);
+    Unwrap_plan plan(Selection(sys,"all"));
+    System small = make_chains(1,10,1);
+    BOOST_CHECK_THROW(plan.apply(small,0),Pteros_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,72 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#include "test_utils.h"
+#include "pteros/core/selection.h"
+
+using namespace std;
+using namespace pteros;
+using namespace Eigen;
+
+System pteros::make_random_system(int n, int nframes, float box, bool with_vel)
+{
+    System sys;
+    vector<Atom> atoms(n);
+    vector<Vector3f> crd(n);
+    for(int i=0;i<n;++i){
+        atoms[i].name = "A";
+        atoms[i].resname = "RES";
+        atoms[i].resid = i+1;
+        atoms[i].resindex = i;
+        atoms[i].mass = 1.0;
+        crd[i] = 0.5*box*(Vector3f::Random(3)+Vector3f::Ones());
+    }
+    sys.atoms_add(atoms,crd);
+    sys.box(0).set_matrix(box*Matrix3f::Identity());
+    if(with_vel) sys.frame(0).vel.assign(n,Vector3f::Zero());
+
+    for(int fr=1;fr<nframes;++fr){
+        Frame f = sys.frame(0);
+        f.time = fr;
+        for(auto& v: f.coord) v = 0.5*box*(Vector3f::Random(3)+Vector3f::Ones());
+        for(auto& v: f.vel) v = Vector3f::Constant(fr);
+        sys.frame_append(f);
+    }
+    return sys;
+}
+
+Options pteros::make_options(const vector<string>& args)
+{
+    vector<string> a = args;
+    a.insert(a.begin(),"test");
+    vector<char*> argv;
+    for(auto& s: a) argv.push_back(&s[0]);
+    Options opt;
+    parse_command_line(argv.size(),argv.data(),opt);
+    return opt;
+}
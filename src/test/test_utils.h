@@ -0,0 +1,48 @@
+/*
+ * This file is a part of
+ *
+ * ============================================
+ * ###   Pteros molecular modeling library  ###
+ * ============================================
+ *
+ * https://github.com/yesint/pteros
+ *
+ * (C) 2009-2020, Semen Yesylevskyy
+ *
+ * All works, which use Pteros, should cite the following papers:
+ *  
+ *  1.  Semen O. Yesylevskyy, "Pteros 2.0: Evolution of the fast parallel
+ *      molecular analysis library for C++ and python",
+ *      Journal of Computational Chemistry, 2015, 36(19), 1480–1488.
+ *      doi: 10.1002/jcc.23943.
+ *
+ *  2.  Semen O. Yesylevskyy, "Pteros: Fast and easy to use open-source C++
+ *      library for molecular analysis",
+ *      Journal of Computational Chemistry, 2012, 33(19), 1632–1636.
+ *      doi: 10.1002/jcc.22989.
+ *
+ * This is free software distributed under Artistic License:
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ *
+*/
+
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include "pteros/core/system.h"
+#include "pteros/analysis/options.h"
+#include <string>
+#include <vector>
+
+namespace pteros {
+
+/// System of n atoms in cubic box of given size with random coordinates
+/// and nframes frames. If with_vel is true frames also contain velocities.
+System make_random_system(int n, int nframes = 1, float box = 3.0, bool with_vel = false);
+
+/// Parses command line given as vector of strings
+Options make_options(const std::vector<std::string>& args);
+
+}
+
+#endif
@@ -630,7 +630,10 @@ int xdr_xtc_seek_time(float time, XDRFILE* handle, int natoms, bool bSeekForward
 int check_trr_content(XDRFILE* handle, int* natoms, int* xsz, int* vsz, int* fsz)
 {
     t_trnheader sh;
+    // Header is read ahead, so restore position for reading the frame
+    int64_t pos = xdr_tell(handle);
     int  ret = do_trnheader(handle,1,&sh);
+    xdr_seek(handle,pos,SEEK_SET);
     if(ret != exdrOK) return ret;
 
     *natoms = sh.natoms;